@@ -0,0 +1,194 @@
+// avl_map_t/avl_set_t operations against a sorted array, plus the generic map
+// against a GBC_AVL_DECLARE map on int keys.
+// build: cc -O2 -o bench_gbc_avl bench/bench_gbc_avl.c
+// run:   ./bench_gbc_avl [--min 1e3] [--max 1e8] [--filter avl_map_get]
+#include "../include/gbc_avl.h"
+#include "gbc_bench.h"
+
+#define MAX_KEY_SIZE 64
+#define QUADRATIC_OPS 1000
+
+// keys of every size order by their leading uint32
+static int u32_key_cmp(const void *a, const void *b) {
+  uint32_t x, y;
+  memcpy(&x, a, sizeof(x));
+  memcpy(&y, b, sizeof(y));
+  return (x > y) - (x < y);
+}
+
+static int int_cmp(const void *a, const void *b) {
+  const int *_a = (int *)a;
+  const int *_b = (int *)b;
+  return GBC_AVL_CMP_NUM(*_a, *_b);
+}
+
+GBC_AVL_DECLARE(int_map, int, int, GBC_AVL_CMP_NUM)
+
+// distinct keys in a scrambled order, i * odd is a bijection modulo 2^32
+static char *make_keys(size_t n, size_t key_size) {
+  char *keys = (char *)calloc(n, key_size);
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t k = (uint32_t)(i * 2654435761u);
+    memcpy(keys + i * key_size, &k, sizeof(k));
+  }
+  return keys;
+}
+
+static void bench_map(bench_t *b, size_t n, size_t key_size) {
+  const bench_cfg_t *cfg = b->cfg;
+  char *keys = make_keys(n, key_size);
+  uint64_t val = 0;
+  avl_map_t *map = avl_map_new(key_size, sizeof(val), u32_key_cmp);
+
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) avl_map_add(map, keys + i * key_size, &val);
+  bench_end(b, "avl_map_add", n, key_size, n);
+
+  if (bench_enabled(cfg, "avl_map_get")) {
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i)
+      sum += *(uint64_t *)avl_map_get(map, keys + i * key_size);
+    bench_end(b, "avl_map_get", n, key_size, n);
+    bench_do_not_optimize(&sum);
+  }
+
+  if (bench_enabled(cfg, "avl_map_get_miss")) {
+    size_t hits = 0;
+    char miss[MAX_KEY_SIZE] = {0};
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) {
+      // odd multiples of the key stride never collide with a stored key
+      uint32_t k = (uint32_t)((n + i) * 2654435761u);
+      memcpy(miss, &k, sizeof(k));
+      hits += avl_map_contains(map, miss);
+    }
+    bench_end(b, "avl_map_get_miss", n, key_size, n);
+    bench_do_not_optimize(&hits);
+  }
+
+  if (bench_enabled(cfg, "avl_map_iter")) {
+    uint64_t sum = 0;
+    bench_begin(b);
+    avl_map_iter_t *iter = avl_map_iter_new(map);
+    while (avl_map_iter_has_next(iter))
+      sum += *(uint8_t *)avl_map_iter_next(iter)->key;
+    avl_map_iter_drop(iter);
+    bench_end(b, "avl_map_iter", n, key_size, n);
+    bench_do_not_optimize(&sum);
+  }
+
+  if (bench_enabled(cfg, "sorted_array_get")) {
+    char *sorted = (char *)malloc(n * key_size);
+    memcpy(sorted, keys, n * key_size);
+    qsort(sorted, n, key_size, u32_key_cmp);
+    size_t found = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) {
+      found += bsearch(keys + i * key_size, sorted, n, key_size,
+                       u32_key_cmp) != NULL;
+    }
+    bench_end(b, "sorted_array_get", n, key_size, n);
+    bench_do_not_optimize(&found);
+
+    // inserting into a sorted array moves half of it on average
+    size_t edits = (n < QUADRATIC_OPS) ? n : QUADRATIC_OPS;
+    sorted = (char *)realloc(sorted, (n + edits) * key_size);
+    size_t size = n;
+    char key[MAX_KEY_SIZE] = {0};
+    bench_begin(b);
+    for (size_t i = 0; i < edits; ++i) {
+      uint32_t k = (uint32_t)((n + i) * 2654435761u);
+      memcpy(key, &k, sizeof(k));
+      size_t lo = 0, hi = size;
+      while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (u32_key_cmp(sorted + mid * key_size, key) < 0)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      memmove(sorted + (lo + 1) * key_size, sorted + lo * key_size,
+              (size - lo) * key_size);
+      memcpy(sorted + lo * key_size, key, key_size);
+      size++;
+    }
+    bench_end(b, "sorted_array_insert", n, key_size, edits);
+    free(sorted);
+  }
+
+  if (bench_enabled(cfg, "avl_map_del")) {
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) avl_map_del(map, keys + i * key_size);
+    bench_end(b, "avl_map_del", n, key_size, n);
+  }
+  avl_map_drop(map);
+  free(map);
+
+  if (bench_enabled(cfg, "avl_set_")) {
+    // two sets sharing half of their keys
+    avl_set_t *s1 = avl_set_new(key_size, u32_key_cmp);
+    avl_set_t *s2 = avl_set_new(key_size, u32_key_cmp);
+    for (size_t i = 0; i < n; ++i) {
+      if (i < n * 3 / 4) avl_set_add(s1, keys + i * key_size);
+      if (i >= n / 4) avl_set_add(s2, keys + i * key_size);
+    }
+    bench_begin(b);
+    avl_set_t *u = avl_set_union(s1, s2);
+    bench_end(b, "avl_set_union", n, key_size, n);
+    bench_begin(b);
+    avl_set_t *in = avl_set_intersection(s1, s2);
+    bench_end(b, "avl_set_intersection", n, key_size, n);
+    bench_begin(b);
+    avl_set_t *d = avl_set_diff(s1, s2);
+    bench_end(b, "avl_set_diff", n, key_size, n);
+    avl_set_drop(u);
+    avl_set_drop(in);
+    avl_set_drop(d);
+    avl_set_drop(s1);
+    avl_set_drop(s2);
+  }
+  free(keys);
+}
+
+static void bench_typed_map(bench_t *b, size_t n) {
+  int *keys = (int *)make_keys(n, sizeof(int));
+  int_map_t *typed = int_map_new();
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) int_map_add(typed, keys[i], keys[i]);
+  bench_end(b, "int_map_add", n, sizeof(int), n);
+
+  int64_t sum = 0;
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) sum += *int_map_get(typed, keys[i]);
+  bench_end(b, "int_map_get", n, sizeof(int), n);
+
+  avl_map_t *generic = avl_map_new(sizeof(int), sizeof(int), int_cmp);
+  for (size_t i = 0; i < n; ++i) avl_map_add(generic, &keys[i], &keys[i]);
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) sum += *(int *)avl_map_get(generic, &keys[i]);
+  bench_end(b, "avl_map_get_int", n, sizeof(int), n);
+  bench_do_not_optimize(&sum);
+
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) int_map_del(typed, keys[i]);
+  bench_end(b, "int_map_del", n, sizeof(int), n);
+  int_map_drop(typed);
+  avl_map_drop(generic);
+  free(generic);
+  free(keys);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  size_t key_sizes[] = {4, 16, MAX_KEY_SIZE};
+  bench_foreach_size(&cfg, n) {
+    for (int i = 0; i < 3; ++i) bench_map(&b, n, key_sizes[i]);
+    if (bench_enabled(&cfg, "int_map")) bench_typed_map(&b, n);
+  }
+  bench_fini(&b);
+  return 0;
+}
@@ -0,0 +1,113 @@
+// bitset_t against avl_set_t on a dense universe of n small integers, and the
+// word kernels at each dispatch level.
+// build: cc -O2 -o bench_gbc_bitset bench/bench_gbc_bitset.c
+// run:   ./bench_gbc_bitset [--min 1e3] [--max 1e7] [--filter and]
+#include "../include/gbc_avl.h"
+#include "../include/gbc_bitset.h"
+#include "gbc_bench.h"
+
+static int size_cmp(const void *a, const void *b) {
+  size_t x = *(const size_t *)a, y = *(const size_t *)b;
+  return (x > y) - (x < y);
+}
+
+// half of the universe, in a scrambled order
+static void make_keys(size_t *keys, size_t n, uint64_t seed) {
+  for (size_t i = 0; i < n / 2; ++i) keys[i] = bench_rand(&seed) % n;
+}
+
+static void bench_bitset(bench_t *b, size_t n) {
+  const bench_cfg_t *cfg = b->cfg;
+  size_t obj_size = sizeof(size_t), half = n / 2;
+  size_t *keys = (size_t *)malloc(half * sizeof(size_t) + 1);
+  size_t *keys2 = (size_t *)malloc(half * sizeof(size_t) + 1);
+  make_keys(keys, n, 1);
+  make_keys(keys2, n, 2);
+  size_t sink = 0;
+  char name[64];
+
+  bitset_t *bs = bitset_new(n), *bs2 = bitset_new(n);
+  avl_set_t *s = avl_set_new(obj_size, size_cmp);
+  avl_set_t *s2 = avl_set_new(obj_size, size_cmp);
+  bench_begin(b);
+  for (size_t i = 0; i < half; ++i) bitset_set(bs, keys[i]);
+  bench_end(b, "bitset_set", n, obj_size, half);
+  bench_begin(b);
+  for (size_t i = 0; i < half; ++i) avl_set_add(s, &keys[i]);
+  bench_end(b, "avl_set_add", n, obj_size, half);
+  for (size_t i = 0; i < half; ++i) {
+    bitset_set(bs2, keys2[i]);
+    avl_set_add(s2, &keys2[i]);
+  }
+
+  if (bench_enabled(cfg, "bitset_test")) {
+    bench_begin(b);
+    for (size_t i = 0; i < half; ++i) sink += bitset_test(bs, keys2[i]);
+    bench_end(b, "bitset_test", n, obj_size, half);
+  }
+  if (bench_enabled(cfg, "avl_set_contains")) {
+    bench_begin(b);
+    for (size_t i = 0; i < half; ++i) sink += avl_set_contains(s, &keys2[i]);
+    bench_end(b, "avl_set_contains", n, obj_size, half);
+  }
+  if (bench_enabled(cfg, "avl_set_intersection")) {
+    bench_begin(b);
+    avl_set_t *i = avl_set_intersection(s, s2);
+    bench_end(b, "avl_set_intersection", n, obj_size, n);
+    sink += i->map->size;
+    avl_set_drop(i);
+  }
+  if (bench_enabled(cfg, "bitset_foreach")) {
+    bench_begin(b);
+    GBC_BITSET_FOREACH(i, bs) { sink += i; }
+    bench_end(b, "bitset_foreach", n, obj_size, n);
+  }
+
+  // the word kernels, per bit of the universe
+  const char *levels[] = {"_scalar", "_avx2"};
+  for (int l = 0; l < 2; ++l) {
+    gbc_cpu_force_level(l ? GBC_CPU_AVX2 : GBC_CPU_SCALAR);
+    snprintf(name, sizeof(name), "bitset_and%s", levels[l]);
+    if (bench_enabled(cfg, name)) {
+      bitset_t *c = bitset_clone(bs);
+      bench_begin(b);
+      bitset_and(c, bs2);
+      bench_end(b, name, n, obj_size, n);
+      sink += c->words[0];
+      bitset_drop(c);
+    }
+    snprintf(name, sizeof(name), "bitset_and_count%s", levels[l]);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      sink += bitset_and_count(bs, bs2);
+      bench_end(b, name, n, obj_size, n);
+    }
+    snprintf(name, sizeof(name), "bitset_rank%s", levels[l]);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      for (size_t i = 0; i < 1000; ++i) {
+        sink += bitset_rank(bs, keys2[i % half]);
+      }
+      bench_end(b, name, n, obj_size, 1000);
+    }
+  }
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+
+  bench_do_not_optimize(&sink);
+  free(keys);
+  free(keys2);
+  bitset_drop(bs);
+  bitset_drop(bs2);
+  avl_set_drop(s);
+  avl_set_drop(s2);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  bench_foreach_size(&cfg, n) { bench_bitset(&b, n); }
+  bench_fini(&b);
+  return 0;
+}
@@ -0,0 +1,147 @@
+// chashmap_t against an avl_map_t behind one global rwlock, from 1 to 64
+// threads at 100%, 95% and 50% reads. The writes alternate inserts and
+// erases so the size stays near n. ns_per_op is wall time over all the
+// threads' operations, so it falls as they scale.
+// build: cc -O2 -pthread -o bench_gbc_chashmap bench/bench_gbc_chashmap.c
+// run:   ./bench_gbc_chashmap [--min 1e3] [--max 1e6] [--filter r95]
+#include "../include/gbc_avl.h"
+#include "../include/gbc_chashmap.h"
+#include "gbc_bench.h"
+
+#define BENCH_MAX_THREADS 64
+// operations per thread and size, so every thread count does the same work
+#define BENCH_OPS_PER_N 4
+
+static int u64_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/// @brief the map under test, either kind
+typedef struct {
+  chashmap_t *cmap;
+  avl_map_t *amap;
+  pthread_rwlock_t lock;
+} bench_map_t;
+
+typedef struct {
+  bench_map_t *m;
+  size_t n;
+  size_t ops;
+  int read_percent;
+  uint64_t seed;
+  size_t sink;
+} bench_worker_t;
+
+static void *chashmap_worker(void *p) {
+  bench_worker_t *w = (bench_worker_t *)p;
+  uint64_t val;
+  for (size_t i = 0; i < w->ops; ++i) {
+    uint64_t r = bench_rand(&w->seed);
+    uint64_t key = r % (2 * w->n);
+    if ((int)((r >> 32) % 100) < w->read_percent) {
+      w->sink += chashmap_get(w->m->cmap, &key, &val);
+    } else if (i & 1) {
+      w->sink += chashmap_insert(w->m->cmap, &key, &key);
+    } else {
+      w->sink += chashmap_erase(w->m->cmap, &key, NULL);
+    }
+  }
+  return NULL;
+}
+
+static void *avl_worker(void *p) {
+  bench_worker_t *w = (bench_worker_t *)p;
+  for (size_t i = 0; i < w->ops; ++i) {
+    uint64_t r = bench_rand(&w->seed);
+    uint64_t key = r % (2 * w->n);
+    if ((int)((r >> 32) % 100) < w->read_percent) {
+      pthread_rwlock_rdlock(&w->m->lock);
+      const uint64_t *val = (const uint64_t *)avl_map_get(w->m->amap, &key);
+      w->sink += val ? *val : 0;
+      pthread_rwlock_unlock(&w->m->lock);
+    } else {
+      pthread_rwlock_wrlock(&w->m->lock);
+      w->sink += (i & 1) ? avl_map_add(w->m->amap, &key, &key)
+                         : avl_map_del(w->m->amap, &key);
+      pthread_rwlock_unlock(&w->m->lock);
+    }
+  }
+  return NULL;
+}
+
+static size_t run_threads(void *(*fn)(void *), bench_map_t *m, size_t n,
+                          size_t threads, int read_percent) {
+  pthread_t tids[BENCH_MAX_THREADS];
+  bench_worker_t workers[BENCH_MAX_THREADS];
+  size_t sink = 0;
+  for (size_t t = 0; t < threads; ++t) {
+    workers[t].m = m;
+    workers[t].n = n;
+    workers[t].ops = BENCH_OPS_PER_N * n / threads;
+    workers[t].read_percent = read_percent;
+    workers[t].seed = t + 1;
+    workers[t].sink = 0;
+    pthread_create(&tids[t], NULL, fn, &workers[t]);
+  }
+  for (size_t t = 0; t < threads; ++t) {
+    pthread_join(tids[t], NULL);
+    sink += workers[t].sink;
+  }
+  return sink;
+}
+
+static void bench_chashmap(bench_t *b, size_t n) {
+  const bench_cfg_t *cfg = b->cfg;
+  size_t obj_size = sizeof(uint64_t), ops = BENCH_OPS_PER_N * n;
+  size_t sink = 0;
+  char name[64];
+
+  bench_map_t m;
+  m.cmap = chashmap_new(obj_size, obj_size, NULL, NULL);
+  m.amap = avl_map_new(obj_size, obj_size, u64_cmp);
+  pthread_rwlock_init(&m.lock, NULL);
+  bench_begin(b);
+  for (uint64_t key = 0; key < 2 * n; key += 2) {
+    chashmap_insert(m.cmap, &key, &key);
+  }
+  bench_end(b, "chashmap_insert", n, obj_size, n);
+  bench_begin(b);
+  for (uint64_t key = 0; key < 2 * n; key += 2) avl_map_add(m.amap, &key, &key);
+  bench_end(b, "avl_map_add", n, obj_size, n);
+
+  int reads[] = {100, 95, 50};
+  for (int r = 0; r < 3; ++r) {
+    for (size_t threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+      snprintf(name, sizeof(name), "chashmap_r%d_t%zu", reads[r], threads);
+      if (bench_enabled(cfg, name)) {
+        bench_begin(b);
+        sink += run_threads(chashmap_worker, &m, n, threads, reads[r]);
+        bench_end(b, name, n, obj_size, ops);
+      }
+      snprintf(name, sizeof(name), "avl_map_rwlock_r%d_t%zu", reads[r],
+               threads);
+      if (bench_enabled(cfg, name)) {
+        bench_begin(b);
+        sink += run_threads(avl_worker, &m, n, threads, reads[r]);
+        bench_end(b, name, n, obj_size, ops);
+      }
+    }
+  }
+
+  bench_do_not_optimize(&sink);
+  chashmap_drop(m.cmap);
+  avl_map_drop(m.amap);
+  free(m.amap);
+  pthread_rwlock_destroy(&m.lock);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  bench_foreach_size(&cfg, n) { bench_chashmap(&b, n); }
+  bench_fini(&b);
+  return 0;
+}
@@ -0,0 +1,179 @@
+// vdq_t and cdq_t operations against a plain C ring buffer.
+// build: cc -O2 -o bench_gbc_deque bench/bench_gbc_deque.c
+// run:   ./bench_gbc_deque [--min 1e3] [--max 1e8] [--filter vdq_push]
+#include "../include/gbc_cdq.h"
+#include "../include/gbc_deque.h"
+#include "gbc_bench.h"
+
+#define MAX_OBJ_SIZE 64
+#define QUADRATIC_OPS 1000
+
+// the block deque: the ends never copy elements, indexing costs a map lookup
+static void bench_cdq(bench_t *b, size_t n, size_t obj_size) {
+  const bench_cfg_t *cfg = b->cfg;
+  char elem[MAX_OBJ_SIZE] = {0};
+
+  if (bench_enabled(cfg, "cdq_push_back")) {
+    bench_begin(b);
+    cdq_t *q = cdq_new(obj_size);
+    for (size_t i = 0; i < n; ++i) cdq_push_back(q, elem);
+    bench_end(b, "cdq_push_back", n, obj_size, n);
+    cdq_drop(q);
+  }
+
+  if (bench_enabled(cfg, "cdq_push_front")) {
+    bench_begin(b);
+    cdq_t *q = cdq_new(obj_size);
+    for (size_t i = 0; i < n; ++i) cdq_push_front(q, elem);
+    bench_end(b, "cdq_push_front", n, obj_size, n);
+    cdq_drop(q);
+  }
+
+  if (bench_enabled(cfg, "cdq_fifo")) {
+    cdq_t *q = cdq_new(obj_size);
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) {
+      cdq_push_back(q, elem);
+      if (q->size == 1000) cdq_del_front(q);
+    }
+    bench_end(b, "cdq_fifo", n, obj_size, n);
+    cdq_drop(q);
+  }
+
+  if (bench_enabled(cfg, "cdq_at")) {
+    cdq_t *q = cdq_new(obj_size);
+    for (size_t i = 0; i < n; ++i) cdq_push_back(q, elem);
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) sum += *(const uint8_t *)cdq_at(q, i);
+    bench_end(b, "cdq_at", n, obj_size, n);
+    bench_do_not_optimize(&sum);
+    cdq_drop(q);
+  }
+}
+
+static void bench_deque(bench_t *b, size_t n, size_t obj_size) {
+  const bench_cfg_t *cfg = b->cfg;
+  char elem[MAX_OBJ_SIZE] = {0};
+
+  if (bench_enabled(cfg, "vdq_push_back")) {
+    bench_begin(b);
+    vdq_t *q = vdq_new(obj_size);
+    for (size_t i = 0; i < n; ++i) vdq_push_back(q, elem);
+    bench_end(b, "vdq_push_back", n, obj_size, n);
+    vdq_drop(q);
+  }
+
+  if (bench_enabled(cfg, "vdq_push_front")) {
+    bench_begin(b);
+    vdq_t *q = vdq_new(obj_size);
+    for (size_t i = 0; i < n; ++i) vdq_push_front(q, elem);
+    bench_end(b, "vdq_push_front", n, obj_size, n);
+    vdq_drop(q);
+  }
+
+  // a bounded FIFO: push at the back and pop at the front
+  if (bench_enabled(cfg, "vdq_fifo")) {
+    vdq_t *q = vdq_new_with_cap(obj_size, 1024);
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) {
+      vdq_push_back(q, elem);
+      if (q->size == 1000) vdq_del_front(q);
+    }
+    bench_end(b, "vdq_fifo", n, obj_size, n);
+    vdq_drop(q);
+  }
+
+  if (bench_enabled(cfg, "c_ring_fifo")) {
+    size_t cap = 1024, head = 0, size = 0;
+    char *ring = (char *)malloc(cap * obj_size);
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) {
+      memcpy(ring + ((head + size) & (cap - 1)) * obj_size, elem, obj_size);
+      size++;
+      if (size == 1000) {
+        head = (head + 1) & (cap - 1);
+        size--;
+      }
+    }
+    bench_end(b, "c_ring_fifo", n, obj_size, n);
+    bench_do_not_optimize(ring);
+    free(ring);
+  }
+
+  vdq_t *q = vdq_new(obj_size);
+  for (size_t i = 0; i < n; ++i) {
+    if (i & 1)
+      vdq_push_back(q, elem);
+    else
+      vdq_push_front(q, elem);
+  }
+
+  if (bench_enabled(cfg, "vdq_at")) {
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) sum += *(const uint8_t *)vdq_at(q, i);
+    bench_end(b, "vdq_at", n, obj_size, n);
+    bench_do_not_optimize(&sum);
+  }
+
+  if (bench_enabled(cfg, "vdq_iter")) {
+    uint64_t sum = 0;
+    bench_begin(b);
+    vdq_iter_t *iter = vdq_iter_new(q);
+    while (vdq_iter_has_next(iter)) sum += *(uint8_t *)vdq_iter_next(iter);
+    vdq_iter_drop(iter);
+    bench_end(b, "vdq_iter", n, obj_size, n);
+    bench_do_not_optimize(&sum);
+  }
+
+  if (bench_enabled(cfg, "vdq_clone")) {
+    bench_begin(b);
+    vdq_t *c = vdq_clone(q);
+    bench_end(b, "vdq_clone", n, obj_size, n);
+    vdq_drop(c);
+  }
+
+  if (bench_enabled(cfg, "vdq_reverse")) {
+    bench_begin(b);
+    vdq_reverse(q);
+    bench_end(b, "vdq_reverse", n, obj_size, n);
+  }
+
+  size_t edits = (n < QUADRATIC_OPS) ? n : QUADRATIC_OPS;
+  if (bench_enabled(cfg, "vdq_insert_mid")) {
+    bench_begin(b);
+    for (size_t i = 0; i < edits; ++i) vdq_insert(q, q->size / 2, elem);
+    bench_end(b, "vdq_insert_mid", n, obj_size, edits);
+  }
+
+  if (bench_enabled(cfg, "vdq_del_at_mid")) {
+    bench_begin(b);
+    for (size_t i = 0; i < edits; ++i) vdq_del_at(q, q->size / 2);
+    bench_end(b, "vdq_del_at_mid", n, obj_size, edits);
+  }
+
+  if (bench_enabled(cfg, "vdq_del_back")) {
+    size_t size = q->size;
+    bench_begin(b);
+    for (size_t i = 0; i < size; ++i) vdq_del_back(q);
+    bench_end(b, "vdq_del_back", n, obj_size, size);
+  }
+  vdq_drop(q);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  size_t obj_sizes[] = {4, 16, MAX_OBJ_SIZE};
+  bench_foreach_size(&cfg, n) {
+    for (int i = 0; i < 3; ++i) {
+      bench_deque(&b, n, obj_sizes[i]);
+      bench_cdq(&b, n, obj_sizes[i]);
+    }
+  }
+  bench_fini(&b);
+  return 0;
+}
@@ -0,0 +1,82 @@
+// extsort_file on inputs 10 times bigger than its memory budget, against
+// vec_sort on the whole input in memory. The input and output files and the
+// spilled runs live in --tmp (default /tmp), so it measures that disk too.
+// build: cc -O2 -o bench_gbc_extsort bench/bench_gbc_extsort.c
+// run:   ./bench_gbc_extsort [--min 1e5] [--max 1e8] [--tmp /data/tmp]
+#include "../include/gbc_extsort.h"
+#include "gbc_bench.h"
+
+#define BUDGET_RATIO 10
+
+typedef struct _record {
+  uint64_t key;
+  uint64_t payload;
+} record_t;
+
+static int record_cmp(const void *a, const void *b) {
+  const record_t *_a = (const record_t *)a;
+  const record_t *_b = (const record_t *)b;
+  return (_a->key > _b->key) - (_a->key < _b->key);
+}
+
+static bool write_input(const char *path, size_t n) {
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  uint64_t state = 88172645463325252ull;
+  record_t block[4096];
+  for (size_t i = 0; i < n;) {
+    size_t len = 0;
+    for (; len < 4096 && i < n; ++len, ++i) {
+      block[len].key = bench_rand(&state);
+      block[len].payload = i;
+    }
+    fwrite(block, sizeof(record_t), len, f);
+  }
+  return fclose(f) == 0;
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  const char *tmp_dir = DEFAULT_EXTSORT_TMP_DIR;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--tmp") == 0) tmp_dir = argv[i + 1];
+  }
+  if (cfg.min_n < 100000) cfg.min_n = 100000;
+  bench_t b;
+  bench_init(&b, &cfg);
+  char in_path[4096], out_path[4096];
+  snprintf(in_path, sizeof(in_path), "%s/bench_extsort_in", tmp_dir);
+  snprintf(out_path, sizeof(out_path), "%s/bench_extsort_out", tmp_dir);
+
+  bench_foreach_size(&cfg, n) {
+    if (!write_input(in_path, n)) {
+      fprintf(stderr, "can not write %s\n", in_path);
+      return 1;
+    }
+    if (bench_enabled(&cfg, "extsort_file")) {
+      extsort_cfg_t sort_cfg = {
+          .mem_budget = n * sizeof(record_t) / BUDGET_RATIO,
+          .tmp_dir = tmp_dir};
+      bench_begin(&b);
+      bool ok = extsort_file(in_path, out_path, sizeof(record_t), record_cmp,
+                             &sort_cfg);
+      bench_end(&b, "extsort_file", n, sizeof(record_t), n);
+      if (!ok) fprintf(stderr, "extsort_file failed\n");
+    }
+    if (bench_enabled(&cfg, "vec_sort")) {
+      extsort_file_iter_t *src =
+          extsort_file_iter_open(in_path, sizeof(record_t));
+      vec_t *vec = vec_from_iter(&src->base);
+      extsort_file_iter_close(src);
+      bench_begin(&b);
+      vec_sort(vec, record_cmp);
+      bench_end(&b, "vec_sort_in_memory", n, sizeof(record_t), n);
+      vec_drop(vec);
+    }
+  }
+  unlink(in_path);
+  unlink(out_path);
+  bench_fini(&b);
+  return 0;
+}
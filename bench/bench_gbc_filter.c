@@ -0,0 +1,110 @@
+// avl_set_t lookups with and without a filter in front, on hits and misses,
+// and the bare filters at each dispatch level.
+// build: cc -O2 -o bench_gbc_filter bench/bench_gbc_filter.c
+// run:   ./bench_gbc_filter [--min 1e3] [--max 1e7] [--filter miss]
+#include "../include/gbc_avl.h"
+#include "../include/gbc_filter.h"
+#include "gbc_bench.h"
+
+static int u64_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void make_keys(uint64_t *keys, size_t n, uint64_t seed) {
+  for (size_t i = 0; i < n; ++i) keys[i] = bench_rand(&seed);
+}
+
+static void bench_filter(bench_t *b, size_t n) {
+  const bench_cfg_t *cfg = b->cfg;
+  size_t obj_size = sizeof(uint64_t);
+  uint64_t *keys = (uint64_t *)malloc(n * sizeof(uint64_t));
+  uint64_t *absent = (uint64_t *)malloc(n * sizeof(uint64_t));
+  uint64_t *hashes = (uint64_t *)malloc(n * sizeof(uint64_t));
+  make_keys(keys, n, 1);
+  make_keys(absent, n, 2);
+  for (size_t i = 0; i < n; ++i) hashes[i] = gbc_hash_bytes(&keys[i], 8);
+  size_t sink = 0;
+  char name[64];
+
+  // the same set with no filter, a Bloom and a cuckoo filter
+  const char *fronts[] = {"", "_bloom", "_cuckoo"};
+  for (int f = 0; f < 3; ++f) {
+    avl_set_t *s = avl_set_new(obj_size, u64_cmp);
+    if (f > 0) {
+      avl_set_enable_filter(s, f == 1 ? GBC_FILTER_BLOOM : GBC_FILTER_CUCKOO,
+                            NULL);
+    }
+    snprintf(name, sizeof(name), "avl_set_add%s", fronts[f]);
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) avl_set_add(s, &keys[i]);
+    bench_end(b, name, n, obj_size, n);
+    snprintf(name, sizeof(name), "avl_set_contains_miss%s", fronts[f]);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      for (size_t i = 0; i < n; ++i) sink += avl_set_contains(s, &absent[i]);
+      bench_end(b, name, n, obj_size, n);
+    }
+    snprintf(name, sizeof(name), "avl_set_contains_hit%s", fronts[f]);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      for (size_t i = 0; i < n; ++i) sink += avl_set_contains(s, &keys[i]);
+      bench_end(b, name, n, obj_size, n);
+    }
+    avl_set_drop(s);
+  }
+
+  // the bare filters on precomputed hashes
+  const char *levels[] = {"_scalar", "_avx2"};
+  for (int l = 0; l < 2; ++l) {
+    gbc_cpu_force_level(l ? GBC_CPU_AVX2 : GBC_CPU_SCALAR);
+    bloom_t *bloom = bloom_new(n, 0);
+    snprintf(name, sizeof(name), "bloom_add%s", levels[l]);
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) bloom_add(bloom, hashes[i]);
+    bench_end(b, name, n, obj_size, n);
+    snprintf(name, sizeof(name), "bloom_may_contain%s", levels[l]);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      for (size_t i = 0; i < n; ++i) {
+        sink += bloom_may_contain(bloom, hashes[i] ^ absent[i]);
+      }
+      bench_end(b, name, n, obj_size, n);
+    }
+    bloom_drop(bloom);
+  }
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+
+  cuckoo_t *c = cuckoo_new(n);
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) cuckoo_add(c, hashes[i]);
+  bench_end(b, "cuckoo_add", n, obj_size, n);
+  if (bench_enabled(cfg, "cuckoo_may_contain")) {
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) {
+      sink += cuckoo_may_contain(c, hashes[i] ^ absent[i]);
+    }
+    bench_end(b, "cuckoo_may_contain", n, obj_size, n);
+  }
+  if (bench_enabled(cfg, "cuckoo_del")) {
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) sink += cuckoo_del(c, hashes[i]);
+    bench_end(b, "cuckoo_del", n, obj_size, n);
+  }
+  cuckoo_drop(c);
+
+  bench_do_not_optimize(&sink);
+  free(keys);
+  free(absent);
+  free(hashes);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  bench_foreach_size(&cfg, n) { bench_filter(&b, n); }
+  bench_fini(&b);
+  return 0;
+}
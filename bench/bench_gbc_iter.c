@@ -0,0 +1,138 @@
+// iter_t traversal: has_next/next per element against iter_next_batch.
+// build: cc -O2 -o bench_gbc_iter bench/bench_gbc_iter.c
+// run:   ./bench_gbc_iter [--min 1e3] [--max 1e7] [--filter batch]
+#include "../include/gbc_avl.h"
+#include "../include/gbc_deque.h"
+#include "../include/gbc_iterator.h"
+#include "../include/gbc_vector.h"
+#include "gbc_bench.h"
+
+static int u32_cmp(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static uint64_t sum_next(iter_t *iter) {
+  uint64_t sum = 0;
+  while (iter->has_next(iter)) sum += *(const uint32_t *)iter->next(iter);
+  return sum;
+}
+
+static uint64_t sum_batch(iter_t *iter, bool pairs) {
+  void *ptrs[ITER_BATCH_MAX];
+  iter_batch_t batch = {.span = NULL, .ptrs = ptrs, .len = 0};
+  uint64_t sum = 0;
+  while (iter_next_batch(iter, &batch, ITER_BATCH_MAX) > 0) {
+    if (batch.span) {
+      const uint32_t *span = (const uint32_t *)batch.span;
+      for (size_t i = 0; i < batch.len; ++i) sum += span[i];
+    } else if (pairs) {
+      for (size_t i = 0; i < batch.len; ++i) {
+        sum += *(const uint32_t *)((const avl_pair_t *)ptrs[i])->key;
+      }
+    } else {
+      for (size_t i = 0; i < batch.len; ++i) sum += *(const uint32_t *)ptrs[i];
+    }
+  }
+  return sum;
+}
+
+static void bench_iter(bench_t *b, size_t n) {
+  const bench_cfg_t *cfg = b->cfg;
+  size_t obj_size = sizeof(uint32_t);
+  vec_t *v = vec_new(obj_size);
+  vdq_t *q = vdq_new(obj_size);
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t x = (uint32_t)i;
+    vec_push(v, &x);
+    // half at each end so the ring wraps
+    if (i % 2) {
+      vdq_push_back(q, &x);
+    } else {
+      vdq_push_front(q, &x);
+    }
+  }
+  uint64_t sum = 0;
+
+  if (bench_enabled(cfg, "vec_next")) {
+    vec_iter_t *iter = vec_iter_new(v);
+    bench_begin(b);
+    sum += sum_next((iter_t *)iter);
+    bench_end(b, "vec_next", n, obj_size, n);
+    vec_iter_drop(iter);
+  }
+
+  if (bench_enabled(cfg, "vec_batch")) {
+    vec_iter_t *iter = vec_iter_new(v);
+    bench_begin(b);
+    sum += sum_batch((iter_t *)iter, false);
+    bench_end(b, "vec_batch", n, obj_size, n);
+    vec_iter_drop(iter);
+  }
+
+  if (bench_enabled(cfg, "vdq_next")) {
+    vdq_iter_t *iter = vdq_iter_new(q);
+    bench_begin(b);
+    sum += sum_next((iter_t *)iter);
+    bench_end(b, "vdq_next", n, obj_size, n);
+    vdq_iter_drop(iter);
+  }
+
+  if (bench_enabled(cfg, "vdq_batch")) {
+    vdq_iter_t *iter = vdq_iter_new(q);
+    bench_begin(b);
+    sum += sum_batch((iter_t *)iter, false);
+    bench_end(b, "vdq_batch", n, obj_size, n);
+    vdq_iter_drop(iter);
+  }
+
+  if (bench_enabled(cfg, "vec_from_iter")) {
+    vdq_iter_t *iter = vdq_iter_new(q);
+    bench_begin(b);
+    vec_t *c = vec_from_iter((iter_t *)iter);
+    bench_end(b, "vec_from_iter", n, obj_size, n);
+    vdq_iter_drop(iter);
+    vec_drop(c);
+  }
+
+  // chasing node pointers dominates, the batch only saves the indirect calls
+  if (n <= 1000000 &&
+      (bench_enabled(cfg, "avl_next") || bench_enabled(cfg, "avl_batch"))) {
+    avl_set_t *set = avl_set_new(obj_size, u32_cmp);
+    for (size_t i = 0; i < n; ++i) {
+      uint32_t key = *(const uint32_t *)vec_at(v, i);
+      avl_set_add(set, &key);
+    }
+    if (bench_enabled(cfg, "avl_next")) {
+      avl_set_iter_t *iter = avl_set_iter_new(set);
+      bench_begin(b);
+      while (avl_set_iter_has_next(iter)) {
+        sum += *(const uint32_t *)avl_set_iter_next(iter);
+      }
+      bench_end(b, "avl_next", n, obj_size, n);
+      avl_set_iter_drop(iter);
+    }
+    if (bench_enabled(cfg, "avl_batch")) {
+      avl_set_iter_t *iter = avl_set_iter_new(set);
+      bench_begin(b);
+      sum += sum_batch((iter_t *)iter, true);
+      bench_end(b, "avl_batch", n, obj_size, n);
+      avl_set_iter_drop(iter);
+    }
+    avl_set_drop(set);
+  }
+
+  bench_do_not_optimize(&sum);
+  vec_drop(v);
+  vdq_drop(q);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  bench_foreach_size(&cfg, n) { bench_iter(&b, n); }
+  bench_fini(&b);
+  return 0;
+}
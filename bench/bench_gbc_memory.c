@@ -0,0 +1,218 @@
+// Memory footprint of vec_t, vdq_t, avl_map_t, avl_set_t and roaring_t per
+// element. Every container is built through a counting allocator, so the
+// numbers are the bytes the library asked for (requested), what malloc really
+// handed out including its rounding (usable, glibc only) and the resident set
+// growth seen by the kernel (rss). peak is the highest requested footprint
+// reached while the container grew, steady is what is left once it is built.
+// build: cc -O2 -o bench_gbc_memory bench/bench_gbc_memory.c
+// run:   ./bench_gbc_memory [--min 1e3] [--max 1e7] [--filter avl_map]
+#include "../include/gbc_avl.h"
+#include "../include/gbc_deque.h"
+#include "../include/gbc_roaring.h"
+#include "../include/gbc_vector.h"
+#include "gbc_bench.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/// @brief a malloc backed allocator which records what goes through it
+/// @param size_t live: requested bytes currently allocated
+/// @param size_t peak: the highest value of live, a moving realloc counts
+/// the old and the new block at the same time
+/// @param size_t usable: bytes malloc handed out for the live blocks
+/// @param size_t blocks: live allocations
+typedef struct _mem_counter {
+  size_t live;
+  size_t peak;
+  size_t usable;
+  size_t blocks;
+} mem_counter_t;
+
+static size_t usable_size(void *ptr, size_t size) {
+#ifdef __GLIBC__
+  (void)size;
+  return malloc_usable_size(ptr);
+#else
+  (void)ptr;
+  return size;
+#endif
+}
+
+static void mem_counter_peak(mem_counter_t *c, size_t transient) {
+  if (c->live + transient > c->peak) c->peak = c->live + transient;
+}
+
+static void *counting_alloc(void *ctx, size_t size) {
+  mem_counter_t *c = (mem_counter_t *)ctx;
+  void *ptr = malloc(size);
+  if (!ptr) return NULL;
+  c->live += size;
+  c->usable += usable_size(ptr, size);
+  c->blocks++;
+  mem_counter_peak(c, 0);
+  return ptr;
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t old_size,
+                              size_t new_size) {
+  mem_counter_t *c = (mem_counter_t *)ctx;
+  if (!ptr) return counting_alloc(ctx, new_size);
+  size_t old_usable = usable_size(ptr, old_size);
+  void *new_ptr = realloc(ptr, new_size);
+  if (!new_ptr) return NULL;
+  if (new_ptr != ptr) mem_counter_peak(c, new_size);
+  c->live = c->live - old_size + new_size;
+  c->usable = c->usable - old_usable + usable_size(new_ptr, new_size);
+  mem_counter_peak(c, 0);
+  return new_ptr;
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size) {
+  mem_counter_t *c = (mem_counter_t *)ctx;
+  c->usable -= usable_size(ptr, size);
+  c->live -= size;
+  c->blocks--;
+  free(ptr);
+}
+
+/// @brief the resident set size of the process in bytes, 0 if unknown
+static size_t rss_bytes(void) {
+#ifdef __linux__
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  size_t pages = 0, resident = 0;
+  int read = fscanf(f, "%zu %zu", &pages, &resident);
+  fclose(f);
+  if (read != 2) return 0;
+  return resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+typedef struct _mem_probe {
+  mem_counter_t counter;
+  gbc_allocator_t alloc;
+  size_t rss_before;
+} mem_probe_t;
+
+static void mem_begin(mem_probe_t *p) {
+  memset(&p->counter, 0, sizeof(p->counter));
+  gbc_allocator_t alloc = {.alloc = counting_alloc,
+                           .realloc = counting_realloc,
+                           .free = counting_free,
+                           .ctx = &p->counter};
+  p->alloc = alloc;
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+  p->rss_before = rss_bytes();
+}
+
+/// @brief print one JSON line with the footprint of the n elements built
+/// since mem_begin
+static void mem_end(mem_probe_t *p, const char *name, size_t n,
+                    size_t obj_size) {
+  size_t rss_after = rss_bytes();
+  double rss = (rss_after > p->rss_before) ? rss_after - p->rss_before : 0;
+  const mem_counter_t *c = &p->counter;
+  printf("{\"bench\":\"%s\",\"n\":%zu,\"obj_size\":%zu,\"blocks\":%zu,"
+         "\"steady_bytes_per_elem\":%.2f,\"peak_bytes_per_elem\":%.2f,"
+         "\"usable_bytes_per_elem\":%.2f,\"rss_bytes_per_elem\":%.2f}\n",
+         name, n, obj_size, c->blocks, (double)c->live / n,
+         (double)c->peak / n, (double)c->usable / n, rss / n);
+  fflush(stdout);
+}
+
+static int u32_cmp(const void *a, const void *b) {
+  uint32_t x, y;
+  memcpy(&x, a, sizeof(x));
+  memcpy(&y, b, sizeof(y));
+  return (x > y) - (x < y);
+}
+
+GBC_AVL_DECLARE(int_map, int, int, GBC_AVL_CMP_NUM)
+
+static void bench_memory(const bench_cfg_t *cfg, size_t n, size_t obj_size) {
+  mem_probe_t p;
+  char elem[64] = {0};
+
+  if (bench_enabled(cfg, "vec")) {
+    mem_begin(&p);
+    vec_t *vec = vec_new_ex(obj_size, DEFAULT_VEC_CAP, &p.alloc);
+    for (size_t i = 0; i < n; ++i) vec_push(vec, elem);
+    mem_end(&p, "vec_push", n, obj_size);
+    vec_drop(vec);
+  }
+
+  if (bench_enabled(cfg, "vdq")) {
+    mem_begin(&p);
+    vdq_t *q = vdq_new_ex(obj_size, DEFAULT_DQ_SIZE, &p.alloc);
+    for (size_t i = 0; i < n; ++i) vdq_push_back(q, elem);
+    mem_end(&p, "vdq_push_back", n, obj_size);
+    vdq_drop(q);
+  }
+
+  // distinct keys: i * odd is a bijection modulo 2^32
+  if (bench_enabled(cfg, "avl_map")) {
+    mem_begin(&p);
+    avl_map_t *map = avl_map_new_ex(obj_size, obj_size, u32_cmp, &p.alloc);
+    for (size_t i = 0; i < n; ++i) {
+      uint32_t k = (uint32_t)(i * 2654435761u);
+      memcpy(elem, &k, sizeof(k));
+      avl_map_add(map, elem, elem);
+    }
+    mem_end(&p, "avl_map_add", n, obj_size);
+    avl_map_drop(map);
+    gbc_free(&p.alloc, map, sizeof(avl_map_t));
+  }
+
+  if (bench_enabled(cfg, "avl_set")) {
+    mem_begin(&p);
+    avl_set_t *set = avl_set_new_ex(obj_size, u32_cmp, &p.alloc);
+    for (size_t i = 0; i < n; ++i) {
+      uint32_t k = (uint32_t)(i * 2654435761u);
+      memcpy(elem, &k, sizeof(k));
+      avl_set_add(set, elem);
+    }
+    mem_end(&p, "avl_set_add", n, obj_size);
+    avl_set_drop(set);
+  }
+
+  // the same keys as avl_set, then the even numbers, dense enough for bitmaps
+  if (obj_size == sizeof(uint32_t) && bench_enabled(cfg, "roaring")) {
+    mem_begin(&p);
+    roaring_t *r = roaring_new_ex(&p.alloc);
+    for (size_t i = 0; i < n; ++i) roaring_add(r, (uint32_t)(i * 2654435761u));
+    mem_end(&p, "roaring_add", n, obj_size);
+    roaring_drop(r);
+
+    mem_begin(&p);
+    r = roaring_new_ex(&p.alloc);
+    for (size_t i = 0; i < n; ++i) roaring_add(r, (uint32_t)(i * 2));
+    mem_end(&p, "roaring_add_dense", n, obj_size);
+    roaring_drop(r);
+  }
+
+  if (obj_size == sizeof(int) && bench_enabled(cfg, "int_map")) {
+    mem_begin(&p);
+    int_map_t *typed = int_map_new_ex(&p.alloc);
+    for (size_t i = 0; i < n; ++i) {
+      int k = (int)(i * 2654435761u);
+      int_map_add(typed, k, k);
+    }
+    mem_end(&p, "int_map_add", n, obj_size);
+    int_map_drop(typed);
+  }
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  size_t obj_sizes[] = {4, 16, 64};
+  bench_foreach_size(&cfg, n) {
+    for (int i = 0; i < 3; ++i) bench_memory(&cfg, n, obj_sizes[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+// The numeric kernels against a vec_foreach callback, at each dispatch
+// level and with threads.
+// build: cc -O2 -pthread -o bench_gbc_numeric bench/bench_gbc_numeric.c
+// run:   ./bench_gbc_numeric [--min 1e3] [--max 1e8] [--filter sum]
+#define GBC_THREADS
+#include "../include/gbc_numeric.h"
+#include "gbc_bench.h"
+
+#define BENCH_THREADS 4
+
+static float foreach_sum;
+
+static void foreach_add(const void *p) { foreach_sum += *(const float *)p; }
+
+typedef struct _num_mode {
+  const char *name;
+  gbc_cpu_level_t level;
+  size_t threads;
+} num_mode_t;
+
+static const num_mode_t modes[] = {
+    {"scalar", GBC_CPU_SCALAR, 1},
+    {"avx2", GBC_CPU_AVX2, 1},
+    {"avx2_t4", GBC_CPU_AVX2, BENCH_THREADS},
+};
+
+static void bench_numeric(bench_t *b, size_t n) {
+  const bench_cfg_t *cfg = b->cfg;
+  vec_t *x = vec_new_with_cap(sizeof(float), n);
+  vec_t *y = vec_new_with_cap(sizeof(float), n);
+  vec_t *xi = vec_new_with_cap(sizeof(int32_t), n);
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  for (size_t i = 0; i < n; ++i) {
+    float a = (float)(bench_rand(&seed) % 1000) / 8;
+    int32_t ai = (int32_t)(bench_rand(&seed) % 2000) - 1000;
+    vec_push(x, &a);
+    vec_push(y, &a);
+    vec_push(xi, &ai);
+  }
+  double sink = 0;
+  char name[64];
+
+  if (bench_enabled(cfg, "sum_foreach")) {
+    foreach_sum = 0;
+    bench_begin(b);
+    vec_foreach(x, foreach_add);
+    bench_end(b, "sum_foreach", n, sizeof(float), n);
+    sink += foreach_sum;
+  }
+
+  for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+    gbc_cpu_force_level(modes[m].level);
+    gbc_numeric_set_threads(modes[m].threads);
+
+    snprintf(name, sizeof(name), "sum_f32_%s", modes[m].name);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      sink += vec_sum_f32(x);
+      bench_end(b, name, n, sizeof(float), n);
+    }
+
+    snprintf(name, sizeof(name), "sum_i32_%s", modes[m].name);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      sink += (double)vec_sum_i32(xi);
+      bench_end(b, name, n, sizeof(int32_t), n);
+    }
+
+    snprintf(name, sizeof(name), "min_f32_%s", modes[m].name);
+    if (bench_enabled(cfg, name)) {
+      float min = 0;
+      size_t idx = 0;
+      bench_begin(b);
+      vec_min_f32(x, &min, &idx);
+      bench_end(b, name, n, sizeof(float), n);
+      sink += min + (double)idx;
+    }
+
+    snprintf(name, sizeof(name), "dot_f32_%s", modes[m].name);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      sink += vec_dot_f32(x, y);
+      bench_end(b, name, n, sizeof(float), n);
+    }
+
+    snprintf(name, sizeof(name), "axpy_f32_%s", modes[m].name);
+    if (bench_enabled(cfg, name)) {
+      bench_begin(b);
+      vec_axpy_f32(0.5f, x, y);
+      bench_end(b, name, n, sizeof(float), n);
+    }
+
+    snprintf(name, sizeof(name), "prefix_sum_i32_%s", modes[m].name);
+    if (bench_enabled(cfg, name)) {
+      vec_t *c = vec_clone(xi);
+      bench_begin(b);
+      vec_prefix_sum_i32(c);
+      bench_end(b, name, n, sizeof(int32_t), n);
+      vec_drop(c);
+    }
+  }
+  gbc_numeric_set_threads(1);
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+
+  bench_do_not_optimize(&sink);
+  vec_drop(x);
+  vec_drop(y);
+  vec_drop(xi);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  bench_foreach_size(&cfg, n) { bench_numeric(&b, n); }
+  bench_fini(&b);
+  return 0;
+}
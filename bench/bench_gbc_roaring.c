@@ -0,0 +1,116 @@
+// roaring_t against avl_set_t on uint32_t keys, scattered over the whole
+// range and packed in a dense one.
+// build: cc -O2 -o bench_gbc_roaring bench/bench_gbc_roaring.c
+// run:   ./bench_gbc_roaring [--min 1e3] [--max 1e7] [--filter contains]
+#include "../include/gbc_avl.h"
+#include "../include/gbc_roaring.h"
+#include "gbc_bench.h"
+
+static int u32_cmp(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// the i-th key of a set: scattered, i * odd is a bijection modulo 2^32, or
+// every other number from offset
+static uint32_t key_at(size_t i, bool dense, uint32_t offset) {
+  return dense ? offset + (uint32_t)(i * 2) : (uint32_t)(i * 2654435761u);
+}
+
+static void bench_roaring(bench_t *b, size_t n, bool dense) {
+  const bench_cfg_t *cfg = b->cfg;
+  const char *sfx = dense ? "_dense" : "";
+  size_t obj_size = sizeof(uint32_t);
+  char name[64];
+  size_t sink = 0;
+  uint64_t seed = 42;
+  uint32_t *probes = (uint32_t *)malloc(n * sizeof(uint32_t));
+  for (size_t i = 0; i < n; ++i) {
+    probes[i] = key_at(bench_rand(&seed) % n, dense, 0);
+  }
+
+  roaring_t *r = roaring_new(), *r2 = roaring_new();
+  avl_set_t *s = avl_set_new(obj_size, u32_cmp);
+  avl_set_t *s2 = avl_set_new(obj_size, u32_cmp);
+  snprintf(name, sizeof(name), "roaring_add%s", sfx);
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) roaring_add(r, key_at(i, dense, 0));
+  bench_end(b, name, n, obj_size, n);
+  snprintf(name, sizeof(name), "avl_set_add%s", sfx);
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t k = key_at(i, dense, 0);
+    avl_set_add(s, &k);
+  }
+  bench_end(b, name, n, obj_size, n);
+
+  snprintf(name, sizeof(name), "roaring_contains%s", sfx);
+  if (bench_enabled(cfg, name)) {
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) sink += roaring_contains(r, probes[i]);
+    bench_end(b, name, n, obj_size, n);
+  }
+  snprintf(name, sizeof(name), "avl_set_contains%s", sfx);
+  if (bench_enabled(cfg, name)) {
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) sink += avl_set_contains(s, &probes[i]);
+    bench_end(b, name, n, obj_size, n);
+  }
+
+  // the second set overlaps the first by half
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t k = key_at(i, dense, (uint32_t)n);
+    if (!dense) k = key_at(i + n / 2, false, 0);
+    roaring_add(r2, k);
+    avl_set_add(s2, &k);
+  }
+  snprintf(name, sizeof(name), "roaring_intersection%s", sfx);
+  if (bench_enabled(cfg, name)) {
+    bench_begin(b);
+    roaring_t *i = roaring_intersection(r, r2);
+    bench_end(b, name, n, obj_size, 2 * n);
+    sink += (size_t)roaring_cardinality(i);
+    roaring_drop(i);
+  }
+  snprintf(name, sizeof(name), "avl_set_intersection%s", sfx);
+  if (bench_enabled(cfg, name)) {
+    bench_begin(b);
+    avl_set_t *i = avl_set_intersection(s, s2);
+    bench_end(b, name, n, obj_size, 2 * n);
+    sink += i->map->size;
+    avl_set_drop(i);
+  }
+  snprintf(name, sizeof(name), "roaring_iter%s", sfx);
+  if (bench_enabled(cfg, name)) {
+    roaring_iter_t it;
+    iter_batch_t batch;
+    size_t got;
+    roaring_iter_init(&it, r);
+    bench_begin(b);
+    while ((got = iter_next_batch(&it.base, &batch, ITER_BATCH_MAX)) > 0) {
+      sink += ((uint32_t *)batch.span)[got - 1];
+    }
+    bench_end(b, name, n, obj_size, n);
+    roaring_iter_fini(&it);
+  }
+
+  bench_do_not_optimize(&sink);
+  free(probes);
+  roaring_drop(r);
+  roaring_drop(r2);
+  avl_set_drop(s);
+  avl_set_drop(s2);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  bench_foreach_size(&cfg, n) {
+    bench_roaring(&b, n, false);
+    bench_roaring(&b, n, true);
+  }
+  bench_fini(&b);
+  return 0;
+}
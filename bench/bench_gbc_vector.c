@@ -0,0 +1,238 @@
+// vec_t operations against a plain C array, and segvec_t against vec_t.
+// build: cc -O2 -o bench_gbc_vector bench/bench_gbc_vector.c
+// run:   ./bench_gbc_vector [--min 1e3] [--max 1e8] [--filter vec_push]
+#include "../include/gbc_segvec.h"
+#include "../include/gbc_vector.h"
+#include "gbc_bench.h"
+
+#define MAX_OBJ_SIZE 64
+#define QUADRATIC_OPS 1000
+
+static int u32_key_cmp(const void *a, const void *b) {
+  uint32_t x, y;
+  memcpy(&x, a, sizeof(x));
+  memcpy(&y, b, sizeof(y));
+  return (x > y) - (x < y);
+}
+
+static uint64_t foreach_sum;
+
+// a garbage collection sweep drops about half the keys
+static bool key_is_live(const void *p, void *ctx) {
+  (void)ctx;
+  return *(const uint8_t *)p & 1;
+}
+
+static void foreach_add(const void *p) { foreach_sum += *(const uint8_t *)p; }
+
+static vec_t *make_vec(size_t n, size_t obj_size, uint64_t *seed) {
+  vec_t *v = vec_new_with_cap(obj_size, n);
+  char elem[MAX_OBJ_SIZE] = {0};
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t key = (uint32_t)bench_rand(seed);
+    memcpy(elem, &key, sizeof(key));
+    vec_push(v, elem);
+  }
+  return v;
+}
+
+static void bench_vector(bench_t *b, size_t n, size_t obj_size) {
+  const bench_cfg_t *cfg = b->cfg;
+  char elem[MAX_OBJ_SIZE] = {0};
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+
+  if (bench_enabled(cfg, "vec_push")) {
+    bench_begin(b);
+    vec_t *v = vec_new(obj_size);
+    for (size_t i = 0; i < n; ++i) vec_push(v, elem);
+    bench_end(b, "vec_push", n, obj_size, n);
+    vec_drop(v);
+  }
+
+  if (bench_enabled(cfg, "c_array_push")) {
+    bench_begin(b);
+    size_t cap = DEFAULT_VEC_CAP, size = 0;
+    char *arr = (char *)malloc(cap * obj_size);
+    for (size_t i = 0; i < n; ++i) {
+      if (size == cap) {
+        cap *= 2;
+        arr = (char *)realloc(arr, cap * obj_size);
+      }
+      memcpy(arr + size++ * obj_size, elem, obj_size);
+    }
+    bench_end(b, "c_array_push", n, obj_size, n);
+    bench_do_not_optimize(arr);
+    free(arr);
+  }
+
+  vec_t *v = make_vec(n, obj_size, &seed);
+
+  if (bench_enabled(cfg, "vec_at")) {
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) sum += *(const uint8_t *)vec_at(v, i);
+    bench_end(b, "vec_at", n, obj_size, n);
+    bench_do_not_optimize(&sum);
+  }
+
+  if (bench_enabled(cfg, "c_array_read")) {
+    uint64_t sum = 0;
+    const char *arr = v->buf;
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) sum += *(const uint8_t *)(arr + i * obj_size);
+    bench_end(b, "c_array_read", n, obj_size, n);
+    bench_do_not_optimize(&sum);
+  }
+
+  if (bench_enabled(cfg, "vec_iter")) {
+    uint64_t sum = 0;
+    bench_begin(b);
+    vec_iter_t *iter = vec_iter_new(v);
+    while (vec_iter_has_next(iter)) sum += *(uint8_t *)vec_iter_next(iter);
+    vec_iter_drop(iter);
+    bench_end(b, "vec_iter", n, obj_size, n);
+    bench_do_not_optimize(&sum);
+  }
+
+  if (bench_enabled(cfg, "vec_foreach")) {
+    bench_begin(b);
+    vec_foreach(v, foreach_add);
+    bench_end(b, "vec_foreach", n, obj_size, n);
+  }
+
+  if (bench_enabled(cfg, "vec_clone")) {
+    bench_begin(b);
+    vec_t *c = vec_clone(v);
+    bench_end(b, "vec_clone", n, obj_size, n);
+    vec_drop(c);
+  }
+
+  if (bench_enabled(cfg, "vec_reverse")) {
+    bench_begin(b);
+    vec_reverse(v);
+    bench_end(b, "vec_reverse", n, obj_size, n);
+  }
+
+  if (bench_enabled(cfg, "vec_sort")) {
+    bench_begin(b);
+    vec_sort(v, u32_key_cmp);
+    bench_end(b, "vec_sort", n, obj_size, n);
+  }
+
+  // positional edits move the whole tail, keep their op count bounded
+  size_t edits = (n < QUADRATIC_OPS) ? n : QUADRATIC_OPS;
+  if (bench_enabled(cfg, "vec_insert_front")) {
+    bench_begin(b);
+    for (size_t i = 0; i < edits; ++i) vec_insert(v, 0, elem);
+    bench_end(b, "vec_insert_front", n, obj_size, edits);
+  }
+
+  if (bench_enabled(cfg, "vec_del_at_front")) {
+    bench_begin(b);
+    for (size_t i = 0; i < edits; ++i) vec_del_at(v, 0);
+    bench_end(b, "vec_del_at_front", n, obj_size, edits);
+  }
+
+  // a sweep with vec_del_at moves the tail once per dead key
+  if (bench_enabled(cfg, "vec_sweep_del_at")) {
+    vec_t *c = vec_clone(v);
+    size_t dead = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < c->size && dead < edits;) {
+      if (key_is_live(vec_at(c, i), NULL)) {
+        i++;
+      } else {
+        vec_del_at(c, i);
+        dead++;
+      }
+    }
+    bench_end(b, "vec_sweep_del_at", n, obj_size, dead);
+    vec_drop(c);
+  }
+
+  if (bench_enabled(cfg, "vec_sweep_retain")) {
+    vec_t *c = vec_clone(v);
+    bench_begin(b);
+    size_t dead = vec_retain(c, key_is_live, NULL);
+    bench_end(b, "vec_sweep_retain", n, obj_size, dead);
+    vec_drop(c);
+  }
+
+  if (bench_enabled(cfg, "vec_del_top")) {
+    size_t size = v->size;
+    bench_begin(b);
+    for (size_t i = 0; i < size; ++i) vec_del_top(v);
+    bench_end(b, "vec_del_top", n, obj_size, size);
+  }
+  vec_drop(v);
+}
+
+// the slowest single push, where vec_t pays for copying its whole buffer
+static void bench_worst_push(const char *name, size_t n, size_t obj_size,
+                             bool segmented) {
+  char elem[MAX_OBJ_SIZE] = {0};
+  vec_t *v = segmented ? NULL : vec_new(obj_size);
+  segvec_t *sv = segmented ? segvec_new(obj_size) : NULL;
+  double worst = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double start = bench_now_ns();
+    if (segmented)
+      segvec_push(sv, elem);
+    else
+      vec_push(v, elem);
+    double elapsed = bench_now_ns() - start;
+    if (elapsed > worst) worst = elapsed;
+  }
+  printf("{\"bench\":\"%s\",\"n\":%zu,\"obj_size\":%zu,"
+         "\"worst_ns\":%.0f}\n",
+         name, n, obj_size, worst);
+  if (v) vec_drop(v);
+  if (sv) segvec_drop(sv);
+}
+
+static void bench_segvec(bench_t *b, size_t n, size_t obj_size) {
+  const bench_cfg_t *cfg = b->cfg;
+  char elem[MAX_OBJ_SIZE] = {0};
+
+  segvec_t *sv = segvec_new(obj_size);
+  bench_begin(b);
+  for (size_t i = 0; i < n; ++i) segvec_push(sv, elem);
+  bench_end(b, "segvec_push", n, obj_size, n);
+
+  if (bench_enabled(cfg, "segvec_at")) {
+    uint64_t sum = 0;
+    bench_begin(b);
+    for (size_t i = 0; i < n; ++i) sum += *(const uint8_t *)segvec_at(sv, i);
+    bench_end(b, "segvec_at", n, obj_size, n);
+    bench_do_not_optimize(&sum);
+  }
+
+  if (bench_enabled(cfg, "segvec_foreach")) {
+    bench_begin(b);
+    segvec_foreach(sv, foreach_add);
+    bench_end(b, "segvec_foreach", n, obj_size, n);
+  }
+  segvec_drop(sv);
+
+  if (bench_enabled(cfg, "push_worst")) {
+    bench_worst_push("vec_push_worst", n, obj_size, false);
+    bench_worst_push("segvec_push_worst", n, obj_size, true);
+  }
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  size_t obj_sizes[] = {4, 16, MAX_OBJ_SIZE};
+  bench_foreach_size(&cfg, n) {
+    for (int i = 0; i < 3; ++i) bench_vector(&b, n, obj_sizes[i]);
+    if (bench_enabled(&cfg, "segvec") || bench_enabled(&cfg, "push_worst")) {
+      for (int i = 0; i < 3; ++i) bench_segvec(&b, n, obj_sizes[i]);
+    }
+  }
+  bench_do_not_optimize(&foreach_sum);
+  bench_fini(&b);
+  return 0;
+}
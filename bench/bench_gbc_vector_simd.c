@@ -0,0 +1,105 @@
+// The typed scan kernels against the cmp_fn loops of vec_del.
+// build: cc -O2 -o bench_gbc_vector_simd bench/bench_gbc_vector_simd.c
+// run:   ./bench_gbc_vector_simd [--min 1e3] [--max 1e7] [--filter remove]
+#include "../include/gbc_vector_simd.h"
+#include "gbc_bench.h"
+
+// one element in PURGE_EVERY is the ID being purged
+#define PURGE_EVERY 100
+#define PURGE_ID 7u
+// vec_del pays O(n) per removed element, so its runs stop here
+#define VEC_DEL_MAX_N 100000
+
+static int u32_cmp(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static vec_t *make_ids(size_t n) {
+  vec_t *v = vec_new_with_cap(sizeof(uint32_t), n);
+  uint64_t seed = 42;
+  for (size_t i = 0; i < n; ++i) {
+    uint32_t x = (i % PURGE_EVERY == PURGE_EVERY - 1)
+                     ? PURGE_ID
+                     : PURGE_ID + 1 + (uint32_t)(bench_rand(&seed) % 1000000);
+    vec_push(v, &x);
+  }
+  return v;
+}
+
+static void bench_scan(bench_t *b, size_t n, const char *level_name) {
+  const bench_cfg_t *cfg = b->cfg;
+  size_t obj_size = sizeof(uint32_t);
+  char name[64];
+  uint32_t id = PURGE_ID;
+  vec_t *v = make_ids(n);
+  size_t sink = 0;
+
+  // the first match sits at the very end
+  uint32_t last = 0xffffffffu;
+  vec_update(v, n - 1, &last);
+  snprintf(name, sizeof(name), "find_cmp_fn");
+  if (!level_name[0] && bench_enabled(cfg, name)) {
+    bench_begin(b);
+    for (size_t i = 0; i < v->size; ++i) {
+      if (u32_cmp(vec_at(v, i), &last) == 0) {
+        sink += i;
+        break;
+      }
+    }
+    bench_end(b, name, n, obj_size, n);
+  }
+  snprintf(name, sizeof(name), "find_u32%s", level_name);
+  if (bench_enabled(cfg, name)) {
+    size_t idx = 0;
+    bench_begin(b);
+    vec_find_u32(v, last, &idx);
+    bench_end(b, name, n, obj_size, n);
+    sink += idx;
+  }
+  snprintf(name, sizeof(name), "count_eq_u32%s", level_name);
+  if (bench_enabled(cfg, name)) {
+    bench_begin(b);
+    sink += vec_count_eq_u32(v, id);
+    bench_end(b, name, n, obj_size, n);
+  }
+
+  snprintf(name, sizeof(name), "vec_del_loop");
+  if (!level_name[0] && n <= VEC_DEL_MAX_N && bench_enabled(cfg, name)) {
+    vec_t *c = make_ids(n);
+    bench_begin(b);
+    while (vec_del(c, &id, u32_cmp)) {
+    }
+    bench_end(b, name, n, obj_size, n);
+    sink += c->size;
+    vec_drop(c);
+  }
+  snprintf(name, sizeof(name), "remove_all_eq_u32%s", level_name);
+  if (bench_enabled(cfg, name)) {
+    vec_t *c = make_ids(n);
+    bench_begin(b);
+    sink += vec_remove_all_eq_u32(c, id);
+    bench_end(b, name, n, obj_size, n);
+    vec_drop(c);
+  }
+  bench_do_not_optimize(&sink);
+  vec_drop(v);
+}
+
+int main(int argc, char **argv) {
+  bench_cfg_t cfg;
+  bench_parse_args(&cfg, argc, argv);
+  bench_t b;
+  bench_init(&b, &cfg);
+  bench_foreach_size(&cfg, n) {
+    // the dispatched kernels first, then each level forced
+    bench_scan(&b, n, "");
+    gbc_cpu_force_level(GBC_CPU_SCALAR);
+    bench_scan(&b, n, "_scalar");
+    gbc_cpu_force_level(GBC_CPU_SSE2);
+    if (gbc_cpu_level() == GBC_CPU_SSE2) bench_scan(&b, n, "_sse2");
+    gbc_cpu_force_level(GBC_CPU_AVX2);
+  }
+  bench_fini(&b);
+  return 0;
+}
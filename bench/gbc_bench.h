@@ -0,0 +1,171 @@
+#ifndef _GBC_BENCH_H
+#define _GBC_BENCH_H
+// Minimal benchmark harness shared by the bench_*.c programs. Every
+// measurement is printed as one JSON object per line, with ns/op and, when
+// perf_event_open is available, cycles, instructions and cache misses per op.
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_NUM_COUNTERS 3
+#define BENCH_DEFAULT_MIN_N 1000
+#define BENCH_DEFAULT_MAX_N 1000000
+
+/// @brief the command line configuration of a benchmark program
+/// @param size_t min_n: the smallest element count, a power of 10
+/// @param size_t max_n: the biggest element count, up to 1e8
+/// @param const char* filter: only run benchmarks whose name contains it
+typedef struct _bench_cfg {
+  size_t min_n;
+  size_t max_n;
+  const char *filter;
+} bench_cfg_t;
+
+/// @brief a running measurement
+typedef struct _bench {
+  const bench_cfg_t *cfg;
+  int fds[BENCH_NUM_COUNTERS];
+  bool has_counters;
+  double start_ns;
+} bench_t;
+
+/// @brief parse `--min N --max N --filter NAME` from the command line
+static inline void bench_parse_args(bench_cfg_t *cfg, int argc, char **argv) {
+  cfg->min_n = BENCH_DEFAULT_MIN_N;
+  cfg->max_n = BENCH_DEFAULT_MAX_N;
+  cfg->filter = NULL;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--min") == 0)
+      cfg->min_n = (size_t)strtod(argv[i + 1], NULL);
+    else if (strcmp(argv[i], "--max") == 0)
+      cfg->max_n = (size_t)strtod(argv[i + 1], NULL);
+    else if (strcmp(argv[i], "--filter") == 0)
+      cfg->filter = argv[i + 1];
+  }
+}
+
+/// @brief check if the benchmark called name was selected with --filter
+static inline bool bench_enabled(const bench_cfg_t *cfg, const char *name) {
+  return !cfg->filter || strstr(name, cfg->filter);
+}
+
+static inline double bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/// @brief a cheap deterministic random generator, so runs are comparable
+static inline uint64_t bench_rand(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+/// @brief keep the compiler from optimizing a computed value away
+static inline void bench_do_not_optimize(const void *p) {
+  __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+#ifdef __linux__
+static inline int bench_perf_open(uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = config;
+  attr.disabled = (group_fd == -1);
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+/// @brief set up the hardware counters, falling back to time only
+static inline void bench_init(bench_t *b, const bench_cfg_t *cfg) {
+  b->cfg = cfg;
+  b->has_counters = false;
+  for (int i = 0; i < BENCH_NUM_COUNTERS; ++i) b->fds[i] = -1;
+#ifdef __linux__
+  uint64_t configs[BENCH_NUM_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES,
+                                          PERF_COUNT_HW_INSTRUCTIONS,
+                                          PERF_COUNT_HW_CACHE_MISSES};
+  b->fds[0] = bench_perf_open(configs[0], -1);
+  if (b->fds[0] < 0) return;
+  for (int i = 1; i < BENCH_NUM_COUNTERS; ++i) {
+    b->fds[i] = bench_perf_open(configs[i], b->fds[0]);
+    if (b->fds[i] < 0) return;
+  }
+  b->has_counters = true;
+#endif
+}
+
+static inline void bench_fini(bench_t *b) {
+#ifdef __linux__
+  for (int i = 0; i < BENCH_NUM_COUNTERS; ++i) {
+    if (b->fds[i] >= 0) close(b->fds[i]);
+  }
+#endif
+}
+
+/// @brief start measuring, call right before the timed loop
+static inline void bench_begin(bench_t *b) {
+#ifdef __linux__
+  if (b->has_counters) {
+    ioctl(b->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(b->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+  b->start_ns = bench_now_ns();
+}
+
+/// @brief stop measuring and print one JSON line for ops operations
+/// @param b
+/// @param name: the operation, e.g. "vec_push"
+/// @param n: the element count of the container
+/// @param obj_size: the key or element size in bytes
+/// @param ops: the number of operations timed
+static inline void bench_end(bench_t *b, const char *name, size_t n,
+                             size_t obj_size, size_t ops) {
+  double elapsed = bench_now_ns() - b->start_ns;
+  uint64_t values[1 + BENCH_NUM_COUNTERS] = {0};
+  bool counted = false;
+#ifdef __linux__
+  if (b->has_counters) {
+    ioctl(b->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    counted = read(b->fds[0], values, sizeof(values)) == sizeof(values);
+  }
+#endif
+  if (ops == 0) ops = 1;
+  printf("{\"bench\":\"%s\",\"n\":%zu,\"obj_size\":%zu,\"ops\":%zu,"
+         "\"ns_per_op\":%.3f",
+         name, n, obj_size, ops, elapsed / ops);
+  if (counted) {
+    printf(",\"cycles_per_op\":%.3f,\"instructions_per_op\":%.3f,"
+           "\"cache_misses_per_op\":%.4f",
+           (double)values[1] / ops, (double)values[2] / ops,
+           (double)values[3] / ops);
+  }
+  printf("}\n");
+  fflush(stdout);
+}
+
+/// @brief loop n over the powers of ten between cfg->min_n and cfg->max_n
+#define bench_foreach_size(cfg, n) \
+  for (size_t n = (cfg)->min_n; n <= (cfg)->max_n; n *= 10)
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef _GBC_ALLOC_H
+#define _GBC_ALLOC_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_ARENA_CHUNK_SIZE 65536
+#define GBC_ARENA_ALIGN 16
+
+/// @brief the allocator used by the containers for every internal allocation
+/// @param alloc: allocate size bytes, return NULL if failed
+/// @param realloc: resize ptr from old_size to new_size bytes keeping its
+/// content, return NULL if failed and leave ptr untouched
+/// @param free: release ptr, size is the size it was allocated with
+/// @param void* ctx: passed as the first argument of the functions above
+typedef struct _gbc_allocator {
+  void *(*alloc)(void *ctx, size_t size);
+  void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+  void (*free)(void *ctx, void *ptr, size_t size);
+  void *ctx;
+} gbc_allocator_t;
+
+/// @brief one block of memory the arena bumps through. data is aligned to
+/// GBC_ARENA_ALIGN, as malloc aligns the chunk at least that much, so the
+/// aligned sizes keep every allocation aligned
+typedef struct _gbc_arena_chunk {
+  struct _gbc_arena_chunk *next;
+  size_t cap;
+  size_t used;
+  _Alignas(GBC_ARENA_ALIGN) char data[];
+} gbc_arena_chunk_t;
+
+/// @brief bump arena allocator. free is a no-op (except for the most recent
+/// allocation), everything is released at once by gbc_arena_reset or
+/// gbc_arena_fini, so a whole graph of containers built on it can be thrown
+/// away without walking it
+/// @param gbc_arena_chunk_t* head: the chunk allocations are served from
+/// @param size_t chunk_size: the size of a regular chunk
+/// @param gbc_allocator_t allocator: the interface handed to the containers
+typedef struct _gbc_arena {
+  gbc_arena_chunk_t *head;
+  size_t chunk_size;
+  gbc_allocator_t allocator;
+} gbc_arena_t;
+
+/// @brief the malloc/realloc/free allocator used when none is given
+static void *gbc_std_alloc(void *ctx, size_t size) {
+  (void)ctx;
+  return malloc(size);
+}
+
+static void *gbc_std_realloc(void *ctx, void *ptr, size_t old_size,
+                             size_t new_size) {
+  (void)ctx;
+  (void)old_size;
+  return realloc(ptr, new_size);
+}
+
+static void gbc_std_free(void *ctx, void *ptr, size_t size) {
+  (void)ctx;
+  (void)size;
+  free(ptr);
+}
+
+static const gbc_allocator_t gbc_std_allocator = {.alloc = gbc_std_alloc,
+                                                  .realloc = gbc_std_realloc,
+                                                  .free = gbc_std_free,
+                                                  .ctx = NULL};
+
+/// @brief return alloc, or the standard allocator if alloc is NULL
+static inline const gbc_allocator_t *gbc_allocator_or_std(
+    const gbc_allocator_t *alloc) {
+  return alloc ? alloc : &gbc_std_allocator;
+}
+
+static inline void *gbc_alloc(const gbc_allocator_t *alloc, size_t size) {
+  return alloc->alloc(alloc->ctx, size);
+}
+
+static inline void *gbc_realloc(const gbc_allocator_t *alloc, void *ptr,
+                                size_t old_size, size_t new_size) {
+  return alloc->realloc(alloc->ctx, ptr, old_size, new_size);
+}
+
+static inline void gbc_free(const gbc_allocator_t *alloc, void *ptr,
+                            size_t size) {
+  if (ptr) alloc->free(alloc->ctx, ptr, size);
+}
+
+/// @brief initialize an arena
+/// @param arena
+/// @param chunk_size: bytes per chunk, 0 for DEFAULT_ARENA_CHUNK_SIZE
+void gbc_arena_init(gbc_arena_t *arena, size_t chunk_size);
+
+/// @brief get the allocator interface of the arena, valid as long as the
+/// arena itself is
+/// @param arena
+/// @return
+const gbc_allocator_t *gbc_arena_allocator(gbc_arena_t *arena);
+
+/// @brief release every allocation of the arena at once. The newest chunk is
+/// kept for reuse
+/// @param arena
+void gbc_arena_reset(gbc_arena_t *arena);
+
+/// @brief release all the memory of the arena
+/// @param arena
+void gbc_arena_fini(gbc_arena_t *arena);
+
+static inline size_t gbc_arena_align(size_t size) {
+  return (size + GBC_ARENA_ALIGN - 1) & ~(size_t)(GBC_ARENA_ALIGN - 1);
+}
+
+static void *gbc_arena_alloc(void *ctx, size_t size) {
+  gbc_arena_t *arena = (gbc_arena_t *)ctx;
+  size = gbc_arena_align(size);
+  gbc_arena_chunk_t *head = arena->head;
+  if (!head || head->cap - head->used < size) {
+    size_t cap = (size > arena->chunk_size) ? size : arena->chunk_size;
+    gbc_arena_chunk_t *chunk =
+        (gbc_arena_chunk_t *)malloc(sizeof(gbc_arena_chunk_t) + cap);
+    if (!chunk) return NULL;
+    chunk->cap = cap;
+    chunk->used = 0;
+    chunk->next = head;
+    arena->head = chunk;
+    head = chunk;
+  }
+  void *ptr = head->data + head->used;
+  head->used += size;
+  return ptr;
+}
+
+static inline bool gbc_arena_is_last(const gbc_arena_t *arena, const void *ptr,
+                                     size_t size) {
+  const gbc_arena_chunk_t *head = arena->head;
+  return head && (const char *)ptr + gbc_arena_align(size) ==
+                     head->data + head->used;
+}
+
+static void *gbc_arena_realloc(void *ctx, void *ptr, size_t old_size,
+                               size_t new_size) {
+  gbc_arena_t *arena = (gbc_arena_t *)ctx;
+  if (!ptr) return gbc_arena_alloc(ctx, new_size);
+  if (gbc_arena_is_last(arena, ptr, old_size)) {
+    // the newest allocation grows or shrinks in place
+    gbc_arena_chunk_t *head = arena->head;
+    size_t start = (char *)ptr - head->data;
+    if (start + gbc_arena_align(new_size) <= head->cap) {
+      head->used = start + gbc_arena_align(new_size);
+      return ptr;
+    }
+  } else if (new_size <= old_size) {
+    return ptr;
+  }
+  void *new_ptr = gbc_arena_alloc(ctx, new_size);
+  if (!new_ptr) return NULL;
+  memcpy(new_ptr, ptr, (old_size < new_size) ? old_size : new_size);
+  return new_ptr;
+}
+
+static void gbc_arena_free(void *ctx, void *ptr, size_t size) {
+  gbc_arena_t *arena = (gbc_arena_t *)ctx;
+  if (gbc_arena_is_last(arena, ptr, size)) {
+    arena->head->used -= gbc_arena_align(size);
+  }
+}
+
+void gbc_arena_init(gbc_arena_t *arena, size_t chunk_size) {
+  assert(arena);
+  arena->head = NULL;
+  arena->chunk_size = chunk_size ? chunk_size : DEFAULT_ARENA_CHUNK_SIZE;
+  gbc_allocator_t allocator = {.alloc = gbc_arena_alloc,
+                               .realloc = gbc_arena_realloc,
+                               .free = gbc_arena_free,
+                               .ctx = arena};
+  arena->allocator = allocator;
+}
+
+const gbc_allocator_t *gbc_arena_allocator(gbc_arena_t *arena) {
+  assert(arena);
+  return &arena->allocator;
+}
+
+void gbc_arena_reset(gbc_arena_t *arena) {
+  assert(arena);
+  if (!arena->head) return;
+  gbc_arena_chunk_t *chunk = arena->head->next;
+  while (chunk) {
+    gbc_arena_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->head->next = NULL;
+  arena->head->used = 0;
+}
+
+void gbc_arena_fini(gbc_arena_t *arena) {
+  assert(arena);
+  gbc_arena_reset(arena);
+  free(arena->head);
+  arena->head = NULL;
+}
+
+#endif
@@ -6,7 +6,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "gbc_alloc.h"
+#include "gbc_filter.h"
 #include "gbc_iterator.h"
+#include "gbc_probes.h"
+#include "gbc_stats.h"
 #include "gbc_vector.h"
 
 #define avl_max(a, b) (((a) < (b)) ? (b) : (a))
@@ -32,6 +36,8 @@ typedef struct _avl_node avl_node_t;
 /// @param size_t size: the size of map
 /// @param size_t key_obj_size: the key object size
 /// @param size_t val_obj_size: the value object size
+/// @param gbc_filter_t* filter: NULL, or a filter of the keys checked before
+/// every descent, see avl_map_enable_filter
 typedef struct _avl_map avl_map_t;
 
 /// @brief the compare function for the keys in the map
@@ -66,6 +72,13 @@ typedef struct _avl_map {
   size_t size;
   size_t key_obj_size;
   size_t val_obj_size;
+  const gbc_allocator_t *alloc;
+  gbc_filter_t *filter;
+  gbc_hash_fn hash_fn;
+  // the deleted keys a Bloom filter still reports, it is rebuilt once they
+  // are over a quarter of size
+  size_t filter_stale;
+  GBC_STATS_FIELD
 } avl_map_t;
 
 static char set_value[0];
@@ -76,21 +89,22 @@ typedef struct _avl_set {
   size_t size;
 } avl_set_t;
 
-typedef vec_t *next_nodes_ptr;
-typedef avl_set_t *seen_nodes_ptr;
-
-/// @brief avl_map_iter_t
+/// @brief avl_map_iter_t, an in-order walk that follows the parent pointers
+/// from one node to its successor, so it holds no stack
+/// @param next_node: the node to yield next, NULL at the end
+/// @param alloc: the allocator of a heap iterator, NULL for one set up by
+/// avl_map_iter_init
 typedef struct _avl_map_iter {
   iter_t base;
-  next_nodes_ptr next_ptrs;  // vec_t<avl_node_t*>
-  seen_nodes_ptr seen_ptrs;  // avl_set_t<avl_node_t*>
+  avl_node_t *next_node;
+  const gbc_allocator_t *alloc;
 } avl_map_iter_t;
 
 /// @brief avl_set_iter_t
 typedef struct _avl_set_iter {
   iter_t base;
-  next_nodes_ptr next_ptrs;  // vec_t<avl_node_t*>
-  seen_nodes_ptr seen_ptrs;  // avl_set_t<avl_node_t*>
+  avl_node_t *next_node;
+  const gbc_allocator_t *alloc;
 } avl_set_iter_t;
 
 /// @brief create a new avl_map_t
@@ -101,6 +115,17 @@ typedef struct _avl_set_iter {
 avl_map_t *avl_map_new(size_t key_obj_size, size_t value_obj_size,
                        int (*cmp_fn)(const void *, const void *));
 
+/// @brief create a new avl_map_t whose memory, including the map itself, its
+/// nodes and its iterators, comes from alloc
+/// @param key_obj_size
+/// @param value_obj_size
+/// @param cmp_fn
+/// @param alloc: NULL for malloc/free
+/// @return
+avl_map_t *avl_map_new_ex(size_t key_obj_size, size_t value_obj_size,
+                          int (*cmp_fn)(const void *, const void *),
+                          const gbc_allocator_t *alloc);
+
 /// @brief adding key-value pair into the map. Update the value if the key
 /// exists
 /// @param map
@@ -152,12 +177,47 @@ bool avl_map_drop(avl_map_t *map);
 /// @param fn
 void avl_map_foreach(const avl_map_t *map, avl_foreach fn);
 
+/// @brief keep a filter of the keys, so looking up an absent key mostly
+/// returns before the descent: contains, get, get_mut, update and del check
+/// it first. add and del keep it up to date, and it is rebuilt from the tree
+/// twice as big when the map outgrows it. A Bloom filter is smaller and
+/// checks one cache line, but a deleted key stays in it until it is rebuilt
+/// once the deleted keys are over a quarter of the keys left; a cuckoo
+/// filter deletes keys and checks two cache lines. Enabling it again
+/// rebuilds it
+/// @param map
+/// @param kind
+/// @param hash_fn: hashes the key_obj_size bytes of a key. Keys cmp_fn finds
+/// equal must hash equal, NULL hashes the key bytes, for keys equal only when
+/// their bytes are
+/// @return return false if the memory ran out, the map is left without one
+bool avl_map_enable_filter(avl_map_t *map, gbc_filter_kind_t kind,
+                           gbc_hash_fn hash_fn);
+
+/// @brief drop the filter of the map
+/// @param map
+void avl_map_disable_filter(avl_map_t *map);
+
+/// @brief read the operation counters of the map, use set->map for a set
+/// @param map
+/// @param out
+/// @return return false, with out zeroed, unless built with GBC_STATS
+bool avl_map_stats(const avl_map_t *map, gbc_stats_t *out);
+
 /// @brief create a new avl_set_t
 /// @param key_obj_size
 /// @param cmp_fn
 /// @return
 avl_set_t *avl_set_new(size_t key_obj_size, avl_cmp_fn cmp_fn);
 
+/// @brief create a new avl_set_t whose memory comes from alloc
+/// @param key_obj_size
+/// @param cmp_fn
+/// @param alloc: NULL for malloc/free
+/// @return
+avl_set_t *avl_set_new_ex(size_t key_obj_size, avl_cmp_fn cmp_fn,
+                          const gbc_allocator_t *alloc);
+
 /// @brief adding an element into the set
 /// @param set
 /// @param key
@@ -181,6 +241,18 @@ bool avl_set_contains(const avl_set_t *set, const avl_key_t key);
 /// @return
 bool avl_set_drop(avl_set_t *set);
 
+/// @brief keep a filter of the elements, see avl_map_enable_filter
+/// @param set
+/// @param kind
+/// @param hash_fn
+/// @return
+bool avl_set_enable_filter(avl_set_t *set, gbc_filter_kind_t kind,
+                           gbc_hash_fn hash_fn);
+
+/// @brief drop the filter of the set
+/// @param set
+void avl_set_disable_filter(avl_set_t *set);
+
 /// @brief intersection of two sets
 /// @param set1
 /// @param set2
@@ -209,6 +281,26 @@ avl_map_iter_t *avl_map_iter_new(avl_map_t *map);
 /// @return
 avl_set_iter_t *avl_set_iter_new(avl_set_t *set);
 
+/// @brief set up an avl_map_iter_t provided by the caller, e.g. on the
+/// stack. Nothing is allocated; finish it with avl_map_iter_fini
+/// @param iter
+/// @param map
+void avl_map_iter_init(avl_map_iter_t *iter, avl_map_t *map);
+
+/// @brief set up an avl_set_iter_t provided by the caller, finish it with
+/// avl_set_iter_fini
+/// @param iter
+/// @param set
+void avl_set_iter_init(avl_set_iter_t *iter, avl_set_t *set);
+
+/// @brief finish an iterator set up by avl_map_iter_init
+/// @param iter
+void avl_map_iter_fini(avl_map_iter_t *iter);
+
+/// @brief finish an iterator set up by avl_set_iter_init
+/// @param iter
+void avl_set_iter_fini(avl_set_iter_t *iter);
+
 /// @brief drop an avl_map_iter_t
 /// @param iter
 /// @return
@@ -239,29 +331,35 @@ avl_pair_t *avl_map_iter_next(avl_map_iter_t *iter);
 /// @return
 void *avl_set_iter_next(avl_set_iter_t *iter);
 
-avl_node_t *avl_node_new(const avl_key_t _key, size_t _key_obj_size,
-                         const avl_val_t _value, size_t _value_obj_size) {
-  avl_node_t *node = (avl_node_t *)malloc(sizeof(avl_node_t));
+avl_node_t *avl_node_new(const avl_map_t *map, const avl_key_t _key,
+                         const avl_val_t _value) {
+  const gbc_allocator_t *alloc = map->alloc;
+  avl_node_t *node = (avl_node_t *)gbc_alloc(alloc, sizeof(avl_node_t));
   if (!node) return NULL;
   node->height = 1;
   node->parent = node->left = node->right = NULL;
-  char *key_buf = (char *)malloc(sizeof(_key_obj_size));
+  char *key_buf = (char *)gbc_alloc(alloc, map->key_obj_size);
   if (!key_buf) {
-    free(node);
+    gbc_free(alloc, node, sizeof(avl_node_t));
     node = NULL;
     return NULL;
   }
-  char *val_buf = (char *)malloc(sizeof(_value_obj_size));
+  char *val_buf = (char *)gbc_alloc(alloc, map->val_obj_size);
   if (!val_buf) {
-    free(node);
-    free(key_buf);
+    gbc_free(alloc, key_buf, map->key_obj_size);
+    gbc_free(alloc, node, sizeof(avl_node_t));
     node = NULL;
     key_buf = NULL;
     return NULL;
   }
+  GBC_STATS_ALLOC(map, sizeof(avl_node_t));
+  GBC_STATS_ALLOC(map, map->key_obj_size);
+  GBC_STATS_ALLOC(map, map->val_obj_size);
+  GBC_PROBE3(avl_node_alloc, map, node,
+             sizeof(avl_node_t) + map->key_obj_size + map->val_obj_size);
   avl_pair_t new_pair = {.key = key_buf, .val = val_buf};
-  memcpy(new_pair.key, _key, _key_obj_size);
-  memcpy(new_pair.val, _value, _value_obj_size);
+  memcpy(new_pair.key, _key, map->key_obj_size);
+  memcpy(new_pair.val, _value, map->val_obj_size);
   node->pair = new_pair;
   return node;
 }
@@ -278,77 +376,62 @@ size_t avl_node_height(const avl_node_t *node) {
   return node->height;
 }
 
-bool avl_node_drop(avl_node_t *node) {
+bool avl_node_drop(const avl_map_t *map, avl_node_t *node) {
   if (!node) return false;
-  if (node->pair.key) {
-    free(node->pair.key);
-    node->pair.key = NULL;
-  }
+  GBC_PROBE3(avl_node_free, map, node,
+             sizeof(avl_node_t) + map->key_obj_size + map->val_obj_size);
+  // freed in reverse order, so a bump allocator can take the memory back
   if (node->pair.val) {
-    free(node->pair.val);
+    gbc_free(map->alloc, node->pair.val, map->val_obj_size);
     node->pair.val = NULL;
   }
-  free(node);
+  if (node->pair.key) {
+    gbc_free(map->alloc, node->pair.key, map->key_obj_size);
+    node->pair.key = NULL;
+  }
+  gbc_free(map->alloc, node, sizeof(avl_node_t));
+  GBC_STATS_FREE(map, map->val_obj_size);
+  GBC_STATS_FREE(map, map->key_obj_size);
+  GBC_STATS_FREE(map, sizeof(avl_node_t));
   node = NULL;
   return true;
 }
 
 avl_map_t *avl_map_new(size_t key_obj_size, size_t value_obj_size,
                        avl_cmp_fn cmp_fn) {
-  avl_map_t *tree = (avl_map_t *)malloc(sizeof(avl_map_t));
+  return avl_map_new_ex(key_obj_size, value_obj_size, cmp_fn, NULL);
+}
+
+avl_map_t *avl_map_new_ex(size_t key_obj_size, size_t value_obj_size,
+                          avl_cmp_fn cmp_fn, const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  avl_map_t *tree = (avl_map_t *)gbc_alloc(alloc, sizeof(avl_map_t));
   if (!tree) return NULL;
   tree->cmp_fn = cmp_fn;
   tree->root = NULL;
   tree->size = 0;
   tree->key_obj_size = key_obj_size;
   tree->val_obj_size = value_obj_size;
+  tree->alloc = alloc;
+  tree->filter = NULL;
+  tree->hash_fn = NULL;
+  tree->filter_stale = 0;
+  GBC_STATS_INIT(tree);
+  GBC_STATS_ALLOC(tree, sizeof(avl_map_t));
   return tree;
 }
 
-static void avl_unlink(avl_node_t *child, avl_node_t *parent, avl_map_t *map) {
-  if (child && parent) {
-    int order = map->cmp_fn(child->pair.key, parent->pair.key);
-    if (order < 0) {
-      parent->left = NULL;
-    } else {
-      parent->right = NULL;
-    }
-    child->parent = NULL;
-  } else if (child && !parent) {
-    child->parent = NULL;
-    map->root = child;
-  }
-}
-
-static void avl_set_left(avl_node_t *node, avl_node_t *left_child) {
-  if (node) node->left = left_child;
-  if (left_child) left_child->parent = node;
-}
-
-static void avl_set_right(avl_node_t *node, avl_node_t *right_child) {
-  if (node) node->right = right_child;
-  if (right_child) right_child->parent = node;
-}
-
-static void avl_relink(avl_node_t *child, avl_node_t *parent, avl_map_t *map) {
-  if (!child && !parent)
-    return;
-  else if (child && parent) {
-    int order = map->cmp_fn(parent->pair.key, child->pair.key);
-    if (order < 0) {
-      parent->right = child;
-    } else {
-      parent->left = child;
-    }
-    child->parent = parent;
-    return;
-  } else if (child && !parent) {
-    child->parent = NULL;
-    map->root = child;
-    return;
-  } else {  // !child && parent
-    return;
-  }
+/// @brief put new_child where old_child hung under parent, or at the root if
+/// parent is NULL. Only pointers are compared, so no cmp_fn call is needed
+static void avl_replace_child(avl_map_t *map, avl_node_t *parent,
+                              avl_node_t *old_child, avl_node_t *new_child) {
+  if (!parent)
+    map->root = new_child;
+  else if (parent->left == old_child)
+    parent->left = new_child;
+  else
+    parent->right = new_child;
+  if (new_child) new_child->parent = parent;
 }
 
 static int avl_bf(const avl_node_t *node) {
@@ -374,7 +457,9 @@ static avl_node_t *avl_right_rotate(avl_node_t *y, avl_node_t *parent_n,
   if (t3) {
     t3->parent = y;
   }
-  avl_relink(x, parent_n, map);
+  avl_replace_child(map, parent_n, y, x);
+  GBC_STATS_INC(map, rotations);
+  GBC_PROBE2(avl_rotate, map, y);
 
   y->height = 1 + avl_max(avl_node_height(y->left), avl_node_height(y->right));
   x->height = 1 + avl_max(avl_node_height(x->left), avl_node_height(x->right));
@@ -399,7 +484,9 @@ static avl_node_t *avl_left_rotate(avl_node_t *y, avl_node_t *parent_n,
   if (t2) {
     t2->parent = y;
   }
-  avl_relink(x, parent_n, map);
+  avl_replace_child(map, parent_n, y, x);
+  GBC_STATS_INC(map, rotations);
+  GBC_PROBE2(avl_rotate, map, y);
 
   y->height = 1 + avl_max(avl_node_height(y->left), avl_node_height(y->right));
   x->height = 1 + avl_max(avl_node_height(x->left), avl_node_height(x->right));
@@ -438,11 +525,29 @@ static avl_node_t *avl_find_max_child(avl_node_t *node) {
   return out;
 }
 
+static inline uint64_t avl_key_hash(const avl_map_t *map,
+                                    const avl_key_t key) {
+  return map->hash_fn(key, map->key_obj_size);
+}
+
+/// @brief check if the filter of the map rules the key out
+static inline bool avl_filter_rejects(const avl_map_t *map,
+                                      const avl_key_t key) {
+  if (!map->filter ||
+      gbc_filter_may_contain(map->filter, avl_key_hash(map, key))) {
+    return false;
+  }
+  GBC_STATS_INC(map, filter_skips);
+  return true;
+}
+
 static const avl_node_t *avl_get_node(const avl_map_t *map,
                                       const avl_key_t key) {
+  if (avl_filter_rejects(map, key)) return NULL;
   avl_node_t *node = map->root;
   for (;;) {
     if (!node) return NULL;
+    GBC_STATS_INC(map, cmp_calls);
     int order = map->cmp_fn(key, node->pair.key);
     if (order == 0)
       break;
@@ -458,9 +563,11 @@ static const avl_node_t *avl_get_node(const avl_map_t *map,
 }
 
 static avl_node_t *avl_get_node_mut(const avl_map_t *map, const avl_key_t key) {
+  if (avl_filter_rejects(map, key)) return NULL;
   avl_node_t *node = map->root;
   for (;;) {
     if (!node) return NULL;
+    GBC_STATS_INC(map, cmp_calls);
     int order = map->cmp_fn(key, node->pair.key);
     if (order == 0)
       break;
@@ -518,92 +625,140 @@ static void avl_try_reblance(avl_map_t *map, avl_node_t *node) {
   }
 }
 
-bool avl_map_add(avl_map_t *map, const avl_key_t _key, const avl_val_t _val) {
-  avl_node_t *new_node =
-      avl_node_new(_key, map->key_obj_size, _val, map->val_obj_size);
-  if (!new_node) return false;
-  if (map->size == 0) {
-    map->size++;
-    new_node->parent = NULL;
-    map->root = new_node;
-    return true;
-  }
-  avl_node_t *parent_n = map->root;
-  for (;;) {
-    int order = map->cmp_fn(_key, parent_n->pair.key);
-    if (order == 0) {
-      avl_node_update(parent_n, _val, map->val_obj_size);
-      return true;
-    } else if (order < 0) {
-      if (parent_n->left) {
-        parent_n = parent_n->left;
-        continue;
-      } else {
-        new_node->parent = parent_n;
-        parent_n->left = new_node;
-        map->size++;
-        break;
-      }
-    } else {
-      if (parent_n->right) {
-        parent_n = parent_n->right;
-        continue;
-      } else {
-        new_node->parent = parent_n;
-        parent_n->right = new_node;
-        map->size++;
-        break;
-      }
-    }
+/// @brief hang a fresh node under parent on the side given by order (the
+/// result of comparing the new key against the parent key) and rebalance.
+/// A NULL parent makes the node the root
+static void avl_link_node(avl_map_t *map, avl_node_t *parent,
+                          avl_node_t *node, int order) {
+  node->parent = parent;
+  node->left = node->right = NULL;
+  node->height = 1;
+  map->size++;
+#ifdef GBC_STATS
+  size_t depth = 1;
+  for (avl_node_t *n = parent; n; n = n->parent) depth++;
+  GBC_STATS_MAX(map, max_depth, depth);
+#endif
+  if (!parent) {
+    map->root = node;
+    return;
   }
-  avl_try_reblance(map, new_node);
-  return true;
+  if (order < 0)
+    parent->left = node;
+  else
+    parent->right = node;
+  avl_try_reblance(map, parent);
 }
 
-bool avl_map_del(avl_map_t *map, const avl_key_t key) {
-  avl_node_t *target_node = avl_get_node_mut(map, key);
-  if (!target_node) return false;
+/// @brief take a node out of the tree and rebalance, without freeing it
+static void avl_unlink_node(avl_map_t *map, avl_node_t *target_node) {
   map->size--;
   avl_node_t *cur_parent = target_node->parent;
   avl_node_t *cur_left = target_node->left;
   avl_node_t *cur_right = target_node->right;
+  avl_node_t *rebalance_from = cur_parent;
   if (cur_left && cur_right) {
+    // the biggest node of the left subtree takes the place of the target
     avl_node_t *cur_left_max = avl_find_max_child(cur_left);
-    avl_unlink(cur_left_max, cur_left_max->parent, map);
-    avl_relink(cur_left_max, cur_parent, map);
-    avl_set_right(cur_left_max, cur_right);
     if (cur_left_max != cur_left) {
-      avl_set_left(cur_left_max, cur_left);
+      rebalance_from = cur_left_max->parent;
+      avl_replace_child(map, rebalance_from, cur_left_max, cur_left_max->left);
+      cur_left_max->left = cur_left;
+      cur_left->parent = cur_left_max;
+    } else {
+      rebalance_from = cur_left_max;
     }
-    avl_try_reblance(map, cur_left_max);
-  } else if (cur_left && !cur_right && cur_parent) {
-    cur_left->parent = NULL;
-    target_node->left = NULL;
-    avl_relink(cur_left, cur_parent, map);
-    avl_try_reblance(map, cur_left);
-  } else if (cur_left && !cur_right && !cur_parent) {
-    target_node->left = NULL;
-    cur_left->parent = NULL;
-    map->root = cur_left;
-    avl_try_reblance(map, cur_left);
-  } else if (!cur_left && cur_right && cur_parent) {
-    target_node->right = NULL;
-    cur_right->parent = NULL;
-    avl_relink(cur_right, cur_parent, map);
-    avl_try_reblance(map, cur_right);
-  } else if (!cur_left && cur_right && !cur_parent) {
-    target_node->right = NULL;
-    cur_right->parent = NULL;
-    map->root = cur_right;
-    avl_try_reblance(map, cur_right);
-  } else if (!cur_left && !cur_right && cur_parent) {
-    avl_unlink(target_node, cur_parent, map);
-    avl_try_reblance(map, cur_parent);
+    cur_left_max->right = cur_right;
+    cur_right->parent = cur_left_max;
+    avl_replace_child(map, cur_parent, target_node, cur_left_max);
+  } else if (cur_left) {
+    avl_replace_child(map, cur_parent, target_node, cur_left);
   } else {
-    // !cur_left && !cur_right && !cur_parent
-    map->root = NULL;
+    // cur_right may be NULL when the target is a leaf
+    avl_replace_child(map, cur_parent, target_node, cur_right);
   }
-  avl_node_drop(target_node);
+  target_node->parent = target_node->left = target_node->right = NULL;
+  avl_try_reblance(map, rebalance_from);
+}
+
+/// @brief replace the filter of the map by a new one of kind holding its
+/// keys, with room for as many again
+static bool avl_filter_rebuild(avl_map_t *map, gbc_filter_kind_t kind) {
+  size_t cap = avl_max(map->size * 2, GBC_FILTER_MIN_CAP);
+  gbc_filter_t *f = gbc_filter_new(kind, cap, map->alloc);
+  if (f) {
+    avl_map_iter_t iter;
+    avl_map_iter_init(&iter, map);
+    avl_pair_t *pair;
+    while ((pair = avl_map_iter_next(&iter))) {
+      gbc_filter_add(f, avl_key_hash(map, pair->key));
+    }
+    avl_map_iter_fini(&iter);
+  }
+  gbc_filter_drop(map->filter);
+  map->filter = f;
+  map->filter_stale = 0;
+  return f != NULL;
+}
+
+bool avl_map_enable_filter(avl_map_t *map, gbc_filter_kind_t kind,
+                           gbc_hash_fn hash_fn) {
+  assert(map);
+  map->hash_fn = hash_fn ? hash_fn : gbc_hash_bytes;
+  return avl_filter_rebuild(map, kind);
+}
+
+void avl_map_disable_filter(avl_map_t *map) {
+  assert(map);
+  gbc_filter_drop(map->filter);
+  map->filter = NULL;
+  map->filter_stale = 0;
+}
+
+/// @brief put a key just linked into the filter of the map, if it has one
+static void avl_filter_added(avl_map_t *map, const avl_key_t key) {
+  if (map->filter && !gbc_filter_add(map->filter, avl_key_hash(map, key))) {
+    avl_filter_rebuild(map, map->filter->kind);
+  }
+}
+
+/// @brief take the key of hash, just unlinked, out of the filter of the map
+static void avl_filter_deleted(avl_map_t *map, uint64_t hash) {
+  if (map->filter && !gbc_filter_del(map->filter, hash) &&
+      ++map->filter_stale > map->size / 4) {
+    avl_filter_rebuild(map, map->filter->kind);
+  }
+}
+
+bool avl_map_add(avl_map_t *map, const avl_key_t _key, const avl_val_t _val) {
+  avl_node_t *parent_n = map->root;
+  int order = 0;
+  while (parent_n) {
+    GBC_STATS_INC(map, cmp_calls);
+    order = map->cmp_fn(_key, parent_n->pair.key);
+    if (order == 0) {
+      avl_node_update(parent_n, _val, map->val_obj_size);
+      return true;
+    }
+    avl_node_t *next_n = (order < 0) ? parent_n->left : parent_n->right;
+    if (!next_n) break;
+    parent_n = next_n;
+  }
+  avl_node_t *new_node = avl_node_new(map, _key, _val);
+  if (!new_node) return false;
+  avl_link_node(map, parent_n, new_node, order);
+  avl_filter_added(map, _key);
+  return true;
+}
+
+bool avl_map_del(avl_map_t *map, const avl_key_t key) {
+  avl_node_t *target_node = avl_get_node_mut(map, key);
+  if (!target_node) return false;
+  // key may be the node's own, hash it before the node goes
+  uint64_t hash = map->filter ? avl_key_hash(map, key) : 0;
+  avl_unlink_node(map, target_node);
+  avl_node_drop(map, target_node);
+  avl_filter_deleted(map, hash);
   return true;
 }
 
@@ -652,6 +807,7 @@ bool avl_map_del_max(avl_map_t *map) {
 
 bool avl_map_drop(avl_map_t *map) {
   assert(map);
+  avl_map_disable_filter(map);
   size_t len = map->size;
   for (int i = 0; i < len; ++i) {
     bool flag = avl_map_del_min(map);
@@ -673,17 +829,29 @@ void avl_map_foreach(const avl_map_t *map, avl_foreach fn) {
   avl_map_middle_order_impl(map->root, fn);
 }
 
+bool avl_map_stats(const avl_map_t *map, gbc_stats_t *out) {
+  assert(map && out);
+  return GBC_STATS_READ(map, out);
+}
+
 avl_set_t *avl_set_new(size_t key_obj_size, avl_cmp_fn cmp_fn) {
-  avl_map_t *map = avl_map_new(key_obj_size, sizeof(set_value), cmp_fn);
+  return avl_set_new_ex(key_obj_size, cmp_fn, NULL);
+}
+
+avl_set_t *avl_set_new_ex(size_t key_obj_size, avl_cmp_fn cmp_fn,
+                          const gbc_allocator_t *alloc) {
+  avl_map_t *map =
+      avl_map_new_ex(key_obj_size, sizeof(set_value), cmp_fn, alloc);
   if (!map) return NULL;
-  avl_set_t *set = (avl_set_t *)malloc(sizeof(avl_set_t));
+  avl_set_t *set = (avl_set_t *)gbc_alloc(map->alloc, sizeof(avl_set_t));
   if (!set) {
-    avl_map_drop(map);
+    gbc_free(map->alloc, map, sizeof(avl_map_t));
     map = NULL;
     return NULL;
   }
   set->map = map;
   set->size = 0;
+  return set;
 }
 
 bool avl_set_add(avl_set_t *set, const avl_key_t key) {
@@ -704,67 +872,59 @@ bool avl_set_contains(const avl_set_t *set, const avl_key_t key) {
   return avl_map_contains(set->map, key);
 }
 
+bool avl_set_enable_filter(avl_set_t *set, gbc_filter_kind_t kind,
+                           gbc_hash_fn hash_fn) {
+  assert(set);
+  return avl_map_enable_filter(set->map, kind, hash_fn);
+}
+
+void avl_set_disable_filter(avl_set_t *set) {
+  assert(set);
+  avl_map_disable_filter(set->map);
+}
+
 bool avl_set_drop(avl_set_t *set) {
+  const gbc_allocator_t *alloc = set->map->alloc;
   bool flag = avl_map_drop(set->map);
-  free(set);
+  gbc_free(alloc, set->map, sizeof(avl_map_t));
+  gbc_free(alloc, set, sizeof(avl_set_t));
   set = NULL;
   return flag;
 }
 
 bool _avl_map_iter_has_next(const iter_t *_iter) {
   const avl_map_iter_t *iter = (avl_map_iter_t *)_iter;
-  return iter->next_ptrs->size > 0;
+  return iter->next_node != NULL;
 }
 
 bool _avl_set_iter_has_next(const iter_t *_iter) {
   const avl_set_iter_t *iter = (avl_set_iter_t *)_iter;
-  return iter->next_ptrs->size > 0;
-}
-
-#define _avl_iter_next                                                         \
-  avl_node_t *out = NULL;                                                      \
-  for (;;) {                                                                   \
-    if (iter->next_ptrs->size == 0) break;                                     \
-    avl_node_t **cur_node_ptr =                                                \
-        (avl_node_t **)vec_at_mut(iter->next_ptrs, iter->next_ptrs->size - 1); \
-    if (!cur_node_ptr) {                                                       \
-      vec_del_top(iter->next_ptrs);                                            \
-      continue;                                                                \
-    }                                                                          \
-    avl_node_t *cur_left = (*cur_node_ptr)->left;                              \
-    avl_node_t *cur_right = (*cur_node_ptr)->right;                            \
-    avl_node_t *cur_left_ptr = NULL;                                           \
-    avl_node_t *cur_right_ptr = NULL;                                          \
-    if (cur_left && !avl_set_contains(iter->seen_ptrs, &cur_left)) {           \
-      cur_left_ptr = cur_left;                                                 \
-    }                                                                          \
-    if (cur_right && !avl_set_contains(iter->seen_ptrs, &cur_right)) {         \
-      cur_right_ptr = cur_right;                                               \
-    }                                                                          \
-                                                                               \
-    if (!cur_left_ptr && cur_right_ptr) {                                      \
-      out = *cur_node_ptr;                                                     \
-      vec_del_top(iter->next_ptrs);                                            \
-      avl_set_add(iter->seen_ptrs, &out);                                      \
-      vec_push(iter->next_ptrs, &cur_right_ptr);                               \
-      break;                                                                   \
-    } else if (cur_left_ptr && cur_right_ptr) {                                \
-      vec_push(iter->next_ptrs, &cur_left_ptr);                                \
-      continue;                                                                \
-    } else if (!cur_left_ptr && !cur_right_ptr) {                              \
-      out = *cur_node_ptr;                                                     \
-      vec_del_top(iter->next_ptrs);                                            \
-      avl_set_add(iter->seen_ptrs, &out);                                      \
-      break;                                                                   \
-    } else {                                                                   \
-      /* cur_left && !cur_right */                                             \
-      vec_push(iter->next_ptrs, &cur_left_ptr);                                \
-      continue;                                                                \
-    }                                                                          \
-  }                                                                            \
-  if (!out) return NULL;                                                       \
-  avl_pair_t *pair_ptr = &out->pair;                                           \
-  return pair_ptr;
+  return iter->next_node != NULL;
+}
+
+static avl_node_t *avl_leftmost(avl_node_t *node) {
+  if (!node) return NULL;
+  while (node->left) node = node->left;
+  return node;
+}
+
+/// @brief the in-order successor: the leftmost node of the right subtree,
+/// or else the first ancestor reached from its left subtree
+static avl_node_t *avl_successor(avl_node_t *node) {
+  if (node->right) return avl_leftmost(node->right);
+  avl_node_t *parent = node->parent;
+  while (parent && parent->right == node) {
+    node = parent;
+    parent = parent->parent;
+  }
+  return parent;
+}
+
+#define _avl_iter_next                   \
+  avl_node_t *out = iter->next_node;     \
+  if (!out) return NULL;                 \
+  iter->next_node = avl_successor(out);  \
+  return &out->pair;
 
 void *_avl_map_iter_next(iter_t *_iter) {
   avl_map_iter_t *iter = (avl_map_iter_t *)_iter;
@@ -776,90 +936,87 @@ void *_avl_set_iter_next(iter_t *_iter) {
   _avl_iter_next
 }
 
-typedef avl_node_t *avl_node_ptr;
-
-static int avl_node_ptr_cmp(const void *n1, const void *n2) {
-  const avl_node_ptr *a1 = (avl_node_ptr *)n1;
-  const avl_node_ptr *a2 = (avl_node_ptr *)n2;
-  if (*a1 == *a2)
-    return 0;
-  else if (*a1 < *a2)
-    return -1;
-  else
-    return 1;
+/// the nodes are not contiguous, the batch is an array of pair pointers
+/// filled with direct calls of the walk
+size_t _avl_map_iter_next_batch(iter_t *_iter, iter_batch_t *batch,
+                                size_t max) {
+  assert(batch->ptrs || max == 0);
+  batch->span = NULL;
+  batch->len = 0;
+  while (batch->len < max && _avl_map_iter_has_next(_iter)) {
+    batch->ptrs[batch->len++] = _avl_map_iter_next(_iter);
+  }
+  return batch->len;
 }
 
-avl_map_iter_t *avl_map_iter_new(avl_map_t *map) {
-  assert(map);
-  avl_map_iter_t *iter = (avl_map_iter_t *)malloc(sizeof(avl_map_iter_t));
-  if (!iter) {
-    return NULL;
+size_t _avl_set_iter_next_batch(iter_t *_iter, iter_batch_t *batch,
+                                size_t max) {
+  assert(batch->ptrs || max == 0);
+  batch->span = NULL;
+  batch->len = 0;
+  while (batch->len < max && _avl_set_iter_has_next(_iter)) {
+    batch->ptrs[batch->len++] = _avl_set_iter_next(_iter);
   }
+  return batch->len;
+}
+
+void avl_map_iter_init(avl_map_iter_t *iter, avl_map_t *map) {
+  assert(iter && map);
   iter_t base = {.obj_size = sizeof(avl_pair_t),
                  .has_next = _avl_map_iter_has_next,
-                 .next = _avl_map_iter_next};
+                 .next = _avl_map_iter_next,
+                 .next_batch = _avl_map_iter_next_batch};
   iter->base = base;
-  next_nodes_ptr next_ptrs = vec_new(sizeof(avl_node_t *));
-  if (!next_ptrs) {
-    free(iter);
-    return NULL;
-  }
-  seen_nodes_ptr seen_ptrs =
-      avl_set_new(sizeof(avl_node_t *), avl_node_ptr_cmp);
-  if (!seen_ptrs) {
-    free(iter);
-    vec_drop(next_ptrs);
-    return NULL;
-  }
-  if (map->size > 0) {
-    vec_push(next_ptrs, &map->root);
-  }
+  iter->next_node = avl_leftmost(map->root);
+  iter->alloc = NULL;
+  GBC_PROBE3(iter_new, map, iter, map->size);
+}
+
+void avl_set_iter_init(avl_set_iter_t *iter, avl_set_t *set) {
+  assert(iter && set);
+  iter_t base = {.obj_size = sizeof(avl_pair_t),
+                 .has_next = _avl_set_iter_has_next,
+                 .next = _avl_set_iter_next,
+                 .next_batch = _avl_set_iter_next_batch};
   iter->base = base;
-  iter->next_ptrs = next_ptrs;
-  iter->seen_ptrs = seen_ptrs;
+  iter->next_node = avl_leftmost(set->map->root);
+  iter->alloc = NULL;
+  GBC_PROBE3(iter_new, set, iter, set->size);
+}
+
+void avl_map_iter_fini(avl_map_iter_t *iter) {
+  assert(iter && !iter->alloc);
+  iter->next_node = NULL;
+}
+
+void avl_set_iter_fini(avl_set_iter_t *iter) {
+  assert(iter && !iter->alloc);
+  iter->next_node = NULL;
+}
+
+avl_map_iter_t *avl_map_iter_new(avl_map_t *map) {
+  assert(map);
+  avl_map_iter_t *iter =
+      (avl_map_iter_t *)gbc_alloc(map->alloc, sizeof(avl_map_iter_t));
+  if (!iter) return NULL;
+  avl_map_iter_init(iter, map);
+  iter->alloc = map->alloc;
   return iter;
 }
 
 avl_set_iter_t *avl_set_iter_new(avl_set_t *set) {
   assert(set);
-  avl_set_iter_t *iter = (avl_set_iter_t *)malloc(sizeof(avl_set_iter_t));
+  avl_set_iter_t *iter =
+      (avl_set_iter_t *)gbc_alloc(set->map->alloc, sizeof(avl_set_iter_t));
   if (!iter) return NULL;
-  iter_t base = {.obj_size = sizeof(avl_pair_t),
-                 .has_next = _avl_set_iter_has_next,
-                 .next = _avl_set_iter_next};
-  iter->base = base;
-  next_nodes_ptr next_ptrs = vec_new(sizeof(avl_node_t *));
-  if (!next_ptrs) {
-    free(iter);
-    return NULL;
-  }
-  seen_nodes_ptr seen_ptrs =
-      avl_set_new(sizeof(avl_node_t *), avl_node_ptr_cmp);
-  if (!seen_ptrs) {
-    free(iter);
-    vec_drop(next_ptrs);
-    return NULL;
-  }
-  if (set->size > 0) {
-    vec_push(next_ptrs, &(set->map->root));
-  }
-  iter->base = base;
-  iter->next_ptrs = next_ptrs;
-  iter->seen_ptrs = seen_ptrs;
+  avl_set_iter_init(iter, set);
+  iter->alloc = set->map->alloc;
   return iter;
 }
 
-#define _avl_iter_drop             \
-  if (!iter) return false;         \
-  if (iter->next_ptrs) {           \
-    vec_drop(iter->next_ptrs);     \
-    iter->next_ptrs = NULL;        \
-  }                                \
-  if (iter->seen_ptrs) {           \
-    avl_set_drop(iter->seen_ptrs); \
-    iter->seen_ptrs = NULL;        \
-  }                                \
-  free(iter);                      \
+#define _avl_iter_drop                         \
+  if (!iter) return false;                     \
+  gbc_free(iter->alloc, iter, sizeof(*iter));  \
   return true;
 
 bool avl_map_iter_drop(avl_map_iter_t *iter) { _avl_iter_drop }
@@ -886,64 +1043,196 @@ void *avl_set_iter_next(avl_set_iter_t *iter) {
   return out->key;
 }
 
-avl_set_t *avl_set_intersection(avl_set_t *set1, avl_set_t *set2) {
-  assert(set1 && set2);
-  avl_set_t *out = avl_set_new(set1->map->key_obj_size, set1->map->cmp_fn);
-  avl_set_iter_t *iter1 = avl_set_iter_new(set1);
-  avl_set_iter_t *iter2 = avl_set_iter_new(set2);
-  while (avl_set_iter_has_next(iter1)) {
-    const avl_key_t n = avl_set_iter_next(iter1);
-    bool in_set1 = avl_set_contains(set1, n);
-    bool in_set2 = avl_set_contains(set2, n);
-    if (in_set1 && in_set2) {
-      avl_set_add(out, n);
+/// @brief add the keys of src to out, those in filter only when keep is
+/// true and those not in filter only when keep is false. The keys are pulled
+/// a batch at a time
+static void avl_set_add_from(avl_set_t *out, avl_set_t *src,
+                             avl_set_t *filter, bool keep) {
+  avl_set_iter_t iter;
+  avl_set_iter_init(&iter, src);
+  void *ptrs[ITER_BATCH_MAX];
+  iter_batch_t batch = {.span = NULL, .ptrs = ptrs, .len = 0};
+  while (iter_next_batch(&iter.base, &batch, ITER_BATCH_MAX) > 0) {
+    for (size_t i = 0; i < batch.len; ++i) {
+      const avl_key_t key = ((avl_pair_t *)batch.ptrs[i])->key;
+      if (filter && avl_set_contains(filter, key) != keep) continue;
+      avl_set_add(out, key);
     }
   }
-  while (avl_set_iter_has_next(iter2)) {
-    const avl_key_t n = avl_set_iter_next(iter2);
-    bool in_set1 = avl_set_contains(set1, n);
-    bool in_set2 = avl_set_contains(set2, n);
-    if (in_set1 && in_set2) {
-      avl_set_add(out, n);
-    }
-  }
-  avl_set_iter_drop(iter1);
-  avl_set_iter_drop(iter2);
+  avl_set_iter_fini(&iter);
+}
+
+avl_set_t *avl_set_intersection(avl_set_t *set1, avl_set_t *set2) {
+  assert(set1 && set2);
+  avl_set_t *out = avl_set_new_ex(set1->map->key_obj_size, set1->map->cmp_fn,
+                                  set1->map->alloc);
+  if (!out) return NULL;
+  // walk the smaller set and probe the bigger one
+  avl_set_t *small = set1->size <= set2->size ? set1 : set2;
+  avl_set_t *big = small == set1 ? set2 : set1;
+  avl_set_add_from(out, small, big, true);
   return out;
 }
 
 avl_set_t *avl_set_union(avl_set_t *set1, avl_set_t *set2) {
   assert(set1 && set2);
-  avl_set_t *out = avl_set_new(set1->map->key_obj_size, set1->map->cmp_fn);
-  avl_set_iter_t *iter1 = avl_set_iter_new(set1);
-  avl_set_iter_t *iter2 = avl_set_iter_new(set2);
-  while (avl_set_iter_has_next(iter1)) {
-    const avl_key_t n = avl_set_iter_next(iter1);
-    avl_set_add(out, n);
-  }
-  while (avl_set_iter_has_next(iter2)) {
-    const avl_key_t n = avl_set_iter_next(iter2);
-    avl_set_add(out, n);
-  }
-  avl_set_iter_drop(iter1);
-  avl_set_iter_drop(iter2);
+  avl_set_t *out = avl_set_new_ex(set1->map->key_obj_size, set1->map->cmp_fn,
+                                  set1->map->alloc);
+  if (!out) return NULL;
+  avl_set_add_from(out, set1, NULL, true);
+  avl_set_add_from(out, set2, NULL, true);
   return out;
 }
 
 avl_set_t *avl_set_diff(avl_set_t *set1, avl_set_t *set2) {
   assert(set1 && set2);
-  avl_set_t *out = avl_set_new(set1->map->key_obj_size, set1->map->cmp_fn);
-  avl_set_iter_t *iter1 = avl_set_iter_new(set1);
-  while (avl_set_iter_has_next(iter1)) {
-    const avl_key_t n = avl_set_iter_next(iter1);
-    bool in_set1 = avl_set_contains(set1, n);
-    bool in_set2 = avl_set_contains(set2, n);
-    if (in_set1 && !in_set2) {
-      avl_set_add(out, n);
-    }
-  }
-  avl_set_iter_drop(iter1);
+  avl_set_t *out = avl_set_new_ex(set1->map->key_obj_size, set1->map->cmp_fn,
+                                  set1->map->alloc);
+  if (!out) return NULL;
+  avl_set_add_from(out, set1, set2, false);
   return out;
 }
 
+/// @brief three-way compare of two scalar values, usable as the CMP argument
+/// of GBC_AVL_DECLARE for integer and floating point keys
+#define GBC_AVL_CMP_NUM(a, b) (((a) > (b)) - ((a) < (b)))
+
+/// @brief generate a typed avl map `name##_t` whose keys and values are stored
+/// by value inside the node and whose key comparison `CMP(KeyT, KeyT)` is
+/// expanded inline on every descent step. Rotations, linking and unlinking are
+/// shared with avl_map_t, so the generated map embeds one as `base`; the
+/// generic read-only functions (avl_map_foreach, avl_map_iter_new, ...) accept
+/// `&map->base`, but nodes must only be added or deleted through the typed API.
+/// avl_map_enable_filter(&map->base, ...) puts a filter in front of the typed
+/// lookups, the typed add and del keep it up to date
+/// @param name: prefix of the generated type and functions
+/// @param KeyT: the key type
+/// @param ValT: the value type
+/// @param CMP: a function or macro taking two KeyT, returning <0, 0 or >0
+#define GBC_AVL_DECLARE(name, KeyT, ValT, CMP)                               \
+  typedef struct _##name##_node {                                            \
+    avl_node_t base;                                                         \
+    KeyT key;                                                                \
+    ValT val;                                                                \
+  } name##_node_t;                                                           \
+                                                                             \
+  typedef struct _##name {                                                   \
+    avl_map_t base;                                                          \
+  } name##_t;                                                                \
+                                                                             \
+  static int name##_cmp_fn(const void *a, const void *b) {                   \
+    return CMP(*(const KeyT *)a, *(const KeyT *)b);                          \
+  }                                                                          \
+                                                                             \
+  static inline name##_t *name##_new_ex(const gbc_allocator_t *alloc) {      \
+    alloc = gbc_allocator_or_std(alloc);                                     \
+    name##_t *map = (name##_t *)gbc_alloc(alloc, sizeof(name##_t));          \
+    if (!map) return NULL;                                                   \
+    map->base.alloc = alloc;                                                 \
+    map->base.cmp_fn = name##_cmp_fn;                                        \
+    map->base.root = NULL;                                                   \
+    map->base.size = 0;                                                      \
+    map->base.key_obj_size = sizeof(KeyT);                                   \
+    map->base.val_obj_size = sizeof(ValT);                                   \
+    map->base.filter = NULL;                                                 \
+    map->base.hash_fn = NULL;                                                \
+    map->base.filter_stale = 0;                                              \
+    GBC_STATS_INIT(&map->base);                                              \
+    GBC_STATS_ALLOC(&map->base, sizeof(name##_t));                           \
+    return map;                                                              \
+  }                                                                          \
+                                                                             \
+  static inline name##_t *name##_new(void) { return name##_new_ex(NULL); }   \
+                                                                             \
+  static inline size_t name##_size(const name##_t *map) {                    \
+    return map->base.size;                                                   \
+  }                                                                          \
+                                                                             \
+  static inline name##_node_t *name##_find(const name##_t *map, KeyT key) {  \
+    if (avl_filter_rejects(&map->base, &key)) return NULL;                   \
+    avl_node_t *node = map->base.root;                                       \
+    while (node) {                                                           \
+      name##_node_t *typed = (name##_node_t *)node;                          \
+      GBC_STATS_INC(&map->base, cmp_calls);                                  \
+      int order = CMP(key, typed->key);                                      \
+      if (order == 0) return typed;                                          \
+      node = (order < 0) ? node->left : node->right;                         \
+    }                                                                        \
+    return NULL;                                                             \
+  }                                                                          \
+                                                                             \
+  static inline bool name##_add(name##_t *map, KeyT key, ValT val) {         \
+    avl_node_t *parent_n = map->base.root;                                   \
+    int order = 0;                                                           \
+    while (parent_n) {                                                       \
+      name##_node_t *typed = (name##_node_t *)parent_n;                      \
+      GBC_STATS_INC(&map->base, cmp_calls);                                  \
+      order = CMP(key, typed->key);                                          \
+      if (order == 0) {                                                      \
+        typed->val = val;                                                    \
+        return true;                                                         \
+      }                                                                      \
+      avl_node_t *next_n = (order < 0) ? parent_n->left : parent_n->right;   \
+      if (!next_n) break;                                                    \
+      parent_n = next_n;                                                     \
+    }                                                                        \
+    name##_node_t *node =                                                    \
+        (name##_node_t *)gbc_alloc(map->base.alloc, sizeof(name##_node_t));  \
+    if (!node) return false;                                                 \
+    GBC_STATS_ALLOC(&map->base, sizeof(name##_node_t));                      \
+    GBC_PROBE3(avl_node_alloc, &map->base, node, sizeof(name##_node_t));     \
+    node->key = key;                                                         \
+    node->val = val;                                                         \
+    node->base.pair.key = (char *)&node->key;                                \
+    node->base.pair.val = (char *)&node->val;                                \
+    avl_link_node(&map->base, parent_n, &node->base, order);                 \
+    avl_filter_added(&map->base, &key);                                      \
+    return true;                                                             \
+  }                                                                          \
+                                                                             \
+  static inline void name##_node_drop(name##_t *map, name##_node_t *node) {  \
+    GBC_PROBE3(avl_node_free, &map->base, node, sizeof(name##_node_t));      \
+    gbc_free(map->base.alloc, node, sizeof(name##_node_t));                  \
+    GBC_STATS_FREE(&map->base, sizeof(name##_node_t));                       \
+  }                                                                          \
+                                                                             \
+  static inline bool name##_del(name##_t *map, KeyT key) {                   \
+    name##_node_t *node = name##_find(map, key);                             \
+    if (!node) return false;                                                 \
+    uint64_t hash = map->base.filter ? avl_key_hash(&map->base, &key) : 0;   \
+    avl_unlink_node(&map->base, &node->base);                                \
+    name##_node_drop(map, node);                                             \
+    avl_filter_deleted(&map->base, hash);                                    \
+    return true;                                                             \
+  }                                                                          \
+                                                                             \
+  static inline bool name##_contains(const name##_t *map, KeyT key) {        \
+    return name##_find(map, key) != NULL;                                    \
+  }                                                                          \
+                                                                             \
+  static inline const ValT *name##_get(const name##_t *map, KeyT key) {      \
+    name##_node_t *node = name##_find(map, key);                             \
+    return node ? &node->val : NULL;                                         \
+  }                                                                          \
+                                                                             \
+  static inline ValT *name##_get_mut(name##_t *map, KeyT key) {              \
+    name##_node_t *node = name##_find(map, key);                             \
+    return node ? &node->val : NULL;                                         \
+  }                                                                          \
+                                                                             \
+  static inline void name##_drop_subtree(name##_t *map, avl_node_t *node) {  \
+    if (!node) return;                                                       \
+    name##_drop_subtree(map, node->left);                                    \
+    name##_drop_subtree(map, node->right);                                   \
+    name##_node_drop(map, (name##_node_t *)node);                            \
+  }                                                                          \
+                                                                             \
+  static inline bool name##_drop(name##_t *map) {                            \
+    if (!map) return false;                                                  \
+    avl_map_disable_filter(&map->base);                                      \
+    name##_drop_subtree(map, map->base.root);                                \
+    gbc_free(map->base.alloc, map, sizeof(name##_t));                        \
+    return true;                                                             \
+  }
+
 #endif
\ No newline at end of file
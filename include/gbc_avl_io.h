@@ -0,0 +1,415 @@
+#ifndef _GBC_AVL_IO_H
+#define _GBC_AVL_IO_H
+// Snapshots are mapped and read with POSIX calls, as in gbc_vector_io.h,
+// which a strict -std=c11 hides unless the macros below are defined ahead
+// of every system header: include this header first, define them yourself
+// or build with -std=gnu11.
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gbc_alloc.h"
+#include "gbc_avl.h"
+#include "gbc_vector_io.h"
+
+#define AVL_FILE_MAGIC "GBCAVL1"
+#define AVL_FILE_ALIGN 8
+// a multiple of 8, so the checksum goes a word at a time across flushes
+#define AVL_FILE_BUF_SIZE 4096
+
+/// @brief the header at the start of a map snapshot. It is followed by the
+/// count keys in ascending order as one contiguous array, then, starting on
+/// an AVL_FILE_ALIGN boundary, the count values in the same order. Integers
+/// are stored in native byte order
+/// @param char magic[8]: AVL_FILE_MAGIC
+/// @param uint64_t key_obj_size
+/// @param uint64_t val_obj_size
+/// @param uint64_t count: the number of pairs
+/// @param uint64_t vals_offset: the file offset of the value array
+/// @param uint64_t checksum: vec_file_checksum of everything after the header
+typedef struct _avl_file_header {
+  char magic[8];
+  uint64_t key_obj_size;
+  uint64_t val_obj_size;
+  uint64_t count;
+  uint64_t vals_offset;
+  uint64_t checksum;
+  uint64_t reserved[2];
+} avl_file_header_t;
+
+/// @brief a read-only view of a map snapshot mapped into memory. Lookups are
+/// binary searches over the sorted key array, no node is ever built
+/// @param const char* keys: the sorted key array
+/// @param const char* vals: the value array, vals[i] belongs to keys[i]
+/// @param size_t count: the number of pairs
+/// @param cmp_fn: the compare function the map was ordered with
+typedef struct _avl_snapshot {
+  const char *keys;
+  const char *vals;
+  size_t count;
+  size_t key_obj_size;
+  size_t val_obj_size;
+  avl_cmp_fn cmp_fn;
+  void *base;
+  size_t map_size;
+} avl_snapshot_t;
+
+/// @brief write the pairs of the map in ascending key order to path. For a
+/// set pass set->map
+/// @param map
+/// @param path
+/// @return return false if the file can not be written
+bool avl_map_save(const avl_map_t *map, const char *path);
+
+/// @brief rebuild a map saved by avl_map_save in O(n), without a single key
+/// comparison. The checksum is checked first
+/// @param path
+/// @param cmp_fn: must order the keys the way the saved map did
+/// @return return NULL if the file can not be read or is corrupted
+avl_map_t *avl_map_load(const char *path, avl_cmp_fn cmp_fn);
+
+/// @brief rebuild a map like avl_map_load with its memory from alloc
+/// @param path
+/// @param cmp_fn
+/// @param alloc: NULL for malloc/free
+/// @return
+avl_map_t *avl_map_load_ex(const char *path, avl_cmp_fn cmp_fn,
+                           const gbc_allocator_t *alloc);
+
+/// @brief map a snapshot read-only, nothing is read or copied up front
+/// @param path
+/// @param cmp_fn: must order the keys the way the saved map did
+/// @return return NULL if the file can not be opened or is not a snapshot
+avl_snapshot_t *avl_snapshot_open(const char *path, avl_cmp_fn cmp_fn);
+
+/// @brief unmap the snapshot, the pointers it returned become invalid
+/// @param snap
+/// @return
+bool avl_snapshot_close(avl_snapshot_t *snap);
+
+/// @brief check the whole snapshot against its checksum
+/// @param snap
+/// @return
+bool avl_snapshot_verify(const avl_snapshot_t *snap);
+
+/// @brief get the number of pairs in the snapshot
+/// @param snap
+/// @return
+size_t avl_snapshot_length(const avl_snapshot_t *snap);
+
+/// @brief get the value of a key, NULL if the key is not in the snapshot
+/// @param snap
+/// @param key
+/// @return
+const void *avl_snapshot_get(const avl_snapshot_t *snap, const void *key);
+
+/// @brief check if the snapshot contains the key
+/// @param snap
+/// @param key
+/// @return
+bool avl_snapshot_contains(const avl_snapshot_t *snap, const void *key);
+
+/// @brief get the index of the first key not smaller than key, count if
+/// there is none
+/// @param snap
+/// @param key
+/// @return
+size_t avl_snapshot_lower_bound(const avl_snapshot_t *snap, const void *key);
+
+/// @brief get the index of the first key bigger than key, count if there is
+/// none
+/// @param snap
+/// @param key
+/// @return
+size_t avl_snapshot_upper_bound(const avl_snapshot_t *snap, const void *key);
+
+/// @brief get the key at index idx in ascending order
+/// @param snap
+/// @param idx
+/// @return
+const void *avl_snapshot_key_at(const avl_snapshot_t *snap, size_t idx);
+
+/// @brief get the value at index idx in ascending key order
+/// @param snap
+/// @param idx
+/// @return
+const void *avl_snapshot_val_at(const avl_snapshot_t *snap, size_t idx);
+
+/// @brief call fn on every pair with lo <= key < hi in ascending order
+/// @param snap
+/// @param lo
+/// @param hi
+/// @param fn
+/// @return the number of pairs visited
+size_t avl_snapshot_range(const avl_snapshot_t *snap, const void *lo,
+                          const void *hi, avl_foreach fn);
+
+static inline size_t avl_file_vals_offset(size_t key_obj_size, size_t count) {
+  size_t end = sizeof(avl_file_header_t) + key_obj_size * count;
+  return (end + AVL_FILE_ALIGN - 1) & ~(size_t)(AVL_FILE_ALIGN - 1);
+}
+
+/// @brief the body of a snapshot is staged in buf, which is checksummed and
+/// written out whenever it fills up
+typedef struct _avl_file_writer {
+  FILE *f;
+  uint64_t checksum;
+  bool ok;
+  size_t used;
+  char buf[AVL_FILE_BUF_SIZE];
+} avl_file_writer_t;
+
+static void avl_file_flush(avl_file_writer_t *w) {
+  if (!w->ok || w->used == 0) return;
+  w->checksum = vec_file_checksum_update(w->checksum, w->buf, w->used);
+  w->ok = fwrite(w->buf, w->used, 1, w->f) == 1;
+  w->used = 0;
+}
+
+static void avl_file_write(avl_file_writer_t *w, const char *buf, size_t len) {
+  while (w->ok && len > 0) {
+    size_t n = AVL_FILE_BUF_SIZE - w->used;
+    if (n > len) n = len;
+    memcpy(w->buf + w->used, buf, n);
+    w->used += n;
+    buf += n;
+    len -= n;
+    if (w->used == AVL_FILE_BUF_SIZE) avl_file_flush(w);
+  }
+}
+
+/// @brief write the keys, or the values, of the subtree in ascending order
+static void avl_file_write_subtree(avl_file_writer_t *w,
+                                   const avl_node_t *node, bool keys,
+                                   size_t obj_size) {
+  while (node && w->ok) {
+    avl_file_write_subtree(w, node->left, keys, obj_size);
+    avl_file_write(w, keys ? node->pair.key : node->pair.val, obj_size);
+    node = node->right;
+  }
+}
+
+bool avl_map_save(const avl_map_t *map, const char *path) {
+  assert(map && path);
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  avl_file_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, AVL_FILE_MAGIC, sizeof(header.magic));
+  header.key_obj_size = map->key_obj_size;
+  header.val_obj_size = map->val_obj_size;
+  header.count = map->size;
+  header.vals_offset = avl_file_vals_offset(map->key_obj_size, map->size);
+
+  // the header is written twice, the checksum is only known at the end
+  avl_file_writer_t w;
+  w.f = f;
+  w.checksum = VEC_FILE_CHECKSUM_SEED;
+  w.used = 0;
+  w.ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  avl_file_write_subtree(&w, map->root, true, map->key_obj_size);
+  size_t keys_end = sizeof(header) + map->key_obj_size * map->size;
+  char padding[AVL_FILE_ALIGN] = {0};
+  avl_file_write(&w, padding, header.vals_offset - keys_end);
+  avl_file_write_subtree(&w, map->root, false, map->val_obj_size);
+  avl_file_flush(&w);
+  header.checksum = w.checksum;
+  if (w.ok) {
+    w.ok = fseek(f, 0, SEEK_SET) == 0 &&
+           fwrite(&header, sizeof(header), 1, f) == 1;
+  }
+  if (fclose(f) != 0) w.ok = false;
+  return w.ok;
+}
+
+avl_snapshot_t *avl_snapshot_open(const char *path, avl_cmp_fn cmp_fn) {
+  assert(path && cmp_fn);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(avl_file_header_t)) {
+    close(fd);
+    return NULL;
+  }
+  size_t map_size = st.st_size;
+  void *base = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+  const avl_file_header_t *header = (const avl_file_header_t *)base;
+  // the sizes are checked by division, a corrupt header must not wrap them
+  size_t data_size = map_size - sizeof(avl_file_header_t);
+  bool valid =
+      memcmp(header->magic, AVL_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+      header->key_obj_size > 0 &&
+      header->count <= data_size / header->key_obj_size &&
+      header->vals_offset ==
+          avl_file_vals_offset(header->key_obj_size, header->count) &&
+      header->vals_offset <= map_size &&
+      (header->val_obj_size == 0 ||
+       header->count <=
+           (map_size - header->vals_offset) / header->val_obj_size);
+  avl_snapshot_t *snap =
+      valid ? (avl_snapshot_t *)malloc(sizeof(avl_snapshot_t)) : NULL;
+  if (!snap) {
+    munmap(base, map_size);
+    return NULL;
+  }
+  snap->keys = (const char *)base + sizeof(avl_file_header_t);
+  snap->vals = (const char *)base + header->vals_offset;
+  snap->count = header->count;
+  snap->key_obj_size = header->key_obj_size;
+  snap->val_obj_size = header->val_obj_size;
+  snap->cmp_fn = cmp_fn;
+  snap->base = base;
+  snap->map_size = map_size;
+  return snap;
+}
+
+bool avl_snapshot_close(avl_snapshot_t *snap) {
+  if (!snap) return false;
+  munmap(snap->base, snap->map_size);
+  free(snap);
+  return true;
+}
+
+bool avl_snapshot_verify(const avl_snapshot_t *snap) {
+  assert(snap);
+  const avl_file_header_t *header = (const avl_file_header_t *)snap->base;
+  size_t body_size = header->vals_offset - sizeof(avl_file_header_t) +
+                     snap->val_obj_size * snap->count;
+  return vec_file_checksum(snap->keys, body_size) == header->checksum;
+}
+
+size_t avl_snapshot_length(const avl_snapshot_t *snap) {
+  assert(snap);
+  return snap->count;
+}
+
+size_t avl_snapshot_lower_bound(const avl_snapshot_t *snap, const void *key) {
+  assert(snap && key);
+  size_t lo = 0, hi = snap->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (snap->cmp_fn(snap->keys + mid * snap->key_obj_size, key) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+size_t avl_snapshot_upper_bound(const avl_snapshot_t *snap, const void *key) {
+  assert(snap && key);
+  size_t lo = 0, hi = snap->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (snap->cmp_fn(snap->keys + mid * snap->key_obj_size, key) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+const void *avl_snapshot_key_at(const avl_snapshot_t *snap, size_t idx) {
+  assert(snap && idx < snap->count);
+  return snap->keys + idx * snap->key_obj_size;
+}
+
+const void *avl_snapshot_val_at(const avl_snapshot_t *snap, size_t idx) {
+  assert(snap && idx < snap->count);
+  return snap->vals + idx * snap->val_obj_size;
+}
+
+const void *avl_snapshot_get(const avl_snapshot_t *snap, const void *key) {
+  size_t idx = avl_snapshot_lower_bound(snap, key);
+  if (idx == snap->count ||
+      snap->cmp_fn(avl_snapshot_key_at(snap, idx), key) != 0) {
+    return NULL;
+  }
+  return avl_snapshot_val_at(snap, idx);
+}
+
+bool avl_snapshot_contains(const avl_snapshot_t *snap, const void *key) {
+  return avl_snapshot_get(snap, key) != NULL;
+}
+
+size_t avl_snapshot_range(const avl_snapshot_t *snap, const void *lo,
+                          const void *hi, avl_foreach fn) {
+  assert(fn);
+  size_t from = avl_snapshot_lower_bound(snap, lo);
+  size_t to = avl_snapshot_lower_bound(snap, hi);
+  for (size_t i = from; i < to; ++i) {
+    fn(avl_snapshot_key_at(snap, i), avl_snapshot_val_at(snap, i));
+  }
+  return (to > from) ? to - from : 0;
+}
+
+/// @brief build a perfectly balanced subtree out of the pairs [lo, hi), which
+/// satisfies the avl invariant without any rotation
+static avl_node_t *avl_build_sorted(avl_map_t *map, const avl_snapshot_t *snap,
+                                    size_t lo, size_t hi, avl_node_t *parent,
+                                    bool *ok) {
+  if (lo >= hi || !*ok) return NULL;
+  size_t mid = lo + (hi - lo) / 2;
+  avl_node_t *node =
+      avl_node_new(map, (avl_key_t)avl_snapshot_key_at(snap, mid),
+                   (avl_val_t)avl_snapshot_val_at(snap, mid));
+  if (!node) {
+    *ok = false;
+    return NULL;
+  }
+  node->parent = parent;
+  map->size++;
+  node->left = avl_build_sorted(map, snap, lo, mid, node, ok);
+  node->right = avl_build_sorted(map, snap, mid + 1, hi, node, ok);
+  node->height = 1 + avl_max(avl_node_height(node->left),
+                             avl_node_height(node->right));
+  return node;
+}
+
+avl_map_t *avl_map_load(const char *path, avl_cmp_fn cmp_fn) {
+  return avl_map_load_ex(path, cmp_fn, NULL);
+}
+
+avl_map_t *avl_map_load_ex(const char *path, avl_cmp_fn cmp_fn,
+                           const gbc_allocator_t *alloc) {
+  avl_snapshot_t *snap = avl_snapshot_open(path, cmp_fn);
+  if (!snap) return NULL;
+  if (!avl_snapshot_verify(snap)) {
+    avl_snapshot_close(snap);
+    return NULL;
+  }
+  avl_map_t *map = avl_map_new_ex(snap->key_obj_size, snap->val_obj_size,
+                                  cmp_fn, alloc);
+  if (!map) {
+    avl_snapshot_close(snap);
+    return NULL;
+  }
+  bool ok = true;
+  map->root = avl_build_sorted(map, snap, 0, snap->count, NULL, &ok);
+  avl_snapshot_close(snap);
+  if (!ok) {
+    // the nodes built so far are linked, the map drops them as usual
+    avl_map_drop(map);
+    gbc_free(map->alloc, map, sizeof(avl_map_t));
+    return NULL;
+  }
+  return map;
+}
+
+#endif
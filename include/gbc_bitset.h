@@ -0,0 +1,620 @@
+#ifndef _GBC_BITSET_H
+#define _GBC_BITSET_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gbc_alloc.h"
+#include "gbc_cpu.h"
+#include "gbc_iterator.h"
+#include "gbc_stats.h"
+
+#define BITSET_WORD_BITS 64
+#define DEFAULT_BITSET_BITS 64
+
+/// @brief a set of small unsigned integers, one bit each. It holds the bits
+/// 0 to nbits - 1 and grows when a bit past them is set. The set algebra
+/// works a whole word, or with AVX2 four words, at a time
+/// @param words: nbits bits, the ones of the last word past nbits are 0
+/// @param size_t nbits: the number of bits
+/// @param size_t cap: the number of words allocated
+/// @param alloc: the allocator of the words and of the bitset itself
+typedef struct _bitset {
+  uint64_t *words;
+  size_t nbits;
+  size_t cap;
+  const gbc_allocator_t *alloc;
+  GBC_STATS_FIELD
+} bitset_t;
+
+/// @brief The bitset iterator, it yields the size_t index of each set bit in
+/// ascending order. next_batch decodes up to ITER_BATCH_MAX indices into buf
+typedef struct _bitset_iter {
+  iter_t base;
+  const bitset_t *b;
+  size_t next;
+  size_t value;
+  size_t buf[ITER_BATCH_MAX];
+  const gbc_allocator_t *alloc;
+} bitset_iter_t;
+
+/// @brief loop over the set bits of b, binding var, a size_t, to each index
+/// in ascending order. No iterator is involved and break/continue work as in
+/// a plain for loop. Bits set in the body past var are visited, e.g.
+///
+///   GBC_BITSET_FOREACH(i, b) { sum += i; }
+#define GBC_BITSET_FOREACH(var, b)                          \
+  for (size_t var = bitset_next((b), 0); var < (b)->nbits;  \
+       var = bitset_next((b), var + 1))
+
+/// @brief create a new bitset of nbits clear bits
+/// @param nbits
+/// @return
+bitset_t *bitset_new(size_t nbits);
+
+/// @brief create a new bitset whose memory, including the bitset itself and
+/// its iterators, comes from alloc
+/// @param nbits
+/// @param alloc: NULL for malloc/free
+/// @return
+bitset_t *bitset_new_ex(size_t nbits, const gbc_allocator_t *alloc);
+
+/// @brief drop the bitset out of memory
+/// @param b
+/// @return
+bool bitset_drop(bitset_t *b);
+
+/// @brief deep copy a bitset
+/// @param b
+/// @return
+bitset_t *bitset_clone(const bitset_t *b);
+
+/// @brief change the number of bits, the new ones are clear
+/// @param b
+/// @param nbits
+/// @return return false if the memory ran out
+bool bitset_resize(bitset_t *b, size_t nbits);
+
+/// @brief set the bit i, growing the bitset to i + 1 bits if it is shorter
+/// @param b
+/// @param i
+/// @return return false if the bit was already set or the memory ran out
+bool bitset_set(bitset_t *b, size_t i);
+
+/// @brief clear the bit i
+/// @param b
+/// @param i
+/// @return return false if the bit was not set
+bool bitset_clear(bitset_t *b, size_t i);
+
+/// @brief check if the bit i is set, the bits past nbits are clear
+/// @param b
+/// @param i
+/// @return
+bool bitset_test(const bitset_t *b, size_t i);
+
+/// @brief set the bits in [from, to), growing the bitset to to bits if it is
+/// shorter
+/// @param b
+/// @param from
+/// @param to
+/// @return return false if the memory ran out
+bool bitset_set_range(bitset_t *b, size_t from, size_t to);
+
+/// @brief clear every bit, the size stays
+/// @param b
+void bitset_clear_all(bitset_t *b);
+
+/// @brief the number of set bits
+/// @param b
+/// @return
+size_t bitset_count(const bitset_t *b);
+
+/// @brief the number of set bits below i, a popcount of the i / 64 words
+/// below it
+/// @param b
+/// @param i
+/// @return
+size_t bitset_rank(const bitset_t *b, size_t i);
+
+/// @brief find the set bit of rank k, so the k + 1 th one. The words are
+/// counted up to the one holding it
+/// @param b
+/// @param k
+/// @param out: its index when found
+/// @return return false if fewer than k + 1 bits are set
+bool bitset_select(const bitset_t *b, size_t k, size_t *out);
+
+/// @brief the first set bit from i on
+/// @param b
+/// @param i
+/// @return return nbits if there is none
+size_t bitset_next(const bitset_t *b, size_t i);
+
+/// @brief dst &= src, the bits of dst past src are cleared
+/// @param dst
+/// @param src
+void bitset_and(bitset_t *dst, const bitset_t *src);
+
+/// @brief dst |= src, dst grows to the size of src if it is shorter
+/// @param dst
+/// @param src
+/// @return return false if the memory ran out
+bool bitset_or(bitset_t *dst, const bitset_t *src);
+
+/// @brief dst ^= src, dst grows to the size of src if it is shorter
+/// @param dst
+/// @param src
+/// @return return false if the memory ran out
+bool bitset_xor(bitset_t *dst, const bitset_t *src);
+
+/// @brief dst &= ~src, clear the bits of dst set in src
+/// @param dst
+/// @param src
+void bitset_andnot(bitset_t *dst, const bitset_t *src);
+
+/// @brief the number of bits set in both, nothing is built
+/// @param a
+/// @param b
+/// @return
+size_t bitset_and_count(const bitset_t *a, const bitset_t *b);
+
+/// @brief check if both hold the same set bits, whatever their sizes
+/// @param a
+/// @param b
+/// @return
+bool bitset_equal(const bitset_t *a, const bitset_t *b);
+
+/// @brief check if every bit set in a is set in b
+/// @param a
+/// @param b
+/// @return
+bool bitset_is_subset(const bitset_t *a, const bitset_t *b);
+
+/// @brief read the operation counters of the bitset
+/// @param b
+/// @param out
+/// @return return false, with out zeroed, unless built with GBC_STATS
+bool bitset_stats(const bitset_t *b, gbc_stats_t *out);
+
+/// @brief create a bitset_iter_t
+/// @param b
+/// @return
+bitset_iter_t *bitset_iter_new(const bitset_t *b);
+
+/// @brief set up an iterator provided by the caller, e.g. on the stack, so
+/// iterating allocates nothing. Finish it with bitset_iter_fini, not
+/// bitset_iter_drop
+/// @param iter
+/// @param b
+void bitset_iter_init(bitset_iter_t *iter, const bitset_t *b);
+
+/// @brief finish an iterator set up by bitset_iter_init
+/// @param iter
+void bitset_iter_fini(bitset_iter_t *iter);
+
+/// @brief drop a bitset_iter_t
+/// @param iter
+/// @return
+bool bitset_iter_drop(bitset_iter_t *iter);
+
+/// @brief check if the bitset_iter_t has next set bit
+/// @param iter
+/// @return
+bool bitset_iter_has_next(const bitset_iter_t *iter);
+
+/// @brief get the index of the next set bit, a size_t
+/// @param iter
+/// @return
+void *bitset_iter_next(bitset_iter_t *iter);
+
+static inline size_t bitset_words(size_t nbits) {
+  return (nbits + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+}
+
+/// @brief the bits of the last word below nbits
+static inline uint64_t bitset_tail_mask(size_t nbits) {
+  return (nbits % BITSET_WORD_BITS) ? ~0ull >> (64 - nbits % BITSET_WORD_BITS)
+                                    : ~0ull;
+}
+
+/// Word kernels, the scalar loops and the AVX2 ones dispatched at run time.
+/// Every CPU with AVX2 has POPCNT, so the AVX2 kernels count with it
+
+#define _BITSET_NOTARGET
+
+/// @brief generate the in place kernels of one instruction set
+#define _BITSET_WORD_KERNELS(isa, TARGET, STEP, OPS)                           \
+  TARGET static void bitset_words_and_##isa(uint64_t *d, const uint64_t *s,    \
+                                            size_t n) {                        \
+    size_t i = 0;                                                              \
+    for (; i + STEP <= n; i += STEP) OPS##_AND(d + i, s + i);                  \
+    for (; i < n; ++i) d[i] &= s[i];                                           \
+  }                                                                            \
+                                                                               \
+  TARGET static void bitset_words_or_##isa(uint64_t *d, const uint64_t *s,     \
+                                           size_t n) {                         \
+    size_t i = 0;                                                              \
+    for (; i + STEP <= n; i += STEP) OPS##_OR(d + i, s + i);                   \
+    for (; i < n; ++i) d[i] |= s[i];                                           \
+  }                                                                            \
+                                                                               \
+  TARGET static void bitset_words_xor_##isa(uint64_t *d, const uint64_t *s,    \
+                                            size_t n) {                        \
+    size_t i = 0;                                                              \
+    for (; i + STEP <= n; i += STEP) OPS##_XOR(d + i, s + i);                  \
+    for (; i < n; ++i) d[i] ^= s[i];                                           \
+  }                                                                            \
+                                                                               \
+  TARGET static void bitset_words_andnot_##isa(uint64_t *d,                    \
+                                               const uint64_t *s, size_t n) {  \
+    size_t i = 0;                                                              \
+    for (; i + STEP <= n; i += STEP) OPS##_ANDNOT(d + i, s + i);               \
+    for (; i < n; ++i) d[i] &= ~s[i];                                          \
+  }                                                                            \
+                                                                               \
+  TARGET static size_t bitset_words_count_##isa(const uint64_t *w,             \
+                                                size_t n) {                    \
+    size_t c = 0;                                                              \
+    for (size_t i = 0; i < n; ++i) c += (size_t)__builtin_popcountll(w[i]);    \
+    return c;                                                                  \
+  }                                                                            \
+                                                                               \
+  TARGET static size_t bitset_words_and_count_##isa(                           \
+      const uint64_t *a, const uint64_t *b, size_t n) {                        \
+    size_t c = 0;                                                              \
+    for (size_t i = 0; i < n; ++i) {                                           \
+      c += (size_t)__builtin_popcountll(a[i] & b[i]);                          \
+    }                                                                          \
+    return c;                                                                  \
+  }
+
+#define _BITSET_SCALAR_AND(d, s) (*(d) &= *(s))
+#define _BITSET_SCALAR_OR(d, s) (*(d) |= *(s))
+#define _BITSET_SCALAR_XOR(d, s) (*(d) ^= *(s))
+#define _BITSET_SCALAR_ANDNOT(d, s) (*(d) &= ~*(s))
+
+_BITSET_WORD_KERNELS(scalar, _BITSET_NOTARGET, 1, _BITSET_SCALAR)
+
+#ifdef GBC_CPU_X86
+
+#define _BITSET_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+
+#define _BITSET_AVX2_OP(d, s, op)                                   \
+  _mm256_storeu_si256(                                              \
+      (__m256i *)(d), op(_mm256_loadu_si256((const __m256i *)(d)),  \
+                         _mm256_loadu_si256((const __m256i *)(s))))
+#define _BITSET_AVX2_AND(d, s) _BITSET_AVX2_OP(d, s, _mm256_and_si256)
+#define _BITSET_AVX2_OR(d, s) _BITSET_AVX2_OP(d, s, _mm256_or_si256)
+#define _BITSET_AVX2_XOR(d, s) _BITSET_AVX2_OP(d, s, _mm256_xor_si256)
+// _mm256_andnot_si256(a, b) is ~a & b
+#define _BITSET_AVX2_ANDNOT(d, s)                                    \
+  _mm256_storeu_si256(                                               \
+      (__m256i *)(d),                                                \
+      _mm256_andnot_si256(_mm256_loadu_si256((const __m256i *)(s)),  \
+                          _mm256_loadu_si256((const __m256i *)(d))))
+
+_BITSET_WORD_KERNELS(avx2, _BITSET_TARGET_AVX2, 4, _BITSET_AVX2)
+
+/// @brief call the kernel of the best instruction set the CPU has
+#define _BITSET_CALL(fn, ...)                                \
+  (gbc_cpu_level() >= GBC_CPU_AVX2 ? fn##_avx2(__VA_ARGS__)  \
+                                   : fn##_scalar(__VA_ARGS__))
+
+#else
+
+#define _BITSET_CALL(fn, ...) fn##_scalar(__VA_ARGS__)
+
+#endif
+
+/// @brief give b room for nwords words, the new ones are zero
+static bool bitset_reserve(bitset_t *b, size_t nwords) {
+  if (nwords <= b->cap) return true;
+  size_t cap = b->cap ? b->cap : 1;
+  while (cap < nwords) cap *= 2;
+  uint64_t *words = (uint64_t *)gbc_realloc(b->alloc, b->words,
+                                            b->cap * sizeof(uint64_t),
+                                            cap * sizeof(uint64_t));
+  if (!words) return false;
+  GBC_STATS_REALLOC(b, b->cap * sizeof(uint64_t), cap * sizeof(uint64_t));
+  GBC_STATS_INC(b, grows);
+  memset(words + b->cap, 0, (cap - b->cap) * sizeof(uint64_t));
+  b->words = words;
+  b->cap = cap;
+  return true;
+}
+
+bitset_t *bitset_new(size_t nbits) { return bitset_new_ex(nbits, NULL); }
+
+bitset_t *bitset_new_ex(size_t nbits, const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  bitset_t *b = (bitset_t *)gbc_alloc(alloc, sizeof(bitset_t));
+  if (!b) return NULL;
+  size_t cap = bitset_words(nbits ? nbits : DEFAULT_BITSET_BITS);
+  b->words = (uint64_t *)gbc_alloc(alloc, cap * sizeof(uint64_t));
+  if (!b->words) {
+    gbc_free(alloc, b, sizeof(bitset_t));
+    return NULL;
+  }
+  memset(b->words, 0, cap * sizeof(uint64_t));
+  b->nbits = nbits;
+  b->cap = cap;
+  b->alloc = alloc;
+  GBC_STATS_INIT(b);
+  GBC_STATS_ALLOC(b, sizeof(bitset_t));
+  GBC_STATS_ALLOC(b, cap * sizeof(uint64_t));
+  return b;
+}
+
+bool bitset_drop(bitset_t *b) {
+  if (!b) return false;
+  gbc_free(b->alloc, b->words, b->cap * sizeof(uint64_t));
+  gbc_free(b->alloc, b, sizeof(bitset_t));
+  return true;
+}
+
+bitset_t *bitset_clone(const bitset_t *b) {
+  assert(b);
+  bitset_t *c = bitset_new_ex(b->nbits, b->alloc);
+  if (!c) return NULL;
+  memcpy(c->words, b->words, bitset_words(b->nbits) * sizeof(uint64_t));
+  return c;
+}
+
+bool bitset_resize(bitset_t *b, size_t nbits) {
+  assert(b);
+  if (!bitset_reserve(b, bitset_words(nbits))) return false;
+  if (nbits < b->nbits) {
+    // the dropped bits are cleared, so growing again finds them clear
+    size_t nw = bitset_words(nbits), old_nw = bitset_words(b->nbits);
+    if (nw > 0) b->words[nw - 1] &= bitset_tail_mask(nbits);
+    memset(b->words + nw, 0, (old_nw - nw) * sizeof(uint64_t));
+  }
+  b->nbits = nbits;
+  return true;
+}
+
+bool bitset_set(bitset_t *b, size_t i) {
+  assert(b);
+  if (i >= b->nbits && !bitset_resize(b, i + 1)) return false;
+  uint64_t bit = 1ull << (i % BITSET_WORD_BITS);
+  uint64_t *w = &b->words[i / BITSET_WORD_BITS];
+  if (*w & bit) return false;
+  *w |= bit;
+  return true;
+}
+
+bool bitset_clear(bitset_t *b, size_t i) {
+  assert(b);
+  if (i >= b->nbits) return false;
+  uint64_t bit = 1ull << (i % BITSET_WORD_BITS);
+  uint64_t *w = &b->words[i / BITSET_WORD_BITS];
+  if (!(*w & bit)) return false;
+  *w &= ~bit;
+  return true;
+}
+
+bool bitset_test(const bitset_t *b, size_t i) {
+  assert(b);
+  return i < b->nbits &&
+         ((b->words[i / BITSET_WORD_BITS] >> (i % BITSET_WORD_BITS)) & 1);
+}
+
+bool bitset_set_range(bitset_t *b, size_t from, size_t to) {
+  assert(b && from <= to);
+  if (from == to) return true;
+  if (to > b->nbits && !bitset_resize(b, to)) return false;
+  size_t first = from / BITSET_WORD_BITS, last = (to - 1) / BITSET_WORD_BITS;
+  uint64_t head = ~0ull << (from % BITSET_WORD_BITS);
+  uint64_t tail = bitset_tail_mask(to);
+  if (first == last) {
+    b->words[first] |= head & tail;
+    return true;
+  }
+  b->words[first] |= head;
+  memset(b->words + first + 1, 0xff, (last - first - 1) * sizeof(uint64_t));
+  b->words[last] |= tail;
+  return true;
+}
+
+void bitset_clear_all(bitset_t *b) {
+  assert(b);
+  memset(b->words, 0, bitset_words(b->nbits) * sizeof(uint64_t));
+}
+
+size_t bitset_count(const bitset_t *b) {
+  assert(b);
+  return _BITSET_CALL(bitset_words_count, b->words, bitset_words(b->nbits));
+}
+
+size_t bitset_rank(const bitset_t *b, size_t i) {
+  assert(b);
+  if (i >= b->nbits) return bitset_count(b);
+  size_t w = i / BITSET_WORD_BITS;
+  size_t c = _BITSET_CALL(bitset_words_count, b->words, w);
+  uint64_t below = (1ull << (i % BITSET_WORD_BITS)) - 1;
+  return c + (size_t)__builtin_popcountll(b->words[w] & below);
+}
+
+bool bitset_select(const bitset_t *b, size_t k, size_t *out) {
+  assert(b && out);
+  size_t nw = bitset_words(b->nbits);
+  for (size_t w = 0; w < nw; ++w) {
+    size_t c = (size_t)__builtin_popcountll(b->words[w]);
+    if (k >= c) {
+      k -= c;
+      continue;
+    }
+    // drop the k lowest set bits of the word, the next one is the answer
+    uint64_t word = b->words[w];
+    while (k--) word &= word - 1;
+    *out = w * BITSET_WORD_BITS + (size_t)__builtin_ctzll(word);
+    return true;
+  }
+  return false;
+}
+
+size_t bitset_next(const bitset_t *b, size_t i) {
+  if (i >= b->nbits) return b->nbits;
+  size_t w = i / BITSET_WORD_BITS, nw = bitset_words(b->nbits);
+  uint64_t word = b->words[w] & (~0ull << (i % BITSET_WORD_BITS));
+  while (!word) {
+    if (++w == nw) return b->nbits;
+    word = b->words[w];
+  }
+  return w * BITSET_WORD_BITS + (size_t)__builtin_ctzll(word);
+}
+
+void bitset_and(bitset_t *dst, const bitset_t *src) {
+  assert(dst && src);
+  size_t nw = bitset_words(dst->nbits), sw = bitset_words(src->nbits);
+  size_t n = nw < sw ? nw : sw;
+  _BITSET_CALL(bitset_words_and, dst->words, src->words, n);
+  memset(dst->words + n, 0, (nw - n) * sizeof(uint64_t));
+}
+
+bool bitset_or(bitset_t *dst, const bitset_t *src) {
+  assert(dst && src);
+  if (src->nbits > dst->nbits && !bitset_resize(dst, src->nbits)) {
+    return false;
+  }
+  _BITSET_CALL(bitset_words_or, dst->words, src->words,
+               bitset_words(src->nbits));
+  return true;
+}
+
+bool bitset_xor(bitset_t *dst, const bitset_t *src) {
+  assert(dst && src);
+  if (src->nbits > dst->nbits && !bitset_resize(dst, src->nbits)) {
+    return false;
+  }
+  _BITSET_CALL(bitset_words_xor, dst->words, src->words,
+               bitset_words(src->nbits));
+  return true;
+}
+
+void bitset_andnot(bitset_t *dst, const bitset_t *src) {
+  assert(dst && src);
+  size_t nw = bitset_words(dst->nbits), sw = bitset_words(src->nbits);
+  _BITSET_CALL(bitset_words_andnot, dst->words, src->words, nw < sw ? nw : sw);
+}
+
+size_t bitset_and_count(const bitset_t *a, const bitset_t *b) {
+  assert(a && b);
+  size_t aw = bitset_words(a->nbits), bw = bitset_words(b->nbits);
+  return _BITSET_CALL(bitset_words_and_count, a->words, b->words,
+                      aw < bw ? aw : bw);
+}
+
+/// @brief check if the words past n of the longer bitset are all zero
+static bool bitset_rest_zero(const bitset_t *a, const bitset_t *b, size_t n) {
+  const bitset_t *longer = a->nbits > b->nbits ? a : b;
+  size_t lw = bitset_words(longer->nbits);
+  for (size_t i = n; i < lw; ++i) {
+    if (longer->words[i]) return false;
+  }
+  return true;
+}
+
+bool bitset_equal(const bitset_t *a, const bitset_t *b) {
+  assert(a && b);
+  size_t aw = bitset_words(a->nbits), bw = bitset_words(b->nbits);
+  size_t n = aw < bw ? aw : bw;
+  return memcmp(a->words, b->words, n * sizeof(uint64_t)) == 0 &&
+         bitset_rest_zero(a, b, n);
+}
+
+bool bitset_is_subset(const bitset_t *a, const bitset_t *b) {
+  assert(a && b);
+  size_t aw = bitset_words(a->nbits), bw = bitset_words(b->nbits);
+  size_t n = aw < bw ? aw : bw;
+  for (size_t i = 0; i < n; ++i) {
+    if (a->words[i] & ~b->words[i]) return false;
+  }
+  return aw <= bw || bitset_rest_zero(a, b, n);
+}
+
+bool bitset_stats(const bitset_t *b, gbc_stats_t *out) {
+  assert(b && out);
+  return GBC_STATS_READ(b, out);
+}
+
+bool _bitset_iter_has_next(const iter_t *_iter) {
+  const bitset_iter_t *iter = (bitset_iter_t *)_iter;
+  return iter->next < iter->b->nbits;
+}
+
+void *_bitset_iter_next(iter_t *_iter) {
+  bitset_iter_t *iter = (bitset_iter_t *)_iter;
+  if (iter->next >= iter->b->nbits) return NULL;
+  iter->value = iter->next;
+  iter->next = bitset_next(iter->b, iter->next + 1);
+  return &iter->value;
+}
+
+/// a span of indices decoded into the iterator's buffer, a word at a time
+size_t _bitset_iter_next_batch(iter_t *_iter, iter_batch_t *batch,
+                               size_t max) {
+  bitset_iter_t *iter = (bitset_iter_t *)_iter;
+  const bitset_t *b = iter->b;
+  if (max > ITER_BATCH_MAX) max = ITER_BATCH_MAX;
+  size_t k = 0, nw = bitset_words(b->nbits);
+  size_t i = iter->next;
+  while (k < max && i < b->nbits) {
+    size_t w = i / BITSET_WORD_BITS;
+    uint64_t word = b->words[w] & (~0ull << (i % BITSET_WORD_BITS));
+    for (; word && k < max; word &= word - 1) {
+      iter->buf[k++] = w * BITSET_WORD_BITS + (size_t)__builtin_ctzll(word);
+    }
+    i = word ? w * BITSET_WORD_BITS + (size_t)__builtin_ctzll(word)
+             : (w + 1 < nw ? (w + 1) * BITSET_WORD_BITS : b->nbits);
+  }
+  iter->next = bitset_next(b, i);
+  batch->len = k;
+  batch->span = k ? (char *)iter->buf : NULL;
+  return k;
+}
+
+void bitset_iter_init(bitset_iter_t *iter, const bitset_t *b) {
+  assert(iter && b);
+  iter_t base = {.obj_size = sizeof(size_t),
+                 .has_next = _bitset_iter_has_next,
+                 .next = _bitset_iter_next,
+                 .next_batch = _bitset_iter_next_batch};
+  iter->base = base;
+  iter->b = b;
+  iter->next = bitset_next(b, 0);
+  iter->alloc = NULL;
+}
+
+void bitset_iter_fini(bitset_iter_t *iter) {
+  assert(iter && !iter->alloc);
+  iter->b = NULL;
+}
+
+bitset_iter_t *bitset_iter_new(const bitset_t *b) {
+  assert(b);
+  bitset_iter_t *iter =
+      (bitset_iter_t *)gbc_alloc(b->alloc, sizeof(bitset_iter_t));
+  if (!iter) return NULL;
+  bitset_iter_init(iter, b);
+  iter->alloc = b->alloc;
+  return iter;
+}
+
+bool bitset_iter_drop(bitset_iter_t *iter) {
+  if (!iter) return false;
+  gbc_free(iter->alloc, iter, sizeof(bitset_iter_t));
+  return true;
+}
+
+bool bitset_iter_has_next(const bitset_iter_t *iter) {
+  return iter->base.has_next((iter_t *)iter);
+}
+
+void *bitset_iter_next(bitset_iter_t *iter) {
+  return iter->base.next((iter_t *)iter);
+}
+
+#endif
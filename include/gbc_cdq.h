@@ -0,0 +1,617 @@
+#ifndef _GBC_CDQ_H
+#define _GBC_CDQ_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gbc_alloc.h"
+#include "gbc_iterator.h"
+#include "gbc_probes.h"
+#include "gbc_stats.h"
+
+#define CDQ_BLOCK_BYTES 4096
+#define CDQ_MIN_BLOCK_CAP 16
+#define CDQ_BLOCK_CACHE 4
+#define DEFAULT_CDQ_MAP_CAP 8
+
+/// @brief chunked double-ended queue. The elements live in fixed-size blocks
+/// of block_cap elements and a ring of block pointers (the map) keeps them
+/// in order, as in std::deque. Pushing and popping at either end never moves
+/// an element: a full end only gets one more block, and an emptied block
+/// goes to a small cache for the next one. Growing the map copies block
+/// pointers, never elements
+/// @param size_t block_cap: elements per block, a power of two
+/// @param size_t block_shift: log2 of block_cap
+/// @param char** map: the ring of block pointers, map_cap is a power of two
+/// @param size_t map_front: the ring position of the first block
+/// @param size_t n_blocks: the number of blocks in use
+/// @param size_t head: the position of the first element in the first block
+/// @param char* cache[]: emptied blocks kept for reuse
+/// @param alloc: the allocator of the blocks, the map and the deque itself
+typedef struct _cdq {
+  size_t obj_size;
+  size_t size;
+  size_t block_cap;
+  size_t block_shift;
+  char **map;
+  size_t map_cap;
+  size_t map_front;
+  size_t n_blocks;
+  size_t head;
+  char *cache[CDQ_BLOCK_CACHE];
+  size_t n_cached;
+  const gbc_allocator_t *alloc;
+  GBC_STATS_FIELD
+} cdq_t;
+
+/// @brief The chunked deque iterator
+typedef struct _cdq_iter {
+  iter_t base;
+  size_t cur_idx;
+  cdq_t *dq;
+  const gbc_allocator_t *alloc;
+} cdq_iter_t;
+
+/// @brief create a new cdq_t
+/// @param element_size: the size of each element
+/// @return
+cdq_t *cdq_new(size_t element_size);
+
+/// @brief create a new cdq_t whose memory, including the deque itself and
+/// its iterators, comes from alloc
+/// @param element_size
+/// @param alloc: NULL for malloc/free
+/// @return
+cdq_t *cdq_new_ex(size_t element_size, const gbc_allocator_t *alloc);
+
+/// @brief drop the cdq_t out of memory
+/// @param q
+/// @return
+bool cdq_drop(cdq_t *q);
+
+/// @brief check if cdq_t is empty
+/// @param q
+/// @return
+bool cdq_is_empty(const cdq_t *q);
+
+/// @brief get the length of cdq_t
+/// @param q
+/// @return
+size_t cdq_length(const cdq_t *q);
+
+/// @brief push an element at the back of cdq_t
+/// @param q
+/// @param value
+/// @return
+bool cdq_push_back(cdq_t *q, const void *value);
+
+/// @brief push an element at the front of cdq_t
+/// @param q
+/// @param value
+/// @return
+bool cdq_push_front(cdq_t *q, const void *value);
+
+/// @brief insert an element before index idx, idx can be the length. The
+/// shorter side of the deque is shifted by one
+/// @param q
+/// @param idx
+/// @param value
+/// @return
+bool cdq_insert(cdq_t *q, size_t idx, const void *value);
+
+/// @brief check the front/first element, NULL if empty
+/// @param q
+/// @return
+const void *cdq_front(const cdq_t *q);
+
+/// @brief check the back/last element, NULL if empty
+/// @param q
+/// @return
+const void *cdq_back(const cdq_t *q);
+
+/// @brief check the element with a certain index
+/// @param q
+/// @param idx
+/// @return
+const void *cdq_at(const cdq_t *q, size_t idx);
+
+/// @brief Get the mutable pointer with an index
+/// @param q
+/// @param idx
+/// @return
+void *cdq_at_mut(cdq_t *q, size_t idx);
+
+/// @brief update the value in the cdq_t with an index
+/// @param q
+/// @param idx
+/// @param value
+/// @return
+bool cdq_update(cdq_t *q, size_t idx, const void *value);
+
+/// @brief for each element in the cdq_t and process it, a block at a time
+/// @param q
+/// @param foreach_fn
+void cdq_foreach(const cdq_t *q, void (*foreach_fn)(const void *));
+
+/// @brief delete the first element
+/// @param q
+/// @return return false if the deletion failed
+bool cdq_del_front(cdq_t *q);
+
+/// @brief delete the last element
+/// @param q
+/// @return return false if the deletion failed
+bool cdq_del_back(cdq_t *q);
+
+/// @brief delete an element with an index, the shorter side of the deque is
+/// shifted by one
+/// @param q
+/// @param idx
+/// @return
+bool cdq_del_at(cdq_t *q, size_t idx);
+
+/// @brief delete the first element equal to target_value
+/// @param q
+/// @param target_value
+/// @param cmp_fn
+/// @return
+bool cdq_del(cdq_t *q, const void *target_value,
+             int (*cmp_fn)(const void *, const void *));
+
+/// @brief deep clone a cdq_t
+/// @param q
+/// @return
+cdq_t *cdq_clone(const cdq_t *q);
+
+/// @brief reverse the cdq_t in place
+/// @param q
+/// @return
+bool cdq_reverse(cdq_t *q);
+
+/// @brief sort the cdq_t. The elements are sorted in a temporary buffer and
+/// copied back, the blocks stay where they are
+/// @param q
+/// @param cmp_fn
+/// @return
+bool cdq_sort(cdq_t *q, int (*cmp_fn)(const void *, const void *));
+
+/// @brief create a cdq_t from an array
+/// @param _arr
+/// @param array_size
+/// @param obj_size
+/// @return
+cdq_t *cdq_from_array(const void *_arr, size_t array_size, size_t obj_size);
+
+/// @brief create a cdq_t from an iterator
+/// @param iter
+/// @return
+cdq_t *cdq_from_iter(iter_t *iter);
+
+/// @brief read the operation counters of the deque
+/// @param q
+/// @param out
+/// @return return false, with out zeroed, unless built with GBC_STATS
+bool cdq_stats(const cdq_t *q, gbc_stats_t *out);
+
+/// @brief create a new cdq_iter_t
+/// @param dq
+/// @return
+cdq_iter_t *cdq_iter_new(cdq_t *dq);
+
+/// @brief set up an iterator provided by the caller, e.g. on the stack, so
+/// iterating allocates nothing. Finish it with cdq_iter_fini, not
+/// cdq_iter_drop
+/// @param iter
+/// @param dq
+void cdq_iter_init(cdq_iter_t *iter, cdq_t *dq);
+
+/// @brief finish an iterator set up by cdq_iter_init
+/// @param iter
+void cdq_iter_fini(cdq_iter_t *iter);
+
+/// @brief drop a cdq_iter_t
+/// @param iter
+/// @return
+bool cdq_iter_drop(cdq_iter_t *iter);
+
+/// @brief check if the cdq_iter_t has next element
+/// @param iter
+/// @return
+bool cdq_iter_has_next(const cdq_iter_t *iter);
+
+/// @brief get the next element
+/// @param iter
+/// @return
+void *cdq_iter_next(cdq_iter_t *iter);
+
+static inline size_t cdq_block_bytes(const cdq_t *q) {
+  return q->block_cap * q->obj_size;
+}
+
+static inline char *cdq_block(const cdq_t *q, size_t block_idx) {
+  return q->map[(q->map_front + block_idx) & (q->map_cap - 1)];
+}
+
+static inline char *cdq_slot(const cdq_t *q, size_t idx) {
+  size_t pos = q->head + idx;
+  return cdq_block(q, pos >> q->block_shift) +
+         (pos & (q->block_cap - 1)) * q->obj_size;
+}
+
+static char *cdq_take_block(cdq_t *q) {
+  if (q->n_cached > 0) return q->cache[--q->n_cached];
+  char *block = (char *)gbc_alloc(q->alloc, cdq_block_bytes(q));
+  if (block) GBC_STATS_ALLOC(q, cdq_block_bytes(q));
+  return block;
+}
+
+static void cdq_give_block(cdq_t *q, char *block) {
+  if (q->n_cached < CDQ_BLOCK_CACHE) {
+    q->cache[q->n_cached++] = block;
+    return;
+  }
+  gbc_free(q->alloc, block, cdq_block_bytes(q));
+  GBC_STATS_FREE(q, cdq_block_bytes(q));
+}
+
+/// @brief make room in the map for one more block, copying block pointers
+/// into a ring twice as big with the first block at position 0
+static bool cdq_reserve_map(cdq_t *q) {
+  if (q->n_blocks < q->map_cap) return true;
+  size_t new_cap = q->map_cap * 2;
+  char **map = (char **)gbc_alloc(q->alloc, new_cap * sizeof(char *));
+  if (!map) return false;
+  for (size_t i = 0; i < q->n_blocks; ++i) map[i] = cdq_block(q, i);
+  gbc_free(q->alloc, q->map, q->map_cap * sizeof(char *));
+  GBC_STATS_REALLOC(q, q->map_cap * sizeof(char *), new_cap * sizeof(char *));
+  GBC_STATS_INC(q, grows);
+  GBC_PROBE4(cdq_grow, q, q->map_cap, new_cap, q->n_blocks * sizeof(char *));
+  q->map = map;
+  q->map_cap = new_cap;
+  q->map_front = 0;
+  return true;
+}
+
+cdq_t *cdq_new(size_t element_size) { return cdq_new_ex(element_size, NULL); }
+
+cdq_t *cdq_new_ex(size_t element_size, const gbc_allocator_t *alloc) {
+  assert(element_size > 0);
+  alloc = gbc_allocator_or_std(alloc);
+  cdq_t *q = (cdq_t *)gbc_alloc(alloc, sizeof(cdq_t));
+  if (!q) return NULL;
+  q->map = (char **)gbc_alloc(alloc, DEFAULT_CDQ_MAP_CAP * sizeof(char *));
+  if (!q->map) {
+    gbc_free(alloc, q, sizeof(cdq_t));
+    return NULL;
+  }
+  q->obj_size = element_size;
+  q->size = 0;
+  // the biggest power of two that fits CDQ_BLOCK_BYTES, at least the minimum
+  q->block_shift = 0;
+  while ((((size_t)2 << q->block_shift) * element_size) <= CDQ_BLOCK_BYTES) {
+    q->block_shift++;
+  }
+  while (((size_t)1 << q->block_shift) < CDQ_MIN_BLOCK_CAP) q->block_shift++;
+  q->block_cap = (size_t)1 << q->block_shift;
+  q->map_cap = DEFAULT_CDQ_MAP_CAP;
+  q->map_front = 0;
+  q->n_blocks = 0;
+  q->head = 0;
+  q->n_cached = 0;
+  q->alloc = alloc;
+  GBC_STATS_INIT(q);
+  GBC_STATS_ALLOC(q, sizeof(cdq_t));
+  GBC_STATS_ALLOC(q, DEFAULT_CDQ_MAP_CAP * sizeof(char *));
+  return q;
+}
+
+bool cdq_drop(cdq_t *q) {
+  if (!q) return false;
+  for (size_t i = 0; i < q->n_blocks; ++i) {
+    gbc_free(q->alloc, cdq_block(q, i), cdq_block_bytes(q));
+  }
+  for (size_t i = 0; i < q->n_cached; ++i) {
+    gbc_free(q->alloc, q->cache[i], cdq_block_bytes(q));
+  }
+  gbc_free(q->alloc, q->map, q->map_cap * sizeof(char *));
+  gbc_free(q->alloc, q, sizeof(cdq_t));
+  return true;
+}
+
+bool cdq_is_empty(const cdq_t *q) {
+  assert(q);
+  return q->size == 0;
+}
+
+size_t cdq_length(const cdq_t *q) {
+  assert(q);
+  return q->size;
+}
+
+bool cdq_push_back(cdq_t *q, const void *value) {
+  assert(q && value);
+  if (q->head + q->size == q->n_blocks * q->block_cap) {
+    if (!cdq_reserve_map(q)) return false;
+    char *block = cdq_take_block(q);
+    if (!block) return false;
+    q->map[(q->map_front + q->n_blocks) & (q->map_cap - 1)] = block;
+    q->n_blocks++;
+  }
+  memcpy(cdq_slot(q, q->size), value, q->obj_size);
+  q->size++;
+  return true;
+}
+
+bool cdq_push_front(cdq_t *q, const void *value) {
+  assert(q && value);
+  if (q->head == 0) {
+    if (!cdq_reserve_map(q)) return false;
+    char *block = cdq_take_block(q);
+    if (!block) return false;
+    q->map_front = (q->map_front + q->map_cap - 1) & (q->map_cap - 1);
+    q->map[q->map_front] = block;
+    q->n_blocks++;
+    q->head = q->block_cap;
+  }
+  q->head--;
+  q->size++;
+  memcpy(cdq_slot(q, 0), value, q->obj_size);
+  return true;
+}
+
+bool cdq_del_front(cdq_t *q) {
+  assert(q);
+  if (q->size == 0) return false;
+  q->head++;
+  q->size--;
+  if (q->head == q->block_cap || q->size == 0) {
+    cdq_give_block(q, q->map[q->map_front]);
+    q->map_front = (q->map_front + 1) & (q->map_cap - 1);
+    q->n_blocks--;
+    q->head = 0;
+  }
+  return true;
+}
+
+bool cdq_del_back(cdq_t *q) {
+  assert(q);
+  if (q->size == 0) return false;
+  q->size--;
+  // release the last block once no element is left in it
+  if (q->size == 0 || q->head + q->size <= (q->n_blocks - 1) * q->block_cap) {
+    cdq_give_block(q, cdq_block(q, q->n_blocks - 1));
+    q->n_blocks--;
+    if (q->n_blocks == 0) q->head = 0;
+  }
+  return true;
+}
+
+const void *cdq_front(const cdq_t *q) {
+  assert(q);
+  if (q->size == 0) return NULL;
+  return cdq_slot(q, 0);
+}
+
+const void *cdq_back(const cdq_t *q) {
+  assert(q);
+  if (q->size == 0) return NULL;
+  return cdq_slot(q, q->size - 1);
+}
+
+const void *cdq_at(const cdq_t *q, size_t idx) {
+  assert(q && idx < q->size);
+  return cdq_slot(q, idx);
+}
+
+void *cdq_at_mut(cdq_t *q, size_t idx) {
+  assert(q && idx < q->size);
+  return cdq_slot(q, idx);
+}
+
+bool cdq_update(cdq_t *q, size_t idx, const void *value) {
+  assert(q && value);
+  if (idx >= q->size) return false;
+  memcpy(cdq_slot(q, idx), value, q->obj_size);
+  return true;
+}
+
+void cdq_foreach(const cdq_t *q, void (*foreach_fn)(const void *)) {
+  assert(q && foreach_fn);
+  size_t idx = 0;
+  while (idx < q->size) {
+    // the rest of the block idx is in, in one pass
+    size_t offset = (q->head + idx) & (q->block_cap - 1);
+    size_t n = q->block_cap - offset;
+    if (n > q->size - idx) n = q->size - idx;
+    const char *p = cdq_slot(q, idx);
+    for (size_t i = 0; i < n; ++i) foreach_fn(p + i * q->obj_size);
+    idx += n;
+  }
+}
+
+bool cdq_insert(cdq_t *q, size_t idx, const void *value) {
+  assert(q && value && idx <= q->size);
+  if (idx < q->size / 2) {
+    // open a slot at the front and shift [0, idx) one step down
+    if (!cdq_push_front(q, cdq_slot(q, 0))) return false;
+    for (size_t i = 1; i < idx; ++i) {
+      memcpy(cdq_slot(q, i), cdq_slot(q, i + 1), q->obj_size);
+    }
+  } else {
+    if (idx == q->size) return cdq_push_back(q, value);
+    if (!cdq_push_back(q, cdq_slot(q, q->size - 1))) return false;
+    for (size_t i = q->size - 2; i > idx; --i) {
+      memcpy(cdq_slot(q, i), cdq_slot(q, i - 1), q->obj_size);
+    }
+  }
+  memcpy(cdq_slot(q, idx), value, q->obj_size);
+  return true;
+}
+
+bool cdq_del_at(cdq_t *q, size_t idx) {
+  assert(q);
+  if (idx >= q->size) return false;
+  if (idx < q->size / 2) {
+    for (size_t i = idx; i > 0; --i) {
+      memcpy(cdq_slot(q, i), cdq_slot(q, i - 1), q->obj_size);
+    }
+    return cdq_del_front(q);
+  }
+  for (size_t i = idx; i + 1 < q->size; ++i) {
+    memcpy(cdq_slot(q, i), cdq_slot(q, i + 1), q->obj_size);
+  }
+  return cdq_del_back(q);
+}
+
+bool cdq_del(cdq_t *q, const void *target_value,
+             int (*cmp_fn)(const void *, const void *)) {
+  assert(q && target_value && cmp_fn);
+  for (size_t i = 0; i < q->size; ++i) {
+    GBC_STATS_INC(q, cmp_calls);
+    if (cmp_fn(cdq_slot(q, i), target_value) == 0) return cdq_del_at(q, i);
+  }
+  return false;
+}
+
+cdq_t *cdq_clone(const cdq_t *q) {
+  assert(q);
+  cdq_t *out = cdq_new_ex(q->obj_size, q->alloc);
+  if (!out) return NULL;
+  for (size_t i = 0; i < q->size; ++i) {
+    if (!cdq_push_back(out, cdq_slot(q, i))) {
+      cdq_drop(out);
+      return NULL;
+    }
+  }
+  return out;
+}
+
+bool cdq_reverse(cdq_t *q) {
+  assert(q);
+  if (q->size == 0) return false;
+  char tmp[q->obj_size];
+  for (size_t start = 0, end = q->size - 1; start < end; ++start, --end) {
+    memcpy(tmp, cdq_slot(q, start), q->obj_size);
+    memcpy(cdq_slot(q, start), cdq_slot(q, end), q->obj_size);
+    memcpy(cdq_slot(q, end), tmp, q->obj_size);
+  }
+  return true;
+}
+
+bool cdq_sort(cdq_t *q, int (*cmp_fn)(const void *, const void *)) {
+  assert(q && cmp_fn);
+  if (q->size == 0) return false;
+  size_t bytes = q->size * q->obj_size;
+  char *buf = (char *)gbc_alloc(q->alloc, bytes);
+  if (!buf) return false;
+  for (size_t i = 0; i < q->size; ++i) {
+    memcpy(buf + i * q->obj_size, cdq_slot(q, i), q->obj_size);
+  }
+  GBC_STATS_QSORT(q, buf, q->size, q->obj_size, cmp_fn);
+  for (size_t i = 0; i < q->size; ++i) {
+    memcpy(cdq_slot(q, i), buf + i * q->obj_size, q->obj_size);
+  }
+  gbc_free(q->alloc, buf, bytes);
+  return true;
+}
+
+cdq_t *cdq_from_array(const void *_arr, size_t array_size, size_t obj_size) {
+  cdq_t *q = cdq_new(obj_size);
+  if (!q) return NULL;
+  const char *arr = (const char *)_arr;
+  for (size_t i = 0; i < array_size; ++i) {
+    if (!cdq_push_back(q, arr + i * obj_size)) {
+      cdq_drop(q);
+      return NULL;
+    }
+  }
+  return q;
+}
+
+cdq_t *cdq_from_iter(iter_t *iter) {
+  assert(iter);
+  cdq_t *q = cdq_new(iter->obj_size);
+  if (!q) return NULL;
+  while (iter->has_next(iter)) {
+    if (!cdq_push_back(q, iter->next(iter))) {
+      cdq_drop(q);
+      return NULL;
+    }
+  }
+  return q;
+}
+
+bool cdq_stats(const cdq_t *q, gbc_stats_t *out) {
+  assert(q && out);
+  return GBC_STATS_READ(q, out);
+}
+
+bool _cdq_iter_has_next(const iter_t *_iter) {
+  const cdq_iter_t *iter = (cdq_iter_t *)_iter;
+  return iter->cur_idx < iter->dq->size;
+}
+
+void *_cdq_iter_next(iter_t *_iter) {
+  cdq_iter_t *iter = (cdq_iter_t *)_iter;
+  if (!_cdq_iter_has_next(_iter)) return NULL;
+  return cdq_slot(iter->dq, iter->cur_idx++);
+}
+
+/// a span runs up to the end of the current block
+size_t _cdq_iter_next_batch(iter_t *_iter, iter_batch_t *batch, size_t max) {
+  cdq_iter_t *iter = (cdq_iter_t *)_iter;
+  cdq_t *q = iter->dq;
+  size_t len = q->size - iter->cur_idx;
+  size_t offset = (q->head + iter->cur_idx) & (q->block_cap - 1);
+  if (len > q->block_cap - offset) len = q->block_cap - offset;
+  if (len > max) len = max;
+  batch->span = len ? cdq_slot(q, iter->cur_idx) : NULL;
+  batch->len = len;
+  iter->cur_idx += len;
+  return len;
+}
+
+void cdq_iter_init(cdq_iter_t *iter, cdq_t *dq) {
+  assert(iter && dq);
+  iter_t base = {.obj_size = dq->obj_size,
+                 .has_next = _cdq_iter_has_next,
+                 .next = _cdq_iter_next,
+                 .next_batch = _cdq_iter_next_batch};
+  iter->base = base;
+  iter->cur_idx = 0;
+  iter->dq = dq;
+  iter->alloc = NULL;
+  GBC_PROBE3(iter_new, dq, iter, dq->size);
+}
+
+void cdq_iter_fini(cdq_iter_t *iter) {
+  assert(iter && !iter->alloc);
+  iter->dq = NULL;
+}
+
+cdq_iter_t *cdq_iter_new(cdq_t *dq) {
+  assert(dq);
+  cdq_iter_t *iter = (cdq_iter_t *)gbc_alloc(dq->alloc, sizeof(cdq_iter_t));
+  if (!iter) return NULL;
+  cdq_iter_init(iter, dq);
+  iter->alloc = dq->alloc;
+  return iter;
+}
+
+bool cdq_iter_drop(cdq_iter_t *iter) {
+  if (!iter) return false;
+  gbc_free(iter->alloc, iter, sizeof(cdq_iter_t));
+  return true;
+}
+
+bool cdq_iter_has_next(const cdq_iter_t *iter) {
+  return iter->base.has_next((iter_t *)iter);
+}
+
+void *cdq_iter_next(cdq_iter_t *iter) {
+  return iter->base.next((iter_t *)iter);
+}
+
+#endif
@@ -0,0 +1,494 @@
+#ifndef _GBC_CHASHMAP_H
+#define _GBC_CHASHMAP_H
+// pthread_rwlock_t is POSIX, see the note below
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gbc_alloc.h"
+#include "gbc_filter.h"
+#include "gbc_stats.h"
+
+/// A hash map that many threads may use at once; link with -pthread. Keys
+/// and values are copied in and out as key_obj_size and val_obj_size bytes,
+/// as in avl_map_t. The map is split into shards, a power of two of them,
+/// each an open addressing table with linear probing behind a rwlock of its
+/// own. A key's shard is picked by the high bits of its hash and its slot by
+/// the low bits, so threads working on different keys rarely meet on a lock
+/// and a shard grows by itself, stopping only the threads that use it.
+///
+/// Nothing points into the map once a call returns: lookups copy the value
+/// out and chashmap_upsert_with runs its callback under the shard's lock.
+///
+/// The shard locks are POSIX rwlocks, which a strict -std=c11 hides. The
+/// header defines _POSIX_C_SOURCE for them, which only works when it is
+/// included before any system header; otherwise define it yourself or
+/// build with -std=gnu11
+
+#define DEFAULT_CHASHMAP_SHARDS 64
+#define CHASHMAP_MAX_SHARDS (1 << 16)
+#define CHASHMAP_MIN_SHARD_CAP 8
+// a shard grows once more than 3/4 of its slots are taken
+#define CHASHMAP_LOAD_NUM 3
+#define CHASHMAP_LOAD_DEN 4
+
+/// @brief the compare function for the keys, return 0 if they are equal
+typedef int (*chashmap_cmp_fn)(const void *, const void *);
+
+/// @brief the callback of chashmap_upsert_with
+/// @param val: the value of the key, zeroed if the key was just added
+/// @param found: true if the key was there before
+/// @param ctx
+typedef void (*chashmap_upsert_fn)(void *val, bool found, void *ctx);
+
+/// @brief the callback of chashmap_foreach
+typedef void (*chashmap_foreach_fn)(const void *key, const void *val,
+                                    void *ctx);
+
+/// @brief one shard of the map
+/// @param pthread_rwlock_t lock: taken to read for lookups, to write for
+/// changes
+/// @param uint64_t* hashes: cap hashes, 0 for an empty slot
+/// @param char* entries: cap entries of the key then the value, stride bytes
+/// each
+/// @param size_t cap: 0 before the first key, then a power of two
+/// @param size_t count: the number of keys
+typedef struct _chashmap_shard {
+  pthread_rwlock_t lock;
+  uint64_t *hashes;
+  char *entries;
+  size_t cap;
+  size_t count;
+  GBC_STATS_FIELD
+  // keeps the next shard's lock off the cache lines of this one
+  char pad[64];
+} chashmap_shard_t;
+
+/// @brief the concurrent hash map
+/// @param size_t key_obj_size: the key object size
+/// @param size_t val_obj_size: the value object size
+/// @param size_t val_offset: where the value starts in an entry, aligned to
+/// 8 bytes
+/// @param size_t stride: the bytes of an entry
+/// @param gbc_hash_fn hash_fn: hashes the keys
+/// @param chashmap_cmp_fn cmp_fn: compares the keys, NULL for memcmp
+/// @param chashmap_shard_t* shards: nshards shards, a power of two
+/// @param unsigned shard_shift: 64 - log2(nshards), or 64 for one shard
+typedef struct _chashmap {
+  size_t key_obj_size;
+  size_t val_obj_size;
+  size_t val_offset;
+  size_t stride;
+  gbc_hash_fn hash_fn;
+  chashmap_cmp_fn cmp_fn;
+  chashmap_shard_t *shards;
+  size_t nshards;
+  unsigned shard_shift;
+  const gbc_allocator_t *alloc;
+  GBC_STATS_FIELD
+} chashmap_t;
+
+/// @brief create a new chashmap_t with DEFAULT_CHASHMAP_SHARDS shards
+/// @param key_obj_size
+/// @param val_obj_size
+/// @param hash_fn: NULL for gbc_hash_bytes over the key's bytes
+/// @param cmp_fn: NULL to compare the key's bytes
+/// @return
+chashmap_t *chashmap_new(size_t key_obj_size, size_t val_obj_size,
+                         gbc_hash_fn hash_fn, chashmap_cmp_fn cmp_fn);
+
+/// @brief create a new chashmap_t with nshards shards whose memory comes
+/// from alloc. The allocator is called under a shard's lock, from many
+/// threads, so it must be thread safe; an arena is not
+/// @param key_obj_size
+/// @param val_obj_size
+/// @param hash_fn: NULL for gbc_hash_bytes over the key's bytes
+/// @param cmp_fn: NULL to compare the key's bytes
+/// @param nshards: rounded up to a power of two, 0 for the default
+/// @param alloc: NULL for malloc/free
+/// @return
+chashmap_t *chashmap_new_ex(size_t key_obj_size, size_t val_obj_size,
+                            gbc_hash_fn hash_fn, chashmap_cmp_fn cmp_fn,
+                            size_t nshards, const gbc_allocator_t *alloc);
+
+/// @brief drop the chashmap_t out of memory, no other thread may use it
+/// @param map
+/// @return
+bool chashmap_drop(chashmap_t *map);
+
+/// @brief copy the value of key out
+/// @param map
+/// @param key
+/// @param val_out: val_obj_size bytes, or NULL
+/// @return return false if the key is not in the map
+bool chashmap_get(chashmap_t *map, const void *key, void *val_out);
+
+/// @brief check if key is in the map
+/// @param map
+/// @param key
+/// @return
+bool chashmap_contains(chashmap_t *map, const void *key);
+
+/// @brief add key with val unless it is in the map already
+/// @param map
+/// @param key
+/// @param val
+/// @return return false if the key was there, its value is left alone, or
+/// if there was no memory
+bool chashmap_insert(chashmap_t *map, const void *key, const void *val);
+
+/// @brief run fn on the value of key under the shard's lock, adding the key
+/// with a zeroed value first if it is not there. fn must not use the map
+/// @param map
+/// @param key
+/// @param fn
+/// @param ctx: passed to fn
+/// @return return false if there was no memory to add the key
+bool chashmap_upsert_with(chashmap_t *map, const void *key,
+                          chashmap_upsert_fn fn, void *ctx);
+
+/// @brief delete key from the map
+/// @param map
+/// @param key
+/// @param val_out: gets the value of the key if not NULL
+/// @return return false if the key was not there
+bool chashmap_erase(chashmap_t *map, const void *key, void *val_out);
+
+/// @brief the number of keys, each shard is counted at a different moment
+/// while other threads change the map
+/// @param map
+/// @return
+size_t chashmap_size(chashmap_t *map);
+
+/// @brief delete every key, the shards keep their memory
+/// @param map
+void chashmap_clear(chashmap_t *map);
+
+/// @brief run fn on every key and value, a shard at a time under its read
+/// lock. fn must not change the map
+/// @param map
+/// @param fn
+/// @param ctx: passed to fn
+void chashmap_foreach(chashmap_t *map, chashmap_foreach_fn fn, void *ctx);
+
+/// @brief the counters of the map summed over its shards
+/// @param map
+/// @param out
+/// @return return false, with out zeroed, unless built with GBC_STATS
+bool chashmap_stats(chashmap_t *map, gbc_stats_t *out);
+
+/// @brief the hash of key, never 0 so that 0 marks an empty slot. It is
+/// mixed once more so that a weak hash_fn still spreads over the shards
+static inline uint64_t chashmap_hash(const chashmap_t *map, const void *key) {
+  uint64_t h = gbc_hash_mix(map->hash_fn(key, map->key_obj_size));
+  return h ? h : 1;
+}
+
+static inline chashmap_shard_t *chashmap_shard_of(const chashmap_t *map,
+                                                  uint64_t h) {
+  return &map->shards[map->shard_shift < 64 ? h >> map->shard_shift : 0];
+}
+
+static inline char *chashmap_entry(const chashmap_t *map,
+                                   const chashmap_shard_t *s, size_t i) {
+  return s->entries + i * map->stride;
+}
+
+static inline bool chashmap_key_eq(const chashmap_t *map, const void *a,
+                                   const void *b) {
+  return map->cmp_fn ? map->cmp_fn(a, b) == 0
+                     : memcmp(a, b, map->key_obj_size) == 0;
+}
+
+/// @brief the slot of key in s, or s->cap if it is not there. The caller
+/// holds the shard's lock
+static size_t chashmap_find_slot(const chashmap_t *map,
+                                 const chashmap_shard_t *s, const void *key,
+                                 uint64_t h) {
+  if (s->cap == 0) return 0;
+  size_t mask = s->cap - 1;
+  for (size_t i = h & mask; s->hashes[i] != 0; i = (i + 1) & mask) {
+    if (s->hashes[i] == h &&
+        chashmap_key_eq(map, key, chashmap_entry(map, s, i))) {
+      return i;
+    }
+  }
+  return s->cap;
+}
+
+/// @brief the first empty slot for h in the cap slots of hashes, which has
+/// one
+static size_t chashmap_free_slot(const uint64_t *hashes, size_t cap,
+                                 uint64_t h) {
+  size_t mask = cap - 1, i = h & mask;
+  while (hashes[i] != 0) i = (i + 1) & mask;
+  return i;
+}
+
+/// @brief double the slots of s, or make its first ones, moving the entries
+/// over. The caller holds the shard's write lock
+static bool chashmap_shard_grow(const chashmap_t *map, chashmap_shard_t *s) {
+  size_t new_cap = s->cap ? s->cap * 2 : CHASHMAP_MIN_SHARD_CAP;
+  uint64_t *hashes =
+      (uint64_t *)gbc_alloc(map->alloc, new_cap * sizeof(uint64_t));
+  char *entries = (char *)gbc_alloc(map->alloc, new_cap * map->stride);
+  if (!hashes || !entries) {
+    if (hashes) gbc_free(map->alloc, hashes, new_cap * sizeof(uint64_t));
+    if (entries) gbc_free(map->alloc, entries, new_cap * map->stride);
+    return false;
+  }
+  memset(hashes, 0, new_cap * sizeof(uint64_t));
+  for (size_t i = 0; i < s->cap; ++i) {
+    if (s->hashes[i] == 0) continue;
+    size_t j = chashmap_free_slot(hashes, new_cap, s->hashes[i]);
+    hashes[j] = s->hashes[i];
+    memcpy(entries + j * map->stride, chashmap_entry(map, s, i),
+           map->stride);
+  }
+  if (s->cap) {
+    gbc_free(map->alloc, s->hashes, s->cap * sizeof(uint64_t));
+    gbc_free(map->alloc, s->entries, s->cap * map->stride);
+    GBC_STATS_FREE(s, s->cap * sizeof(uint64_t));
+    GBC_STATS_FREE(s, s->cap * map->stride);
+    GBC_STATS_INC(s, grows);
+  }
+  GBC_STATS_ALLOC(s, new_cap * sizeof(uint64_t));
+  GBC_STATS_ALLOC(s, new_cap * map->stride);
+  s->hashes = hashes;
+  s->entries = entries;
+  s->cap = new_cap;
+  return true;
+}
+
+/// @brief the slot of key in s, added with a zeroed value if it was not
+/// there, or s->cap if there was no memory. The caller holds the shard's
+/// write lock
+/// @param found: set to true if the key was there
+static size_t chashmap_find_or_add(const chashmap_t *map, chashmap_shard_t *s,
+                                   const void *key, uint64_t h, bool *found) {
+  size_t i = chashmap_find_slot(map, s, key, h);
+  *found = i < s->cap;
+  if (*found) return i;
+  if ((s->count + 1) * CHASHMAP_LOAD_DEN > s->cap * CHASHMAP_LOAD_NUM &&
+      !chashmap_shard_grow(map, s)) {
+    return s->cap;
+  }
+  i = chashmap_free_slot(s->hashes, s->cap, h);
+  s->hashes[i] = h;
+  char *entry = chashmap_entry(map, s, i);
+  memcpy(entry, key, map->key_obj_size);
+  memset(entry + map->val_offset, 0, map->val_obj_size);
+  s->count++;
+  return i;
+}
+
+/// @brief empty slot i of s, moving later entries of the probe run back so
+/// that no lookup stops early at the hole
+static void chashmap_remove_slot(const chashmap_t *map, chashmap_shard_t *s,
+                                 size_t i) {
+  size_t mask = s->cap - 1;
+  for (size_t j = (i + 1) & mask; s->hashes[j] != 0; j = (j + 1) & mask) {
+    size_t home = s->hashes[j] & mask;
+    // the entry at j may fill the hole unless its home lies in (i, j]
+    bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+    if (stays) continue;
+    s->hashes[i] = s->hashes[j];
+    memcpy(chashmap_entry(map, s, i), chashmap_entry(map, s, j), map->stride);
+    i = j;
+  }
+  s->hashes[i] = 0;
+  s->count--;
+}
+
+chashmap_t *chashmap_new(size_t key_obj_size, size_t val_obj_size,
+                         gbc_hash_fn hash_fn, chashmap_cmp_fn cmp_fn) {
+  return chashmap_new_ex(key_obj_size, val_obj_size, hash_fn, cmp_fn, 0,
+                         NULL);
+}
+
+chashmap_t *chashmap_new_ex(size_t key_obj_size, size_t val_obj_size,
+                            gbc_hash_fn hash_fn, chashmap_cmp_fn cmp_fn,
+                            size_t nshards, const gbc_allocator_t *alloc) {
+  assert(key_obj_size > 0);
+  alloc = gbc_allocator_or_std(alloc);
+  if (nshards == 0) nshards = DEFAULT_CHASHMAP_SHARDS;
+  if (nshards > CHASHMAP_MAX_SHARDS) nshards = CHASHMAP_MAX_SHARDS;
+  unsigned bits = 0;
+  while (((size_t)1 << bits) < nshards) bits++;
+  nshards = (size_t)1 << bits;
+
+  chashmap_t *map = (chashmap_t *)gbc_alloc(alloc, sizeof(chashmap_t));
+  if (!map) return NULL;
+  map->shards = (chashmap_shard_t *)gbc_alloc(
+      alloc, nshards * sizeof(chashmap_shard_t));
+  if (!map->shards) {
+    gbc_free(alloc, map, sizeof(chashmap_t));
+    return NULL;
+  }
+  map->key_obj_size = key_obj_size;
+  map->val_obj_size = val_obj_size;
+  map->val_offset = (key_obj_size + 7) & ~(size_t)7;
+  map->stride = (map->val_offset + val_obj_size + 7) & ~(size_t)7;
+  map->hash_fn = hash_fn ? hash_fn : gbc_hash_bytes;
+  map->cmp_fn = cmp_fn;
+  map->nshards = nshards;
+  map->shard_shift = 64 - bits;
+  map->alloc = alloc;
+  for (size_t k = 0; k < nshards; ++k) {
+    chashmap_shard_t *s = &map->shards[k];
+    pthread_rwlock_init(&s->lock, NULL);
+    s->hashes = NULL;
+    s->entries = NULL;
+    s->cap = s->count = 0;
+    GBC_STATS_INIT(s);
+  }
+  GBC_STATS_INIT(map);
+  GBC_STATS_ALLOC(map, sizeof(chashmap_t));
+  GBC_STATS_ALLOC(map, nshards * sizeof(chashmap_shard_t));
+  return map;
+}
+
+bool chashmap_drop(chashmap_t *map) {
+  if (!map) return false;
+  for (size_t k = 0; k < map->nshards; ++k) {
+    chashmap_shard_t *s = &map->shards[k];
+    if (s->cap) {
+      gbc_free(map->alloc, s->hashes, s->cap * sizeof(uint64_t));
+      gbc_free(map->alloc, s->entries, s->cap * map->stride);
+    }
+    pthread_rwlock_destroy(&s->lock);
+  }
+  gbc_free(map->alloc, map->shards, map->nshards * sizeof(chashmap_shard_t));
+  gbc_free(map->alloc, map, sizeof(chashmap_t));
+  return true;
+}
+
+bool chashmap_get(chashmap_t *map, const void *key, void *val_out) {
+  assert(map && key);
+  uint64_t h = chashmap_hash(map, key);
+  chashmap_shard_t *s = chashmap_shard_of(map, h);
+  pthread_rwlock_rdlock(&s->lock);
+  size_t i = chashmap_find_slot(map, s, key, h);
+  bool found = i < s->cap;
+  if (found && val_out) {
+    memcpy(val_out, chashmap_entry(map, s, i) + map->val_offset,
+           map->val_obj_size);
+  }
+  pthread_rwlock_unlock(&s->lock);
+  return found;
+}
+
+bool chashmap_contains(chashmap_t *map, const void *key) {
+  return chashmap_get(map, key, NULL);
+}
+
+bool chashmap_insert(chashmap_t *map, const void *key, const void *val) {
+  assert(map && key);
+  uint64_t h = chashmap_hash(map, key);
+  chashmap_shard_t *s = chashmap_shard_of(map, h);
+  pthread_rwlock_wrlock(&s->lock);
+  bool found;
+  size_t i = chashmap_find_or_add(map, s, key, h, &found);
+  bool added = !found && i < s->cap;
+  if (added && map->val_obj_size) {
+    memcpy(chashmap_entry(map, s, i) + map->val_offset, val,
+           map->val_obj_size);
+  }
+  pthread_rwlock_unlock(&s->lock);
+  return added;
+}
+
+bool chashmap_upsert_with(chashmap_t *map, const void *key,
+                          chashmap_upsert_fn fn, void *ctx) {
+  assert(map && key && fn);
+  uint64_t h = chashmap_hash(map, key);
+  chashmap_shard_t *s = chashmap_shard_of(map, h);
+  pthread_rwlock_wrlock(&s->lock);
+  bool found;
+  size_t i = chashmap_find_or_add(map, s, key, h, &found);
+  bool ok = i < s->cap;
+  if (ok) fn(chashmap_entry(map, s, i) + map->val_offset, found, ctx);
+  pthread_rwlock_unlock(&s->lock);
+  return ok;
+}
+
+bool chashmap_erase(chashmap_t *map, const void *key, void *val_out) {
+  assert(map && key);
+  uint64_t h = chashmap_hash(map, key);
+  chashmap_shard_t *s = chashmap_shard_of(map, h);
+  pthread_rwlock_wrlock(&s->lock);
+  size_t i = chashmap_find_slot(map, s, key, h);
+  bool found = i < s->cap;
+  if (found) {
+    if (val_out) {
+      memcpy(val_out, chashmap_entry(map, s, i) + map->val_offset,
+             map->val_obj_size);
+    }
+    chashmap_remove_slot(map, s, i);
+  }
+  pthread_rwlock_unlock(&s->lock);
+  return found;
+}
+
+size_t chashmap_size(chashmap_t *map) {
+  assert(map);
+  size_t size = 0;
+  for (size_t k = 0; k < map->nshards; ++k) {
+    chashmap_shard_t *s = &map->shards[k];
+    pthread_rwlock_rdlock(&s->lock);
+    size += s->count;
+    pthread_rwlock_unlock(&s->lock);
+  }
+  return size;
+}
+
+void chashmap_clear(chashmap_t *map) {
+  assert(map);
+  for (size_t k = 0; k < map->nshards; ++k) {
+    chashmap_shard_t *s = &map->shards[k];
+    pthread_rwlock_wrlock(&s->lock);
+    if (s->cap) memset(s->hashes, 0, s->cap * sizeof(uint64_t));
+    s->count = 0;
+    pthread_rwlock_unlock(&s->lock);
+  }
+}
+
+void chashmap_foreach(chashmap_t *map, chashmap_foreach_fn fn, void *ctx) {
+  assert(map && fn);
+  for (size_t k = 0; k < map->nshards; ++k) {
+    chashmap_shard_t *s = &map->shards[k];
+    pthread_rwlock_rdlock(&s->lock);
+    for (size_t i = 0; i < s->cap; ++i) {
+      if (s->hashes[i] == 0) continue;
+      const char *entry = chashmap_entry(map, s, i);
+      fn(entry, entry + map->val_offset, ctx);
+    }
+    pthread_rwlock_unlock(&s->lock);
+  }
+}
+
+bool chashmap_stats(chashmap_t *map, gbc_stats_t *out) {
+  assert(map && out);
+  bool on = GBC_STATS_READ(map, out);
+#ifdef GBC_STATS
+  for (size_t k = 0; k < map->nshards; ++k) {
+    chashmap_shard_t *s = &map->shards[k];
+    pthread_rwlock_rdlock(&s->lock);
+    out->allocs += s->stats.allocs;
+    out->frees += s->stats.frees;
+    out->bytes += s->stats.bytes;
+    // the shards peak at different moments, so this is an upper bound
+    out->peak_bytes += s->stats.peak_bytes;
+    out->grows += s->stats.grows;
+    pthread_rwlock_unlock(&s->lock);
+  }
+#endif
+  return on;
+}
+
+#endif
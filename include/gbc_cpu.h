@@ -0,0 +1,80 @@
+#ifndef _GBC_CPU_H
+#define _GBC_CPU_H
+#include <stdbool.h>
+
+/// @brief runtime CPU feature dispatch for the SIMD kernels. The kernels are
+/// compiled for their instruction set with a target attribute, so the rest of
+/// the program keeps its baseline flags and one binary runs everywhere: a
+/// kernel is only called when the CPU reports its features at run time.
+/// GBC_CPU_X86 is defined when such kernels can be built (gcc or clang on
+/// x86); elsewhere only the scalar paths exist. Defining GBC_NO_SIMD before
+/// including any GBC header drops the vector kernels altogether
+#if !defined(GBC_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define GBC_CPU_X86 1
+#include <immintrin.h>
+#define GBC_TARGET_SSE2 __attribute__((target("sse2")))
+#define GBC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/// @brief the instruction sets the kernels know about, in increasing order
+typedef enum _gbc_cpu_level {
+  GBC_CPU_SCALAR = 0,
+  GBC_CPU_SSE2 = 1,
+  GBC_CPU_AVX2 = 2,
+} gbc_cpu_level_t;
+
+// -1 until the first query, then the detected or forced level. Threads may
+// query it at once, so it is read and written atomically; a race between
+// two first queries stores the same detected level twice
+static int gbc_cpu_level_cache = -1;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define _gbc_cpu_cache_load() \
+  __atomic_load_n(&gbc_cpu_level_cache, __ATOMIC_RELAXED)
+#define _gbc_cpu_cache_store(v) \
+  __atomic_store_n(&gbc_cpu_level_cache, (v), __ATOMIC_RELAXED)
+#else
+#define _gbc_cpu_cache_load() (gbc_cpu_level_cache)
+#define _gbc_cpu_cache_store(v) (gbc_cpu_level_cache = (v))
+#endif
+
+/// @brief the best instruction set the kernels may use on this CPU
+/// @return
+gbc_cpu_level_t gbc_cpu_level(void);
+
+/// @brief cap the level the kernels dispatch to, e.g. GBC_CPU_SCALAR to
+/// compare or test the fallbacks. The cap can not raise the detected level
+/// @param level
+void gbc_cpu_force_level(gbc_cpu_level_t level);
+
+/// @brief check if the AVX2 kernels may run
+/// @return
+bool gbc_cpu_has_avx2(void);
+
+static gbc_cpu_level_t gbc_cpu_detect(void) {
+#ifdef GBC_CPU_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return GBC_CPU_AVX2;
+  if (__builtin_cpu_supports("sse2")) return GBC_CPU_SSE2;
+#endif
+  return GBC_CPU_SCALAR;
+}
+
+gbc_cpu_level_t gbc_cpu_level(void) {
+  int level = _gbc_cpu_cache_load();
+  if (level < 0) {
+    level = (int)gbc_cpu_detect();
+    _gbc_cpu_cache_store(level);
+  }
+  return (gbc_cpu_level_t)level;
+}
+
+void gbc_cpu_force_level(gbc_cpu_level_t level) {
+  gbc_cpu_level_t detected = gbc_cpu_detect();
+  _gbc_cpu_cache_store((int)(level < detected ? level : detected));
+}
+
+bool gbc_cpu_has_avx2(void) { return gbc_cpu_level() >= GBC_CPU_AVX2; }
+
+#endif
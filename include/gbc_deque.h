@@ -7,11 +7,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "gbc_alloc.h"
 #include "gbc_iterator.h"
+#include "gbc_probes.h"
+#include "gbc_stats.h"
 
 #define DEFAULT_DQ_SIZE 8
 
 /// @brief vector double-ended queue
+/// @param alloc: the allocator of the buffer and of the deque itself
 typedef struct _vdq_t {
   size_t obj_size;
   size_t front;
@@ -19,13 +23,34 @@ typedef struct _vdq_t {
   size_t cap;
   size_t size;
   char *buf;
+  const gbc_allocator_t *alloc;
+  GBC_STATS_FIELD
 } vdq_t;
 
+/// @brief the element at idx, the ring position wraps with a compare rather
+/// than a modulo
+static inline char *vdq_slot(const vdq_t *q, size_t idx) {
+  size_t pos = q->front + idx;
+  if (pos >= q->cap) pos -= q->cap;
+  return q->buf + pos * q->obj_size;
+}
+
+/// @brief loop over the elements of q front to back with an index, binding
+/// var, a T*, to each of them. break/continue work as in a plain for loop; q
+/// is evaluated on every step and must not change size in the body
+#define GBC_VDQ_FOREACH(T, var, q)                              \
+  for (size_t var##_idx_ = 0, var##_once_ = 1;                  \
+       var##_once_ && var##_idx_ < (q)->size;                   \
+       var##_once_ = !var##_once_, ++var##_idx_)                \
+    for (T *var = (T *)vdq_slot((q), var##_idx_); var##_once_;  \
+         var##_once_ = !var##_once_)
+
 /// @brief The vector deque iterator
 typedef struct _vdq_iter_t {
   iter_t base;
   size_t cur_idx;
   vdq_t *dq;
+  const gbc_allocator_t *alloc;
 } vdq_iter_t;
 
 /// @brief create a new vdq_t
@@ -64,7 +89,9 @@ bool vdq_push_back(vdq_t *q, const void *value);
 /// @return
 bool vdq_push_front(vdq_t *q, const void *value);
 
-/// @brief insert an element in the vdq_t given an index
+/// @brief insert an element in the vdq_t before an index, idx can be the
+/// length. The shorter side of the ring is shifted by one, so it costs
+/// O(min(idx, length - idx)) and only allocates when the deque is full
 /// @param q
 /// @param idx
 /// @param value
@@ -115,12 +142,21 @@ bool vdq_del_front(vdq_t *q);
 /// @return return false if the deletion failed
 bool vdq_del_back(vdq_t *q);
 
-/// @brief delete an element in the vdq_t with an index
+/// @brief delete an element in the vdq_t with an index. The shorter side of
+/// the ring is shifted by one and nothing is allocated
 /// @param q
 /// @param idx
 /// @return
 bool vdq_del_at(vdq_t *q, size_t idx);
 
+/// @brief delete the elements in [from, to), shifting whichever side of the
+/// range is shorter
+/// @param q
+/// @param from
+/// @param to
+/// @return
+bool vdq_drain_range(vdq_t *q, size_t from, size_t to);
+
 /// @brief delete an element out of the vdq_t
 /// @param q
 /// @param target_value
@@ -129,21 +165,59 @@ bool vdq_del_at(vdq_t *q, size_t idx);
 bool vdq_del(vdq_t *q, const void *target_value,
              int (*cmp_fn)(const void *, const void *));
 
+/// @brief keep the elements for which pred returns true and delete the
+/// others in a single pass, keeping their order. pred sees each element once,
+/// front to back
+/// @param q
+/// @param pred
+/// @param ctx: passed to pred
+/// @return the number of deleted elements
+size_t vdq_retain(vdq_t *q, iter_pred_fn pred, void *ctx);
+
+/// @brief collapse every run of equal neighbours into its first element, on
+/// a sorted deque this removes all the duplicates
+/// @param q
+/// @param cmp_fn
+/// @return the number of deleted elements
+size_t vdq_dedup(vdq_t *q, int (*cmp_fn)(const void *, const void *));
+
+/// @brief delete an element in O(1) by moving the back one into its slot,
+/// the order of the elements is not kept
+/// @param q
+/// @param idx
+/// @return
+bool vdq_swap_remove(vdq_t *q, size_t idx);
+
+/// @brief shorten the deque to its first len elements, nothing happens if it
+/// is not longer than that. The capacity is kept
+/// @param q
+/// @param len
+void vdq_truncate(vdq_t *q, size_t len);
+
 /// @brief create a new vdq_t with specified capacity size
 /// @param element_size
 /// @param cap
 /// @return
 vdq_t *vdq_new_with_cap(size_t element_size, size_t cap);
 
+/// @brief create a new vdq_t with specified capacity whose memory, including
+/// the deque itself and its iterators, comes from alloc
+/// @param element_size
+/// @param cap
+/// @param alloc: NULL for malloc/free
+/// @return
+vdq_t *vdq_new_ex(size_t element_size, size_t cap,
+                  const gbc_allocator_t *alloc);
+
 /// @brief deep clone a vdq_t
 /// @param q
 /// @return
 vdq_t *vdq_clone(vdq_t *q);
 
-/// reverse the vdq_t
+/// reverse the vdq_t in place
 bool vdq_reverse(vdq_t *q);
 
-/// sort the vdq_t
+/// sort the vdq_t, the buffer is relinearized only when the ring wraps
 bool vdq_sort(vdq_t *q, int (*cmp_fn)(const void *, const void *));
 
 /// @brief create a vdq_t from an array
@@ -158,6 +232,17 @@ vdq_t *vdq_from_array(const void *_arr, size_t array_size, size_t obj_size);
 /// @return
 vdq_iter_t *vdq_iter_new(vdq_t *dq);
 
+/// @brief set up an iterator provided by the caller, e.g. on the stack, so
+/// iterating allocates nothing. Finish it with vdq_iter_fini, not
+/// vdq_iter_drop
+/// @param iter
+/// @param dq
+void vdq_iter_init(vdq_iter_t *iter, vdq_t *dq);
+
+/// @brief finish an iterator set up by vdq_iter_init
+/// @param iter
+void vdq_iter_fini(vdq_iter_t *iter);
+
 /// @brief drop a vdq_iter_t
 /// @param iter
 /// @return
@@ -178,30 +263,28 @@ void *vdq_iter_next(vdq_iter_t *iter);
 /// @return
 vdq_t *vdq_from_iter(iter_t *iter);
 
+/// @brief read the operation counters of the deque
+/// @param q
+/// @param out
+/// @return return false, with out zeroed, unless built with GBC_STATS
+bool vdq_stats(const vdq_t *q, gbc_stats_t *out);
+
 vdq_t *vdq_new(size_t element_size) {
-  char *buf = (char *)malloc(DEFAULT_DQ_SIZE * element_size);
-  if (!buf) return NULL;
-  vdq_t *q = (vdq_t *)malloc(sizeof(vdq_t));
-  if (!q) {
-    free(buf);
-    buf = NULL;
-    return NULL;
-  }
-  q->obj_size = element_size;
-  q->front = 0;
-  q->rear = 0;
-  q->cap = DEFAULT_DQ_SIZE;
-  q->size = 0;
-  q->buf = buf;
-  return q;
+  return vdq_new_ex(element_size, DEFAULT_DQ_SIZE, NULL);
 }
 
 vdq_t *vdq_new_with_cap(size_t element_size, size_t cap) {
-  char *buf = (char *)malloc(cap * element_size);
+  return vdq_new_ex(element_size, cap, NULL);
+}
+
+vdq_t *vdq_new_ex(size_t element_size, size_t cap,
+                  const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  char *buf = (char *)gbc_alloc(alloc, cap * element_size);
   if (!buf) return NULL;
-  vdq_t *q = (vdq_t *)malloc(sizeof(vdq_t));
+  vdq_t *q = (vdq_t *)gbc_alloc(alloc, sizeof(vdq_t));
   if (!q) {
-    free(buf);
+    gbc_free(alloc, buf, cap * element_size);
     buf = NULL;
     return NULL;
   }
@@ -211,14 +294,18 @@ vdq_t *vdq_new_with_cap(size_t element_size, size_t cap) {
   q->cap = cap;
   q->size = 0;
   q->buf = buf;
+  q->alloc = alloc;
+  GBC_STATS_INIT(q);
+  GBC_STATS_ALLOC(q, sizeof(vdq_t));
+  GBC_STATS_ALLOC(q, cap * element_size);
   return q;
 }
 
 vdq_t *vdq_clone(vdq_t *q) {
   if (!q) return NULL;
-  vdq_t *out = vdq_new_with_cap(q->obj_size, q->cap);
+  vdq_t *out = vdq_new_ex(q->obj_size, q->cap, q->alloc);
   if (!out) return NULL;
-  memcpy(out->buf, q->buf, q->obj_size * q->size);
+  memcpy(out->buf, q->buf, q->obj_size * q->cap);
   out->front = q->front;
   out->rear = q->rear;
   out->size = q->size;
@@ -228,14 +315,19 @@ vdq_t *vdq_clone(vdq_t *q) {
 bool vdq_drop(vdq_t *q) {
   if (!q) return false;
   if (q->buf) {
-    free(q->buf);
+    gbc_free(q->alloc, q->buf, q->cap * q->obj_size);
     q->buf = NULL;
   }
-  free(q);
+  gbc_free(q->alloc, q, sizeof(vdq_t));
   q = NULL;
   return true;
 }
 
+bool vdq_stats(const vdq_t *q, gbc_stats_t *out) {
+  assert(q && out);
+  return GBC_STATS_READ(q, out);
+}
+
 bool vdq_is_empty(const vdq_t *q) {
   assert(q);
   return q->size == 0;
@@ -252,18 +344,18 @@ size_t vdq_length(const vdq_t *q) {
 }
 
 static bool vdq_enlarge(vdq_t *q, size_t new_cap) {
-  char *new_buf = (char *)malloc(q->obj_size * new_cap);
+  char *new_buf = (char *)gbc_alloc(q->alloc, q->obj_size * new_cap);
   if (!new_buf) return false;
+  GBC_STATS_INC(q, grows);
+  GBC_STATS_REALLOC(q, q->obj_size * q->cap, q->obj_size * new_cap);
+  GBC_PROBE4(vdq_grow, q, q->cap, new_cap, q->size * q->obj_size);
   if (q->rear > q->front) {
-    memcpy(new_buf, q->buf, q->obj_size * q->size);
+    memcpy(new_buf, q->buf + (q->front * q->obj_size), q->obj_size * q->size);
     q->front = 0;
-    q->rear = q->size;
+    q->rear = q->size % new_cap;
+    gbc_free(q->alloc, q->buf, q->obj_size * q->cap);
     q->cap = new_cap;
-    if (q->buf) {
-      free(q->buf);
-      q->buf = new_buf;
-    } else
-      q->buf = new_buf;
+    q->buf = new_buf;
     return true;
   } else {
     size_t front_parts = (q->cap - q->front) * q->obj_size;
@@ -271,17 +363,47 @@ static bool vdq_enlarge(vdq_t *q, size_t new_cap) {
     memcpy(new_buf, q->buf + (q->front * q->obj_size), front_parts);
     memcpy(new_buf + front_parts, q->buf, rear_parts);
     q->front = 0;
-    q->rear = q->size;
+    q->rear = q->size % new_cap;
+    gbc_free(q->alloc, q->buf, q->obj_size * q->cap);
     q->cap = new_cap;
-    if (q->buf) {
-      free(q->buf);
-      q->buf = new_buf;
-    } else
-      q->buf = new_buf;
+    q->buf = new_buf;
     return true;
   }
 }
 
+/// @brief move n elements from the ring slot src to the ring slot dst, both
+/// sides may wrap. The move is split where either side wraps, so each piece
+/// is a plain memmove. Copying from the end when moving towards the rear
+/// keeps overlapping ranges intact
+static void vdq_ring_move(vdq_t *q, size_t dst, size_t src, size_t n) {
+  size_t dist = (dst + q->cap - src) % q->cap;
+  if (n == 0 || dist == 0) return;
+  if (dist < q->cap - dist) {
+    size_t src_end = (src + n) % q->cap;
+    size_t dst_end = (dst + n) % q->cap;
+    while (n > 0) {
+      size_t len = src_end == 0 ? q->cap : src_end;
+      if (dst_end != 0 && dst_end < len) len = dst_end;
+      if (n < len) len = n;
+      src_end = (src_end == 0 ? q->cap : src_end) - len;
+      dst_end = (dst_end == 0 ? q->cap : dst_end) - len;
+      memmove(q->buf + dst_end * q->obj_size, q->buf + src_end * q->obj_size,
+              len * q->obj_size);
+      n -= len;
+    }
+  } else {
+    while (n > 0) {
+      size_t len = q->cap - (src > dst ? src : dst);
+      if (n < len) len = n;
+      memmove(q->buf + dst * q->obj_size, q->buf + src * q->obj_size,
+              len * q->obj_size);
+      src = (src + len) % q->cap;
+      dst = (dst + len) % q->cap;
+      n -= len;
+    }
+  }
+}
+
 bool vdq_push_back(vdq_t *q, const void *value) {
   assert(q && value);
   if (vdq_is_full(q)) {
@@ -305,26 +427,27 @@ bool vdq_push_front(vdq_t *q, const void *value) {
 }
 
 bool vdq_insert(vdq_t *q, size_t idx, const void *value) {
-  assert(q && value && q->size > idx);
+  assert(q && value && q->size >= idx);
+  if (idx == 0) return vdq_push_front(q, value);
+  if (idx == q->size) return vdq_push_back(q, value);
   if (vdq_is_full(q)) {
     if (!vdq_enlarge(q, q->cap * 2)) return false;
-  } else {
-    if (!vdq_enlarge(q, q->cap)) return false;
   }
-  if (idx == 0)
-    return vdq_push_front(q, value);
-  else if (idx == q->size)
-    return vdq_push_back(q, value);
-  else {
-    size_t pos0 = (q->front + idx) % q->cap;
-    size_t pos1 = (q->front + idx + 1) % q->cap;
-    memmove(q->buf + pos1 * q->obj_size, q->buf + pos0 * q->obj_size,
-            (q->size - idx) * q->obj_size);
-    memcpy(q->buf + pos0 * q->obj_size, value, q->obj_size);
-    q->size++;
+  if (idx < q->size - idx) {
+    // move [0, idx) one slot towards the front
+    size_t new_front = (q->front + q->cap - 1) % q->cap;
+    vdq_ring_move(q, new_front, q->front, idx);
+    q->front = new_front;
+  } else {
+    // move [idx, size) one slot towards the rear
+    size_t pos = (q->front + idx) % q->cap;
+    vdq_ring_move(q, (pos + 1) % q->cap, pos, q->size - idx);
     q->rear = (q->rear + 1) % q->cap;
-    return true;
   }
+  memcpy(q->buf + ((q->front + idx) % q->cap) * q->obj_size, value,
+         q->obj_size);
+  q->size++;
+  return true;
 }
 
 const void *vdq_front(const vdq_t *q) {
@@ -382,21 +505,26 @@ bool vdq_del_back(vdq_t *q) {
 
 bool vdq_del_at(vdq_t *q, size_t idx) {
   assert(q && q->size > idx);
-  if (idx == 0)
-    return vdq_del_front(q);
-  else if (idx == q->size)
-    return vdq_del_back(q);
-  else {
-    if (q->rear < q->front) {
-      if (!vdq_enlarge(q, q->cap)) return false;
-    }
-    memmove(q->buf + ((idx + q->front) % q->cap) * q->obj_size,
-            q->buf + ((idx + 1 + q->front) % q->cap) * q->obj_size,
-            (q->size - idx - 1) * q->obj_size);
-    q->size--;
-    q->rear = (q->rear + q->cap - 1) % q->cap;
-    return true;
+  return vdq_drain_range(q, idx, idx + 1);
+}
+
+bool vdq_drain_range(vdq_t *q, size_t from, size_t to) {
+  assert(q && from <= to && to <= q->size);
+  size_t n = to - from;
+  if (n == 0) return true;
+  if (from < q->size - to) {
+    // move [0, from) n slots towards the rear
+    size_t new_front = (q->front + n) % q->cap;
+    vdq_ring_move(q, new_front, q->front, from);
+    q->front = new_front;
+  } else {
+    // move [to, size) n slots towards the front
+    vdq_ring_move(q, (q->front + from) % q->cap, (q->front + to) % q->cap,
+                  q->size - to);
+    q->rear = (q->rear + q->cap - n) % q->cap;
   }
+  q->size -= n;
+  return true;
 }
 
 bool vdq_del(vdq_t *q, const void *target_value,
@@ -405,6 +533,7 @@ bool vdq_del(vdq_t *q, const void *target_value,
   bool flag = false;
   for (int i = 0; i < q->size; ++i) {
     const void *ele = vdq_at(q, i);
+    GBC_STATS_INC(q, cmp_calls);
     int order = cmp_fn(ele, target_value);
     if (order == 0) {
       flag = true;
@@ -419,20 +548,62 @@ bool vdq_del(vdq_t *q, const void *target_value,
   return flag;
 }
 
+size_t vdq_retain(vdq_t *q, iter_pred_fn pred, void *ctx) {
+  assert(q && pred);
+  size_t w = 0;
+  for (size_t r = 0; r < q->size; ++r) {
+    char *elem = vdq_slot(q, r);
+    if (!pred(elem, ctx)) continue;
+    if (w != r) memcpy(vdq_slot(q, w), elem, q->obj_size);
+    w++;
+  }
+  size_t removed = q->size - w;
+  vdq_truncate(q, w);
+  return removed;
+}
+
+size_t vdq_dedup(vdq_t *q, int (*cmp_fn)(const void *, const void *)) {
+  assert(q && cmp_fn);
+  if (q->size < 2) return 0;
+  // w is one past the last kept element, compare against it
+  size_t w = 1;
+  for (size_t r = 1; r < q->size; ++r) {
+    char *elem = vdq_slot(q, r);
+    GBC_STATS_INC(q, cmp_calls);
+    if (cmp_fn(vdq_slot(q, w - 1), elem) == 0) continue;
+    if (w != r) memcpy(vdq_slot(q, w), elem, q->obj_size);
+    w++;
+  }
+  size_t removed = q->size - w;
+  vdq_truncate(q, w);
+  return removed;
+}
+
+bool vdq_swap_remove(vdq_t *q, size_t idx) {
+  assert(q && q->size > idx);
+  if (idx != q->size - 1) {
+    memcpy(vdq_slot(q, idx), vdq_slot(q, q->size - 1), q->obj_size);
+  }
+  return vdq_del_back(q);
+}
+
+void vdq_truncate(vdq_t *q, size_t len) {
+  assert(q);
+  if (len >= q->size) return;
+  q->rear = (q->front + len) % q->cap;
+  q->size = len;
+}
+
 bool vdq_reverse(vdq_t *q) {
   assert(q);
   if (q->size == 0) return false;
-  if (!vdq_enlarge(q, q->cap)) return false;
-  size_t start = q->front;
-  size_t end = (q->rear + q->cap - 1) % q->cap;
   char tmp[q->obj_size];
-  while (start < end) {
-    memcpy(tmp, q->buf + start * q->obj_size, q->obj_size);
-    memcpy(q->buf + start * q->obj_size, q->buf + end * q->obj_size,
-           q->obj_size);
-    memcpy(q->buf + end * q->obj_size, tmp, q->obj_size);
-    start = (start + 1) % q->cap;
-    end = (end + q->cap - 1) % q->cap;
+  for (size_t start = 0, end = q->size - 1; start < end; ++start, --end) {
+    char *a = vdq_at_mut(q, start);
+    char *b = vdq_at_mut(q, end);
+    memcpy(tmp, a, q->obj_size);
+    memcpy(a, b, q->obj_size);
+    memcpy(b, tmp, q->obj_size);
   }
   return true;
 }
@@ -440,8 +611,11 @@ bool vdq_reverse(vdq_t *q) {
 bool vdq_sort(vdq_t *q, int (*cmp_fn)(const void *, const void *)) {
   assert(q);
   if (q->size == 0) return false;
-  if (!vdq_enlarge(q, q->cap)) return false;
-  qsort(q->buf, q->size, q->obj_size, cmp_fn);
+  if (q->front + q->size > q->cap) {
+    if (!vdq_enlarge(q, q->cap)) return false;
+  }
+  GBC_STATS_QSORT(q, q->buf + q->front * q->obj_size, q->size, q->obj_size,
+                  cmp_fn);
   return true;
 }
 
@@ -472,24 +646,50 @@ void *_vdq_iter_next(iter_t *_iter) {
   }
 }
 
-vdq_iter_t *vdq_iter_new(vdq_t *dq) {
-  assert(dq);
-  vdq_iter_t *iter = (vdq_iter_t *)malloc(sizeof(vdq_iter_t));
-  if (!iter) {
-    return NULL;
-  }
+/// a span runs up to the end of the buffer, so a wrapped ring takes two
+size_t _vdq_iter_next_batch(iter_t *_iter, iter_batch_t *batch, size_t max) {
+  vdq_iter_t *iter = (vdq_iter_t *)_iter;
+  vdq_t *q = iter->dq;
+  size_t pos = (q->front + iter->cur_idx) % q->cap;
+  size_t len = q->size - iter->cur_idx;
+  if (len > q->cap - pos) len = q->cap - pos;
+  if (len > max) len = max;
+  batch->span = q->buf + pos * q->obj_size;
+  batch->len = len;
+  iter->cur_idx += len;
+  return len;
+}
+
+void vdq_iter_init(vdq_iter_t *iter, vdq_t *dq) {
+  assert(iter && dq);
   iter_t base = {.obj_size = dq->obj_size,
                  .has_next = _vdq_iter_has_next,
-                 .next = _vdq_iter_next};
+                 .next = _vdq_iter_next,
+                 .next_batch = _vdq_iter_next_batch};
   iter->base = base;
   iter->cur_idx = 0;
   iter->dq = dq;
+  iter->alloc = NULL;
+  GBC_PROBE3(iter_new, dq, iter, dq->size);
+}
+
+void vdq_iter_fini(vdq_iter_t *iter) {
+  assert(iter && !iter->alloc);
+  iter->dq = NULL;
+}
+
+vdq_iter_t *vdq_iter_new(vdq_t *dq) {
+  assert(dq);
+  vdq_iter_t *iter = (vdq_iter_t *)gbc_alloc(dq->alloc, sizeof(vdq_iter_t));
+  if (!iter) return NULL;
+  vdq_iter_init(iter, dq);
+  iter->alloc = dq->alloc;
   return iter;
 }
 
 bool vdq_iter_drop(vdq_iter_t *iter) {
   if (!iter) return false;
-  free(iter);
+  gbc_free(iter->alloc, iter, sizeof(vdq_iter_t));
   return true;
 }
 
@@ -504,9 +704,34 @@ void *vdq_iter_next(vdq_iter_t *iter) {
 vdq_t *vdq_from_iter(iter_t *iter) {
   assert(iter);
   vdq_t *dq = vdq_new(iter->obj_size);
-  while (iter->has_next(iter)) {
-    const void *out = iter->next(iter);
-    vdq_push_back(dq, out);
+  if (!dq) return NULL;
+  void *ptrs[ITER_BATCH_MAX];
+  iter_batch_t batch = {.span = NULL, .ptrs = ptrs, .len = 0};
+  while (iter_next_batch(iter, &batch, ITER_BATCH_MAX) > 0) {
+    if (dq->cap - dq->size < batch.len) {
+      size_t cap = dq->cap * 2;
+      while (cap - dq->size < batch.len) cap *= 2;
+      if (!vdq_enlarge(dq, cap)) {
+        vdq_drop(dq);
+        return NULL;
+      }
+    }
+    if (batch.span) {
+      // at most two copies, split where the rear wraps
+      size_t first = dq->cap - dq->rear;
+      if (first > batch.len) first = batch.len;
+      memcpy(dq->buf + dq->rear * dq->obj_size, batch.span,
+             first * dq->obj_size);
+      memcpy(dq->buf, batch.span + first * dq->obj_size,
+             (batch.len - first) * dq->obj_size);
+      dq->rear = (dq->rear + batch.len) % dq->cap;
+    } else {
+      for (size_t i = 0; i < batch.len; ++i) {
+        memcpy(dq->buf + dq->rear * dq->obj_size, batch.ptrs[i], dq->obj_size);
+        dq->rear = (dq->rear + 1) % dq->cap;
+      }
+    }
+    dq->size += batch.len;
   }
   return dq;
 }
@@ -0,0 +1,455 @@
+#ifndef _GBC_EXTSORT_H
+#define _GBC_EXTSORT_H
+// The runs are spilled to files made with mkstemp and fdopen, which are
+// POSIX and hidden by a strict -std=c11. Include this header before any
+// system header for the macros below to take effect, or define them, or
+// build with -std=gnu11.
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gbc_heap.h"
+#include "gbc_iterator.h"
+#include "gbc_vector.h"
+
+#define DEFAULT_EXTSORT_MEM_BUDGET (64 << 20)
+#define DEFAULT_EXTSORT_TMP_DIR "/tmp"
+#define EXTSORT_MIN_RUN_BUF (64 << 10)
+
+/// @brief the configuration of an external sort
+/// @param size_t mem_budget: bytes of records held in memory at once, both
+/// while sorting runs and while merging them. 0 for the default. A merge
+/// reads at least EXTSORT_MIN_RUN_BUF per run, more runs than fit into the
+/// budget that way are merged in several passes
+/// @param const char* tmp_dir: where the runs are spilled, NULL for the
+/// default. The run files are unlinked as soon as they are created
+typedef struct _extsort_cfg {
+  size_t mem_budget;
+  const char *tmp_dir;
+} extsort_cfg_t;
+
+typedef struct _extsort extsort_t;
+
+/// @brief a sorted run spilled to a temporary file, read back through buf
+typedef struct _extsort_run {
+  FILE *f;
+  char *buf;
+  size_t cap;
+  size_t len;
+  size_t pos;
+  const extsort_t *owner;
+} extsort_run_t;
+
+/// @brief external merge sort. The source is cut into runs of mem_budget
+/// bytes, each sorted in memory with vec_sort and spilled to a temporary
+/// file, then the runs are merged k at a time through a heap_t. The sorter
+/// is itself an iter_t which yields the records in ascending order; when the
+/// whole source fits into the budget nothing is spilled and the records come
+/// straight out of memory
+/// @param iter_t base: the sorted output
+/// @param vec_t* mem: the records when nothing was spilled
+/// @param vec_t* runs: vec_t<extsort_run_t*>, runs[first_run..] are pending
+/// @param size_t spilled: the runs cut from the source, merge passes add
+/// more to runs
+/// @param heap_t* heap: heap_t<extsort_run_t*> ordered by current record
+/// @param char* out: the record last returned by next
+typedef struct _extsort {
+  iter_t base;
+  int (*cmp_fn)(const void *, const void *);
+  extsort_cfg_t cfg;
+  vec_t *mem;
+  size_t mem_pos;
+  vec_t *runs;
+  size_t first_run;
+  size_t spilled;
+  heap_t *heap;
+  char *out;
+  bool failed;
+} extsort_t;
+
+/// @brief a raw record file read as an iter_t, e.g. the source of a sort
+typedef struct _extsort_file_iter {
+  iter_t base;
+  FILE *f;
+  char *buf;
+  size_t cap;
+  size_t len;
+  size_t pos;
+} extsort_file_iter_t;
+
+/// @brief sort every record of src, whose records are src->obj_size bytes.
+/// src is fully consumed before this returns
+/// @param src
+/// @param cmp_fn: the compare function of the records
+/// @param cfg: NULL for the defaults
+/// @return return NULL if failed, e.g. the tmp_dir is not writable
+extsort_t *extsort_from_iter(iter_t *src,
+                             int (*cmp_fn)(const void *, const void *),
+                             const extsort_cfg_t *cfg);
+
+/// @brief drop the sorter and its temporary files
+/// @param s
+/// @return
+bool extsort_drop(extsort_t *s);
+
+/// @brief check if there are more sorted records
+/// @param s
+/// @return
+bool extsort_has_next(const extsort_t *s);
+
+/// @brief get the next sorted record, valid until the next call
+/// @param s
+/// @return
+void *extsort_next(extsort_t *s);
+
+/// @brief write the remaining sorted records to path as raw records
+/// @param s
+/// @param path
+/// @return
+bool extsort_write(extsort_t *s, const char *path);
+
+/// @brief get the number of runs that were spilled from the source, 0 if it
+/// fit into the memory budget. Runs written by merge passes are not counted
+/// @param s
+/// @return
+size_t extsort_run_count(const extsort_t *s);
+
+/// @brief check if reading a run failed, the output is then incomplete
+/// @param s
+/// @return
+bool extsort_failed(const extsort_t *s);
+
+/// @brief open a file of raw obj_size records as an iter_t
+/// @param path
+/// @param obj_size
+/// @return
+extsort_file_iter_t *extsort_file_iter_open(const char *path, size_t obj_size);
+
+/// @brief close a file iterator
+/// @param iter
+/// @return
+bool extsort_file_iter_close(extsort_file_iter_t *iter);
+
+/// @brief sort the raw records of in_path into out_path
+/// @param in_path
+/// @param out_path
+/// @param obj_size
+/// @param cmp_fn
+/// @param cfg: NULL for the defaults
+/// @return
+bool extsort_file(const char *in_path, const char *out_path, size_t obj_size,
+                  int (*cmp_fn)(const void *, const void *),
+                  const extsort_cfg_t *cfg);
+
+static inline size_t extsort_obj_size(const extsort_t *s) {
+  return s->base.obj_size;
+}
+
+static inline extsort_run_t *extsort_run_at(const extsort_t *s, size_t idx) {
+  return *(extsort_run_t **)vec_at(s->runs, idx);
+}
+
+static inline const char *extsort_run_cur(const extsort_run_t *run) {
+  return run->buf + run->pos * run->owner->base.obj_size;
+}
+
+/// @brief order runs by their current record through the shared cmp_fn
+static int extsort_run_cmp(const void *a, const void *b) {
+  const extsort_run_t *ra = *(const extsort_run_t **)a;
+  const extsort_run_t *rb = *(const extsort_run_t **)b;
+  return ra->owner->cmp_fn(extsort_run_cur(ra), extsort_run_cur(rb));
+}
+
+static void extsort_run_drop(extsort_run_t *run) {
+  if (run->f) fclose(run->f);
+  free(run->buf);
+  free(run);
+}
+
+/// @brief create an empty run backed by an unlinked temporary file
+static extsort_run_t *extsort_run_new(extsort_t *s) {
+  size_t len = strlen(s->cfg.tmp_dir);
+  char path[len + sizeof("/gbc_extsort_XXXXXX")];
+  memcpy(path, s->cfg.tmp_dir, len);
+  memcpy(path + len, "/gbc_extsort_XXXXXX", sizeof("/gbc_extsort_XXXXXX"));
+  int fd = mkstemp(path);
+  if (fd < 0) return NULL;
+  unlink(path);
+  extsort_run_t *run = (extsort_run_t *)calloc(1, sizeof(extsort_run_t));
+  if (run) run->f = fdopen(fd, "w+b");
+  if (!run || !run->f) {
+    if (run) free(run);
+    close(fd);
+    return NULL;
+  }
+  run->owner = s;
+  if (!vec_push(s->runs, &run)) {
+    extsort_run_drop(run);
+    return NULL;
+  }
+  return run;
+}
+
+/// @brief sort the records held in s->mem and spill them as a new run
+static bool extsort_spill(extsort_t *s) {
+  vec_sort(s->mem, s->cmp_fn);
+  extsort_run_t *run = extsort_run_new(s);
+  if (!run) return false;
+  size_t n = s->mem->size;
+  bool ok = fwrite(s->mem->buf, extsort_obj_size(s), n, run->f) == n;
+  s->mem->size = 0;
+  ++s->spilled;
+  return ok;
+}
+
+/// @brief load the next block of a run, return false once it is exhausted
+static bool extsort_run_fill(extsort_t *s, extsort_run_t *run) {
+  run->pos = 0;
+  run->len = fread(run->buf, extsort_obj_size(s), run->cap, run->f);
+  if (run->len == 0 && ferror(run->f)) s->failed = true;
+  return run->len > 0;
+}
+
+/// @brief rewind runs[from, to) and put those with records into a new heap,
+/// each with a read buffer of its share of the memory budget
+static bool extsort_merge_begin(extsort_t *s, size_t from, size_t to) {
+  size_t obj_size = extsort_obj_size(s);
+  size_t share = s->cfg.mem_budget / (to - from);
+  if (share < EXTSORT_MIN_RUN_BUF) share = EXTSORT_MIN_RUN_BUF;
+  size_t cap = share / obj_size ? share / obj_size : 1;
+  s->heap = heap_new(sizeof(extsort_run_t *), extsort_run_cmp);
+  if (!s->heap) return false;
+  for (size_t i = from; i < to; ++i) {
+    extsort_run_t *run = extsort_run_at(s, i);
+    char *buf = (char *)realloc(run->buf, cap * obj_size);
+    if (!buf) return false;
+    run->buf = buf;
+    run->cap = cap;
+    fflush(run->f);
+    rewind(run->f);
+    if (extsort_run_fill(s, run) && !heap_push(s->heap, &run)) return false;
+  }
+  return true;
+}
+
+/// @brief take the smallest record out of the merge into s->out
+static bool extsort_merge_next(extsort_t *s) {
+  if (heap_is_empty(s->heap)) return false;
+  extsort_run_t *run = *(extsort_run_t *const *)heap_top(s->heap);
+  memcpy(s->out, extsort_run_cur(run), extsort_obj_size(s));
+  run->pos++;
+  if (run->pos < run->len || extsort_run_fill(s, run)) {
+    // the run stays, its new current record is sifted down from the top
+    heap_replace(s->heap, &run, NULL);
+  } else {
+    heap_pop(s->heap, NULL);
+  }
+  return true;
+}
+
+/// @brief merge the oldest fan_in runs into one new run until a single
+/// merge pass is left
+static bool extsort_merge_passes(extsort_t *s) {
+  size_t fan_in = s->cfg.mem_budget / EXTSORT_MIN_RUN_BUF;
+  if (fan_in < 2) fan_in = 2;
+  while (s->runs->size - s->first_run > fan_in) {
+    size_t from = s->first_run;
+    if (!extsort_merge_begin(s, from, from + fan_in)) return false;
+    extsort_run_t *merged = extsort_run_new(s);
+    if (!merged) return false;
+    while (extsort_merge_next(s)) {
+      if (fwrite(s->out, extsort_obj_size(s), 1, merged->f) != 1) return false;
+    }
+    heap_drop(s->heap);
+    s->heap = NULL;
+    for (size_t i = from; i < from + fan_in; ++i) {
+      extsort_run_drop(extsort_run_at(s, i));
+    }
+    s->first_run += fan_in;
+    if (s->failed) return false;
+  }
+  return true;
+}
+
+static bool _extsort_has_next(const iter_t *iter) {
+  const extsort_t *s = (const extsort_t *)iter;
+  if (s->heap) return !heap_is_empty(s->heap);
+  return s->mem && s->mem_pos < s->mem->size;
+}
+
+static void *_extsort_next(iter_t *iter) {
+  extsort_t *s = (extsort_t *)iter;
+  if (s->heap) return extsort_merge_next(s) ? s->out : NULL;
+  if (!_extsort_has_next(iter)) return NULL;
+  return vec_at_mut(s->mem, s->mem_pos++);
+}
+
+extsort_t *extsort_from_iter(iter_t *src,
+                             int (*cmp_fn)(const void *, const void *),
+                             const extsort_cfg_t *cfg) {
+  assert(src && cmp_fn && src->obj_size > 0);
+  extsort_t *s = (extsort_t *)calloc(1, sizeof(extsort_t));
+  if (!s) return NULL;
+  iter_t base = {.obj_size = src->obj_size,
+                 .has_next = _extsort_has_next,
+                 .next = _extsort_next};
+  s->base = base;
+  s->cmp_fn = cmp_fn;
+  s->cfg.mem_budget = DEFAULT_EXTSORT_MEM_BUDGET;
+  s->cfg.tmp_dir = DEFAULT_EXTSORT_TMP_DIR;
+  if (cfg && cfg->mem_budget) s->cfg.mem_budget = cfg->mem_budget;
+  if (cfg && cfg->tmp_dir) s->cfg.tmp_dir = cfg->tmp_dir;
+
+  size_t run_cap = s->cfg.mem_budget / src->obj_size;
+  if (run_cap == 0) run_cap = 1;
+  s->out = (char *)malloc(src->obj_size);
+  s->runs = vec_new(sizeof(extsort_run_t *));
+  // the run buffer grows up to run_cap only, small inputs stay small
+  s->mem = vec_new(src->obj_size);
+  if (!s->out || !s->runs || !s->mem) {
+    extsort_drop(s);
+    return NULL;
+  }
+  while (src->has_next(src)) {
+    if (s->mem->size == run_cap && !extsort_spill(s)) {
+      extsort_drop(s);
+      return NULL;
+    }
+    if (s->mem->size == s->mem->cap) {
+      size_t cap = vec_grown_cap(s->mem);
+      if (!vec_enlarge(s->mem, (cap < run_cap) ? cap : run_cap)) {
+        extsort_drop(s);
+        return NULL;
+      }
+    }
+    if (!vec_push(s->mem, src->next(src))) {
+      extsort_drop(s);
+      return NULL;
+    }
+  }
+  if (s->runs->size == 0) {
+    if (s->mem->size > 0) vec_sort(s->mem, cmp_fn);
+    return s;
+  }
+  bool ok = s->mem->size == 0 || extsort_spill(s);
+  // the run buffer is given back before the merge takes its share
+  vec_drop(s->mem);
+  s->mem = NULL;
+  if (!ok || !extsort_merge_passes(s) ||
+      !extsort_merge_begin(s, s->first_run, s->runs->size)) {
+    extsort_drop(s);
+    return NULL;
+  }
+  return s;
+}
+
+bool extsort_drop(extsort_t *s) {
+  if (!s) return false;
+  if (s->runs) {
+    for (size_t i = s->first_run; i < s->runs->size; ++i) {
+      extsort_run_drop(extsort_run_at(s, i));
+    }
+    vec_drop(s->runs);
+  }
+  if (s->heap) heap_drop(s->heap);
+  if (s->mem) vec_drop(s->mem);
+  free(s->out);
+  free(s);
+  return true;
+}
+
+bool extsort_has_next(const extsort_t *s) {
+  assert(s);
+  return s->base.has_next(&s->base);
+}
+
+void *extsort_next(extsort_t *s) {
+  assert(s);
+  return s->base.next(&s->base);
+}
+
+bool extsort_write(extsort_t *s, const char *path) {
+  assert(s && path);
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  bool ok = true;
+  while (ok && extsort_has_next(s)) {
+    ok = fwrite(extsort_next(s), extsort_obj_size(s), 1, f) == 1;
+  }
+  if (fclose(f) != 0) ok = false;
+  return ok && !s->failed;
+}
+
+size_t extsort_run_count(const extsort_t *s) {
+  assert(s);
+  return s->spilled;
+}
+
+bool extsort_failed(const extsort_t *s) {
+  assert(s);
+  return s->failed;
+}
+
+static bool _extsort_file_iter_has_next(const iter_t *_iter) {
+  extsort_file_iter_t *iter = (extsort_file_iter_t *)_iter;
+  if (iter->pos < iter->len) return true;
+  iter->pos = 0;
+  iter->len = fread(iter->buf, iter->base.obj_size, iter->cap, iter->f);
+  return iter->len > 0;
+}
+
+static void *_extsort_file_iter_next(iter_t *_iter) {
+  extsort_file_iter_t *iter = (extsort_file_iter_t *)_iter;
+  if (!_extsort_file_iter_has_next(_iter)) return NULL;
+  return iter->buf + iter->base.obj_size * iter->pos++;
+}
+
+extsort_file_iter_t *extsort_file_iter_open(const char *path,
+                                            size_t obj_size) {
+  assert(path && obj_size > 0);
+  extsort_file_iter_t *iter =
+      (extsort_file_iter_t *)calloc(1, sizeof(extsort_file_iter_t));
+  if (!iter) return NULL;
+  iter_t base = {.obj_size = obj_size,
+                 .has_next = _extsort_file_iter_has_next,
+                 .next = _extsort_file_iter_next};
+  iter->base = base;
+  iter->cap = EXTSORT_MIN_RUN_BUF / obj_size ? EXTSORT_MIN_RUN_BUF / obj_size
+                                             : 1;
+  iter->buf = (char *)malloc(iter->cap * obj_size);
+  iter->f = fopen(path, "rb");
+  if (!iter->buf || !iter->f) {
+    extsort_file_iter_close(iter);
+    return NULL;
+  }
+  return iter;
+}
+
+bool extsort_file_iter_close(extsort_file_iter_t *iter) {
+  if (!iter) return false;
+  if (iter->f) fclose(iter->f);
+  free(iter->buf);
+  free(iter);
+  return true;
+}
+
+bool extsort_file(const char *in_path, const char *out_path, size_t obj_size,
+                  int (*cmp_fn)(const void *, const void *),
+                  const extsort_cfg_t *cfg) {
+  extsort_file_iter_t *src = extsort_file_iter_open(in_path, obj_size);
+  if (!src) return false;
+  extsort_t *s = extsort_from_iter(&src->base, cmp_fn, cfg);
+  extsort_file_iter_close(src);
+  if (!s) return false;
+  bool ok = extsort_write(s, out_path);
+  extsort_drop(s);
+  return ok;
+}
+
+#endif
@@ -0,0 +1,560 @@
+#ifndef _GBC_FILTER_H
+#define _GBC_FILTER_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gbc_alloc.h"
+#include "gbc_cpu.h"
+
+/// Approximate membership filters. They answer "maybe present" or "surely
+/// absent" from a 64-bit hash of a key, so a miss costs one or two cache
+/// lines instead of a search. A false positive only sends the caller on to
+/// the exact lookup; there are no false negatives.
+///
+///   bloom_t    a blocked Bloom filter: every key sets 8 bits in one 32-byte
+///              block. No deletes
+///   cuckoo_t   a cuckoo filter of 16-bit fingerprints, 4 per bucket, each
+///              key in one of two buckets. Supports deletes of added keys
+///   gbc_filter_t  either of them behind one interface
+
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_BLOCK_BITS (BLOOM_BLOCK_WORDS * 32)
+// about 0.6% false positives, see bloom_new
+#define DEFAULT_BLOOM_BITS_PER_KEY 12
+#define CUCKOO_BUCKET_SLOTS 4
+// the load a cuckoo filter is sized for, in percent of its slots
+#define CUCKOO_LOAD_PERCENT 90
+#define CUCKOO_MAX_KICKS 500
+#define GBC_FILTER_MIN_CAP 64
+
+/// @brief hash the size bytes of key
+typedef uint64_t (*gbc_hash_fn)(const void *key, size_t size);
+
+/// @brief a blocked Bloom filter
+/// @param blocks: nblocks blocks of BLOOM_BLOCK_WORDS uint32_t
+/// @param size_t count: the number of keys added
+/// @param size_t capacity: the number of keys it was sized for
+typedef struct _bloom {
+  uint32_t *blocks;
+  size_t nblocks;
+  size_t count;
+  size_t capacity;
+  const gbc_allocator_t *alloc;
+} bloom_t;
+
+/// @brief a cuckoo filter
+/// @param slots: nbuckets buckets of CUCKOO_BUCKET_SLOTS fingerprints, 0 for
+/// an empty slot
+/// @param size_t nbuckets: a power of two
+/// @param size_t count: the number of fingerprints held, the victim included
+/// @param size_t capacity: CUCKOO_LOAD_PERCENT of the slots
+/// @param victim: a fingerprint the last failed insertion could not place,
+/// it belongs to bucket victim_idx or its alternate
+typedef struct _cuckoo {
+  uint16_t *slots;
+  size_t nbuckets;
+  size_t count;
+  size_t capacity;
+  uint16_t victim;
+  size_t victim_idx;
+  uint64_t rng;
+  const gbc_allocator_t *alloc;
+} cuckoo_t;
+
+typedef enum _gbc_filter_kind {
+  GBC_FILTER_BLOOM = 0,
+  GBC_FILTER_CUCKOO = 1,
+} gbc_filter_kind_t;
+
+/// @brief a Bloom or a cuckoo filter
+typedef struct _gbc_filter {
+  gbc_filter_kind_t kind;
+  union {
+    bloom_t *bloom;
+    cuckoo_t *cuckoo;
+  } u;
+} gbc_filter_t;
+
+/// @brief hash size bytes, a multiply-xorshift mix of 8 bytes at a time
+/// @param key
+/// @param size
+/// @return
+uint64_t gbc_hash_bytes(const void *key, size_t size);
+
+/// @brief create a Bloom filter for expected keys. With bits_per_key 8, 12
+/// and 16 about 3.5%, 0.6% and 0.15% of the absent keys pass
+/// @param expected
+/// @param bits_per_key: 0 for DEFAULT_BLOOM_BITS_PER_KEY
+/// @return
+bloom_t *bloom_new(size_t expected, size_t bits_per_key);
+
+/// @brief create a Bloom filter whose memory comes from alloc
+/// @param expected
+/// @param bits_per_key
+/// @param alloc: NULL for malloc/free
+/// @return
+bloom_t *bloom_new_ex(size_t expected, size_t bits_per_key,
+                      const gbc_allocator_t *alloc);
+
+/// @brief drop the filter out of memory
+/// @param b
+/// @return
+bool bloom_drop(bloom_t *b);
+
+/// @brief add the key of the hash
+/// @param b
+/// @param hash
+/// @return return false once more keys than expected were added, the key is
+/// added anyway but the false positives grow
+bool bloom_add(bloom_t *b, uint64_t hash);
+
+/// @brief check if the key of the hash may have been added
+/// @param b
+/// @param hash
+/// @return return false if it was surely not
+bool bloom_may_contain(const bloom_t *b, uint64_t hash);
+
+/// @brief forget every key
+/// @param b
+void bloom_clear(bloom_t *b);
+
+/// @brief create a cuckoo filter for expected keys. A full one lets about
+/// 0.012% of the absent keys pass, 8 slots checked against 16-bit
+/// fingerprints; the buckets are a power of two, so often it is half full
+/// @param expected
+/// @return
+cuckoo_t *cuckoo_new(size_t expected);
+
+/// @brief create a cuckoo filter whose memory comes from alloc
+/// @param expected
+/// @param alloc: NULL for malloc/free
+/// @return
+cuckoo_t *cuckoo_new_ex(size_t expected, const gbc_allocator_t *alloc);
+
+/// @brief drop the filter out of memory
+/// @param c
+/// @return
+bool cuckoo_drop(cuckoo_t *c);
+
+/// @brief add the key of the hash. Adding a key twice holds it twice
+/// @param c
+/// @param hash
+/// @return return false if the filter is full, the key was not added
+bool cuckoo_add(cuckoo_t *c, uint64_t hash);
+
+/// @brief delete the key of the hash. Only delete keys that were added, a
+/// key sharing the fingerprint and a bucket would be deleted instead
+/// @param c
+/// @param hash
+/// @return return false if no matching fingerprint was found
+bool cuckoo_del(cuckoo_t *c, uint64_t hash);
+
+/// @brief check if the key of the hash may be in the filter
+/// @param c
+/// @param hash
+/// @return return false if it surely is not
+bool cuckoo_may_contain(const cuckoo_t *c, uint64_t hash);
+
+/// @brief forget every key
+/// @param c
+void cuckoo_clear(cuckoo_t *c);
+
+/// @brief create a filter of kind for expected keys, a Bloom filter has
+/// DEFAULT_BLOOM_BITS_PER_KEY
+/// @param kind
+/// @param expected
+/// @param alloc: NULL for malloc/free
+/// @return
+gbc_filter_t *gbc_filter_new(gbc_filter_kind_t kind, size_t expected,
+                             const gbc_allocator_t *alloc);
+
+/// @brief drop the filter out of memory
+/// @param f
+/// @return
+bool gbc_filter_drop(gbc_filter_t *f);
+
+/// @brief add the key of the hash
+/// @param f
+/// @param hash
+/// @return return false if the filter is over its capacity and should be
+/// rebuilt bigger; a cuckoo filter did not add the key then
+bool gbc_filter_add(gbc_filter_t *f, uint64_t hash);
+
+/// @brief delete the key of the hash
+/// @param f
+/// @param hash
+/// @return return false if it could not be deleted, always for a Bloom
+/// filter
+bool gbc_filter_del(gbc_filter_t *f, uint64_t hash);
+
+/// @brief check if the key of the hash may be in the filter
+/// @param f
+/// @param hash
+/// @return
+bool gbc_filter_may_contain(const gbc_filter_t *f, uint64_t hash);
+
+/// @brief the number of keys the filter was sized for
+/// @param f
+/// @return
+size_t gbc_filter_capacity(const gbc_filter_t *f);
+
+/// @brief the bytes held by the filter
+/// @param f
+/// @return
+size_t gbc_filter_memory_usage(const gbc_filter_t *f);
+
+static inline uint64_t gbc_hash_mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+uint64_t gbc_hash_bytes(const void *key, size_t size) {
+  const unsigned char *p = (const unsigned char *)key;
+  uint64_t h = 0x9e3779b97f4a7c15ull ^ (size * 0x100000001b3ull);
+  for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    h = (h ^ gbc_hash_mix(word)) * 0x9e3779b97f4a7c15ull;
+    p += sizeof(uint64_t);
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, p, size);
+  return gbc_hash_mix(h ^ tail);
+}
+
+/// Each of the 8 words of a block gets one bit, picked by the top 5 bits of
+/// the low half of the hash times a per word odd constant; the high half
+/// picks the block
+
+static const uint32_t bloom_salts[BLOOM_BLOCK_WORDS] = {
+    0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+    0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+
+static inline uint32_t *bloom_block(const bloom_t *b, uint64_t hash) {
+  size_t idx = (size_t)(((hash >> 32) * (uint64_t)b->nblocks) >> 32);
+  return b->blocks + idx * BLOOM_BLOCK_WORDS;
+}
+
+static void bloom_block_add_scalar(uint32_t *block, uint32_t key) {
+  for (int i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+    block[i] |= 1u << ((key * bloom_salts[i]) >> 27);
+  }
+}
+
+static bool bloom_block_check_scalar(const uint32_t *block, uint32_t key) {
+  for (int i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+    if (!(block[i] & (1u << ((key * bloom_salts[i]) >> 27)))) return false;
+  }
+  return true;
+}
+
+#ifdef GBC_CPU_X86
+
+GBC_TARGET_AVX2 static inline __m256i bloom_mask_avx2(uint32_t key) {
+  __m256i salts = _mm256_loadu_si256((const __m256i *)bloom_salts);
+  __m256i bits = _mm256_srli_epi32(
+      _mm256_mullo_epi32(_mm256_set1_epi32((int)key), salts), 27);
+  return _mm256_sllv_epi32(_mm256_set1_epi32(1), bits);
+}
+
+GBC_TARGET_AVX2 static void bloom_block_add_avx2(uint32_t *block,
+                                                 uint32_t key) {
+  __m256i words = _mm256_loadu_si256((const __m256i *)block);
+  _mm256_storeu_si256((__m256i *)block,
+                      _mm256_or_si256(words, bloom_mask_avx2(key)));
+}
+
+/// the key passes when the block has every bit of the mask
+GBC_TARGET_AVX2 static bool bloom_block_check_avx2(const uint32_t *block,
+                                                   uint32_t key) {
+  __m256i words = _mm256_loadu_si256((const __m256i *)block);
+  return _mm256_testc_si256(words, bloom_mask_avx2(key));
+}
+
+#define _BLOOM_CALL(fn, ...)                                  \
+  (gbc_cpu_level() >= GBC_CPU_AVX2 ? fn##_avx2(__VA_ARGS__)   \
+                                   : fn##_scalar(__VA_ARGS__))
+
+#else
+
+#define _BLOOM_CALL(fn, ...) fn##_scalar(__VA_ARGS__)
+
+#endif
+
+bloom_t *bloom_new(size_t expected, size_t bits_per_key) {
+  return bloom_new_ex(expected, bits_per_key, NULL);
+}
+
+bloom_t *bloom_new_ex(size_t expected, size_t bits_per_key,
+                      const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  if (bits_per_key == 0) bits_per_key = DEFAULT_BLOOM_BITS_PER_KEY;
+  if (expected == 0) expected = 1;
+  bloom_t *b = (bloom_t *)gbc_alloc(alloc, sizeof(bloom_t));
+  if (!b) return NULL;
+  b->nblocks = (expected * bits_per_key + BLOOM_BLOCK_BITS - 1) /
+               BLOOM_BLOCK_BITS;
+  size_t bytes = b->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint32_t);
+  b->blocks = (uint32_t *)gbc_alloc(alloc, bytes);
+  if (!b->blocks) {
+    gbc_free(alloc, b, sizeof(bloom_t));
+    return NULL;
+  }
+  memset(b->blocks, 0, bytes);
+  b->count = 0;
+  b->capacity = expected;
+  b->alloc = alloc;
+  return b;
+}
+
+bool bloom_drop(bloom_t *b) {
+  if (!b) return false;
+  gbc_free(b->alloc, b->blocks,
+           b->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint32_t));
+  gbc_free(b->alloc, b, sizeof(bloom_t));
+  return true;
+}
+
+bool bloom_add(bloom_t *b, uint64_t hash) {
+  assert(b);
+  _BLOOM_CALL(bloom_block_add, bloom_block(b, hash), (uint32_t)hash);
+  return ++b->count <= b->capacity;
+}
+
+bool bloom_may_contain(const bloom_t *b, uint64_t hash) {
+  assert(b);
+  return _BLOOM_CALL(bloom_block_check, bloom_block(b, hash), (uint32_t)hash);
+}
+
+void bloom_clear(bloom_t *b) {
+  assert(b);
+  memset(b->blocks, 0, b->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint32_t));
+  b->count = 0;
+}
+
+/// A key lives in bucket i1, from the low bits of its hash, or in i1 xor a
+/// hash of its fingerprint, so a fingerprint alone finds its other bucket
+/// when kicked out
+
+static inline uint16_t cuckoo_fingerprint(uint64_t hash) {
+  uint16_t fp = (uint16_t)(hash >> 32);
+  return fp ? fp : 1;
+}
+
+static inline size_t cuckoo_alt(const cuckoo_t *c, size_t i, uint16_t fp) {
+  return (i ^ (size_t)(fp * 0x5bd1e995u)) & (c->nbuckets - 1);
+}
+
+/// @brief check if the bucket holds fp, the 4 slots compared as one word
+static inline bool cuckoo_bucket_has(const cuckoo_t *c, size_t i,
+                                     uint16_t fp) {
+  const uint64_t lanes = 0x0001000100010001ull;
+  uint64_t bucket;
+  memcpy(&bucket, c->slots + i * CUCKOO_BUCKET_SLOTS, sizeof(bucket));
+  // a lane of v is zero where the slot equals fp
+  uint64_t v = bucket ^ (fp * lanes);
+  return ((v - lanes) & ~v & (lanes << 15)) != 0;
+}
+
+static bool cuckoo_bucket_put(cuckoo_t *c, size_t i, uint16_t fp) {
+  uint16_t *bucket = c->slots + i * CUCKOO_BUCKET_SLOTS;
+  for (int s = 0; s < CUCKOO_BUCKET_SLOTS; ++s) {
+    if (bucket[s] == 0) {
+      bucket[s] = fp;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool cuckoo_bucket_take(cuckoo_t *c, size_t i, uint16_t fp) {
+  uint16_t *bucket = c->slots + i * CUCKOO_BUCKET_SLOTS;
+  for (int s = 0; s < CUCKOO_BUCKET_SLOTS; ++s) {
+    if (bucket[s] == fp) {
+      bucket[s] = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+cuckoo_t *cuckoo_new(size_t expected) { return cuckoo_new_ex(expected, NULL); }
+
+cuckoo_t *cuckoo_new_ex(size_t expected, const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  if (expected == 0) expected = 1;
+  cuckoo_t *c = (cuckoo_t *)gbc_alloc(alloc, sizeof(cuckoo_t));
+  if (!c) return NULL;
+  size_t slots = (expected * 100 + CUCKOO_LOAD_PERCENT - 1) /
+                 CUCKOO_LOAD_PERCENT;
+  c->nbuckets = 1;
+  while (c->nbuckets * CUCKOO_BUCKET_SLOTS < slots) c->nbuckets *= 2;
+  size_t bytes = c->nbuckets * CUCKOO_BUCKET_SLOTS * sizeof(uint16_t);
+  c->slots = (uint16_t *)gbc_alloc(alloc, bytes);
+  if (!c->slots) {
+    gbc_free(alloc, c, sizeof(cuckoo_t));
+    return NULL;
+  }
+  memset(c->slots, 0, bytes);
+  c->count = 0;
+  c->capacity = c->nbuckets * CUCKOO_BUCKET_SLOTS * CUCKOO_LOAD_PERCENT / 100;
+  c->victim = 0;
+  c->victim_idx = 0;
+  c->rng = 0x2545f4914f6cdd1dull;
+  c->alloc = alloc;
+  return c;
+}
+
+bool cuckoo_drop(cuckoo_t *c) {
+  if (!c) return false;
+  gbc_free(c->alloc, c->slots,
+           c->nbuckets * CUCKOO_BUCKET_SLOTS * sizeof(uint16_t));
+  gbc_free(c->alloc, c, sizeof(cuckoo_t));
+  return true;
+}
+
+bool cuckoo_add(cuckoo_t *c, uint64_t hash) {
+  assert(c);
+  // with the victim slot taken an eviction chain could lose a fingerprint
+  if (c->victim) return false;
+  uint16_t fp = cuckoo_fingerprint(hash);
+  size_t i = (size_t)hash & (c->nbuckets - 1);
+  if (cuckoo_bucket_put(c, i, fp) ||
+      cuckoo_bucket_put(c, (i = cuckoo_alt(c, i, fp)), fp)) {
+    c->count++;
+    return true;
+  }
+  // kick a random fingerprint of the bucket to its other bucket, and so on
+  for (int kick = 0; kick < CUCKOO_MAX_KICKS; ++kick) {
+    c->rng ^= c->rng << 13;
+    c->rng ^= c->rng >> 7;
+    c->rng ^= c->rng << 17;
+    uint16_t *slot =
+        &c->slots[i * CUCKOO_BUCKET_SLOTS + c->rng % CUCKOO_BUCKET_SLOTS];
+    uint16_t out = *slot;
+    *slot = fp;
+    fp = out;
+    i = cuckoo_alt(c, i, fp);
+    if (cuckoo_bucket_put(c, i, fp)) {
+      c->count++;
+      return true;
+    }
+  }
+  // the key is in, the last fingerprint kicked out waits aside
+  c->victim = fp;
+  c->victim_idx = i;
+  c->count++;
+  return true;
+}
+
+bool cuckoo_del(cuckoo_t *c, uint64_t hash) {
+  assert(c);
+  uint16_t fp = cuckoo_fingerprint(hash);
+  size_t i1 = (size_t)hash & (c->nbuckets - 1), i2 = cuckoo_alt(c, i1, fp);
+  if (cuckoo_bucket_take(c, i1, fp) || cuckoo_bucket_take(c, i2, fp)) {
+    c->count--;
+    // a slot is free now, so the victim may find its way back
+    size_t alt = cuckoo_alt(c, c->victim_idx, c->victim);
+    if (c->victim && (cuckoo_bucket_put(c, c->victim_idx, c->victim) ||
+                      cuckoo_bucket_put(c, alt, c->victim))) {
+      c->victim = 0;
+    }
+    return true;
+  }
+  if (c->victim == fp && (c->victim_idx == i1 || c->victim_idx == i2)) {
+    c->victim = 0;
+    c->count--;
+    return true;
+  }
+  return false;
+}
+
+bool cuckoo_may_contain(const cuckoo_t *c, uint64_t hash) {
+  assert(c);
+  uint16_t fp = cuckoo_fingerprint(hash);
+  size_t i1 = (size_t)hash & (c->nbuckets - 1), i2 = cuckoo_alt(c, i1, fp);
+  return cuckoo_bucket_has(c, i1, fp) || cuckoo_bucket_has(c, i2, fp) ||
+         (c->victim == fp && (c->victim_idx == i1 || c->victim_idx == i2));
+}
+
+void cuckoo_clear(cuckoo_t *c) {
+  assert(c);
+  memset(c->slots, 0, c->nbuckets * CUCKOO_BUCKET_SLOTS * sizeof(uint16_t));
+  c->count = 0;
+  c->victim = 0;
+}
+
+gbc_filter_t *gbc_filter_new(gbc_filter_kind_t kind, size_t expected,
+                             const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  gbc_filter_t *f = (gbc_filter_t *)gbc_alloc(alloc, sizeof(gbc_filter_t));
+  if (!f) return NULL;
+  f->kind = kind;
+  bool ok;
+  if (kind == GBC_FILTER_BLOOM) {
+    ok = (f->u.bloom = bloom_new_ex(expected, 0, alloc)) != NULL;
+  } else {
+    ok = (f->u.cuckoo = cuckoo_new_ex(expected, alloc)) != NULL;
+  }
+  if (!ok) {
+    gbc_free(alloc, f, sizeof(gbc_filter_t));
+    return NULL;
+  }
+  return f;
+}
+
+bool gbc_filter_drop(gbc_filter_t *f) {
+  if (!f) return false;
+  const gbc_allocator_t *alloc;
+  if (f->kind == GBC_FILTER_BLOOM) {
+    alloc = f->u.bloom->alloc;
+    bloom_drop(f->u.bloom);
+  } else {
+    alloc = f->u.cuckoo->alloc;
+    cuckoo_drop(f->u.cuckoo);
+  }
+  gbc_free(alloc, f, sizeof(gbc_filter_t));
+  return true;
+}
+
+bool gbc_filter_add(gbc_filter_t *f, uint64_t hash) {
+  assert(f);
+  if (f->kind == GBC_FILTER_BLOOM) return bloom_add(f->u.bloom, hash);
+  return f->u.cuckoo->count < f->u.cuckoo->capacity &&
+         cuckoo_add(f->u.cuckoo, hash);
+}
+
+bool gbc_filter_del(gbc_filter_t *f, uint64_t hash) {
+  assert(f);
+  return f->kind == GBC_FILTER_CUCKOO && cuckoo_del(f->u.cuckoo, hash);
+}
+
+bool gbc_filter_may_contain(const gbc_filter_t *f, uint64_t hash) {
+  assert(f);
+  if (f->kind == GBC_FILTER_BLOOM) return bloom_may_contain(f->u.bloom, hash);
+  return cuckoo_may_contain(f->u.cuckoo, hash);
+}
+
+size_t gbc_filter_capacity(const gbc_filter_t *f) {
+  assert(f);
+  return f->kind == GBC_FILTER_BLOOM ? f->u.bloom->capacity
+                                     : f->u.cuckoo->capacity;
+}
+
+size_t gbc_filter_memory_usage(const gbc_filter_t *f) {
+  assert(f);
+  if (f->kind == GBC_FILTER_BLOOM) {
+    return sizeof(gbc_filter_t) + sizeof(bloom_t) +
+           f->u.bloom->nblocks * BLOOM_BLOCK_WORDS * sizeof(uint32_t);
+  }
+  return sizeof(gbc_filter_t) + sizeof(cuckoo_t) +
+         f->u.cuckoo->nbuckets * CUCKOO_BUCKET_SLOTS * sizeof(uint16_t);
+}
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef _GBC_HEAP_H
+#define _GBC_HEAP_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gbc_vector.h"
+
+#define DEFAULT_HEAP_ARITY 2
+
+/// @brief The d-ary heap priority queue, elements are stored contiguously in
+/// a vec_t and the smallest element given by cmp_fn is on the top
+/// @param vec_t* vec: the element storage
+/// @param size_t arity: children per node, 2 for a binary heap; 4 keeps all
+/// children of a node in one cache line for small elements
+/// @param cmp_fn: the compare function of the elements
+typedef struct _heap {
+  vec_t *vec;
+  size_t arity;
+  int (*cmp_fn)(const void *, const void *);
+} heap_t;
+
+/// @brief create a new binary heap
+/// @param obj_size: the size of each element
+/// @param cmp_fn: the compare function of the elements
+/// @return
+heap_t *heap_new(size_t obj_size, int (*cmp_fn)(const void *, const void *));
+
+/// @brief create a new d-ary heap
+/// @param obj_size
+/// @param arity: children per node, must be at least 2
+/// @param cmp_fn
+/// @return
+heap_t *heap_new_with_arity(size_t obj_size, size_t arity,
+                            int (*cmp_fn)(const void *, const void *));
+
+/// @brief heapify a vector in O(n) into a binary heap. The heap takes the
+/// ownership of the vector, which is dropped together with the heap
+/// @param vec
+/// @param cmp_fn
+/// @return return NULL if failed, the vector is then left untouched
+heap_t *heap_from_vec(vec_t *vec, int (*cmp_fn)(const void *, const void *));
+
+/// @brief heapify a vector in O(n) into a d-ary heap, see heap_from_vec
+/// @param vec
+/// @param arity
+/// @param cmp_fn
+/// @return
+heap_t *heap_from_vec_with_arity(vec_t *vec, size_t arity,
+                                 int (*cmp_fn)(const void *, const void *));
+
+/// @brief drop the heap out of memory
+/// @param h
+/// @return
+bool heap_drop(heap_t *h);
+
+/// @brief get the number of elements in the heap
+/// @param h
+/// @return
+size_t heap_length(const heap_t *h);
+
+/// @brief check if the heap is empty
+/// @param h
+/// @return
+bool heap_is_empty(const heap_t *h);
+
+/// @brief check the smallest element, NULL if the heap is empty
+/// @param h
+/// @return
+const void *heap_top(const heap_t *h);
+
+/// @brief push an element into the heap
+/// @param h
+/// @param value
+/// @return
+bool heap_push(heap_t *h, const void *value);
+
+/// @brief pop the smallest element out of the heap
+/// @param h
+/// @param out: receives a copy of the popped element, can be NULL
+/// @return return false if the heap is empty
+bool heap_pop(heap_t *h, void *out);
+
+/// @brief push an element and then pop the smallest one, with at most one
+/// sift down. If value is not bigger than the top it comes straight back
+/// @param h
+/// @param value
+/// @param out: receives the popped element, can not be NULL
+/// @return
+bool heap_push_pop(heap_t *h, const void *value, void *out);
+
+/// @brief pop the smallest element and then push value, with one sift down.
+/// Unlike heap_push_pop the popped element can be smaller than value
+/// @param h
+/// @param value
+/// @param out: receives the popped element, can be NULL
+/// @return return false if the heap is empty
+bool heap_replace(heap_t *h, const void *value, void *out);
+
+static inline char *heap_slot(const heap_t *h, size_t idx) {
+  return h->vec->buf + idx * h->vec->obj_size;
+}
+
+/// @brief move the element at idx up until its parent is not bigger
+static void heap_sift_up(heap_t *h, size_t idx) {
+  size_t obj_size = h->vec->obj_size;
+  char tmp[obj_size];
+  memcpy(tmp, heap_slot(h, idx), obj_size);
+  while (idx > 0) {
+    size_t parent = (idx - 1) / h->arity;
+    if (h->cmp_fn(tmp, heap_slot(h, parent)) >= 0) break;
+    memcpy(heap_slot(h, idx), heap_slot(h, parent), obj_size);
+    idx = parent;
+  }
+  memcpy(heap_slot(h, idx), tmp, obj_size);
+}
+
+/// @brief place value into the hole at idx, moving smaller children up
+static void heap_sift_down(heap_t *h, size_t idx, const void *value) {
+  size_t obj_size = h->vec->obj_size;
+  size_t size = h->vec->size;
+  for (;;) {
+    size_t first = idx * h->arity + 1;
+    if (first >= size) break;
+    size_t last = first + h->arity;
+    if (last > size) last = size;
+    size_t best = first;
+    for (size_t c = first + 1; c < last; ++c) {
+      if (h->cmp_fn(heap_slot(h, c), heap_slot(h, best)) < 0) best = c;
+    }
+    if (h->cmp_fn(heap_slot(h, best), value) >= 0) break;
+    memcpy(heap_slot(h, idx), heap_slot(h, best), obj_size);
+    idx = best;
+  }
+  memcpy(heap_slot(h, idx), value, obj_size);
+}
+
+heap_t *heap_new(size_t obj_size, int (*cmp_fn)(const void *, const void *)) {
+  return heap_new_with_arity(obj_size, DEFAULT_HEAP_ARITY, cmp_fn);
+}
+
+heap_t *heap_new_with_arity(size_t obj_size, size_t arity,
+                            int (*cmp_fn)(const void *, const void *)) {
+  assert(arity >= 2 && cmp_fn);
+  vec_t *vec = vec_new(obj_size);
+  if (!vec) return NULL;
+  heap_t *h = (heap_t *)malloc(sizeof(heap_t));
+  if (!h) {
+    vec_drop(vec);
+    return NULL;
+  }
+  h->vec = vec;
+  h->arity = arity;
+  h->cmp_fn = cmp_fn;
+  return h;
+}
+
+heap_t *heap_from_vec(vec_t *vec, int (*cmp_fn)(const void *, const void *)) {
+  return heap_from_vec_with_arity(vec, DEFAULT_HEAP_ARITY, cmp_fn);
+}
+
+heap_t *heap_from_vec_with_arity(vec_t *vec, size_t arity,
+                                 int (*cmp_fn)(const void *, const void *)) {
+  assert(vec && arity >= 2 && cmp_fn);
+  heap_t *h = (heap_t *)malloc(sizeof(heap_t));
+  if (!h) return NULL;
+  h->vec = vec;
+  h->arity = arity;
+  h->cmp_fn = cmp_fn;
+  if (vec->size < 2) return h;
+  char tmp[vec->obj_size];
+  size_t idx = (vec->size - 2) / arity + 1;
+  while (idx-- > 0) {
+    memcpy(tmp, heap_slot(h, idx), vec->obj_size);
+    heap_sift_down(h, idx, tmp);
+  }
+  return h;
+}
+
+bool heap_drop(heap_t *h) {
+  if (!h) return false;
+  vec_drop(h->vec);
+  h->vec = NULL;
+  free(h);
+  return true;
+}
+
+size_t heap_length(const heap_t *h) {
+  assert(h);
+  return h->vec->size;
+}
+
+bool heap_is_empty(const heap_t *h) {
+  assert(h);
+  return h->vec->size == 0;
+}
+
+const void *heap_top(const heap_t *h) {
+  assert(h);
+  if (h->vec->size == 0) return NULL;
+  return heap_slot(h, 0);
+}
+
+bool heap_push(heap_t *h, const void *value) {
+  assert(h && value);
+  if (!vec_push(h->vec, value)) return false;
+  heap_sift_up(h, h->vec->size - 1);
+  return true;
+}
+
+bool heap_pop(heap_t *h, void *out) {
+  assert(h);
+  if (h->vec->size == 0) return false;
+  if (out) memcpy(out, heap_slot(h, 0), h->vec->obj_size);
+  h->vec->size--;
+  if (h->vec->size > 0) {
+    heap_sift_down(h, 0, heap_slot(h, h->vec->size));
+  }
+  return true;
+}
+
+bool heap_push_pop(heap_t *h, const void *value, void *out) {
+  assert(h && value && out);
+  if (h->vec->size == 0 || h->cmp_fn(value, heap_slot(h, 0)) <= 0) {
+    memcpy(out, value, h->vec->obj_size);
+    return true;
+  }
+  // value may alias out, keep a copy before the top is written out
+  char tmp[h->vec->obj_size];
+  memcpy(tmp, value, h->vec->obj_size);
+  memcpy(out, heap_slot(h, 0), h->vec->obj_size);
+  heap_sift_down(h, 0, tmp);
+  return true;
+}
+
+bool heap_replace(heap_t *h, const void *value, void *out) {
+  assert(h && value);
+  if (h->vec->size == 0) return false;
+  char tmp[h->vec->obj_size];
+  memcpy(tmp, value, h->vec->obj_size);
+  if (out) memcpy(out, heap_slot(h, 0), h->vec->obj_size);
+  heap_sift_down(h, 0, tmp);
+  return true;
+}
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef _GBC_IPQ_H
+#define _GBC_IPQ_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gbc_vector.h"
+
+#define DEFAULT_IPQ_CAP 8
+#define IPQ_NO_POS ((size_t)-1)
+
+/// @brief the stable handle of an entry in the ipq_t, valid from ipq_push
+/// until the entry is popped or removed. Handles are reused afterwards
+typedef size_t ipq_handle_t;
+
+/// @brief indexed binary heap priority queue. The heap orders handles, keys
+/// live in a slot per handle and pos maps every handle back to its heap
+/// position, so an entry can be updated or removed in O(log n). Freed handles
+/// are recycled, so no allocation happens once the queue reached its peak size
+/// @param vec_t* heap: vec_t<ipq_handle_t> ordered by key
+/// @param vec_t* keys: vec_t<key> indexed by handle
+/// @param vec_t* pos: vec_t<size_t> heap position of a handle, IPQ_NO_POS when
+/// the handle is free
+/// @param vec_t* free_handles: vec_t<ipq_handle_t> handles ready for reuse
+/// @param cmp_fn: the compare function of the keys
+typedef struct _ipq {
+  vec_t *heap;
+  vec_t *keys;
+  vec_t *pos;
+  vec_t *free_handles;
+  int (*cmp_fn)(const void *, const void *);
+} ipq_t;
+
+/// @brief create a new ipq_t
+/// @param key_obj_size: the size of each key
+/// @param cmp_fn: the compare function of the keys
+/// @return
+ipq_t *ipq_new(size_t key_obj_size, int (*cmp_fn)(const void *, const void *));
+
+/// @brief create a new ipq_t able to hold cap entries without allocating
+/// @param key_obj_size
+/// @param cap
+/// @param cmp_fn
+/// @return
+ipq_t *ipq_new_with_cap(size_t key_obj_size, size_t cap,
+                        int (*cmp_fn)(const void *, const void *));
+
+/// @brief drop the ipq_t out of memory
+/// @param q
+/// @return
+bool ipq_drop(ipq_t *q);
+
+/// @brief get the number of entries in the queue
+/// @param q
+/// @return
+size_t ipq_length(const ipq_t *q);
+
+/// @brief check if the queue is empty
+/// @param q
+/// @return
+bool ipq_is_empty(const ipq_t *q);
+
+/// @brief check if the handle refers to an entry in the queue
+/// @param q
+/// @param handle
+/// @return
+bool ipq_contains(const ipq_t *q, ipq_handle_t handle);
+
+/// @brief get the key of an entry, NULL if the handle is not in the queue
+/// @param q
+/// @param handle
+/// @return
+const void *ipq_key(const ipq_t *q, ipq_handle_t handle);
+
+/// @brief push a key into the queue
+/// @param q
+/// @param key
+/// @param out_handle: receives the handle of the new entry, can be NULL
+/// @return
+bool ipq_push(ipq_t *q, const void *key, ipq_handle_t *out_handle);
+
+/// @brief check the smallest key, NULL if the queue is empty
+/// @param q
+/// @param out_handle: receives the handle of the top entry, can be NULL
+/// @return
+const void *ipq_top(const ipq_t *q, ipq_handle_t *out_handle);
+
+/// @brief pop the entry with the smallest key, its handle becomes free
+/// @param q
+/// @param out_key: receives a copy of the key, can be NULL
+/// @param out_handle: receives the handle, can be NULL
+/// @return return false if the queue is empty
+bool ipq_pop(ipq_t *q, void *out_key, ipq_handle_t *out_handle);
+
+/// @brief lower the key of an entry
+/// @param q
+/// @param handle
+/// @param key
+/// @return return false if the handle is not in the queue or if key is bigger
+/// than the current key
+bool ipq_decrease_key(ipq_t *q, ipq_handle_t handle, const void *key);
+
+/// @brief change the key of an entry in either direction
+/// @param q
+/// @param handle
+/// @param key
+/// @return return false if the handle is not in the queue
+bool ipq_update(ipq_t *q, ipq_handle_t handle, const void *key);
+
+/// @brief remove an entry from the queue, its handle becomes free
+/// @param q
+/// @param handle
+/// @return return false if the handle is not in the queue
+bool ipq_remove(ipq_t *q, ipq_handle_t handle);
+
+static inline ipq_handle_t *ipq_heap_buf(const ipq_t *q) {
+  return (ipq_handle_t *)q->heap->buf;
+}
+
+static inline size_t *ipq_pos_buf(const ipq_t *q) {
+  return (size_t *)q->pos->buf;
+}
+
+static inline const char *ipq_key_of(const ipq_t *q, ipq_handle_t handle) {
+  return q->keys->buf + handle * q->keys->obj_size;
+}
+
+static void ipq_sift_up(ipq_t *q, size_t idx) {
+  ipq_handle_t *heap = ipq_heap_buf(q);
+  size_t *pos = ipq_pos_buf(q);
+  ipq_handle_t handle = heap[idx];
+  const char *key = ipq_key_of(q, handle);
+  while (idx > 0) {
+    size_t parent = (idx - 1) / 2;
+    if (q->cmp_fn(key, ipq_key_of(q, heap[parent])) >= 0) break;
+    heap[idx] = heap[parent];
+    pos[heap[idx]] = idx;
+    idx = parent;
+  }
+  heap[idx] = handle;
+  pos[handle] = idx;
+}
+
+static void ipq_sift_down(ipq_t *q, size_t idx) {
+  ipq_handle_t *heap = ipq_heap_buf(q);
+  size_t *pos = ipq_pos_buf(q);
+  size_t size = q->heap->size;
+  ipq_handle_t handle = heap[idx];
+  const char *key = ipq_key_of(q, handle);
+  for (;;) {
+    size_t child = idx * 2 + 1;
+    if (child >= size) break;
+    if (child + 1 < size && q->cmp_fn(ipq_key_of(q, heap[child + 1]),
+                                      ipq_key_of(q, heap[child])) < 0) {
+      child++;
+    }
+    if (q->cmp_fn(ipq_key_of(q, heap[child]), key) >= 0) break;
+    heap[idx] = heap[child];
+    pos[heap[idx]] = idx;
+    idx = child;
+  }
+  heap[idx] = handle;
+  pos[handle] = idx;
+}
+
+/// @brief take the entry at heap position idx out and free its handle
+static void ipq_remove_at(ipq_t *q, size_t idx) {
+  ipq_handle_t *heap = ipq_heap_buf(q);
+  size_t *pos = ipq_pos_buf(q);
+  ipq_handle_t handle = heap[idx];
+  size_t last = q->heap->size - 1;
+  q->heap->size--;
+  if (idx != last) {
+    heap[idx] = heap[last];
+    pos[heap[idx]] = idx;
+    if (idx > 0 && q->cmp_fn(ipq_key_of(q, heap[idx]),
+                             ipq_key_of(q, heap[(idx - 1) / 2])) < 0) {
+      ipq_sift_up(q, idx);
+    } else {
+      ipq_sift_down(q, idx);
+    }
+  }
+  pos[handle] = IPQ_NO_POS;
+  // ipq_push reserves a free_handles slot for every handle it makes
+  bool pushed = vec_push(q->free_handles, &handle);
+  assert(pushed);
+  (void)pushed;
+}
+
+ipq_t *ipq_new(size_t key_obj_size, int (*cmp_fn)(const void *, const void *)) {
+  return ipq_new_with_cap(key_obj_size, DEFAULT_IPQ_CAP, cmp_fn);
+}
+
+ipq_t *ipq_new_with_cap(size_t key_obj_size, size_t cap,
+                        int (*cmp_fn)(const void *, const void *)) {
+  assert(cmp_fn);
+  if (cap == 0) cap = DEFAULT_IPQ_CAP;
+  ipq_t *q = (ipq_t *)malloc(sizeof(ipq_t));
+  if (!q) return NULL;
+  q->heap = vec_new_with_cap(sizeof(ipq_handle_t), cap);
+  q->keys = vec_new_with_cap(key_obj_size, cap);
+  q->pos = vec_new_with_cap(sizeof(size_t), cap);
+  q->free_handles = vec_new_with_cap(sizeof(ipq_handle_t), cap);
+  q->cmp_fn = cmp_fn;
+  if (!q->heap || !q->keys || !q->pos || !q->free_handles) {
+    ipq_drop(q);
+    return NULL;
+  }
+  return q;
+}
+
+bool ipq_drop(ipq_t *q) {
+  if (!q) return false;
+  if (q->heap) vec_drop(q->heap);
+  if (q->keys) vec_drop(q->keys);
+  if (q->pos) vec_drop(q->pos);
+  if (q->free_handles) vec_drop(q->free_handles);
+  free(q);
+  return true;
+}
+
+size_t ipq_length(const ipq_t *q) {
+  assert(q);
+  return q->heap->size;
+}
+
+bool ipq_is_empty(const ipq_t *q) {
+  assert(q);
+  return q->heap->size == 0;
+}
+
+bool ipq_contains(const ipq_t *q, ipq_handle_t handle) {
+  assert(q);
+  return handle < q->pos->size && ipq_pos_buf(q)[handle] != IPQ_NO_POS;
+}
+
+const void *ipq_key(const ipq_t *q, ipq_handle_t handle) {
+  if (!ipq_contains(q, handle)) return NULL;
+  return ipq_key_of(q, handle);
+}
+
+bool ipq_push(ipq_t *q, const void *key, ipq_handle_t *out_handle) {
+  assert(q && key);
+  ipq_handle_t handle;
+  if (q->free_handles->size > 0) {
+    handle = *(ipq_handle_t *)vec_top(q->free_handles);
+    vec_del_top(q->free_handles);
+    vec_update(q->keys, handle, key);
+  } else {
+    handle = q->keys->size;
+    size_t no_pos = IPQ_NO_POS;
+    // room to give every handle back, so the pushes to free_handles in
+    // ipq_remove_at and below can not fail
+    if (q->free_handles->cap <= handle &&
+        !vec_enlarge(q->free_handles, vec_grown_cap(q->free_handles))) {
+      return false;
+    }
+    if (!vec_push(q->keys, key)) return false;
+    if (!vec_push(q->pos, &no_pos)) {
+      vec_del_top(q->keys);
+      return false;
+    }
+  }
+  if (!vec_push(q->heap, &handle)) {
+    bool pushed = vec_push(q->free_handles, &handle);
+    assert(pushed);
+    (void)pushed;
+    return false;
+  }
+  ipq_sift_up(q, q->heap->size - 1);
+  if (out_handle) *out_handle = handle;
+  return true;
+}
+
+const void *ipq_top(const ipq_t *q, ipq_handle_t *out_handle) {
+  assert(q);
+  if (q->heap->size == 0) return NULL;
+  ipq_handle_t handle = ipq_heap_buf(q)[0];
+  if (out_handle) *out_handle = handle;
+  return ipq_key_of(q, handle);
+}
+
+bool ipq_pop(ipq_t *q, void *out_key, ipq_handle_t *out_handle) {
+  assert(q);
+  if (q->heap->size == 0) return false;
+  ipq_handle_t handle = ipq_heap_buf(q)[0];
+  if (out_key) memcpy(out_key, ipq_key_of(q, handle), q->keys->obj_size);
+  if (out_handle) *out_handle = handle;
+  ipq_remove_at(q, 0);
+  return true;
+}
+
+bool ipq_decrease_key(ipq_t *q, ipq_handle_t handle, const void *key) {
+  assert(q && key);
+  if (!ipq_contains(q, handle)) return false;
+  if (q->cmp_fn(key, ipq_key_of(q, handle)) > 0) return false;
+  vec_update(q->keys, handle, key);
+  ipq_sift_up(q, ipq_pos_buf(q)[handle]);
+  return true;
+}
+
+bool ipq_update(ipq_t *q, ipq_handle_t handle, const void *key) {
+  assert(q && key);
+  if (!ipq_contains(q, handle)) return false;
+  int order = q->cmp_fn(key, ipq_key_of(q, handle));
+  vec_update(q->keys, handle, key);
+  if (order < 0)
+    ipq_sift_up(q, ipq_pos_buf(q)[handle]);
+  else if (order > 0)
+    ipq_sift_down(q, ipq_pos_buf(q)[handle]);
+  return true;
+}
+
+bool ipq_remove(ipq_t *q, ipq_handle_t handle) {
+  assert(q);
+  if (!ipq_contains(q, handle)) return false;
+  ipq_remove_at(q, ipq_pos_buf(q)[handle]);
+  return true;
+}
+
+#endif
@@ -1,15 +1,472 @@
 #ifndef _GBC_ITER_H
 #define _GBC_ITER_H
+#include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
+// the number of pointers a caller of iter_next_batch usually provides
+#define ITER_BATCH_MAX 256
+
 /// @brief The base struct of iterator
 typedef struct _iter iter_t;
 
+/// @brief a batch of elements pulled in one call. Either span points to len
+/// contiguous elements, or span is NULL and the caller's ptrs array holds len
+/// element pointers
+/// @param span: the contiguous elements, NULL when ptrs is filled
+/// @param ptrs: provided by the caller, room for max pointers
+/// @param len: the number of elements in the batch
+typedef struct _iter_batch {
+  char *span;
+  void **ptrs;
+  size_t len;
+} iter_batch_t;
+
+/// @brief next_batch is optional, NULL when the iterator does not provide
+/// it. It returns up to max elements in batch, 0 at the end, and advances the
+/// iterator past them. The elements stay valid until the next call of next or
+/// next_batch, so only iterators whose element pointers outlive a call of next
+/// can hand out more than one
 typedef struct _iter {
   size_t obj_size;
   bool (*has_next)(const iter_t *);
   void *(*next)(iter_t *iter);
+  size_t (*next_batch)(iter_t *iter, iter_batch_t *batch, size_t max);
 } iter_t;
 
-#endif
\ No newline at end of file
+/// @brief pull up to max elements in one call. Two indirect calls per element
+/// become one per batch, and spans can be copied whole. An iterator without
+/// next_batch may reuse one buffer for every element, so the fallback returns
+/// a single element in batch->ptrs
+/// @param iter
+/// @param batch: its ptrs must have room for max pointers
+/// @param max
+/// @return the number of elements in the batch, 0 at the end
+size_t iter_next_batch(iter_t *iter, iter_batch_t *batch, size_t max);
+
+/// @brief the i-th element of a batch
+static inline void *iter_batch_at(const iter_batch_t *batch, size_t i,
+                                  size_t obj_size) {
+  return batch->span ? batch->span + i * obj_size : batch->ptrs[i];
+}
+
+/// The adapters below are lazy: each one lives in a struct provided by the
+/// caller, usually on the stack, wraps another iter_t and pulls from it only
+/// when it is asked for an element, so a pipeline such as
+///
+///   iter_filter_t f;
+///   iter_take_t t;
+///   iter_t *it = iter_take(&t, iter_filter(&f, src, is_odd, NULL), 10);
+///
+/// streams in one pass and allocates nothing. An adapter must not outlive
+/// the iterators it wraps, and the element pointers it yields are valid
+/// until the next call of next, as for the container iterators
+
+/// @brief writes the mapped value of in to out
+typedef void (*iter_map_fn)(void *out, const void *in, void *ctx);
+
+/// @brief returns true to keep the element
+typedef bool (*iter_pred_fn)(const void *elem, void *ctx);
+
+/// @brief folds elem into acc
+typedef void (*iter_fold_fn)(void *acc, const void *elem, void *ctx);
+
+/// @brief the adapter of iter_map, out holds the current mapped value
+typedef struct _iter_map {
+  iter_t base;
+  iter_t *src;
+  void *out;
+  iter_map_fn fn;
+  void *ctx;
+} iter_map_t;
+
+/// @brief the adapter of iter_filter, pending is the next kept element
+typedef struct _iter_filter {
+  iter_t base;
+  iter_t *src;
+  iter_pred_fn pred;
+  void *ctx;
+  void *pending;
+  bool ready;
+} iter_filter_t;
+
+/// @brief the adapter of iter_take
+typedef struct _iter_take {
+  iter_t base;
+  iter_t *src;
+  size_t left;
+} iter_take_t;
+
+/// @brief the adapter of iter_skip, the elements are skipped on first use
+typedef struct _iter_skip {
+  iter_t base;
+  iter_t *src;
+  size_t skip;
+} iter_skip_t;
+
+/// @brief the element yielded by iter_zip
+typedef struct _iter_pair {
+  void *first;
+  void *second;
+} iter_pair_t;
+
+/// @brief the adapter of iter_zip
+typedef struct _iter_zip {
+  iter_t base;
+  iter_t *a;
+  iter_t *b;
+  iter_pair_t pair;
+} iter_zip_t;
+
+/// @brief the adapter of iter_chain
+typedef struct _iter_chain {
+  iter_t base;
+  iter_t *a;
+  iter_t *b;
+} iter_chain_t;
+
+/// @brief the element yielded by iter_enumerate
+typedef struct _iter_enum {
+  size_t idx;
+  void *value;
+} iter_enum_t;
+
+/// @brief the adapter of iter_enumerate
+typedef struct _iter_enumerate {
+  iter_t base;
+  iter_t *src;
+  size_t next_idx;
+  iter_enum_t cur;
+} iter_enumerate_t;
+
+/// @brief map every element of src with fn into the caller's buffer out
+/// @param it: the adapter to set up
+/// @param src
+/// @param obj_size: the size of the mapped elements, the size of out
+/// @param out: the buffer fn writes, the adapter yields it
+/// @param fn
+/// @param ctx: passed to fn
+/// @return the adapter as an iter_t
+iter_t *iter_map(iter_map_t *it, iter_t *src, size_t obj_size, void *out,
+                 iter_map_fn fn, void *ctx);
+
+/// @brief keep the elements of src for which pred returns true
+/// @param it: the adapter to set up
+/// @param src
+/// @param pred
+/// @param ctx: passed to pred
+/// @return the adapter as an iter_t
+iter_t *iter_filter(iter_filter_t *it, iter_t *src, iter_pred_fn pred,
+                    void *ctx);
+
+/// @brief yield at most n elements of src
+/// @param it: the adapter to set up
+/// @param src
+/// @param n
+/// @return the adapter as an iter_t
+iter_t *iter_take(iter_take_t *it, iter_t *src, size_t n);
+
+/// @brief drop the first n elements of src
+/// @param it: the adapter to set up
+/// @param src
+/// @param n
+/// @return the adapter as an iter_t
+iter_t *iter_skip(iter_skip_t *it, iter_t *src, size_t n);
+
+/// @brief yield an iter_pair_t of the elements of a and b, stopping with the
+/// shorter one
+/// @param it: the adapter to set up
+/// @param a
+/// @param b
+/// @return the adapter as an iter_t
+iter_t *iter_zip(iter_zip_t *it, iter_t *a, iter_t *b);
+
+/// @brief yield the elements of a, then those of b. Both must have the same
+/// obj_size
+/// @param it: the adapter to set up
+/// @param a
+/// @param b
+/// @return the adapter as an iter_t
+iter_t *iter_chain(iter_chain_t *it, iter_t *a, iter_t *b);
+
+/// @brief yield an iter_enum_t of the index and the element of src
+/// @param it: the adapter to set up
+/// @param src
+/// @return the adapter as an iter_t
+iter_t *iter_enumerate(iter_enumerate_t *it, iter_t *src);
+
+/// @brief fold all the remaining elements of iter into acc
+/// @param iter
+/// @param acc
+/// @param fn
+/// @param ctx: passed to fn
+void iter_fold(iter_t *iter, void *acc, iter_fold_fn fn, void *ctx);
+
+/// @brief consume iter and count its remaining elements
+/// @param iter
+/// @return
+size_t iter_count(iter_t *iter);
+
+size_t iter_next_batch(iter_t *iter, iter_batch_t *batch, size_t max) {
+  assert(iter && batch);
+  if (iter->next_batch) return iter->next_batch(iter, batch, max);
+  assert(batch->ptrs || max == 0);
+  batch->span = NULL;
+  batch->len = 0;
+  if (max > 0 && iter->has_next(iter)) {
+    batch->ptrs[batch->len++] = iter->next(iter);
+  }
+  return batch->len;
+}
+
+static bool _iter_map_has_next(const iter_t *_iter) {
+  const iter_map_t *it = (const iter_map_t *)_iter;
+  return it->src->has_next(it->src);
+}
+
+static void *_iter_map_next(iter_t *_iter) {
+  iter_map_t *it = (iter_map_t *)_iter;
+  if (!it->src->has_next(it->src)) return NULL;
+  it->fn(it->out, it->src->next(it->src), it->ctx);
+  return it->out;
+}
+
+iter_t *iter_map(iter_map_t *it, iter_t *src, size_t obj_size, void *out,
+                 iter_map_fn fn, void *ctx) {
+  assert(it && src && out && fn);
+  iter_t base = {.obj_size = obj_size,
+                 .has_next = _iter_map_has_next,
+                 .next = _iter_map_next};
+  it->base = base;
+  it->src = src;
+  it->out = out;
+  it->fn = fn;
+  it->ctx = ctx;
+  return &it->base;
+}
+
+/// has_next has to look ahead for a kept element, so it updates the adapter
+/// through the const pointer, which always points to a caller's struct
+static bool _iter_filter_has_next(const iter_t *_iter) {
+  iter_filter_t *it = (iter_filter_t *)_iter;
+  while (!it->ready && it->src->has_next(it->src)) {
+    void *elem = it->src->next(it->src);
+    if (it->pred(elem, it->ctx)) {
+      it->pending = elem;
+      it->ready = true;
+    }
+  }
+  return it->ready;
+}
+
+static void *_iter_filter_next(iter_t *_iter) {
+  iter_filter_t *it = (iter_filter_t *)_iter;
+  if (!_iter_filter_has_next(_iter)) return NULL;
+  it->ready = false;
+  return it->pending;
+}
+
+/// keeps the matches of a source batch as pointers into it, which stay valid
+/// for as long as the source batch does
+static size_t _iter_filter_next_batch(iter_t *_iter, iter_batch_t *batch,
+                                      size_t max) {
+  iter_filter_t *it = (iter_filter_t *)_iter;
+  assert(batch->ptrs || max == 0);
+  if (max == 0) return batch->len = 0;
+  if (it->ready) {
+    // has_next already pulled the next kept element
+    it->ready = false;
+    batch->span = NULL;
+    batch->ptrs[0] = it->pending;
+    return batch->len = 1;
+  }
+  while (iter_next_batch(it->src, batch, max) > 0) {
+    size_t kept = 0;
+    for (size_t i = 0; i < batch->len; ++i) {
+      void *elem = iter_batch_at(batch, i, it->src->obj_size);
+      if (it->pred(elem, it->ctx)) batch->ptrs[kept++] = elem;
+    }
+    batch->span = NULL;
+    batch->len = kept;
+    if (kept > 0) return kept;
+  }
+  return 0;
+}
+
+iter_t *iter_filter(iter_filter_t *it, iter_t *src, iter_pred_fn pred,
+                    void *ctx) {
+  assert(it && src && pred);
+  iter_t base = {.obj_size = src->obj_size,
+                 .has_next = _iter_filter_has_next,
+                 .next = _iter_filter_next,
+                 .next_batch = _iter_filter_next_batch};
+  it->base = base;
+  it->src = src;
+  it->pred = pred;
+  it->ctx = ctx;
+  it->pending = NULL;
+  it->ready = false;
+  return &it->base;
+}
+
+static bool _iter_take_has_next(const iter_t *_iter) {
+  const iter_take_t *it = (const iter_take_t *)_iter;
+  return it->left > 0 && it->src->has_next(it->src);
+}
+
+static void *_iter_take_next(iter_t *_iter) {
+  iter_take_t *it = (iter_take_t *)_iter;
+  if (!_iter_take_has_next(_iter)) return NULL;
+  it->left--;
+  return it->src->next(it->src);
+}
+
+static size_t _iter_take_next_batch(iter_t *_iter, iter_batch_t *batch,
+                                    size_t max) {
+  iter_take_t *it = (iter_take_t *)_iter;
+  size_t n = iter_next_batch(it->src, batch, max < it->left ? max : it->left);
+  it->left -= n;
+  return n;
+}
+
+iter_t *iter_take(iter_take_t *it, iter_t *src, size_t n) {
+  assert(it && src);
+  iter_t base = {.obj_size = src->obj_size,
+                 .has_next = _iter_take_has_next,
+                 .next = _iter_take_next,
+                 .next_batch = _iter_take_next_batch};
+  it->base = base;
+  it->src = src;
+  it->left = n;
+  return &it->base;
+}
+
+static bool _iter_skip_has_next(const iter_t *_iter) {
+  iter_skip_t *it = (iter_skip_t *)_iter;
+  for (; it->skip > 0 && it->src->has_next(it->src); it->skip--) {
+    it->src->next(it->src);
+  }
+  return it->src->has_next(it->src);
+}
+
+static void *_iter_skip_next(iter_t *_iter) {
+  iter_skip_t *it = (iter_skip_t *)_iter;
+  if (!_iter_skip_has_next(_iter)) return NULL;
+  return it->src->next(it->src);
+}
+
+static size_t _iter_skip_next_batch(iter_t *_iter, iter_batch_t *batch,
+                                    size_t max) {
+  iter_skip_t *it = (iter_skip_t *)_iter;
+  _iter_skip_has_next(_iter);
+  return iter_next_batch(it->src, batch, max);
+}
+
+iter_t *iter_skip(iter_skip_t *it, iter_t *src, size_t n) {
+  assert(it && src);
+  iter_t base = {.obj_size = src->obj_size,
+                 .has_next = _iter_skip_has_next,
+                 .next = _iter_skip_next,
+                 .next_batch = _iter_skip_next_batch};
+  it->base = base;
+  it->src = src;
+  it->skip = n;
+  return &it->base;
+}
+
+static bool _iter_zip_has_next(const iter_t *_iter) {
+  const iter_zip_t *it = (const iter_zip_t *)_iter;
+  return it->a->has_next(it->a) && it->b->has_next(it->b);
+}
+
+static void *_iter_zip_next(iter_t *_iter) {
+  iter_zip_t *it = (iter_zip_t *)_iter;
+  if (!_iter_zip_has_next(_iter)) return NULL;
+  it->pair.first = it->a->next(it->a);
+  it->pair.second = it->b->next(it->b);
+  return &it->pair;
+}
+
+iter_t *iter_zip(iter_zip_t *it, iter_t *a, iter_t *b) {
+  assert(it && a && b);
+  iter_t base = {.obj_size = sizeof(iter_pair_t),
+                 .has_next = _iter_zip_has_next,
+                 .next = _iter_zip_next};
+  it->base = base;
+  it->a = a;
+  it->b = b;
+  it->pair.first = NULL;
+  it->pair.second = NULL;
+  return &it->base;
+}
+
+static bool _iter_chain_has_next(const iter_t *_iter) {
+  const iter_chain_t *it = (const iter_chain_t *)_iter;
+  return it->a->has_next(it->a) || it->b->has_next(it->b);
+}
+
+static void *_iter_chain_next(iter_t *_iter) {
+  iter_chain_t *it = (iter_chain_t *)_iter;
+  if (it->a->has_next(it->a)) return it->a->next(it->a);
+  if (it->b->has_next(it->b)) return it->b->next(it->b);
+  return NULL;
+}
+
+static size_t _iter_chain_next_batch(iter_t *_iter, iter_batch_t *batch,
+                                     size_t max) {
+  iter_chain_t *it = (iter_chain_t *)_iter;
+  size_t n = iter_next_batch(it->a, batch, max);
+  return n > 0 ? n : iter_next_batch(it->b, batch, max);
+}
+
+iter_t *iter_chain(iter_chain_t *it, iter_t *a, iter_t *b) {
+  assert(it && a && b && a->obj_size == b->obj_size);
+  iter_t base = {.obj_size = a->obj_size,
+                 .has_next = _iter_chain_has_next,
+                 .next = _iter_chain_next,
+                 .next_batch = _iter_chain_next_batch};
+  it->base = base;
+  it->a = a;
+  it->b = b;
+  return &it->base;
+}
+
+static bool _iter_enumerate_has_next(const iter_t *_iter) {
+  const iter_enumerate_t *it = (const iter_enumerate_t *)_iter;
+  return it->src->has_next(it->src);
+}
+
+static void *_iter_enumerate_next(iter_t *_iter) {
+  iter_enumerate_t *it = (iter_enumerate_t *)_iter;
+  if (!it->src->has_next(it->src)) return NULL;
+  it->cur.idx = it->next_idx++;
+  it->cur.value = it->src->next(it->src);
+  return &it->cur;
+}
+
+iter_t *iter_enumerate(iter_enumerate_t *it, iter_t *src) {
+  assert(it && src);
+  iter_t base = {.obj_size = sizeof(iter_enum_t),
+                 .has_next = _iter_enumerate_has_next,
+                 .next = _iter_enumerate_next};
+  it->base = base;
+  it->src = src;
+  it->next_idx = 0;
+  it->cur.idx = 0;
+  it->cur.value = NULL;
+  return &it->base;
+}
+
+void iter_fold(iter_t *iter, void *acc, iter_fold_fn fn, void *ctx) {
+  assert(iter && fn);
+  while (iter->has_next(iter)) fn(acc, iter->next(iter), ctx);
+}
+
+size_t iter_count(iter_t *iter) {
+  assert(iter);
+  size_t n = 0;
+  for (; iter->has_next(iter); ++n) iter->next(iter);
+  return n;
+}
+
+#endif
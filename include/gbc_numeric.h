@@ -0,0 +1,678 @@
+#ifndef _GBC_NUMERIC_H
+#define _GBC_NUMERIC_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gbc_cpu.h"
+#include "gbc_vector.h"
+#include "gbc_vector_simd.h"
+
+#ifdef GBC_THREADS
+#include <pthread.h>
+#endif
+
+/// Typed numeric kernels over vectors of float, double, int32_t and int64_t,
+/// the vector's obj_size being the size of the type. They run on AVX2 when
+/// the CPU has it and on a scalar loop elsewhere, see gbc_cpu.h.
+///
+///   vec_sum_f32(vec)                 the sum of the elements
+///   vec_min_f32(vec, &min, &idx)     the smallest element and its first
+///   vec_max_f32(vec, &max, &idx)     index, likewise the largest
+///   vec_dot_f32(a, b)                the dot product of two vectors
+///   vec_prefix_sum_f32(vec)          the inclusive prefix sum, in place
+///   vec_axpy_f32(alpha, x, y)        y[i] += alpha * x[i]
+///
+/// and the same for f64, i32 and i64. The sums of i32 are int64_t, integer
+/// arithmetic wraps around on overflow. Floats are summed in several
+/// partial sums, so their results may differ from a serial loop in the last
+/// bits, and a vector holding NaN has no meaningful min or max.
+///
+/// When GBC_THREADS is defined before including any GBC header, inputs of at
+/// least GBC_NUMERIC_PAR_MIN elements are split over up to the threads set by
+/// gbc_numeric_set_threads, one by default, each thread taking at least
+/// GBC_NUMERIC_PAR_MIN elements; link with -pthread then
+
+#ifndef GBC_NUMERIC_PAR_MIN
+#define GBC_NUMERIC_PAR_MIN (1 << 18)
+#endif
+#define GBC_NUMERIC_MAX_THREADS 64
+
+/// @brief set the number of threads used for large inputs, between 1 and
+/// GBC_NUMERIC_MAX_THREADS. It has no effect unless built with GBC_THREADS
+/// @param n
+void gbc_numeric_set_threads(size_t n);
+
+/// @brief the sum of the elements, 0 for an empty vector
+/// @param vec
+/// @return
+float vec_sum_f32(const vec_t *vec);
+double vec_sum_f64(const vec_t *vec);
+int64_t vec_sum_i32(const vec_t *vec);
+int64_t vec_sum_i64(const vec_t *vec);
+
+/// @brief find the smallest element
+/// @param vec
+/// @param min: its value, may be NULL
+/// @param idx: the first index holding it, may be NULL
+/// @return return false if the vector is empty
+bool vec_min_f32(const vec_t *vec, float *min, size_t *idx);
+bool vec_min_f64(const vec_t *vec, double *min, size_t *idx);
+bool vec_min_i32(const vec_t *vec, int32_t *min, size_t *idx);
+bool vec_min_i64(const vec_t *vec, int64_t *min, size_t *idx);
+
+/// @brief find the largest element
+/// @param vec
+/// @param max: its value, may be NULL
+/// @param idx: the first index holding it, may be NULL
+/// @return return false if the vector is empty
+bool vec_max_f32(const vec_t *vec, float *max, size_t *idx);
+bool vec_max_f64(const vec_t *vec, double *max, size_t *idx);
+bool vec_max_i32(const vec_t *vec, int32_t *max, size_t *idx);
+bool vec_max_i64(const vec_t *vec, int64_t *max, size_t *idx);
+
+/// @brief the dot product of two vectors of the same length
+/// @param a
+/// @param b
+/// @return
+float vec_dot_f32(const vec_t *a, const vec_t *b);
+double vec_dot_f64(const vec_t *a, const vec_t *b);
+int64_t vec_dot_i32(const vec_t *a, const vec_t *b);
+int64_t vec_dot_i64(const vec_t *a, const vec_t *b);
+
+/// @brief replace every element with the sum of it and all the elements
+/// before it
+/// @param vec
+void vec_prefix_sum_f32(vec_t *vec);
+void vec_prefix_sum_f64(vec_t *vec);
+void vec_prefix_sum_i32(vec_t *vec);
+void vec_prefix_sum_i64(vec_t *vec);
+
+/// @brief add alpha * x[i] to every y[i], x and y having the same length
+/// @param alpha
+/// @param x
+/// @param y
+void vec_axpy_f32(float alpha, const vec_t *x, vec_t *y);
+void vec_axpy_f64(double alpha, const vec_t *x, vec_t *y);
+void vec_axpy_i32(int32_t alpha, const vec_t *x, vec_t *y);
+void vec_axpy_i64(int64_t alpha, const vec_t *x, vec_t *y);
+
+/// @brief generate the scalar kernels of one type. ACC is the type of its
+/// sums; the arithmetic is done in UACC and UT, which are unsigned for the
+/// integers so that overflow wraps around
+#define _NUM_SCALAR_KERNELS(sfx, T, ACC, UACC, UT)                            \
+  static ACC num_sum_##sfx##_scalar(const T *a, size_t n) {                   \
+    UACC s0 = 0, s1 = 0, s2 = 0, s3 = 0;                                      \
+    size_t i = 0;                                                             \
+    for (; i + 4 <= n; i += 4) {                                              \
+      s0 += (UACC)a[i];                                                       \
+      s1 += (UACC)a[i + 1];                                                   \
+      s2 += (UACC)a[i + 2];                                                   \
+      s3 += (UACC)a[i + 3];                                                   \
+    }                                                                         \
+    for (; i < n; ++i) s0 += (UACC)a[i];                                      \
+    return (ACC)(s0 + s1 + s2 + s3);                                          \
+  }                                                                           \
+                                                                              \
+  static ACC num_dot_##sfx##_scalar(const T *a, const T *b, size_t n) {       \
+    UACC s0 = 0, s1 = 0;                                                      \
+    size_t i = 0;                                                             \
+    for (; i + 2 <= n; i += 2) {                                              \
+      s0 += (UACC)a[i] * (UACC)b[i];                                          \
+      s1 += (UACC)a[i + 1] * (UACC)b[i + 1];                                  \
+    }                                                                         \
+    for (; i < n; ++i) s0 += (UACC)a[i] * (UACC)b[i];                         \
+    return (ACC)(s0 + s1);                                                    \
+  }                                                                           \
+                                                                              \
+  static T num_min_##sfx##_scalar(const T *a, size_t n) {                     \
+    T m = a[0];                                                               \
+    for (size_t i = 1; i < n; ++i)                                            \
+      if (a[i] < m) m = a[i];                                                 \
+    return m;                                                                 \
+  }                                                                           \
+                                                                              \
+  static T num_max_##sfx##_scalar(const T *a, size_t n) {                     \
+    T m = a[0];                                                               \
+    for (size_t i = 1; i < n; ++i)                                            \
+      if (a[i] > m) m = a[i];                                                 \
+    return m;                                                                 \
+  }                                                                           \
+                                                                              \
+  /* carry is the sum of everything before a, the result the new carry */     \
+  static T num_prefix_##sfx##_scalar(T *a, size_t n, T carry) {               \
+    UT s = (UT)carry;                                                         \
+    for (size_t i = 0; i < n; ++i) {                                          \
+      s += (UT)a[i];                                                          \
+      a[i] = (T)s;                                                            \
+    }                                                                         \
+    return (T)s;                                                              \
+  }                                                                           \
+                                                                              \
+  static void num_axpy_##sfx##_scalar(T alpha, const T *x, T *y, size_t n) {  \
+    for (size_t i = 0; i < n; ++i)                                            \
+      y[i] = (T)((UT)y[i] + (UT)alpha * (UT)x[i]);                            \
+  }
+
+_NUM_SCALAR_KERNELS(f32, float, float, float, float)
+_NUM_SCALAR_KERNELS(f64, double, double, double, double)
+_NUM_SCALAR_KERNELS(i32, int32_t, int64_t, uint64_t, uint32_t)
+_NUM_SCALAR_KERNELS(i64, int64_t, int64_t, uint64_t, uint64_t)
+
+#ifdef GBC_CPU_X86
+
+/// The AVX2 building blocks of each type: V holds LANES elements, and the
+/// partial sums of sum and dot are kept in a V of ACC lanes
+
+#define _NUM_AVX2_FLOAT_OPS(sfx, T, V, ps)                               \
+  GBC_TARGET_AVX2 static inline V num_zero_##sfx(void) {                 \
+    return _mm256_setzero_##ps();                                        \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_load_##sfx(const T *p) {           \
+    return _mm256_loadu_##ps(p);                                         \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline void num_store_##sfx(T *p, V v) {        \
+    _mm256_storeu_##ps(p, v);                                            \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_set1_##sfx(T x) {                  \
+    return _mm256_set1_##ps(x);                                          \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_add_##sfx(V a, V b) {              \
+    return _mm256_add_##ps(a, b);                                        \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_mul_##sfx(V a, V b) {              \
+    return _mm256_mul_##ps(a, b);                                        \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_vmin_##sfx(V a, V b) {             \
+    return _mm256_min_##ps(a, b);                                        \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_vmax_##sfx(V a, V b) {             \
+    return _mm256_max_##ps(a, b);                                        \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_acc_add_##sfx(V a, V b) {          \
+    return _mm256_add_##ps(a, b);                                        \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_sum_step_##sfx(V s, const T *p) {  \
+    return _mm256_add_##ps(s, _mm256_loadu_##ps(p));                     \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline V num_dot_step_##sfx(V s, const T *p,    \
+                                                     const T *q) {       \
+    return _mm256_add_##ps(s,                                            \
+                           _mm256_mul_##ps(_mm256_loadu_##ps(p),         \
+                                           _mm256_loadu_##ps(q)));       \
+  }
+
+_NUM_AVX2_FLOAT_OPS(f32, float, __m256, ps)
+_NUM_AVX2_FLOAT_OPS(f64, double, __m256d, pd)
+
+/// @brief the inclusive prefix sum of the lanes: within each 128 bit half
+/// first, then the low half's total is added to the high half
+GBC_TARGET_AVX2 static inline __m256 num_scan_f32(__m256 x) {
+  __m256i b = _mm256_castps_si256(x);
+  x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(b, 4)));
+  b = _mm256_castps_si256(x);
+  x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(b, 8)));
+  __m256 t = _mm256_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+  return _mm256_add_ps(x, _mm256_permute2f128_ps(t, t, 0x08));
+}
+
+GBC_TARGET_AVX2 static inline __m256 num_last_f32(__m256 x) {
+  return _mm256_permutevar8x32_ps(x, _mm256_set1_epi32(7));
+}
+
+GBC_TARGET_AVX2 static inline __m256d num_scan_f64(__m256d x) {
+  __m256i b = _mm256_castpd_si256(x);
+  x = _mm256_add_pd(x, _mm256_castsi256_pd(_mm256_slli_si256(b, 8)));
+  __m256d t = _mm256_permute4x64_pd(x, _MM_SHUFFLE(1, 1, 1, 1));
+  return _mm256_add_pd(x, _mm256_blend_pd(_mm256_setzero_pd(), t, 0xc));
+}
+
+GBC_TARGET_AVX2 static inline __m256d num_last_f64(__m256d x) {
+  return _mm256_permute4x64_pd(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+#define _NUM_AVX2_INT_OPS(sfx, T, epi)                                   \
+  GBC_TARGET_AVX2 static inline __m256i num_zero_##sfx(void) {           \
+    return _mm256_setzero_si256();                                       \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline __m256i num_load_##sfx(const T *p) {     \
+    return _mm256_loadu_si256((const __m256i *)p);                       \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline void num_store_##sfx(T *p, __m256i v) {  \
+    _mm256_storeu_si256((__m256i *)p, v);                                \
+  }                                                                      \
+  GBC_TARGET_AVX2 static inline __m256i num_add_##sfx(__m256i a,         \
+                                                      __m256i b) {       \
+    return _mm256_add_##epi(a, b);                                       \
+  }
+
+_NUM_AVX2_INT_OPS(i32, int32_t, epi32)
+_NUM_AVX2_INT_OPS(i64, int64_t, epi64)
+
+GBC_TARGET_AVX2 static inline __m256i num_set1_i32(int32_t x) {
+  return _mm256_set1_epi32(x);
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_mul_i32(__m256i a, __m256i b) {
+  return _mm256_mullo_epi32(a, b);
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_vmin_i32(__m256i a, __m256i b) {
+  return _mm256_min_epi32(a, b);
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_vmax_i32(__m256i a, __m256i b) {
+  return _mm256_max_epi32(a, b);
+}
+
+/// the partial sums of i32 are 64 bit lanes, each step widens 8 elements
+GBC_TARGET_AVX2 static inline __m256i num_acc_add_i32(__m256i a, __m256i b) {
+  return _mm256_add_epi64(a, b);
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_sum_step_i32(__m256i s,
+                                                       const int32_t *p) {
+  __m256i lo = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)p));
+  __m256i hi =
+      _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(p + 4)));
+  return _mm256_add_epi64(s, _mm256_add_epi64(lo, hi));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_dot_step_i32(__m256i s,
+                                                       const int32_t *p,
+                                                       const int32_t *q) {
+  // _mm256_mul_epi32 multiplies the low signed halves of the 64 bit lanes
+  __m256i plo = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)p));
+  __m256i qlo = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)q));
+  __m256i phi =
+      _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(p + 4)));
+  __m256i qhi =
+      _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(q + 4)));
+  return _mm256_add_epi64(s, _mm256_add_epi64(_mm256_mul_epi32(plo, qlo),
+                                              _mm256_mul_epi32(phi, qhi)));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_scan_i32(__m256i x) {
+  x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+  x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+  __m256i t = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+  return _mm256_add_epi32(x, _mm256_permute2x128_si256(t, t, 0x08));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_last_i32(__m256i x) {
+  return _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_set1_i64(int64_t x) {
+  return _mm256_set1_epi64x((long long)x);
+}
+
+/// AVX2 has no 64 bit multiply: the low 64 bits of the product are
+/// alo * blo + ((ahi * blo + alo * bhi) << 32)
+GBC_TARGET_AVX2 static inline __m256i num_mul_i64(__m256i a, __m256i b) {
+  __m256i ahi = _mm256_srli_epi64(a, 32), bhi = _mm256_srli_epi64(b, 32);
+  __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(ahi, b),
+                                   _mm256_mul_epu32(a, bhi));
+  return _mm256_add_epi64(_mm256_mul_epu32(a, b),
+                          _mm256_slli_epi64(cross, 32));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_vmin_i64(__m256i a, __m256i b) {
+  return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_vmax_i64(__m256i a, __m256i b) {
+  return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_acc_add_i64(__m256i a, __m256i b) {
+  return _mm256_add_epi64(a, b);
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_sum_step_i64(__m256i s,
+                                                       const int64_t *p) {
+  return _mm256_add_epi64(s, num_load_i64(p));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_dot_step_i64(__m256i s,
+                                                       const int64_t *p,
+                                                       const int64_t *q) {
+  return _mm256_add_epi64(s, num_mul_i64(num_load_i64(p), num_load_i64(q)));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_scan_i64(__m256i x) {
+  x = _mm256_add_epi64(x, _mm256_slli_si256(x, 8));
+  __m256i t = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 1, 1, 1));
+  return _mm256_add_epi64(
+      x, _mm256_blend_epi32(_mm256_setzero_si256(), t, 0xf0));
+}
+
+GBC_TARGET_AVX2 static inline __m256i num_last_i64(__m256i x) {
+  return _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+/// @brief generate the AVX2 kernels of one type from its building blocks.
+/// The sums run four registers of partial sums to hide the add latency, the
+/// tails that do not fill a register go to the scalar kernels
+#define _NUM_AVX2_KERNELS(sfx, T, V, LANES, ACC, UACC)                     \
+  GBC_TARGET_AVX2 static ACC num_sum_##sfx##_avx2(const T *a, size_t n) {  \
+    V s0 = num_zero_##sfx(), s1 = s0, s2 = s0, s3 = s0;                    \
+    size_t i = 0;                                                          \
+    for (; i + 4 * (LANES) <= n; i += 4 * (LANES)) {                       \
+      s0 = num_sum_step_##sfx(s0, a + i);                                  \
+      s1 = num_sum_step_##sfx(s1, a + i + (LANES));                        \
+      s2 = num_sum_step_##sfx(s2, a + i + 2 * (LANES));                    \
+      s3 = num_sum_step_##sfx(s3, a + i + 3 * (LANES));                    \
+    }                                                                      \
+    for (; i + (LANES) <= n; i += (LANES))                                 \
+      s0 = num_sum_step_##sfx(s0, a + i);                                  \
+    s0 = num_acc_add_##sfx(num_acc_add_##sfx(s0, s1),                      \
+                           num_acc_add_##sfx(s2, s3));                     \
+    ACC lanes[sizeof(V) / sizeof(ACC)];                                    \
+    memcpy(lanes, &s0, sizeof(V));                                         \
+    UACC s = (UACC)num_sum_##sfx##_scalar(a + i, n - i);                   \
+    for (size_t j = 0; j < sizeof(V) / sizeof(ACC); ++j)                   \
+      s += (UACC)lanes[j];                                                 \
+    return (ACC)s;                                                         \
+  }                                                                        \
+                                                                           \
+  GBC_TARGET_AVX2 static ACC num_dot_##sfx##_avx2(const T *a, const T *b,  \
+                                                  size_t n) {              \
+    V s0 = num_zero_##sfx(), s1 = s0;                                      \
+    size_t i = 0;                                                          \
+    for (; i + 2 * (LANES) <= n; i += 2 * (LANES)) {                       \
+      s0 = num_dot_step_##sfx(s0, a + i, b + i);                           \
+      s1 = num_dot_step_##sfx(s1, a + i + (LANES), b + i + (LANES));       \
+    }                                                                      \
+    for (; i + (LANES) <= n; i += (LANES))                                 \
+      s0 = num_dot_step_##sfx(s0, a + i, b + i);                           \
+    s0 = num_acc_add_##sfx(s0, s1);                                        \
+    ACC lanes[sizeof(V) / sizeof(ACC)];                                    \
+    memcpy(lanes, &s0, sizeof(V));                                         \
+    UACC s = (UACC)num_dot_##sfx##_scalar(a + i, b + i, n - i);            \
+    for (size_t j = 0; j < sizeof(V) / sizeof(ACC); ++j)                   \
+      s += (UACC)lanes[j];                                                 \
+    return (ACC)s;                                                         \
+  }                                                                        \
+                                                                           \
+  _NUM_AVX2_EXTREMUM(sfx, T, V, LANES, min, <)                             \
+  _NUM_AVX2_EXTREMUM(sfx, T, V, LANES, max, >)                             \
+                                                                           \
+  GBC_TARGET_AVX2 static T num_prefix_##sfx##_avx2(T *a, size_t n,         \
+                                                   T carry) {              \
+    V c = num_set1_##sfx(carry);                                           \
+    size_t i = 0;                                                          \
+    for (; i + (LANES) <= n; i += (LANES)) {                               \
+      V x = num_add_##sfx(num_scan_##sfx(num_load_##sfx(a + i)), c);       \
+      num_store_##sfx(a + i, x);                                           \
+      c = num_last_##sfx(x);                                               \
+    }                                                                      \
+    return num_prefix_##sfx##_scalar(a + i, n - i, i ? a[i - 1] : carry);  \
+  }                                                                        \
+                                                                           \
+  GBC_TARGET_AVX2 static void num_axpy_##sfx##_avx2(T alpha, const T *x,   \
+                                                    T *y, size_t n) {      \
+    V va = num_set1_##sfx(alpha);                                          \
+    size_t i = 0;                                                          \
+    for (; i + (LANES) <= n; i += (LANES)) {                               \
+      V p = num_mul_##sfx(va, num_load_##sfx(x + i));                      \
+      num_store_##sfx(y + i, num_add_##sfx(num_load_##sfx(y + i), p));     \
+    }                                                                      \
+    num_axpy_##sfx##_scalar(alpha, x + i, y + i, n - i);                   \
+  }
+
+/// @brief the min or max kernel, n must not be 0. The loaded elements come
+/// first in the vector min/max so that a NaN in them is skipped
+#define _NUM_AVX2_EXTREMUM(sfx, T, V, LANES, op, CMP)                       \
+  GBC_TARGET_AVX2 static T num_##op##_##sfx##_avx2(const T *a, size_t n) {  \
+    if (n < 2 * (LANES)) return num_##op##_##sfx##_scalar(a, n);            \
+    V m0 = num_load_##sfx(a), m1 = num_load_##sfx(a + (LANES));             \
+    size_t i = 2 * (LANES);                                                 \
+    for (; i + 2 * (LANES) <= n; i += 2 * (LANES)) {                        \
+      m0 = num_v##op##_##sfx(num_load_##sfx(a + i), m0);                    \
+      m1 = num_v##op##_##sfx(num_load_##sfx(a + i + (LANES)), m1);          \
+    }                                                                       \
+    m0 = num_v##op##_##sfx(m1, m0);                                         \
+    T lanes[LANES];                                                         \
+    num_store_##sfx(lanes, m0);                                             \
+    T m = lanes[0];                                                         \
+    for (size_t j = 1; j < (LANES); ++j)                                    \
+      if (lanes[j] CMP m) m = lanes[j];                                     \
+    for (; i < n; ++i)                                                      \
+      if (a[i] CMP m) m = a[i];                                             \
+    return m;                                                               \
+  }
+
+_NUM_AVX2_KERNELS(f32, float, __m256, 8, float, float)
+_NUM_AVX2_KERNELS(f64, double, __m256d, 4, double, double)
+_NUM_AVX2_KERNELS(i32, int32_t, __m256i, 8, int64_t, uint64_t)
+_NUM_AVX2_KERNELS(i64, int64_t, __m256i, 4, int64_t, uint64_t)
+
+/// @brief call the kernel of the best instruction set the CPU has, the
+/// module has no SSE2 kernels: x86-64 compilers already use SSE2 for the
+/// scalar loops
+#define _NUM_CALL(fn, ...)                                   \
+  (gbc_cpu_level() >= GBC_CPU_AVX2 ? fn##_avx2(__VA_ARGS__)  \
+                                   : fn##_scalar(__VA_ARGS__))
+
+#else
+
+#define _NUM_CALL(fn, ...) fn##_scalar(__VA_ARGS__)
+
+#endif
+
+/// @brief one slice of a kernel call, run by a thread of its own when built
+/// with GBC_THREADS. arg is the scalar operand, res the result, both hold a
+/// value of the kernel's type
+typedef struct _num_chunk {
+  void (*run)(struct _num_chunk *);
+  const char *a;
+  const char *b;
+  char *y;
+  size_t n;
+  char arg[8];
+  char res[8];
+} num_chunk_t;
+
+static size_t gbc_numeric_threads = 1;
+
+void gbc_numeric_set_threads(size_t n) {
+  if (n < 1) n = 1;
+  if (n > GBC_NUMERIC_MAX_THREADS) n = GBC_NUMERIC_MAX_THREADS;
+  gbc_numeric_threads = n;
+}
+
+#ifdef GBC_THREADS
+static void *num_chunk_main(void *p) {
+  num_chunk_t *c = (num_chunk_t *)p;
+  c->run(c);
+  return NULL;
+}
+#endif
+
+/// @brief the number of chunks n elements are split into, each of at least
+/// GBC_NUMERIC_PAR_MIN elements
+static size_t num_chunk_count(size_t n) {
+#ifdef GBC_THREADS
+  if (n >= GBC_NUMERIC_PAR_MIN) {
+    size_t k = n / GBC_NUMERIC_PAR_MIN;
+    return k < gbc_numeric_threads ? k : gbc_numeric_threads;
+  }
+#endif
+  (void)n;
+  return 1;
+}
+
+/// @brief run a kernel over n elements of a, b and y, any of them may be
+/// NULL, split into num_chunk_count(n) chunks with a thread each. A chunk
+/// whose thread can not be started runs on the caller
+/// @return the number of chunks, filled in order
+static size_t num_parallel(num_chunk_t *chunks, void (*run)(num_chunk_t *),
+                           const void *a, const void *b, void *y, size_t n,
+                           size_t obj_size, const void *arg) {
+  size_t k = num_chunk_count(n);
+  for (size_t j = 0; j < k; ++j) {
+    // chunk j is [j * n / k, (j + 1) * n / k), none of them empty
+    size_t from = j * n / k, off = from * obj_size;
+    chunks[j].run = run;
+    chunks[j].a = a ? (const char *)a + off : NULL;
+    chunks[j].b = b ? (const char *)b + off : NULL;
+    chunks[j].y = y ? (char *)y + off : NULL;
+    chunks[j].n = (j + 1) * n / k - from;
+    if (arg) memcpy(chunks[j].arg, arg, obj_size);
+  }
+#ifdef GBC_THREADS
+  pthread_t tids[GBC_NUMERIC_MAX_THREADS];
+  bool started[GBC_NUMERIC_MAX_THREADS] = {false};
+  for (size_t j = 1; j < k; ++j) {
+    started[j] = pthread_create(&tids[j], NULL, num_chunk_main,
+                                &chunks[j]) == 0;
+  }
+  run(&chunks[0]);
+  for (size_t j = 1; j < k; ++j) {
+    if (started[j]) {
+      pthread_join(tids[j], NULL);
+    } else {
+      run(&chunks[j]);
+    }
+  }
+#else
+  run(&chunks[0]);
+#endif
+  return k;
+}
+
+/// @brief generate the public functions of one type. FSFX is the
+/// gbc_vector_simd.h type whose equality finds the index of a min or max
+#define _NUM_API(sfx, T, ACC, UACC, UT, FSFX, FT)                              \
+  static void num_sum_chunk_##sfx(num_chunk_t *c) {                            \
+    ACC s = _NUM_CALL(num_sum_##sfx, (const T *)c->a, c->n);                   \
+    memcpy(c->res, &s, sizeof(s));                                             \
+  }                                                                            \
+                                                                               \
+  ACC vec_sum_##sfx(const vec_t *vec) {                                        \
+    assert(vec && vec->obj_size == sizeof(T));                                 \
+    num_chunk_t chunks[GBC_NUMERIC_MAX_THREADS];                               \
+    size_t k = num_parallel(chunks, num_sum_chunk_##sfx, vec->buf, NULL, NULL, \
+                            vec->size, sizeof(T), NULL);                       \
+    UACC s = 0;                                                                \
+    for (size_t j = 0; j < k; ++j) {                                           \
+      ACC r;                                                                   \
+      memcpy(&r, chunks[j].res, sizeof(r));                                    \
+      s += (UACC)r;                                                            \
+    }                                                                          \
+    return (ACC)s;                                                             \
+  }                                                                            \
+                                                                               \
+  static void num_dot_chunk_##sfx(num_chunk_t *c) {                            \
+    ACC s = _NUM_CALL(num_dot_##sfx, (const T *)c->a, (const T *)c->b, c->n);  \
+    memcpy(c->res, &s, sizeof(s));                                             \
+  }                                                                            \
+                                                                               \
+  ACC vec_dot_##sfx(const vec_t *a, const vec_t *b) {                          \
+    assert(a && b && a->obj_size == sizeof(T) && b->obj_size == sizeof(T));    \
+    assert(a->size == b->size);                                                \
+    num_chunk_t chunks[GBC_NUMERIC_MAX_THREADS];                               \
+    size_t k = num_parallel(chunks, num_dot_chunk_##sfx, a->buf, b->buf,       \
+                            NULL, a->size, sizeof(T), NULL);                   \
+    UACC s = 0;                                                                \
+    for (size_t j = 0; j < k; ++j) {                                           \
+      ACC r;                                                                   \
+      memcpy(&r, chunks[j].res, sizeof(r));                                    \
+      s += (UACC)r;                                                            \
+    }                                                                          \
+    return (ACC)s;                                                             \
+  }                                                                            \
+                                                                               \
+  _NUM_API_EXTREMUM(sfx, T, FSFX, FT, min, <)                                  \
+  _NUM_API_EXTREMUM(sfx, T, FSFX, FT, max, >)                                  \
+                                                                               \
+  static void num_prefix_chunk_##sfx(num_chunk_t *c) {                         \
+    T carry;                                                                   \
+    memcpy(&carry, c->arg, sizeof(T));                                         \
+    _NUM_CALL(num_prefix_##sfx, (T *)c->y, c->n, carry);                       \
+  }                                                                            \
+                                                                               \
+  void vec_prefix_sum_##sfx(vec_t *vec) {                                      \
+    assert(vec && vec->obj_size == sizeof(T));                                 \
+    if (num_chunk_count(vec->size) == 1) {                                     \
+      _NUM_CALL(num_prefix_##sfx, (T *)vec->buf, vec->size, (T)0);             \
+      return;                                                                  \
+    }                                                                          \
+    /* sum the chunks, each then starts from the total of those before it */   \
+    num_chunk_t chunks[GBC_NUMERIC_MAX_THREADS];                               \
+    size_t k = num_parallel(chunks, num_sum_chunk_##sfx, vec->buf, NULL, NULL, \
+                            vec->size, sizeof(T), NULL);                       \
+    UT carries[GBC_NUMERIC_MAX_THREADS];                                       \
+    UT total = 0;                                                              \
+    for (size_t j = 0; j < k; ++j) {                                           \
+      ACC r;                                                                   \
+      memcpy(&r, chunks[j].res, sizeof(r));                                    \
+      carries[j] = total;                                                      \
+      total += (UT)r;                                                          \
+    }                                                                          \
+    for (size_t j = 0; j < k; ++j) {                                           \
+      T carry = (T)carries[j];                                                 \
+      memcpy(chunks[j].arg, &carry, sizeof(T));                                \
+    }                                                                          \
+    num_parallel(chunks, num_prefix_chunk_##sfx, NULL, NULL, vec->buf,         \
+                 vec->size, sizeof(T), NULL);                                  \
+  }                                                                            \
+                                                                               \
+  static void num_axpy_chunk_##sfx(num_chunk_t *c) {                           \
+    T alpha;                                                                   \
+    memcpy(&alpha, c->arg, sizeof(T));                                         \
+    _NUM_CALL(num_axpy_##sfx, alpha, (const T *)c->a, (T *)c->y, c->n);        \
+  }                                                                            \
+                                                                               \
+  void vec_axpy_##sfx(T alpha, const vec_t *x, vec_t *y) {                     \
+    assert(x && y && x->obj_size == sizeof(T) && y->obj_size == sizeof(T));    \
+    assert(x->size == y->size);                                                \
+    num_chunk_t chunks[GBC_NUMERIC_MAX_THREADS];                               \
+    num_parallel(chunks, num_axpy_chunk_##sfx, x->buf, NULL, y->buf, x->size,  \
+                 sizeof(T), &alpha);                                           \
+  }
+
+/// @brief the public min or max: the value per chunk, then the first index
+/// holding the overall one, searched from the first chunk that has it
+#define _NUM_API_EXTREMUM(sfx, T, FSFX, FT, op, CMP)                           \
+  static void num_##op##_chunk_##sfx(num_chunk_t *c) {                         \
+    T m = _NUM_CALL(num_##op##_##sfx, (const T *)c->a, c->n);                  \
+    memcpy(c->res, &m, sizeof(m));                                             \
+  }                                                                            \
+                                                                               \
+  bool vec_##op##_##sfx(const vec_t *vec, T *out, size_t *idx) {               \
+    assert(vec && vec->obj_size == sizeof(T));                                 \
+    if (vec->size == 0) return false;                                          \
+    num_chunk_t chunks[GBC_NUMERIC_MAX_THREADS];                               \
+    size_t k = num_parallel(chunks, num_##op##_chunk_##sfx, vec->buf, NULL,    \
+                            NULL, vec->size, sizeof(T), NULL);                 \
+    T m;                                                                       \
+    size_t first = 0;                                                          \
+    memcpy(&m, chunks[0].res, sizeof(T));                                      \
+    for (size_t j = 1; j < k; ++j) {                                           \
+      T r;                                                                     \
+      memcpy(&r, chunks[j].res, sizeof(T));                                    \
+      if (r CMP m) {                                                           \
+        m = r;                                                                 \
+        first = j;                                                             \
+      }                                                                        \
+    }                                                                          \
+    if (out) *out = m;                                                         \
+    if (idx) {                                                                 \
+      size_t from = (size_t)(chunks[first].a - vec->buf) / sizeof(T);          \
+      size_t i = _VEC_SIMD_CALL(vec_find_##FSFX, (const FT *)chunks[first].a,  \
+                                vec->size - from, (FT)m);                      \
+      /* a NaN min is found nowhere */                                         \
+      *idx = from + (i < vec->size - from ? i : 0);                            \
+    }                                                                          \
+    return true;                                                               \
+  }
+
+_NUM_API(f32, float, float, float, float, f32, float)
+_NUM_API(f64, double, double, double, double, f64, double)
+_NUM_API(i32, int32_t, int64_t, uint64_t, uint32_t, u32, uint32_t)
+_NUM_API(i64, int64_t, int64_t, uint64_t, uint64_t, u64, uint64_t)
+
+#endif
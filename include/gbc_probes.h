@@ -0,0 +1,40 @@
+#ifndef _GBC_PROBES_H
+#define _GBC_PROBES_H
+
+/// @brief static tracing probes on the container hot paths. They compile to
+/// nothing unless GBC_USDT is defined before including any GBC header, in
+/// which case they become USDT probes of the provider "gbc" (systemtap's
+/// <sys/sdt.h> is required). An armed probe costs a nop until a tracer
+/// attaches, e.g.
+///
+///   bpftrace -e 'usdt:./app:gbc:vdq_grow { @bytes = hist(arg3); }'
+///
+/// The probes and their arguments:
+///   vec_grow(vec, old_cap, new_cap, bytes_copied)
+///   vdq_grow(dq, old_cap, new_cap, bytes_copied)
+///   segvec_grow(vec, old_cap, new_cap, 0), a new chunk copies nothing
+///   cdq_grow(dq, old_map_cap, new_map_cap, bytes_copied), block pointers
+///   avl_node_alloc(map, node, bytes)
+///   avl_node_free(map, node, bytes)
+///   avl_rotate(map, node)
+///   iter_new(container, iter, length)
+///
+/// bytes_copied of vec_grow is the used part of the buffer, which realloc
+/// only moves when it can not grow in place
+#ifdef GBC_USDT
+#include <sys/sdt.h>
+
+#define GBC_PROBE2(name, a1, a2) DTRACE_PROBE2(gbc, name, a1, a2)
+#define GBC_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(gbc, name, a1, a2, a3)
+#define GBC_PROBE4(name, a1, a2, a3, a4) \
+  DTRACE_PROBE4(gbc, name, a1, a2, a3, a4)
+
+#else
+
+#define GBC_PROBE2(name, a1, a2) ((void)0)
+#define GBC_PROBE3(name, a1, a2, a3) ((void)0)
+#define GBC_PROBE4(name, a1, a2, a3, a4) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,1503 @@
+#ifndef _GBC_ROARING_H
+#define _GBC_ROARING_H
+// roaring_load uses fileno and the checksum comes from gbc_vector_io.h,
+// both POSIX. Under a strict -std=c11 the macros below must precede every
+// system header: include this header first, define them yourself or build
+// with -std=gnu11.
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "gbc_alloc.h"
+#include "gbc_iterator.h"
+#include "gbc_stats.h"
+#include "gbc_vector_io.h"
+
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_BITMAP_WORDS 1024
+#define ROARING_BITMAP_BYTES (ROARING_BITMAP_WORDS * sizeof(uint64_t))
+// a run container with more runs than this is bigger than a bitmap
+#define ROARING_RUN_MAX 2048
+#define DEFAULT_ROARING_CAP 4
+#define ROARING_FILE_MAGIC "GBCROA1"
+
+/// @brief how a container stores its values: a sorted array of up to
+/// ROARING_ARRAY_MAX values, a bitmap of all 65536, or sorted runs of
+/// consecutive values
+typedef enum _roaring_kind {
+  ROARING_ARRAY = 0,
+  ROARING_BITMAP = 1,
+  ROARING_RUN = 2,
+} roaring_kind_t;
+
+/// @brief the len + 1 consecutive values from start
+typedef struct _roaring_run {
+  uint16_t start;
+  uint16_t len;
+} roaring_run_t;
+
+/// @brief the values of a set whose high 16 bits are key, by their low 16
+/// bits. A container is never empty
+/// @param void* data: uint16_t[cap], uint64_t[ROARING_BITMAP_WORDS] or
+/// roaring_run_t[cap]
+/// @param uint32_t card: the number of values, 1 to 65536
+/// @param uint32_t n: the array values or the runs in use
+/// @param uint32_t cap: the array values or the runs data has room for
+typedef struct _roaring_container {
+  void *data;
+  uint32_t card;
+  uint32_t n;
+  uint32_t cap;
+  uint16_t key;
+  uint8_t kind;
+} roaring_container_t;
+
+/// @brief a compressed bitmap set of uint32_t, as in Roaring. The values are
+/// split by their high 16 bits into containers kept sorted by key, each one
+/// in whichever of the three kinds is smallest for its values: an array
+/// while sparse, a 8KB bitmap once dense, runs for long ranges. Lookups are
+/// a binary search over the keys then one within the container, and the
+/// set operations work a container, often a machine word, at a time
+/// @param cs: the containers, sorted by key
+/// @param size_t size: the number of containers
+/// @param alloc: the allocator of the containers and of the set itself
+typedef struct _roaring {
+  roaring_container_t *cs;
+  size_t size;
+  size_t cap;
+  const gbc_allocator_t *alloc;
+  GBC_STATS_FIELD
+} roaring_t;
+
+/// @brief The roaring set iterator, it yields uint32_t values in ascending
+/// order. next_batch decodes up to ITER_BATCH_MAX values into buf
+typedef struct _roaring_iter {
+  iter_t base;
+  const roaring_t *r;
+  size_t ci;
+  uint32_t pos;
+  uint32_t run_off;
+  uint32_t seen;
+  uint32_t value;
+  uint32_t buf[ITER_BATCH_MAX];
+  const gbc_allocator_t *alloc;
+} roaring_iter_t;
+
+/// @brief the header of a serialized set. It is followed by count
+/// roaring_file_container_t, then the data of each container in the same
+/// order: n uint16_t for an array, ROARING_BITMAP_WORDS uint64_t for a
+/// bitmap and n roaring_run_t for runs. Integers are stored in native byte
+/// order
+/// @param char magic[8]: ROARING_FILE_MAGIC
+/// @param uint64_t count: the number of containers
+/// @param uint64_t cardinality: the number of values
+/// @param uint64_t checksum: FNV-1a of everything after the header
+typedef struct _roaring_file_header {
+  char magic[8];
+  uint64_t count;
+  uint64_t cardinality;
+  uint64_t checksum;
+  uint64_t reserved[4];
+} roaring_file_header_t;
+
+/// @brief a serialized container
+/// @param uint32_t n: the array values or the runs, 0 for a bitmap
+typedef struct _roaring_file_container {
+  uint16_t key;
+  uint16_t kind;
+  uint32_t n;
+} roaring_file_container_t;
+
+/// @brief create a new empty set
+/// @return
+roaring_t *roaring_new(void);
+
+/// @brief create a new empty set whose memory, including the set itself and
+/// its iterators, comes from alloc
+/// @param alloc: NULL for malloc/free
+/// @return
+roaring_t *roaring_new_ex(const gbc_allocator_t *alloc);
+
+/// @brief drop the set out of memory
+/// @param r
+/// @return
+bool roaring_drop(roaring_t *r);
+
+/// @brief deep copy a set
+/// @param r
+/// @return
+roaring_t *roaring_clone(const roaring_t *r);
+
+/// @brief add x to the set
+/// @param r
+/// @param x
+/// @return return false if x was already in the set or the memory ran out
+bool roaring_add(roaring_t *r, uint32_t x);
+
+/// @brief add every value in [lo, hi]. A range covering all the values of a
+/// container becomes a single run
+/// @param r
+/// @param lo
+/// @param hi
+/// @return return false if the memory ran out
+bool roaring_add_range(roaring_t *r, uint32_t lo, uint32_t hi);
+
+/// @brief delete x from the set
+/// @param r
+/// @param x
+/// @return return false if x was not in the set
+bool roaring_del(roaring_t *r, uint32_t x);
+
+/// @brief check if x is in the set
+/// @param r
+/// @param x
+/// @return
+bool roaring_contains(const roaring_t *r, uint32_t x);
+
+/// @brief the number of values in the set
+/// @param r
+/// @return
+uint64_t roaring_cardinality(const roaring_t *r);
+
+/// @brief check if the set is empty
+/// @param r
+/// @return
+bool roaring_is_empty(const roaring_t *r);
+
+/// @brief the bytes held by the set, itself included
+/// @param r
+/// @return
+size_t roaring_memory_usage(const roaring_t *r);
+
+/// @brief convert every container to runs where they are smaller than its
+/// array or bitmap, and runs that are not back. Adding values one by one
+/// never creates runs, so call it once a set is built
+/// @param r
+/// @return return false if the memory ran out, the set is still valid
+bool roaring_run_optimize(roaring_t *r);
+
+/// @brief create a new set of the values in both sets
+/// @param a
+/// @param b
+/// @return
+roaring_t *roaring_intersection(const roaring_t *a, const roaring_t *b);
+
+/// @brief create a new set of the values in either set
+/// @param a
+/// @param b
+/// @return
+roaring_t *roaring_union(const roaring_t *a, const roaring_t *b);
+
+/// @brief create a new set of the values of a that are not in b
+/// @param a
+/// @param b
+/// @return
+roaring_t *roaring_diff(const roaring_t *a, const roaring_t *b);
+
+/// @brief the number of values in both sets, nothing is built
+/// @param a
+/// @param b
+/// @return
+uint64_t roaring_intersection_cardinality(const roaring_t *a,
+                                          const roaring_t *b);
+
+/// @brief read the operation counters of the set
+/// @param r
+/// @param out
+/// @return return false, with out zeroed, unless built with GBC_STATS
+bool roaring_stats(const roaring_t *r, gbc_stats_t *out);
+
+/// @brief the size of the set once serialized
+/// @param r
+/// @return
+size_t roaring_serialized_size(const roaring_t *r);
+
+/// @brief write the set to buf, see roaring_file_header_t
+/// @param r
+/// @param buf: room for roaring_serialized_size(r) bytes
+/// @return the number of bytes written
+size_t roaring_serialize(const roaring_t *r, void *buf);
+
+/// @brief rebuild a set written by roaring_serialize, checking its checksum
+/// and every container
+/// @param buf
+/// @param len
+/// @return return NULL if buf is not a valid set
+roaring_t *roaring_deserialize(const void *buf, size_t len);
+
+/// @brief write the set to path
+/// @param r
+/// @param path
+/// @return return false if the file can not be written
+bool roaring_save(const roaring_t *r, const char *path);
+
+/// @brief read a set written by roaring_save
+/// @param path
+/// @return return NULL if the file can not be read or is corrupted
+roaring_t *roaring_load(const char *path);
+
+/// @brief create a roaring_iter_t
+/// @param r
+/// @return
+roaring_iter_t *roaring_iter_new(const roaring_t *r);
+
+/// @brief set up an iterator provided by the caller, e.g. on the stack, so
+/// iterating allocates nothing. Finish it with roaring_iter_fini, not
+/// roaring_iter_drop
+/// @param iter
+/// @param r
+void roaring_iter_init(roaring_iter_t *iter, const roaring_t *r);
+
+/// @brief finish an iterator set up by roaring_iter_init
+/// @param iter
+void roaring_iter_fini(roaring_iter_t *iter);
+
+/// @brief drop a roaring_iter_t
+/// @param iter
+/// @return
+bool roaring_iter_drop(roaring_iter_t *iter);
+
+/// @brief check if the roaring_iter_t has next value
+/// @param iter
+/// @return
+bool roaring_iter_has_next(const roaring_iter_t *iter);
+
+/// @brief get the next value, a uint32_t
+/// @param iter
+/// @return
+void *roaring_iter_next(roaring_iter_t *iter);
+
+/// @brief the scratch space of the set operations
+typedef struct _roaring_scratch {
+  uint64_t a[ROARING_BITMAP_WORDS];
+  uint64_t b[ROARING_BITMAP_WORDS];
+  uint16_t vals[ROARING_ARRAY_MAX];
+} roaring_scratch_t;
+
+static inline size_t roaring_unit(const roaring_container_t *c) {
+  return c->kind == ROARING_ARRAY ? sizeof(uint16_t) : sizeof(roaring_run_t);
+}
+
+static inline size_t roaring_data_bytes(const roaring_container_t *c) {
+  return c->kind == ROARING_BITMAP ? ROARING_BITMAP_BYTES
+                                   : c->cap * roaring_unit(c);
+}
+
+static void *roaring_data_alloc(roaring_t *r, size_t bytes) {
+  void *p = gbc_alloc(r->alloc, bytes);
+  if (p) GBC_STATS_ALLOC(r, bytes);
+  return p;
+}
+
+static void roaring_data_free(roaring_t *r, roaring_container_t *c) {
+  if (!c->data) return;
+  gbc_free(r->alloc, c->data, roaring_data_bytes(c));
+  GBC_STATS_FREE(r, roaring_data_bytes(c));
+  c->data = NULL;
+}
+
+/// @brief give the array or the runs of c room for need entries
+static bool roaring_reserve(roaring_t *r, roaring_container_t *c,
+                            uint32_t need) {
+  if (need <= c->cap) return true;
+  uint32_t cap = c->cap ? c->cap : 4;
+  while (cap < need) cap *= 2;
+  size_t unit = roaring_unit(c);
+  void *p;
+  if (c->data) {
+    p = gbc_realloc(r->alloc, c->data, c->cap * unit, cap * unit);
+    if (!p) return false;
+    GBC_STATS_REALLOC(r, c->cap * unit, cap * unit);
+  } else {
+    p = roaring_data_alloc(r, cap * unit);
+    if (!p) return false;
+  }
+  c->data = p;
+  c->cap = cap;
+  return true;
+}
+
+/// @brief the first index of the sorted a whose value is not less than x
+static inline uint32_t roaring_array_lb(const uint16_t *a, uint32_t n,
+                                        uint16_t x) {
+  uint32_t lo = 0, hi = n;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (a[mid] < x) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/// @brief the first index of the runs starting after x, so x can only be in
+/// the run before it
+static inline uint32_t roaring_runs_ub(const roaring_run_t *runs, uint32_t n,
+                                       uint16_t x) {
+  uint32_t lo = 0, hi = n;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (runs[mid].start <= x) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static inline uint32_t roaring_run_end(const roaring_run_t *run) {
+  return (uint32_t)run->start + run->len;
+}
+
+/// @brief set the bits lo to hi, both included
+/// @return the number of bits that were not set
+static uint32_t roaring_bits_set_range(uint64_t *w, uint32_t lo,
+                                       uint32_t hi) {
+  uint32_t added = 0;
+  uint32_t first = lo >> 6, last = hi >> 6;
+  for (uint32_t i = first; i <= last; ++i) {
+    uint64_t mask = ~0ull;
+    if (i == first) mask &= ~0ull << (lo & 63);
+    if (i == last) mask &= ~0ull >> (63 - (hi & 63));
+    added += (uint32_t)__builtin_popcountll(mask & ~w[i]);
+    w[i] |= mask;
+  }
+  return added;
+}
+
+/// @brief the number of set bits from lo to hi, both included
+static uint32_t roaring_bits_count_range(const uint64_t *w, uint32_t lo,
+                                         uint32_t hi) {
+  uint32_t card = 0;
+  uint32_t first = lo >> 6, last = hi >> 6;
+  for (uint32_t i = first; i <= last; ++i) {
+    uint64_t mask = ~0ull;
+    if (i == first) mask &= ~0ull << (lo & 63);
+    if (i == last) mask &= ~0ull >> (63 - (hi & 63));
+    card += (uint32_t)__builtin_popcountll(mask & w[i]);
+  }
+  return card;
+}
+
+static uint32_t roaring_bits_count(const uint64_t *w) {
+  uint32_t card = 0;
+  for (size_t i = 0; i < ROARING_BITMAP_WORDS; ++i) {
+    card += (uint32_t)__builtin_popcountll(w[i]);
+  }
+  return card;
+}
+
+static bool roaring_c_contains(const roaring_container_t *c, uint16_t x) {
+  if (c->kind == ROARING_ARRAY) {
+    const uint16_t *a = (const uint16_t *)c->data;
+    uint32_t i = roaring_array_lb(a, c->n, x);
+    return i < c->n && a[i] == x;
+  }
+  if (c->kind == ROARING_BITMAP) {
+    return (((const uint64_t *)c->data)[x >> 6] >> (x & 63)) & 1;
+  }
+  const roaring_run_t *runs = (const roaring_run_t *)c->data;
+  uint32_t i = roaring_runs_ub(runs, c->n, x);
+  return i > 0 && x <= roaring_run_end(&runs[i - 1]);
+}
+
+/// @brief or the values of c into the bitmap w
+static void roaring_c_or_bits(const roaring_container_t *c, uint64_t *w) {
+  if (c->kind == ROARING_ARRAY) {
+    const uint16_t *a = (const uint16_t *)c->data;
+    for (uint32_t i = 0; i < c->n; ++i) w[a[i] >> 6] |= 1ull << (a[i] & 63);
+  } else if (c->kind == ROARING_BITMAP) {
+    const uint64_t *src = (const uint64_t *)c->data;
+    for (size_t i = 0; i < ROARING_BITMAP_WORDS; ++i) w[i] |= src[i];
+  } else {
+    const roaring_run_t *runs = (const roaring_run_t *)c->data;
+    for (uint32_t i = 0; i < c->n; ++i) {
+      roaring_bits_set_range(w, runs[i].start, roaring_run_end(&runs[i]));
+    }
+  }
+}
+
+/// @brief the values of c as a bitmap: its own, or scratch filled with them
+static const uint64_t *roaring_c_bits(const roaring_container_t *c,
+                                      uint64_t *scratch) {
+  if (c->kind == ROARING_BITMAP) return (const uint64_t *)c->data;
+  memset(scratch, 0, ROARING_BITMAP_BYTES);
+  roaring_c_or_bits(c, scratch);
+  return scratch;
+}
+
+/// @brief write the values of the bitmap w in ascending order to out
+static uint32_t roaring_bits_values(const uint64_t *w, uint16_t *out) {
+  uint32_t k = 0;
+  for (uint32_t i = 0; i < ROARING_BITMAP_WORDS; ++i) {
+    for (uint64_t word = w[i]; word; word &= word - 1) {
+      out[k++] = (uint16_t)((i << 6) | (uint32_t)__builtin_ctzll(word));
+    }
+  }
+  return k;
+}
+
+/// @brief turn c into a bitmap container
+static bool roaring_c_make_bitmap(roaring_t *r, roaring_container_t *c) {
+  uint64_t *w = (uint64_t *)roaring_data_alloc(r, ROARING_BITMAP_BYTES);
+  if (!w) return false;
+  memset(w, 0, ROARING_BITMAP_BYTES);
+  roaring_c_or_bits(c, w);
+  roaring_data_free(r, c);
+  c->kind = ROARING_BITMAP;
+  c->data = w;
+  c->n = 0;
+  c->cap = 0;
+  return true;
+}
+
+/// @brief turn c, of at most ROARING_ARRAY_MAX values, into an array
+static bool roaring_c_make_array(roaring_t *r, roaring_container_t *c) {
+  assert(c->card <= ROARING_ARRAY_MAX);
+  uint16_t *a = (uint16_t *)roaring_data_alloc(r, c->card * sizeof(uint16_t));
+  if (!a) return false;
+  if (c->kind == ROARING_BITMAP) {
+    roaring_bits_values((const uint64_t *)c->data, a);
+  } else {
+    const roaring_run_t *runs = (const roaring_run_t *)c->data;
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < c->n; ++i) {
+      for (uint32_t v = runs[i].start; v <= roaring_run_end(&runs[i]); ++v) {
+        a[k++] = (uint16_t)v;
+      }
+    }
+  }
+  roaring_data_free(r, c);
+  c->kind = ROARING_ARRAY;
+  c->data = a;
+  c->n = c->card;
+  c->cap = c->card;
+  return true;
+}
+
+/// @brief the number of runs the values of c make
+static uint32_t roaring_c_count_runs(const roaring_container_t *c) {
+  if (c->kind == ROARING_RUN) return c->n;
+  if (c->kind == ROARING_ARRAY) {
+    const uint16_t *a = (const uint16_t *)c->data;
+    uint32_t runs = 1;
+    for (uint32_t i = 1; i < c->n; ++i) runs += a[i] != a[i - 1] + 1;
+    return runs;
+  }
+  // a run starts at every set bit whose lower neighbour is clear
+  const uint64_t *w = (const uint64_t *)c->data;
+  uint32_t runs = 0;
+  uint64_t carry = 0;
+  for (size_t i = 0; i < ROARING_BITMAP_WORDS; ++i) {
+    runs += (uint32_t)__builtin_popcountll(w[i] & ~((w[i] << 1) | carry));
+    carry = w[i] >> 63;
+  }
+  return runs;
+}
+
+/// @brief turn the array or bitmap c into n_runs runs
+static bool roaring_c_make_runs(roaring_t *r, roaring_container_t *c,
+                                uint32_t n_runs) {
+  roaring_run_t *runs =
+      (roaring_run_t *)roaring_data_alloc(r, n_runs * sizeof(roaring_run_t));
+  if (!runs) return false;
+  uint32_t k = 0;
+  for (uint32_t i = 0, v = 0; i < c->card; ++i, ++v) {
+    if (c->kind == ROARING_ARRAY) {
+      v = ((const uint16_t *)c->data)[i];
+    } else {
+      // the next set bit from v on
+      const uint64_t *w = (const uint64_t *)c->data;
+      uint64_t word = w[v >> 6] & (~0ull << (v & 63));
+      while (!word) word = w[(v = (v | 63) + 1) >> 6];
+      v = (v & ~63u) | (uint32_t)__builtin_ctzll(word);
+    }
+    if (k > 0 && roaring_run_end(&runs[k - 1]) + 1 == v) {
+      runs[k - 1].len++;
+    } else {
+      runs[k].start = (uint16_t)v;
+      runs[k].len = 0;
+      k++;
+    }
+  }
+  assert(k == n_runs);
+  roaring_data_free(r, c);
+  c->kind = ROARING_RUN;
+  c->data = runs;
+  c->n = n_runs;
+  c->cap = n_runs;
+  return true;
+}
+
+/// @brief move c to the array or bitmap that suits its cardinality when it
+/// has outgrown its kind. Failing leaves c valid in its current kind
+static bool roaring_c_settle(roaring_t *r, roaring_container_t *c) {
+  if (c->kind == ROARING_BITMAP && c->card <= ROARING_ARRAY_MAX) {
+    return roaring_c_make_array(r, c);
+  }
+  if (c->kind == ROARING_RUN && c->n > ROARING_RUN_MAX) {
+    return c->card <= ROARING_ARRAY_MAX ? roaring_c_make_array(r, c)
+                                        : roaring_c_make_bitmap(r, c);
+  }
+  return true;
+}
+
+/// @brief move c to runs if they are smaller than the array or bitmap its
+/// cardinality calls for, or from runs to those if they are not
+static bool roaring_c_optimize(roaring_t *r, roaring_container_t *c) {
+  uint32_t n_runs = roaring_c_count_runs(c);
+  size_t run_bytes = n_runs * sizeof(roaring_run_t);
+  size_t best_bytes = c->card <= ROARING_ARRAY_MAX ? c->card * sizeof(uint16_t)
+                                                   : ROARING_BITMAP_BYTES;
+  if (c->kind != ROARING_RUN && run_bytes < best_bytes) {
+    return roaring_c_make_runs(r, c, n_runs);
+  }
+  if (c->kind == ROARING_RUN && run_bytes >= best_bytes) {
+    return c->card <= ROARING_ARRAY_MAX ? roaring_c_make_array(r, c)
+                                        : roaring_c_make_bitmap(r, c);
+  }
+  return true;
+}
+
+static bool roaring_c_add(roaring_t *r, roaring_container_t *c, uint16_t x);
+
+static bool roaring_run_add(roaring_t *r, roaring_container_t *c,
+                            uint16_t x) {
+  roaring_run_t *runs = (roaring_run_t *)c->data;
+  uint32_t i = roaring_runs_ub(runs, c->n, x);
+  if (i > 0 && x <= roaring_run_end(&runs[i - 1])) return false;
+  bool joins_prev = i > 0 && roaring_run_end(&runs[i - 1]) + 1 == x;
+  bool joins_next = i < c->n && (uint32_t)x + 1 == runs[i].start;
+  if (joins_prev && joins_next) {
+    runs[i - 1].len = (uint16_t)(roaring_run_end(&runs[i]) - runs[i - 1].start);
+    memmove(runs + i, runs + i + 1, (c->n - i - 1) * sizeof(roaring_run_t));
+    c->n--;
+  } else if (joins_prev) {
+    runs[i - 1].len++;
+  } else if (joins_next) {
+    runs[i].start = x;
+    runs[i].len++;
+  } else {
+    if (!roaring_reserve(r, c, c->n + 1)) return false;
+    runs = (roaring_run_t *)c->data;
+    memmove(runs + i + 1, runs + i, (c->n - i) * sizeof(roaring_run_t));
+    runs[i].start = x;
+    runs[i].len = 0;
+    c->n++;
+  }
+  c->card++;
+  roaring_c_settle(r, c);
+  return true;
+}
+
+static bool roaring_c_add(roaring_t *r, roaring_container_t *c, uint16_t x) {
+  if (c->kind == ROARING_ARRAY) {
+    uint16_t *a = (uint16_t *)c->data;
+    uint32_t i = roaring_array_lb(a, c->n, x);
+    if (i < c->n && a[i] == x) return false;
+    if (c->n == ROARING_ARRAY_MAX) {
+      if (!roaring_c_make_bitmap(r, c)) return false;
+      return roaring_c_add(r, c, x);
+    }
+    if (!roaring_reserve(r, c, c->n + 1)) return false;
+    a = (uint16_t *)c->data;
+    memmove(a + i + 1, a + i, (c->n - i) * sizeof(uint16_t));
+    a[i] = x;
+    c->n++;
+    c->card++;
+    return true;
+  }
+  if (c->kind == ROARING_BITMAP) {
+    uint64_t *w = (uint64_t *)c->data;
+    uint64_t bit = 1ull << (x & 63);
+    if (w[x >> 6] & bit) return false;
+    w[x >> 6] |= bit;
+    c->card++;
+    return true;
+  }
+  return roaring_run_add(r, c, x);
+}
+
+static bool roaring_c_del(roaring_t *r, roaring_container_t *c, uint16_t x) {
+  if (c->kind == ROARING_ARRAY) {
+    uint16_t *a = (uint16_t *)c->data;
+    uint32_t i = roaring_array_lb(a, c->n, x);
+    if (i == c->n || a[i] != x) return false;
+    memmove(a + i, a + i + 1, (c->n - i - 1) * sizeof(uint16_t));
+    c->n--;
+    c->card--;
+    return true;
+  }
+  if (c->kind == ROARING_BITMAP) {
+    uint64_t *w = (uint64_t *)c->data;
+    uint64_t bit = 1ull << (x & 63);
+    if (!(w[x >> 6] & bit)) return false;
+    w[x >> 6] &= ~bit;
+    c->card--;
+    if (c->card > 0) roaring_c_settle(r, c);
+    return true;
+  }
+  roaring_run_t *runs = (roaring_run_t *)c->data;
+  uint32_t i = roaring_runs_ub(runs, c->n, x);
+  if (i == 0 || x > roaring_run_end(&runs[i - 1])) return false;
+  roaring_run_t *run = &runs[i - 1];
+  uint32_t end = roaring_run_end(run);
+  if (run->len == 0) {
+    memmove(runs + i - 1, runs + i, (c->n - i) * sizeof(roaring_run_t));
+    c->n--;
+  } else if (x == run->start) {
+    run->start++;
+    run->len--;
+  } else if (x == end) {
+    run->len--;
+  } else {
+    // split the run around x
+    if (!roaring_reserve(r, c, c->n + 1)) return false;
+    runs = (roaring_run_t *)c->data;
+    run = &runs[i - 1];
+    memmove(runs + i + 1, runs + i, (c->n - i) * sizeof(roaring_run_t));
+    runs[i].start = (uint16_t)(x + 1);
+    runs[i].len = (uint16_t)(end - x - 1);
+    run->len = (uint16_t)(x - 1 - run->start);
+    c->n++;
+  }
+  c->card--;
+  if (c->card > 0) roaring_c_settle(r, c);
+  return true;
+}
+
+/// @brief the index of the container for key, or where it would be inserted
+static size_t roaring_key_lb(const roaring_t *r, uint16_t key) {
+  size_t lo = 0, hi = r->size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (r->cs[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static const roaring_container_t *roaring_find(const roaring_t *r,
+                                               uint16_t key) {
+  size_t i = roaring_key_lb(r, key);
+  return (i < r->size && r->cs[i].key == key) ? &r->cs[i] : NULL;
+}
+
+/// @brief insert an empty array container for key at idx, the caller fills
+/// it before the set is used again
+static roaring_container_t *roaring_insert_at(roaring_t *r, size_t idx,
+                                              uint16_t key) {
+  if (r->size == r->cap) {
+    size_t new_cap = r->cap * 2;
+    roaring_container_t *cs = (roaring_container_t *)gbc_realloc(
+        r->alloc, r->cs, r->cap * sizeof(roaring_container_t),
+        new_cap * sizeof(roaring_container_t));
+    if (!cs) return NULL;
+    GBC_STATS_REALLOC(r, r->cap * sizeof(roaring_container_t),
+                      new_cap * sizeof(roaring_container_t));
+    GBC_STATS_INC(r, grows);
+    r->cs = cs;
+    r->cap = new_cap;
+  }
+  memmove(r->cs + idx + 1, r->cs + idx,
+          (r->size - idx) * sizeof(roaring_container_t));
+  roaring_container_t *c = &r->cs[idx];
+  memset(c, 0, sizeof(*c));
+  c->key = key;
+  c->kind = ROARING_ARRAY;
+  r->size++;
+  return c;
+}
+
+static void roaring_remove_at(roaring_t *r, size_t idx) {
+  roaring_data_free(r, &r->cs[idx]);
+  memmove(r->cs + idx, r->cs + idx + 1,
+          (r->size - idx - 1) * sizeof(roaring_container_t));
+  r->size--;
+}
+
+roaring_t *roaring_new(void) { return roaring_new_ex(NULL); }
+
+roaring_t *roaring_new_ex(const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  roaring_t *r = (roaring_t *)gbc_alloc(alloc, sizeof(roaring_t));
+  if (!r) return NULL;
+  r->cs = (roaring_container_t *)gbc_alloc(
+      alloc, DEFAULT_ROARING_CAP * sizeof(roaring_container_t));
+  if (!r->cs) {
+    gbc_free(alloc, r, sizeof(roaring_t));
+    return NULL;
+  }
+  r->size = 0;
+  r->cap = DEFAULT_ROARING_CAP;
+  r->alloc = alloc;
+  GBC_STATS_INIT(r);
+  GBC_STATS_ALLOC(r, sizeof(roaring_t));
+  GBC_STATS_ALLOC(r, DEFAULT_ROARING_CAP * sizeof(roaring_container_t));
+  return r;
+}
+
+bool roaring_drop(roaring_t *r) {
+  if (!r) return false;
+  for (size_t i = 0; i < r->size; ++i) roaring_data_free(r, &r->cs[i]);
+  gbc_free(r->alloc, r->cs, r->cap * sizeof(roaring_container_t));
+  gbc_free(r->alloc, r, sizeof(roaring_t));
+  return true;
+}
+
+/// @brief append a copy of c to r, whose last key is below c's
+static bool roaring_append_copy(roaring_t *r, const roaring_container_t *c) {
+  roaring_container_t *d = roaring_insert_at(r, r->size, c->key);
+  if (!d) return false;
+  d->kind = c->kind;
+  d->cap = c->kind == ROARING_BITMAP ? 0 : c->n;
+  d->data = roaring_data_alloc(r, roaring_data_bytes(d));
+  if (!d->data) {
+    r->size--;
+    return false;
+  }
+  memcpy(d->data, c->data, roaring_data_bytes(d));
+  d->card = c->card;
+  d->n = c->n;
+  return true;
+}
+
+/// @brief append the k sorted values of vals as a container for key
+static bool roaring_append_values(roaring_t *r, uint16_t key,
+                                  const uint16_t *vals, uint32_t k) {
+  if (k == 0) return true;
+  roaring_container_t *c = roaring_insert_at(r, r->size, key);
+  if (!c || !roaring_reserve(r, c, k)) {
+    if (c) r->size--;
+    return false;
+  }
+  memcpy(c->data, vals, k * sizeof(uint16_t));
+  c->n = k;
+  c->card = k;
+  return true;
+}
+
+/// @brief append the values of the bitmap w as a container for key, an
+/// array if they are few enough
+static bool roaring_append_bits(roaring_t *r, uint16_t key, const uint64_t *w,
+                                uint16_t *scratch_vals) {
+  uint32_t card = roaring_bits_count(w);
+  if (card == 0) return true;
+  if (card <= ROARING_ARRAY_MAX) {
+    roaring_bits_values(w, scratch_vals);
+    return roaring_append_values(r, key, scratch_vals, card);
+  }
+  roaring_container_t *c = roaring_insert_at(r, r->size, key);
+  if (!c) return false;
+  c->kind = ROARING_BITMAP;
+  c->data = roaring_data_alloc(r, ROARING_BITMAP_BYTES);
+  if (!c->data) {
+    r->size--;
+    return false;
+  }
+  memcpy(c->data, w, ROARING_BITMAP_BYTES);
+  c->card = card;
+  return true;
+}
+
+roaring_t *roaring_clone(const roaring_t *r) {
+  assert(r);
+  roaring_t *out = roaring_new_ex(r->alloc);
+  if (!out) return NULL;
+  for (size_t i = 0; i < r->size; ++i) {
+    if (!roaring_append_copy(out, &r->cs[i])) {
+      roaring_drop(out);
+      return NULL;
+    }
+  }
+  return out;
+}
+
+bool roaring_add(roaring_t *r, uint32_t x) {
+  assert(r);
+  uint16_t key = (uint16_t)(x >> 16), low = (uint16_t)x;
+  size_t i = roaring_key_lb(r, key);
+  if (i < r->size && r->cs[i].key == key) {
+    return roaring_c_add(r, &r->cs[i], low);
+  }
+  roaring_container_t *c = roaring_insert_at(r, i, key);
+  if (!c) return false;
+  if (!roaring_reserve(r, c, 1)) {
+    roaring_remove_at(r, i);
+    return false;
+  }
+  ((uint16_t *)c->data)[0] = low;
+  c->n = 1;
+  c->card = 1;
+  return true;
+}
+
+/// @brief add the low values from to to, both included, to the container
+/// for key
+static bool roaring_c_add_range(roaring_t *r, uint16_t key, uint32_t from,
+                                uint32_t to) {
+  size_t i = roaring_key_lb(r, key);
+  roaring_container_t *c;
+  if (i == r->size || r->cs[i].key != key) {
+    c = roaring_insert_at(r, i, key);
+    if (!c) return false;
+    c->kind = ROARING_RUN;
+    if (!roaring_reserve(r, c, 1)) {
+      roaring_remove_at(r, i);
+      return false;
+    }
+    ((roaring_run_t *)c->data)[0].start = (uint16_t)from;
+    ((roaring_run_t *)c->data)[0].len = (uint16_t)(to - from);
+    c->n = 1;
+    c->card = to - from + 1;
+    return true;
+  }
+  c = &r->cs[i];
+  if (from == 0 && to == 0xffff) {
+    roaring_run_t *run = (roaring_run_t *)roaring_data_alloc(r, sizeof(*run));
+    if (!run) return false;
+    run->start = 0;
+    run->len = 0xffff;
+    roaring_data_free(r, c);
+    c->kind = ROARING_RUN;
+    c->data = run;
+    c->n = 1;
+    c->cap = 1;
+    c->card = 0x10000;
+    return true;
+  }
+  bool was_runs = c->kind == ROARING_RUN;
+  if (c->kind != ROARING_BITMAP && !roaring_c_make_bitmap(r, c)) return false;
+  c->card += roaring_bits_set_range((uint64_t *)c->data, from, to);
+  // ranges added to runs likely stay runs
+  if (was_runs) roaring_c_optimize(r, c);
+  roaring_c_settle(r, c);
+  return true;
+}
+
+bool roaring_add_range(roaring_t *r, uint32_t lo, uint32_t hi) {
+  assert(r && lo <= hi);
+  for (uint32_t key = lo >> 16;; ++key) {
+    uint32_t from = key == lo >> 16 ? lo & 0xffff : 0;
+    uint32_t to = key == hi >> 16 ? hi & 0xffff : 0xffff;
+    if (!roaring_c_add_range(r, (uint16_t)key, from, to)) return false;
+    if (key == hi >> 16) return true;
+  }
+}
+
+bool roaring_del(roaring_t *r, uint32_t x) {
+  assert(r);
+  size_t i = roaring_key_lb(r, (uint16_t)(x >> 16));
+  if (i == r->size || r->cs[i].key != (uint16_t)(x >> 16)) return false;
+  if (!roaring_c_del(r, &r->cs[i], (uint16_t)x)) return false;
+  if (r->cs[i].card == 0) roaring_remove_at(r, i);
+  return true;
+}
+
+bool roaring_contains(const roaring_t *r, uint32_t x) {
+  assert(r);
+  const roaring_container_t *c = roaring_find(r, (uint16_t)(x >> 16));
+  return c && roaring_c_contains(c, (uint16_t)x);
+}
+
+uint64_t roaring_cardinality(const roaring_t *r) {
+  assert(r);
+  uint64_t card = 0;
+  for (size_t i = 0; i < r->size; ++i) card += r->cs[i].card;
+  return card;
+}
+
+bool roaring_is_empty(const roaring_t *r) {
+  assert(r);
+  return r->size == 0;
+}
+
+size_t roaring_memory_usage(const roaring_t *r) {
+  assert(r);
+  size_t bytes = sizeof(roaring_t) + r->cap * sizeof(roaring_container_t);
+  for (size_t i = 0; i < r->size; ++i) bytes += roaring_data_bytes(&r->cs[i]);
+  return bytes;
+}
+
+bool roaring_run_optimize(roaring_t *r) {
+  assert(r);
+  bool ok = true;
+  for (size_t i = 0; i < r->size; ++i) {
+    ok = roaring_c_optimize(r, &r->cs[i]) && ok;
+  }
+  return ok;
+}
+
+bool roaring_stats(const roaring_t *r, gbc_stats_t *out) {
+  assert(r && out);
+  return GBC_STATS_READ(r, out);
+}
+
+/// @brief the values of the array c that are, or with keep false are not,
+/// in other
+static uint32_t roaring_array_filter(const roaring_container_t *c,
+                                     const roaring_container_t *other,
+                                     bool keep, uint16_t *out) {
+  const uint16_t *a = (const uint16_t *)c->data;
+  uint32_t k = 0;
+  for (uint32_t i = 0; i < c->n; ++i) {
+    if (roaring_c_contains(other, a[i]) == keep) out[k++] = a[i];
+  }
+  return k;
+}
+
+/// @brief append the runs of c1 and c2 as a run container for key: those
+/// of their intersection when both is true, else those of their union
+static bool roaring_c_runs_merge(roaring_t *out,
+                                 const roaring_container_t *c1,
+                                 const roaring_container_t *c2, bool both) {
+  const roaring_run_t *r1 = (const roaring_run_t *)c1->data;
+  const roaring_run_t *r2 = (const roaring_run_t *)c2->data;
+  roaring_container_t *c = roaring_insert_at(out, out->size, c1->key);
+  if (!c) return false;
+  c->kind = ROARING_RUN;
+  if (!roaring_reserve(out, c, c1->n + c2->n)) {
+    out->size--;
+    return false;
+  }
+  roaring_run_t *runs = (roaring_run_t *)c->data;
+  uint32_t i = 0, j = 0, k = 0, card = 0;
+  if (both) {
+    while (i < c1->n && j < c2->n) {
+      uint32_t end1 = roaring_run_end(&r1[i]), end2 = roaring_run_end(&r2[j]);
+      uint32_t lo = r1[i].start > r2[j].start ? r1[i].start : r2[j].start;
+      uint32_t hi = end1 < end2 ? end1 : end2;
+      if (lo <= hi) {
+        runs[k].start = (uint16_t)lo;
+        runs[k++].len = (uint16_t)(hi - lo);
+        card += hi - lo + 1;
+      }
+      // the run that ends first can not overlap anything after the other
+      if (end1 < end2) {
+        i++;
+      } else {
+        j++;
+      }
+    }
+  } else {
+    while (i < c1->n || j < c2->n) {
+      const roaring_run_t *next =
+          j == c2->n || (i < c1->n && r1[i].start <= r2[j].start) ? &r1[i++]
+                                                                  : &r2[j++];
+      uint32_t lo = next->start, hi = roaring_run_end(next);
+      if (k > 0 && lo <= roaring_run_end(&runs[k - 1]) + 1) {
+        uint32_t end = roaring_run_end(&runs[k - 1]);
+        if (hi > end) {
+          runs[k - 1].len = (uint16_t)(hi - runs[k - 1].start);
+          card += hi - end;
+        }
+      } else {
+        runs[k].start = (uint16_t)lo;
+        runs[k++].len = (uint16_t)(hi - lo);
+        card += hi - lo + 1;
+      }
+    }
+  }
+  if (k == 0) {
+    roaring_data_free(out, c);
+    out->size--;
+    return true;
+  }
+  c->n = k;
+  c->card = card;
+  // give back the room reserved for the worst case, keeping it on failure
+  void *p = gbc_realloc(out->alloc, c->data, c->cap * sizeof(roaring_run_t),
+                        k * sizeof(roaring_run_t));
+  if (p) {
+    GBC_STATS_REALLOC(out, c->cap * sizeof(roaring_run_t),
+                      k * sizeof(roaring_run_t));
+    c->data = p;
+    c->cap = k;
+  }
+  return true;
+}
+
+static bool roaring_c_and(roaring_t *out, const roaring_container_t *c1,
+                          const roaring_container_t *c2,
+                          roaring_scratch_t *s) {
+  if (c1->kind == ROARING_RUN && c2->kind == ROARING_RUN) {
+    return roaring_c_runs_merge(out, c1, c2, true);
+  }
+  if (c1->kind == ROARING_ARRAY || c2->kind == ROARING_ARRAY) {
+    // walk the smaller array and look its values up in the other container
+    const roaring_container_t *a = c1, *b = c2;
+    if (a->kind != ROARING_ARRAY || (b->kind == ROARING_ARRAY && b->n < a->n)) {
+      a = c2;
+      b = c1;
+    }
+    uint32_t k = roaring_array_filter(a, b, true, s->vals);
+    return roaring_append_values(out, c1->key, s->vals, k);
+  }
+  const uint64_t *w1 = roaring_c_bits(c1, s->a), *w2 = roaring_c_bits(c2, s->b);
+  for (size_t i = 0; i < ROARING_BITMAP_WORDS; ++i) s->a[i] = w1[i] & w2[i];
+  return roaring_append_bits(out, c1->key, s->a, s->vals);
+}
+
+static bool roaring_c_or(roaring_t *out, const roaring_container_t *c1,
+                         const roaring_container_t *c2, roaring_scratch_t *s) {
+  if (c1->kind == ROARING_RUN && c2->kind == ROARING_RUN) {
+    return roaring_c_runs_merge(out, c1, c2, false);
+  }
+  if (c1->kind == ROARING_ARRAY && c2->kind == ROARING_ARRAY &&
+      c1->n + c2->n <= ROARING_ARRAY_MAX) {
+    const uint16_t *a = (const uint16_t *)c1->data;
+    const uint16_t *b = (const uint16_t *)c2->data;
+    uint32_t i = 0, j = 0, k = 0;
+    while (i < c1->n && j < c2->n) {
+      if (a[i] < b[j]) {
+        s->vals[k++] = a[i++];
+      } else if (b[j] < a[i]) {
+        s->vals[k++] = b[j++];
+      } else {
+        s->vals[k++] = a[i++];
+        j++;
+      }
+    }
+    while (i < c1->n) s->vals[k++] = a[i++];
+    while (j < c2->n) s->vals[k++] = b[j++];
+    return roaring_append_values(out, c1->key, s->vals, k);
+  }
+  memset(s->a, 0, ROARING_BITMAP_BYTES);
+  roaring_c_or_bits(c1, s->a);
+  roaring_c_or_bits(c2, s->a);
+  return roaring_append_bits(out, c1->key, s->a, s->vals);
+}
+
+static bool roaring_c_diff(roaring_t *out, const roaring_container_t *c1,
+                           const roaring_container_t *c2,
+                           roaring_scratch_t *s) {
+  if (c1->kind == ROARING_ARRAY) {
+    uint32_t k = roaring_array_filter(c1, c2, false, s->vals);
+    return roaring_append_values(out, c1->key, s->vals, k);
+  }
+  memset(s->a, 0, ROARING_BITMAP_BYTES);
+  roaring_c_or_bits(c1, s->a);
+  if (c2->kind == ROARING_ARRAY) {
+    const uint16_t *b = (const uint16_t *)c2->data;
+    for (uint32_t i = 0; i < c2->n; ++i) {
+      s->a[b[i] >> 6] &= ~(1ull << (b[i] & 63));
+    }
+  } else {
+    const uint64_t *w2 = roaring_c_bits(c2, s->b);
+    for (size_t i = 0; i < ROARING_BITMAP_WORDS; ++i) s->a[i] &= ~w2[i];
+  }
+  return roaring_append_bits(out, c1->key, s->a, s->vals);
+}
+
+#define ROARING_OP_AND 0
+#define ROARING_OP_OR 1
+#define ROARING_OP_DIFF 2
+
+/// @brief merge the containers of a and b by key into a new set
+static roaring_t *roaring_merge(const roaring_t *a, const roaring_t *b,
+                                int op) {
+  assert(a && b);
+  roaring_t *out = roaring_new_ex(a->alloc);
+  roaring_scratch_t *s =
+      (roaring_scratch_t *)gbc_alloc(a->alloc, sizeof(roaring_scratch_t));
+  bool ok = out && s;
+  size_t i = 0, j = 0;
+  while (ok && (i < a->size || j < b->size)) {
+    const roaring_container_t *ca = i < a->size ? &a->cs[i] : NULL;
+    const roaring_container_t *cb = j < b->size ? &b->cs[j] : NULL;
+    if (ca && (!cb || ca->key < cb->key)) {
+      // only in a
+      if (op != ROARING_OP_AND) ok = roaring_append_copy(out, ca);
+      i++;
+    } else if (!ca || cb->key < ca->key) {
+      if (op == ROARING_OP_OR) ok = roaring_append_copy(out, cb);
+      j++;
+    } else {
+      size_t before = out->size;
+      if (op == ROARING_OP_AND) {
+        ok = roaring_c_and(out, ca, cb, s);
+      } else if (op == ROARING_OP_OR) {
+        ok = roaring_c_or(out, ca, cb, s);
+      } else {
+        ok = roaring_c_diff(out, ca, cb, s);
+      }
+      // a result built from runs is often a few runs itself, and the array
+      // and bitmap paths never make them
+      if (ok && out->size > before &&
+          (ca->kind == ROARING_RUN || cb->kind == ROARING_RUN)) {
+        ok = roaring_c_optimize(out, &out->cs[out->size - 1]);
+      }
+      i++;
+      j++;
+    }
+    if (op == ROARING_OP_AND && (i == a->size || j == b->size)) break;
+  }
+  if (s) gbc_free(a->alloc, s, sizeof(roaring_scratch_t));
+  if (!ok) {
+    roaring_drop(out);
+    return NULL;
+  }
+  return out;
+}
+
+roaring_t *roaring_intersection(const roaring_t *a, const roaring_t *b) {
+  return roaring_merge(a, b, ROARING_OP_AND);
+}
+
+roaring_t *roaring_union(const roaring_t *a, const roaring_t *b) {
+  return roaring_merge(a, b, ROARING_OP_OR);
+}
+
+roaring_t *roaring_diff(const roaring_t *a, const roaring_t *b) {
+  return roaring_merge(a, b, ROARING_OP_DIFF);
+}
+
+/// @brief the number of values in both c1 and c2, neither of them an array
+static uint32_t roaring_c_and_count(const roaring_container_t *c1,
+                                    const roaring_container_t *c2) {
+  uint32_t card = 0;
+  if (c1->kind == ROARING_BITMAP && c2->kind == ROARING_BITMAP) {
+    const uint64_t *w1 = (const uint64_t *)c1->data;
+    const uint64_t *w2 = (const uint64_t *)c2->data;
+    for (size_t k = 0; k < ROARING_BITMAP_WORDS; ++k) {
+      card += (uint32_t)__builtin_popcountll(w1[k] & w2[k]);
+    }
+    return card;
+  }
+  if (c1->kind == ROARING_BITMAP || c2->kind == ROARING_BITMAP) {
+    const roaring_container_t *bits = c1->kind == ROARING_BITMAP ? c1 : c2;
+    const roaring_container_t *other = bits == c1 ? c2 : c1;
+    const roaring_run_t *runs = (const roaring_run_t *)other->data;
+    for (uint32_t k = 0; k < other->n; ++k) {
+      card += roaring_bits_count_range((const uint64_t *)bits->data,
+                                       runs[k].start,
+                                       roaring_run_end(&runs[k]));
+    }
+    return card;
+  }
+  const roaring_run_t *r1 = (const roaring_run_t *)c1->data;
+  const roaring_run_t *r2 = (const roaring_run_t *)c2->data;
+  uint32_t i = 0, j = 0;
+  while (i < c1->n && j < c2->n) {
+    uint32_t end1 = roaring_run_end(&r1[i]), end2 = roaring_run_end(&r2[j]);
+    uint32_t lo = r1[i].start > r2[j].start ? r1[i].start : r2[j].start;
+    uint32_t hi = end1 < end2 ? end1 : end2;
+    if (lo <= hi) card += hi - lo + 1;
+    if (end1 < end2) {
+      i++;
+    } else {
+      j++;
+    }
+  }
+  return card;
+}
+
+uint64_t roaring_intersection_cardinality(const roaring_t *a,
+                                          const roaring_t *b) {
+  assert(a && b);
+  uint64_t card = 0;
+  size_t i = 0, j = 0;
+  while (i < a->size && j < b->size) {
+    const roaring_container_t *ca = &a->cs[i], *cb = &b->cs[j];
+    if (ca->key != cb->key) {
+      if (ca->key < cb->key) {
+        i++;
+      } else {
+        j++;
+      }
+      continue;
+    }
+    if (ca->kind == ROARING_ARRAY || cb->kind == ROARING_ARRAY) {
+      const roaring_container_t *arr = ca->kind == ROARING_ARRAY ? ca : cb;
+      const roaring_container_t *other = arr == ca ? cb : ca;
+      const uint16_t *v = (const uint16_t *)arr->data;
+      for (uint32_t k = 0; k < arr->n; ++k) {
+        card += roaring_c_contains(other, v[k]);
+      }
+    } else {
+      card += roaring_c_and_count(ca, cb);
+    }
+    i++;
+    j++;
+  }
+  return card;
+}
+
+static inline size_t roaring_file_data_bytes(uint16_t kind, uint32_t n) {
+  if (kind == ROARING_ARRAY) return n * sizeof(uint16_t);
+  if (kind == ROARING_BITMAP) return ROARING_BITMAP_BYTES;
+  return n * sizeof(roaring_run_t);
+}
+
+size_t roaring_serialized_size(const roaring_t *r) {
+  assert(r);
+  size_t len = sizeof(roaring_file_header_t) +
+               r->size * sizeof(roaring_file_container_t);
+  for (size_t i = 0; i < r->size; ++i) {
+    len += roaring_file_data_bytes(r->cs[i].kind, r->cs[i].n);
+  }
+  return len;
+}
+
+size_t roaring_serialize(const roaring_t *r, void *_buf) {
+  assert(r && _buf);
+  char *buf = (char *)_buf;
+  size_t off = sizeof(roaring_file_header_t);
+  for (size_t i = 0; i < r->size; ++i) {
+    const roaring_container_t *c = &r->cs[i];
+    roaring_file_container_t fc = {.key = c->key, .kind = c->kind, .n = 0};
+    if (c->kind != ROARING_BITMAP) fc.n = c->n;
+    memcpy(buf + off, &fc, sizeof(fc));
+    off += sizeof(fc);
+  }
+  for (size_t i = 0; i < r->size; ++i) {
+    const roaring_container_t *c = &r->cs[i];
+    size_t bytes = roaring_file_data_bytes(c->kind, c->n);
+    memcpy(buf + off, c->data, bytes);
+    off += bytes;
+  }
+  roaring_file_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ROARING_FILE_MAGIC, sizeof(header.magic));
+  header.count = r->size;
+  header.cardinality = roaring_cardinality(r);
+  header.checksum =
+      vec_file_checksum(buf + sizeof(header), off - sizeof(header));
+  memcpy(buf, &header, sizeof(header));
+  return off;
+}
+
+/// @brief check the loaded container c and compute its cardinality
+static bool roaring_c_check(roaring_container_t *c) {
+  if (c->kind == ROARING_ARRAY) {
+    const uint16_t *a = (const uint16_t *)c->data;
+    if (c->n == 0 || c->n > ROARING_ARRAY_MAX) return false;
+    for (uint32_t i = 1; i < c->n; ++i) {
+      if (a[i] <= a[i - 1]) return false;
+    }
+    c->card = c->n;
+  } else if (c->kind == ROARING_BITMAP) {
+    // a set never holds a bitmap its values fit in an array for
+    c->card = roaring_bits_count((const uint64_t *)c->data);
+    if (c->card <= ROARING_ARRAY_MAX) return false;
+  } else {
+    const roaring_run_t *runs = (const roaring_run_t *)c->data;
+    if (c->n == 0 || c->n > 0x8000) return false;
+    c->card = 0;
+    for (uint32_t i = 0; i < c->n; ++i) {
+      if (roaring_run_end(&runs[i]) > 0xffff) return false;
+      if (i > 0 && runs[i].start <= roaring_run_end(&runs[i - 1]) + 1) {
+        return false;
+      }
+      c->card += (uint32_t)runs[i].len + 1;
+    }
+  }
+  return true;
+}
+
+roaring_t *roaring_deserialize(const void *_buf, size_t len) {
+  assert(_buf);
+  const char *buf = (const char *)_buf;
+  roaring_file_header_t header;
+  if (len < sizeof(header)) return NULL;
+  memcpy(&header, buf, sizeof(header));
+  if (memcmp(header.magic, ROARING_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.count > 0x10000 ||
+      header.count * sizeof(roaring_file_container_t) >
+          len - sizeof(header) ||
+      vec_file_checksum(buf + sizeof(header), len - sizeof(header)) !=
+          header.checksum) {
+    return NULL;
+  }
+  roaring_t *r = roaring_new();
+  if (!r) return NULL;
+  const char *descs = buf + sizeof(header);
+  size_t off = sizeof(header) + header.count * sizeof(roaring_file_container_t);
+  bool ok = true;
+  for (size_t i = 0; ok && i < header.count; ++i) {
+    roaring_file_container_t fc;
+    memcpy(&fc, descs + i * sizeof(fc), sizeof(fc));
+    size_t bytes = roaring_file_data_bytes(fc.kind, fc.n);
+    ok = fc.kind <= ROARING_RUN && (fc.kind == ROARING_BITMAP) == (fc.n == 0) &&
+         (i == 0 || fc.key > r->cs[r->size - 1].key) && bytes <= len - off;
+    if (!ok) break;
+    roaring_container_t *c = roaring_insert_at(r, r->size, fc.key);
+    ok = c != NULL;
+    if (!ok) break;
+    c->kind = (uint8_t)fc.kind;
+    c->n = fc.kind == ROARING_BITMAP ? 0 : fc.n;
+    c->cap = c->n;
+    c->data = roaring_data_alloc(r, bytes);
+    if (!c->data) {
+      r->size--;
+      ok = false;
+      break;
+    }
+    memcpy(c->data, buf + off, bytes);
+    off += bytes;
+    ok = roaring_c_check(c);
+  }
+  if (!ok || off != len || roaring_cardinality(r) != header.cardinality) {
+    roaring_drop(r);
+    return NULL;
+  }
+  return r;
+}
+
+bool roaring_save(const roaring_t *r, const char *path) {
+  assert(r && path);
+  size_t len = roaring_serialized_size(r);
+  char *buf = (char *)malloc(len);
+  if (!buf) return false;
+  roaring_serialize(r, buf);
+  FILE *f = fopen(path, "wb");
+  bool ok = f && fwrite(buf, len, 1, f) == 1;
+  if (f && fclose(f) != 0) ok = false;
+  free(buf);
+  return ok;
+}
+
+roaring_t *roaring_load(const char *path) {
+  assert(path);
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+  struct stat st;
+  char *buf = NULL;
+  bool ok = fstat(fileno(f), &st) == 0 && st.st_size > 0 &&
+            (buf = (char *)malloc((size_t)st.st_size)) != NULL &&
+            fread(buf, (size_t)st.st_size, 1, f) == 1;
+  fclose(f);
+  roaring_t *r = ok ? roaring_deserialize(buf, (size_t)st.st_size) : NULL;
+  free(buf);
+  return r;
+}
+
+/// @brief decode up to max values from the iterator position into out
+static size_t roaring_iter_fill(roaring_iter_t *iter, uint32_t *out,
+                                size_t max) {
+  const roaring_t *r = iter->r;
+  size_t k = 0;
+  while (k < max && iter->ci < r->size) {
+    const roaring_container_t *c = &r->cs[iter->ci];
+    uint32_t high = (uint32_t)c->key << 16;
+    if (c->kind == ROARING_ARRAY) {
+      const uint16_t *a = (const uint16_t *)c->data;
+      while (k < max && iter->seen < c->n) out[k++] = high | a[iter->seen++];
+    } else if (c->kind == ROARING_BITMAP) {
+      // pos is the next bit to look at
+      const uint64_t *w = (const uint64_t *)c->data;
+      while (k < max && iter->seen < c->card) {
+        uint32_t i = iter->pos >> 6;
+        uint64_t word = w[i] & (~0ull << (iter->pos & 63));
+        while (!word) word = w[++i];
+        uint32_t bit = (i << 6) | (uint32_t)__builtin_ctzll(word);
+        out[k++] = high | bit;
+        iter->pos = bit + 1;
+        iter->seen++;
+      }
+    } else {
+      // pos is the run, run_off the offset in it
+      const roaring_run_t *runs = (const roaring_run_t *)c->data;
+      while (k < max && iter->seen < c->card) {
+        out[k++] = high | (runs[iter->pos].start + iter->run_off);
+        if (iter->run_off == runs[iter->pos].len) {
+          iter->pos++;
+          iter->run_off = 0;
+        } else {
+          iter->run_off++;
+        }
+        iter->seen++;
+      }
+    }
+    if (iter->seen == c->card) {
+      iter->ci++;
+      iter->pos = 0;
+      iter->run_off = 0;
+      iter->seen = 0;
+    }
+  }
+  return k;
+}
+
+bool _roaring_iter_has_next(const iter_t *_iter) {
+  const roaring_iter_t *iter = (roaring_iter_t *)_iter;
+  return iter->ci < iter->r->size;
+}
+
+void *_roaring_iter_next(iter_t *_iter) {
+  roaring_iter_t *iter = (roaring_iter_t *)_iter;
+  if (roaring_iter_fill(iter, &iter->value, 1) == 0) return NULL;
+  return &iter->value;
+}
+
+/// a span of values decoded into the iterator's buffer
+size_t _roaring_iter_next_batch(iter_t *_iter, iter_batch_t *batch,
+                                size_t max) {
+  roaring_iter_t *iter = (roaring_iter_t *)_iter;
+  if (max > ITER_BATCH_MAX) max = ITER_BATCH_MAX;
+  batch->len = roaring_iter_fill(iter, iter->buf, max);
+  batch->span = batch->len ? (char *)iter->buf : NULL;
+  return batch->len;
+}
+
+void roaring_iter_init(roaring_iter_t *iter, const roaring_t *r) {
+  assert(iter && r);
+  iter_t base = {.obj_size = sizeof(uint32_t),
+                 .has_next = _roaring_iter_has_next,
+                 .next = _roaring_iter_next,
+                 .next_batch = _roaring_iter_next_batch};
+  iter->base = base;
+  iter->r = r;
+  iter->ci = 0;
+  iter->pos = 0;
+  iter->run_off = 0;
+  iter->seen = 0;
+  iter->alloc = NULL;
+}
+
+void roaring_iter_fini(roaring_iter_t *iter) {
+  assert(iter && !iter->alloc);
+  iter->r = NULL;
+}
+
+roaring_iter_t *roaring_iter_new(const roaring_t *r) {
+  assert(r);
+  roaring_iter_t *iter =
+      (roaring_iter_t *)gbc_alloc(r->alloc, sizeof(roaring_iter_t));
+  if (!iter) return NULL;
+  roaring_iter_init(iter, r);
+  iter->alloc = r->alloc;
+  return iter;
+}
+
+bool roaring_iter_drop(roaring_iter_t *iter) {
+  if (!iter) return false;
+  gbc_free(iter->alloc, iter, sizeof(roaring_iter_t));
+  return true;
+}
+
+bool roaring_iter_has_next(const roaring_iter_t *iter) {
+  return iter->base.has_next((iter_t *)iter);
+}
+
+void *roaring_iter_next(roaring_iter_t *iter) {
+  return iter->base.next((iter_t *)iter);
+}
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef _GBC_SEGVEC_H
+#define _GBC_SEGVEC_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gbc_alloc.h"
+#include "gbc_iterator.h"
+#include "gbc_probes.h"
+#include "gbc_stats.h"
+
+// chunk k holds SEGVEC_FIRST_CHUNK << k elements, a power of two
+#define SEGVEC_FIRST_CHUNK_LOG2 3
+#define SEGVEC_FIRST_CHUNK (1u << SEGVEC_FIRST_CHUNK_LOG2)
+#define SEGVEC_MAX_CHUNKS (64 - SEGVEC_FIRST_CHUNK_LOG2)
+
+/// @brief The segmented vector. Elements live in chunks which double in
+/// size, chunk k holding SEGVEC_FIRST_CHUNK << k elements, so growing only
+/// allocates the next chunk: an element never moves once pushed and its
+/// address stays valid until it is deleted. Indexing finds the chunk with a
+/// bit scan of the index, in O(1)
+/// @param size_t n_chunks: the number of chunks allocated
+/// @param char* chunks[]: the chunk table
+/// @param alloc: the allocator of the chunks and of the vector itself
+typedef struct _segvec {
+  size_t size;
+  size_t obj_size;
+  size_t n_chunks;
+  char *chunks[SEGVEC_MAX_CHUNKS];
+  const gbc_allocator_t *alloc;
+  GBC_STATS_FIELD
+} segvec_t;
+
+/// @brief The segmented vector iterator
+typedef struct _segvec_iter {
+  iter_t base;
+  size_t cur_idx;
+  segvec_t *vec;
+  const gbc_allocator_t *alloc;
+} segvec_iter_t;
+
+/// @brief create a new segmented vector
+/// @param obj_size the size of each element
+/// @return
+segvec_t *segvec_new(size_t obj_size);
+
+/// @brief create a new segmented vector whose memory comes from alloc
+/// @param obj_size
+/// @param alloc: NULL for malloc/free
+/// @return
+segvec_t *segvec_new_ex(size_t obj_size, const gbc_allocator_t *alloc);
+
+/// @brief drop the segmented vector out of memory
+/// @param vec
+/// @return
+bool segvec_drop(segvec_t *vec);
+
+/// @brief get the number of elements
+/// @param vec
+/// @return
+size_t segvec_length(const segvec_t *vec);
+
+/// @brief get the number of elements the allocated chunks can hold
+/// @param vec
+/// @return
+size_t segvec_capacity(const segvec_t *vec);
+
+/// @brief allocate chunks until cap elements fit, so the following pushes
+/// never allocate
+/// @param vec
+/// @param cap
+/// @return
+bool segvec_reserve(segvec_t *vec, size_t cap);
+
+/// @brief push one element into the vector, no element is moved
+/// @param vec
+/// @param data
+/// @return
+bool segvec_push(segvec_t *vec, const void *data);
+
+/// @brief delete the top element, its chunk is kept for the next pushes
+/// @param vec
+/// @return
+bool segvec_del_top(segvec_t *vec);
+
+/// @brief check the top element in the vector
+/// @param vec
+/// @return
+const void *segvec_top(const segvec_t *vec);
+
+/// @brief get the const pointer of the element at idx, stable until the
+/// element is deleted
+/// @param vec
+/// @param idx
+/// @return
+const void *segvec_at(const segvec_t *vec, size_t idx);
+
+/// @brief get the mutable pointer of the element at idx, stable until the
+/// element is deleted
+/// @param vec
+/// @param idx
+/// @return
+void *segvec_at_mut(segvec_t *vec, size_t idx);
+
+/// @brief update the element at idx
+/// @param vec
+/// @param idx
+/// @param value
+/// @return
+bool segvec_update(segvec_t *vec, size_t idx, const void *value);
+
+/// @brief apply fn to every element in order, a chunk at a time
+/// @param vec
+/// @param fn
+void segvec_foreach(const segvec_t *vec, void (*fn)(const void *));
+
+/// @brief read the operation counters of the vector
+/// @param vec
+/// @param out
+/// @return return false, with out zeroed, unless built with GBC_STATS
+bool segvec_stats(const segvec_t *vec, gbc_stats_t *out);
+
+/// @brief create a segvec_iter_t
+/// @param vec
+/// @return
+segvec_iter_t *segvec_iter_new(segvec_t *vec);
+
+/// @brief set up an iterator provided by the caller, e.g. on the stack, so
+/// iterating allocates nothing. Finish it with segvec_iter_fini, not
+/// segvec_iter_drop
+/// @param iter
+/// @param vec
+void segvec_iter_init(segvec_iter_t *iter, segvec_t *vec);
+
+/// @brief finish an iterator set up by segvec_iter_init
+/// @param iter
+void segvec_iter_fini(segvec_iter_t *iter);
+
+/// @brief drop a segvec_iter_t
+/// @param iter
+/// @return
+bool segvec_iter_drop(segvec_iter_t *iter);
+
+/// @brief to check if the segvec_iter_t has next element
+/// @param iter
+/// @return
+bool segvec_iter_has_next(const segvec_iter_t *iter);
+
+/// @brief get the next element
+/// @param iter
+/// @return
+void *segvec_iter_next(segvec_iter_t *iter);
+
+static inline size_t segvec_chunk_cap(size_t k) {
+  return (size_t)SEGVEC_FIRST_CHUNK << k;
+}
+
+/// @brief index of the highest set bit of x, x must not be 0
+static inline size_t segvec_log2(size_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(x);
+#else
+  size_t r = 0;
+  while (x >>= 1) r++;
+  return r;
+#endif
+}
+
+/// @brief find the chunk of idx and its offset inside it. Shifted by the
+/// first chunk size, the indices of chunk k are [2^(k+b), 2^(k+b+1)), so the
+/// highest set bit names the chunk
+static inline char *segvec_slot(const segvec_t *vec, size_t idx) {
+  size_t j = idx + SEGVEC_FIRST_CHUNK;
+  size_t high = segvec_log2(j);
+  size_t k = high - SEGVEC_FIRST_CHUNK_LOG2;
+  size_t offset = j - ((size_t)1 << high);
+  return vec->chunks[k] + offset * vec->obj_size;
+}
+
+static bool segvec_add_chunk(segvec_t *vec) {
+  size_t k = vec->n_chunks;
+  if (k == SEGVEC_MAX_CHUNKS) return false;
+  size_t bytes = segvec_chunk_cap(k) * vec->obj_size;
+  char *chunk = (char *)gbc_alloc(vec->alloc, bytes);
+  if (!chunk) return false;
+  GBC_STATS_ALLOC(vec, bytes);
+  GBC_STATS_INC(vec, grows);
+  GBC_PROBE4(segvec_grow, vec, segvec_capacity(vec),
+             segvec_capacity(vec) + segvec_chunk_cap(k), 0);
+  vec->chunks[k] = chunk;
+  vec->n_chunks++;
+  return true;
+}
+
+segvec_t *segvec_new(size_t obj_size) { return segvec_new_ex(obj_size, NULL); }
+
+segvec_t *segvec_new_ex(size_t obj_size, const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  segvec_t *vec = (segvec_t *)gbc_alloc(alloc, sizeof(segvec_t));
+  if (!vec) return NULL;
+  vec->size = 0;
+  vec->obj_size = obj_size;
+  vec->n_chunks = 0;
+  vec->alloc = alloc;
+  GBC_STATS_INIT(vec);
+  GBC_STATS_ALLOC(vec, sizeof(segvec_t));
+  return vec;
+}
+
+bool segvec_drop(segvec_t *vec) {
+  if (!vec) return false;
+  for (size_t k = 0; k < vec->n_chunks; ++k) {
+    gbc_free(vec->alloc, vec->chunks[k], segvec_chunk_cap(k) * vec->obj_size);
+  }
+  gbc_free(vec->alloc, vec, sizeof(segvec_t));
+  return true;
+}
+
+size_t segvec_length(const segvec_t *vec) {
+  assert(vec);
+  return vec->size;
+}
+
+size_t segvec_capacity(const segvec_t *vec) {
+  assert(vec);
+  // the chunks double, so n of them hold FIRST * (2^n - 1) elements
+  return (size_t)SEGVEC_FIRST_CHUNK * (((size_t)1 << vec->n_chunks) - 1);
+}
+
+bool segvec_reserve(segvec_t *vec, size_t cap) {
+  assert(vec);
+  while (segvec_capacity(vec) < cap) {
+    if (!segvec_add_chunk(vec)) return false;
+  }
+  return true;
+}
+
+bool segvec_push(segvec_t *vec, const void *data) {
+  assert(vec && data);
+  if (vec->size == segvec_capacity(vec) && !segvec_add_chunk(vec)) {
+    return false;
+  }
+  memcpy(segvec_slot(vec, vec->size), data, vec->obj_size);
+  vec->size++;
+  return true;
+}
+
+bool segvec_del_top(segvec_t *vec) {
+  assert(vec);
+  if (vec->size == 0) return false;
+  vec->size--;
+  return true;
+}
+
+const void *segvec_top(const segvec_t *vec) {
+  assert(vec);
+  if (vec->size == 0) return NULL;
+  return segvec_slot(vec, vec->size - 1);
+}
+
+const void *segvec_at(const segvec_t *vec, size_t idx) {
+  assert(vec && vec->size > idx);
+  return segvec_slot(vec, idx);
+}
+
+void *segvec_at_mut(segvec_t *vec, size_t idx) {
+  assert(vec && vec->size > idx);
+  return segvec_slot(vec, idx);
+}
+
+bool segvec_update(segvec_t *vec, size_t idx, const void *value) {
+  assert(vec && value);
+  if (idx >= vec->size) return false;
+  memcpy(segvec_slot(vec, idx), value, vec->obj_size);
+  return true;
+}
+
+void segvec_foreach(const segvec_t *vec, void (*fn)(const void *)) {
+  assert(vec && fn);
+  size_t left = vec->size;
+  for (size_t k = 0; left > 0; ++k) {
+    size_t n = segvec_chunk_cap(k) < left ? segvec_chunk_cap(k) : left;
+    const char *chunk = vec->chunks[k];
+    for (size_t i = 0; i < n; ++i) fn(chunk + i * vec->obj_size);
+    left -= n;
+  }
+}
+
+bool segvec_stats(const segvec_t *vec, gbc_stats_t *out) {
+  assert(vec && out);
+  return GBC_STATS_READ(vec, out);
+}
+
+bool _segvec_iter_has_next(const iter_t *_iter) {
+  const segvec_iter_t *iter = (segvec_iter_t *)_iter;
+  return iter->cur_idx < iter->vec->size;
+}
+
+void *_segvec_iter_next(iter_t *_iter) {
+  segvec_iter_t *iter = (segvec_iter_t *)_iter;
+  if (!_segvec_iter_has_next(_iter)) return NULL;
+  return segvec_slot(iter->vec, iter->cur_idx++);
+}
+
+/// a span runs up to the end of the current chunk
+size_t _segvec_iter_next_batch(iter_t *_iter, iter_batch_t *batch,
+                               size_t max) {
+  segvec_iter_t *iter = (segvec_iter_t *)_iter;
+  segvec_t *vec = iter->vec;
+  size_t len = vec->size - iter->cur_idx;
+  if (len == 0 || max == 0) {
+    batch->span = NULL;
+    return batch->len = 0;
+  }
+  // the chunk of cur_idx ends where idx + FIRST reaches the next power of two
+  size_t j = iter->cur_idx + SEGVEC_FIRST_CHUNK;
+  size_t chunk_left = ((size_t)2 << segvec_log2(j)) - j;
+  if (len > chunk_left) len = chunk_left;
+  if (len > max) len = max;
+  batch->span = segvec_slot(vec, iter->cur_idx);
+  batch->len = len;
+  iter->cur_idx += len;
+  return len;
+}
+
+void segvec_iter_init(segvec_iter_t *iter, segvec_t *vec) {
+  assert(iter && vec);
+  iter_t base = {.obj_size = vec->obj_size,
+                 .has_next = _segvec_iter_has_next,
+                 .next = _segvec_iter_next,
+                 .next_batch = _segvec_iter_next_batch};
+  iter->base = base;
+  iter->cur_idx = 0;
+  iter->vec = vec;
+  iter->alloc = NULL;
+  GBC_PROBE3(iter_new, vec, iter, vec->size);
+}
+
+void segvec_iter_fini(segvec_iter_t *iter) {
+  assert(iter && !iter->alloc);
+  iter->vec = NULL;
+}
+
+segvec_iter_t *segvec_iter_new(segvec_t *vec) {
+  assert(vec);
+  segvec_iter_t *iter =
+      (segvec_iter_t *)gbc_alloc(vec->alloc, sizeof(segvec_iter_t));
+  if (!iter) return NULL;
+  segvec_iter_init(iter, vec);
+  iter->alloc = vec->alloc;
+  return iter;
+}
+
+bool segvec_iter_drop(segvec_iter_t *iter) {
+  if (!iter) return false;
+  gbc_free(iter->alloc, iter, sizeof(segvec_iter_t));
+  return true;
+}
+
+bool segvec_iter_has_next(const segvec_iter_t *iter) {
+  return iter->base.has_next((iter_t *)iter);
+}
+
+void *segvec_iter_next(segvec_iter_t *iter) {
+  return iter->base.next((iter_t *)iter);
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef _GBC_STATS_H
+#define _GBC_STATS_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief the operation counters and memory statistics of a container. They
+/// are only maintained when GBC_STATS is defined before including any GBC
+/// header; otherwise the containers carry no counters and the query
+/// functions report zeros
+/// @param size_t allocs: allocations made, a realloc counts as one
+/// @param size_t frees: allocations released
+/// @param size_t bytes: live bytes held by the container
+/// @param size_t peak_bytes: the highest value bytes has reached
+/// @param size_t grows: buffer grow or relinearize events
+/// @param size_t rotations: avl rotations
+/// @param size_t cmp_calls: key comparisons
+/// @param size_t max_depth: the deepest avl insertion, the root being 1
+/// @param size_t filter_skips: avl lookups a filter answered with no descent
+typedef struct _gbc_stats {
+  size_t allocs;
+  size_t frees;
+  size_t bytes;
+  size_t peak_bytes;
+  size_t grows;
+  size_t rotations;
+  size_t cmp_calls;
+  size_t max_depth;
+  size_t filter_skips;
+} gbc_stats_t;
+
+#ifdef GBC_STATS
+
+/// @brief the member a container struct gets in GBC_STATS mode
+#define GBC_STATS_FIELD gbc_stats_t stats;
+
+// the counters are bookkeeping, so they are updated through const containers
+#define _gbc_stats_of(obj) ((gbc_stats_t *)&(obj)->stats)
+
+#define GBC_STATS_INIT(obj) memset(_gbc_stats_of(obj), 0, sizeof(gbc_stats_t))
+
+#define GBC_STATS_INC(obj, field) (_gbc_stats_of(obj)->field++)
+
+#define GBC_STATS_MAX(obj, field, value)                          \
+  ((_gbc_stats_of(obj)->field < (size_t)(value))                 \
+       ? (void)(_gbc_stats_of(obj)->field = (size_t)(value))      \
+       : (void)0)
+
+#define GBC_STATS_ALLOC(obj, n)                                   \
+  (_gbc_stats_of(obj)->allocs++, _gbc_stats_of(obj)->bytes += (n), \
+   GBC_STATS_MAX(obj, peak_bytes, _gbc_stats_of(obj)->bytes))
+
+#define GBC_STATS_FREE(obj, n) \
+  (_gbc_stats_of(obj)->frees++, _gbc_stats_of(obj)->bytes -= (n))
+
+#define GBC_STATS_REALLOC(obj, old_n, new_n)                          \
+  (_gbc_stats_of(obj)->allocs++,                                     \
+   _gbc_stats_of(obj)->bytes = _gbc_stats_of(obj)->bytes - (old_n) + \
+                               (new_n),                              \
+   GBC_STATS_MAX(obj, peak_bytes, _gbc_stats_of(obj)->bytes))
+
+/// @brief copy the counters of obj into out, evaluates to true
+#define GBC_STATS_READ(obj, out) (*(out) = (obj)->stats, true)
+
+/// @brief the comparator a counting qsort forwards to and the counters it
+/// bumps, per thread since qsort passes no context
+typedef struct _gbc_stats_cmp {
+  int (*cmp_fn)(const void *, const void *);
+  gbc_stats_t *stats;
+} _gbc_stats_cmp_t;
+
+static _Thread_local _gbc_stats_cmp_t _gbc_stats_cmp;
+
+static inline int _gbc_stats_counting_cmp(const void *a, const void *b) {
+  _gbc_stats_cmp.stats->cmp_calls++;
+  return _gbc_stats_cmp.cmp_fn(a, b);
+}
+
+static inline void _gbc_stats_qsort(gbc_stats_t *stats, void *base,
+                                    size_t n, size_t size,
+                                    int (*cmp_fn)(const void *,
+                                                  const void *)) {
+  // a comparator may sort another container, so the outer one is restored
+  _gbc_stats_cmp_t saved = _gbc_stats_cmp;
+  _gbc_stats_cmp.cmp_fn = cmp_fn;
+  _gbc_stats_cmp.stats = stats;
+  qsort(base, n, size, _gbc_stats_counting_cmp);
+  _gbc_stats_cmp = saved;
+}
+
+/// @brief qsort that counts its comparisons in the cmp_calls of obj
+#define GBC_STATS_QSORT(obj, base, n, size, cmp_fn) \
+  _gbc_stats_qsort(_gbc_stats_of(obj), base, n, size, cmp_fn)
+
+#else
+
+#define GBC_STATS_FIELD
+#define GBC_STATS_INIT(obj) ((void)0)
+#define GBC_STATS_INC(obj, field) ((void)0)
+#define GBC_STATS_MAX(obj, field, value) ((void)0)
+#define GBC_STATS_ALLOC(obj, n) ((void)0)
+#define GBC_STATS_FREE(obj, n) ((void)0)
+#define GBC_STATS_REALLOC(obj, old_n, new_n) ((void)0)
+#define GBC_STATS_READ(obj, out) \
+  (memset((out), 0, sizeof(gbc_stats_t)), false)
+#define GBC_STATS_QSORT(obj, base, n, size, cmp_fn) \
+  qsort(base, n, size, cmp_fn)
+
+#endif
+
+#endif
@@ -7,23 +7,53 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "gbc_alloc.h"
 #include "gbc_iterator.h"
+#include "gbc_probes.h"
+#include "gbc_stats.h"
 
 #define DEFAULT_VEC_CAP 8
 
 /// @brief The Vector collection
+/// @param char* inline_buf: caller-provided storage used before spilling to
+/// the heap, buf is not owned by the vector while it points there
+/// @param alloc: the allocator of the buffer and of the vector itself
 typedef struct _vec {
   size_t size;
   size_t cap;
   size_t obj_size;
   char *buf;
+  char *inline_buf;
+  const gbc_allocator_t *alloc;
+  GBC_STATS_FIELD
 } vec_t;
 
+/// @brief declare a vec_t named `name` together with inline storage for n
+/// elements of type, e.g. on the stack. Finish it with vec_fini
+#define VEC_INLINE_DECL(name, type, n)  \
+  type name##_inline_buf[n];            \
+  vec_t name;                           \
+  vec_init_inline(&name, sizeof(type), name##_inline_buf, n)
+
+/// @brief loop over the elements of vec with an index, binding var, a T*, to
+/// each of them. No iterator is involved and break/continue work as in a
+/// plain for loop. vec is evaluated on every step, and must not grow in the
+/// body, e.g.
+///
+///   GBC_VEC_FOREACH(int, x, v) { sum += *x; }
+#define GBC_VEC_FOREACH(T, var, vec)                                 \
+  for (size_t var##_idx_ = 0, var##_once_ = 1;                       \
+       var##_once_ && var##_idx_ < (vec)->size;                      \
+       var##_once_ = !var##_once_, ++var##_idx_)                     \
+    for (T *var = (T *)((vec)->buf + var##_idx_ * (vec)->obj_size);  \
+         var##_once_; var##_once_ = !var##_once_)
+
 /// @brief The vector iterator
 typedef struct _vec_iter {
   iter_t base;
   size_t cur_idx;
   vec_t *vec;
+  const gbc_allocator_t *alloc;
 } vec_iter_t;
 
 /// @brief create a new vector
@@ -37,10 +67,51 @@ vec_t *vec_new(size_t obj_size);
 /// @return
 vec_t *vec_new_with_cap(size_t obj_size, size_t cap);
 
+/// @brief create a new vector with capacity whose memory, including the
+/// vector itself and its iterators, comes from alloc
+/// @param obj_size
+/// @param cap
+/// @param alloc: NULL for malloc/free
+/// @return
+vec_t *vec_new_ex(size_t obj_size, size_t cap, const gbc_allocator_t *alloc);
+
 /// @brief drop the vector out of memory
 /// @param vec
 bool vec_drop(vec_t *);
 
+/// @brief initialize a vector header that lives on the stack or inside
+/// another struct. No memory is allocated until the first push
+/// @param vec
+/// @param obj_size
+void vec_init(vec_t *vec, size_t obj_size);
+
+/// @brief initialize a vector header that keeps its first inline_cap elements
+/// in storage, a caller-provided buffer of inline_cap * obj_size bytes, and
+/// only moves to the heap when it grows past them
+/// @param vec
+/// @param obj_size
+/// @param storage
+/// @param inline_cap
+void vec_init_inline(vec_t *vec, size_t obj_size, void *storage,
+                     size_t inline_cap);
+
+/// @brief release the heap buffer of a vector set up by vec_init or
+/// vec_init_inline, the header itself is not freed. The vector is left empty
+/// and detached from its inline storage
+/// @param vec
+void vec_fini(vec_t *vec);
+
+/// @brief check if the elements still live in the inline storage
+/// @param vec
+/// @return
+bool vec_is_inline(const vec_t *vec);
+
+/// @brief read the operation counters of the vector
+/// @param vec
+/// @param out
+/// @return return false, with out zeroed, unless built with GBC_STATS
+bool vec_stats(const vec_t *vec, gbc_stats_t *out);
+
 /// @brief push one element into the vector
 /// @param
 /// @param
@@ -87,6 +158,42 @@ bool vec_del_top(vec_t *);
 bool vec_del(vec_t *, const void *target_value,
              int (*cmp_fn)(const void *, const void *));
 
+/// @brief keep the elements for which pred returns true and delete the
+/// others in a single pass, keeping their order. pred sees each element once,
+/// front to back
+/// @param vec
+/// @param pred
+/// @param ctx: passed to pred
+/// @return the number of deleted elements
+size_t vec_retain(vec_t *vec, iter_pred_fn pred, void *ctx);
+
+/// @brief collapse every run of equal neighbours into its first element, on
+/// a sorted vector this removes all the duplicates
+/// @param vec
+/// @param cmp_fn
+/// @return the number of deleted elements
+size_t vec_dedup(vec_t *vec, int (*cmp_fn)(const void *, const void *));
+
+/// @brief delete an element in O(1) by moving the last one into its slot,
+/// the order of the elements is not kept
+/// @param vec
+/// @param idx
+/// @return
+bool vec_swap_remove(vec_t *vec, size_t idx);
+
+/// @brief shorten the vector to its first len elements, nothing happens if
+/// it is not longer than that. The capacity is kept
+/// @param vec
+/// @param len
+void vec_truncate(vec_t *vec, size_t len);
+
+/// @brief delete the elements in [from, to) with a single move of the tail
+/// @param vec
+/// @param from
+/// @param to
+/// @return
+bool vec_drain(vec_t *vec, size_t from, size_t to);
+
 /// @brief get the element in the vector at the input index
 /// @param vec
 /// @param idx
@@ -126,6 +233,17 @@ bool vec_reverse(vec_t *vec);
 /// @return
 vec_iter_t *vec_iter_new(vec_t *vec);
 
+/// @brief set up an iterator provided by the caller, e.g. on the stack, so
+/// iterating allocates nothing. Finish it with vec_iter_fini, not
+/// vec_iter_drop
+/// @param iter
+/// @param vec
+void vec_iter_init(vec_iter_t *iter, vec_t *vec);
+
+/// @brief finish an iterator set up by vec_iter_init
+/// @param iter
+void vec_iter_fini(vec_iter_t *iter);
+
 /// @brief drop a vec_iter_t
 /// @param iter
 /// @return
@@ -146,69 +264,126 @@ void *vec_iter_next(vec_iter_t *iter);
 /// @return
 vec_t *vec_from_iter(iter_t *iter);
 
+/// @brief push all the remaining elements of iter at the back of vec, the
+/// terminal of an iterator pipeline
+/// @param iter
+/// @param vec: its obj_size must be the one of iter
+/// @return return false if a push failed
+bool iter_collect_into(iter_t *iter, vec_t *vec);
+
 vec_t *vec_new(size_t obj_size) {
-  char *buf = (char *)malloc(obj_size * DEFAULT_VEC_CAP);
-  if (!buf) return NULL;
-  vec_t *v = (vec_t *)malloc(sizeof(vec_t));
-  if (!v) {
-    free(buf);
-    buf = NULL;
-    return NULL;
-  }
-  v->buf = buf;
-  v->size = 0;
-  v->obj_size = obj_size;
-  v->cap = DEFAULT_VEC_CAP;
-  return v;
+  return vec_new_ex(obj_size, DEFAULT_VEC_CAP, NULL);
 }
 
 vec_t *vec_new_with_cap(size_t obj_size, size_t cap) {
-  char *buf = (char *)malloc(obj_size * cap);
+  return vec_new_ex(obj_size, cap, NULL);
+}
+
+vec_t *vec_new_ex(size_t obj_size, size_t cap, const gbc_allocator_t *alloc) {
+  alloc = gbc_allocator_or_std(alloc);
+  char *buf = (char *)gbc_alloc(alloc, obj_size * cap);
   if (!buf) return NULL;
-  vec_t *v = (vec_t *)malloc(sizeof(vec_t));
+  vec_t *v = (vec_t *)gbc_alloc(alloc, sizeof(vec_t));
   if (!v) {
-    free(buf);
+    gbc_free(alloc, buf, obj_size * cap);
     buf = NULL;
     return NULL;
   }
   v->buf = buf;
+  v->inline_buf = NULL;
+  v->alloc = alloc;
   v->size = 0;
   v->obj_size = obj_size;
   v->cap = cap;
+  GBC_STATS_INIT(v);
+  GBC_STATS_ALLOC(v, sizeof(vec_t));
+  GBC_STATS_ALLOC(v, obj_size * cap);
   return v;
 }
 
 bool vec_drop(vec_t *vec) {
   if (!vec) return false;
-  if (!vec->buf) {
-    free(vec);
-    vec = NULL;
-    return true;
-  } else {
-    free(vec->buf);
-    vec->buf = NULL;
-    free(vec);
-    vec = NULL;
-    return true;
+  const gbc_allocator_t *alloc = vec->alloc;
+  vec_fini(vec);
+  gbc_free(alloc, vec, sizeof(vec_t));
+  vec = NULL;
+  return true;
+}
+
+void vec_init(vec_t *vec, size_t obj_size) {
+  assert(vec);
+  vec->buf = NULL;
+  vec->inline_buf = NULL;
+  vec->alloc = &gbc_std_allocator;
+  vec->size = 0;
+  vec->obj_size = obj_size;
+  vec->cap = 0;
+  GBC_STATS_INIT(vec);
+}
+
+void vec_init_inline(vec_t *vec, size_t obj_size, void *storage,
+                     size_t inline_cap) {
+  assert(vec && (storage || inline_cap == 0));
+  vec->buf = (char *)storage;
+  vec->inline_buf = (char *)storage;
+  vec->alloc = &gbc_std_allocator;
+  vec->size = 0;
+  vec->obj_size = obj_size;
+  vec->cap = inline_cap;
+  GBC_STATS_INIT(vec);
+}
+
+void vec_fini(vec_t *vec) {
+  assert(vec);
+  if (vec->buf != vec->inline_buf) {
+    gbc_free(vec->alloc, vec->buf, vec->cap * vec->obj_size);
+    if (vec->buf) GBC_STATS_FREE(vec, vec->cap * vec->obj_size);
   }
+  vec->buf = NULL;
+  vec->inline_buf = NULL;
+  vec->size = 0;
+  vec->cap = 0;
+}
+
+bool vec_is_inline(const vec_t *vec) {
+  assert(vec);
+  return vec->buf && vec->buf == vec->inline_buf;
+}
+
+bool vec_stats(const vec_t *vec, gbc_stats_t *out) {
+  assert(vec && out);
+  return GBC_STATS_READ(vec, out);
 }
 
 static bool vec_enlarge(vec_t *vec, size_t new_cap) {
-  char *new_buf = (char *)malloc(vec->obj_size * new_cap);
-  if (!new_buf) {
-    return false;
+  char *new_buf;
+  if (vec->buf && vec->buf == vec->inline_buf) {
+    new_buf = (char *)gbc_alloc(vec->alloc, vec->obj_size * new_cap);
+    if (!new_buf) return false;
+    memcpy(new_buf, vec->buf, (vec->size * vec->obj_size));
+    GBC_STATS_ALLOC(vec, vec->obj_size * new_cap);
+  } else {
+    new_buf = (char *)gbc_realloc(vec->alloc, vec->buf,
+                                  vec->obj_size * vec->cap,
+                                  vec->obj_size * new_cap);
+    if (!new_buf) return false;
+    GBC_STATS_REALLOC(vec, vec->obj_size * vec->cap, vec->obj_size * new_cap);
   }
+  GBC_STATS_INC(vec, grows);
+  GBC_PROBE4(vec_grow, vec, vec->cap, new_cap, vec->size * vec->obj_size);
   vec->cap = new_cap;
-  memcpy(new_buf, vec->buf, (vec->size * vec->obj_size));
-  free(vec->buf);
   vec->buf = new_buf;
   return true;
 }
 
+static inline size_t vec_grown_cap(const vec_t *vec) {
+  return vec->cap ? vec->cap * 2 : DEFAULT_VEC_CAP;
+}
+
 bool vec_push(vec_t *vec, const void *data) {
   assert(vec && data);
   if (vec->cap == vec->size) {
-    if (!vec_enlarge(vec, vec->cap * 2)) return false;
+    if (!vec_enlarge(vec, vec_grown_cap(vec))) return false;
   }
   memcpy(vec->buf + vec->obj_size * vec->size, data, vec->obj_size);
   vec->size++;
@@ -227,7 +402,7 @@ bool vec_del_top(vec_t *vec) {
 
 vec_t *vec_clone(vec_t *vec) {
   assert(vec);
-  vec_t *v = vec_new_with_cap(vec->obj_size, vec->cap);
+  vec_t *v = vec_new_ex(vec->obj_size, vec->cap, vec->alloc);
   if (!v) return NULL;
   v->size = vec->size;
   v->cap = vec->cap;
@@ -248,10 +423,10 @@ vec_t *vec_from_array(const void *_arr, size_t array_size, size_t obj_size) {
 bool vec_insert(vec_t *vec, size_t idx, const void *_data) {
   assert(vec && _data && vec->size > idx);
   if (vec->cap == vec->size) {
-    if (!vec_enlarge(vec, vec->cap * 2)) return false;
+    if (!vec_enlarge(vec, vec_grown_cap(vec))) return false;
   }
   memmove(vec->buf + vec->obj_size * (idx + 1), vec->buf + vec->obj_size * idx,
-          vec->size - idx);
+          vec->obj_size * (vec->size - idx));
   memcpy(vec->buf + vec->obj_size * idx, _data, vec->obj_size);
   vec->size++;
   return true;
@@ -260,7 +435,7 @@ bool vec_insert(vec_t *vec, size_t idx, const void *_data) {
 bool vec_sort(vec_t *vec, int (*cmp_fn)(const void *, const void *)) {
   assert(vec);
   if (vec->size == 0) return false;
-  qsort(vec->buf, vec->size, vec->obj_size, cmp_fn);
+  GBC_STATS_QSORT(vec, vec->buf, vec->size, vec->obj_size, cmp_fn);
   return true;
 }
 
@@ -282,6 +457,7 @@ bool vec_del(vec_t *vec, const void *target_value,
   bool flag = false;
   for (int i = 0; i < vec->size; ++i) {
     const void *ele = vec_at(vec, i);
+    GBC_STATS_INC(vec, cmp_calls);
     int order = cmp_fn(ele, target_value);
     if (order == 0) {
       flag = true;
@@ -295,6 +471,62 @@ bool vec_del(vec_t *vec, const void *target_value,
   return flag;
 }
 
+size_t vec_retain(vec_t *vec, iter_pred_fn pred, void *ctx) {
+  assert(vec && pred);
+  size_t w = 0;
+  for (size_t r = 0; r < vec->size; ++r) {
+    char *elem = vec->buf + vec->obj_size * r;
+    if (!pred(elem, ctx)) continue;
+    if (w != r) memcpy(vec->buf + vec->obj_size * w, elem, vec->obj_size);
+    w++;
+  }
+  size_t removed = vec->size - w;
+  vec->size = w;
+  return removed;
+}
+
+size_t vec_dedup(vec_t *vec, int (*cmp_fn)(const void *, const void *)) {
+  assert(vec && cmp_fn);
+  if (vec->size < 2) return 0;
+  // w is one past the last kept element, compare against it
+  size_t w = 1;
+  for (size_t r = 1; r < vec->size; ++r) {
+    char *elem = vec->buf + vec->obj_size * r;
+    char *last = vec->buf + vec->obj_size * (w - 1);
+    GBC_STATS_INC(vec, cmp_calls);
+    if (cmp_fn(last, elem) == 0) continue;
+    if (w != r) memcpy(last + vec->obj_size, elem, vec->obj_size);
+    w++;
+  }
+  size_t removed = vec->size - w;
+  vec->size = w;
+  return removed;
+}
+
+bool vec_swap_remove(vec_t *vec, size_t idx) {
+  assert(vec && vec->size > idx);
+  if (idx != vec->size - 1) {
+    memcpy(vec->buf + vec->obj_size * idx,
+           vec->buf + vec->obj_size * (vec->size - 1), vec->obj_size);
+  }
+  vec->size--;
+  return true;
+}
+
+void vec_truncate(vec_t *vec, size_t len) {
+  assert(vec);
+  if (len < vec->size) vec->size = len;
+}
+
+bool vec_drain(vec_t *vec, size_t from, size_t to) {
+  assert(vec && from <= to && to <= vec->size);
+  if (from == to) return true;
+  memmove(vec->buf + vec->obj_size * from, vec->buf + vec->obj_size * to,
+          vec->obj_size * (vec->size - to));
+  vec->size -= to - from;
+  return true;
+}
+
 const void *vec_at(const vec_t *vec, const size_t idx) {
   assert(vec && vec->size > idx);
   char *ptr = vec->buf + vec->obj_size * idx;
@@ -355,24 +587,46 @@ void *_vec_iter_next(iter_t *_iter) {
   }
 }
 
-vec_iter_t *vec_iter_new(vec_t *vec) {
-  assert(vec);
-  vec_iter_t *iter = (vec_iter_t *)malloc(sizeof(vec_iter_t));
-  if (!iter) {
-    return NULL;
-  }
+/// the unvisited part of the buffer is one span
+size_t _vec_iter_next_batch(iter_t *_iter, iter_batch_t *batch, size_t max) {
+  vec_iter_t *iter = (vec_iter_t *)_iter;
+  size_t left = iter->vec->size - iter->cur_idx;
+  batch->len = left < max ? left : max;
+  batch->span = iter->vec->buf + iter->cur_idx * iter->vec->obj_size;
+  iter->cur_idx += batch->len;
+  return batch->len;
+}
+
+void vec_iter_init(vec_iter_t *iter, vec_t *vec) {
+  assert(iter && vec);
   iter_t base = {.obj_size = vec->obj_size,
                  .has_next = _vec_iter_has_next,
-                 .next = _vec_iter_next};
+                 .next = _vec_iter_next,
+                 .next_batch = _vec_iter_next_batch};
   iter->base = base;
   iter->cur_idx = 0;
   iter->vec = vec;
+  iter->alloc = NULL;
+  GBC_PROBE3(iter_new, vec, iter, vec->size);
+}
+
+void vec_iter_fini(vec_iter_t *iter) {
+  assert(iter && !iter->alloc);
+  iter->vec = NULL;
+}
+
+vec_iter_t *vec_iter_new(vec_t *vec) {
+  assert(vec);
+  vec_iter_t *iter = (vec_iter_t *)gbc_alloc(vec->alloc, sizeof(vec_iter_t));
+  if (!iter) return NULL;
+  vec_iter_init(iter, vec);
+  iter->alloc = vec->alloc;
   return iter;
 }
 
 bool vec_iter_drop(vec_iter_t *iter) {
   if (!iter) return false;
-  free(iter);
+  gbc_free(iter->alloc, iter, sizeof(vec_iter_t));
   return true;
 }
 
@@ -387,11 +641,35 @@ void *vec_iter_next(vec_iter_t *iter) {
 vec_t *vec_from_iter(iter_t *iter) {
   assert(iter);
   vec_t *v = vec_new(iter->obj_size);
-  while (iter->has_next(iter)) {
-    const void *out = iter->next(iter);
-    vec_push(v, out);
+  if (!v) return NULL;
+  if (!iter_collect_into(iter, v)) {
+    vec_drop(v);
+    return NULL;
   }
   return v;
 }
 
+bool iter_collect_into(iter_t *iter, vec_t *vec) {
+  assert(iter && vec && iter->obj_size == vec->obj_size);
+  void *ptrs[ITER_BATCH_MAX];
+  iter_batch_t batch = {.span = NULL, .ptrs = ptrs, .len = 0};
+  while (iter_next_batch(iter, &batch, ITER_BATCH_MAX) > 0) {
+    if (vec->cap - vec->size < batch.len) {
+      size_t cap = vec_grown_cap(vec);
+      while (cap - vec->size < batch.len) cap *= 2;
+      if (!vec_enlarge(vec, cap)) return false;
+    }
+    char *dst = vec->buf + vec->size * vec->obj_size;
+    if (batch.span) {
+      memcpy(dst, batch.span, batch.len * vec->obj_size);
+    } else {
+      for (size_t i = 0; i < batch.len; ++i) {
+        memcpy(dst + i * vec->obj_size, batch.ptrs[i], vec->obj_size);
+      }
+    }
+    vec->size += batch.len;
+  }
+  return true;
+}
+
 #endif
\ No newline at end of file
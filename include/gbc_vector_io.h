@@ -0,0 +1,353 @@
+#ifndef _GBC_VECTOR_IO_H
+#define _GBC_VECTOR_IO_H
+// Saving, loading and mapping vectors goes through POSIX calls (mmap,
+// ftruncate, pread, fileno) that a strict -std=c11 hides. The feature test
+// macros below expose them when this header is included before any system
+// header; otherwise define them on the command line or use -std=gnu11.
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gbc_alloc.h"
+#include "gbc_vector.h"
+
+#define VEC_FILE_MAGIC "GBCVEC1"
+#define VEC_FILE_HAS_CHECKSUM 1u
+#define VEC_FILE_CHECKSUM_SEED 14695981039346656037ull
+
+/// @brief the header at the start of a vector file, followed by count *
+/// obj_size bytes of elements. Integers are stored in native byte order and
+/// the header is 64 bytes so the elements stay aligned when mapped
+/// @param char magic[8]: VEC_FILE_MAGIC
+/// @param uint64_t obj_size: the size of each element
+/// @param uint64_t count: the number of elements
+/// @param uint64_t checksum: FNV-1a of the elements, see flags
+/// @param uint64_t flags: VEC_FILE_HAS_CHECKSUM when checksum is up to date
+typedef struct _vec_file_header {
+  char magic[8];
+  uint64_t obj_size;
+  uint64_t count;
+  uint64_t checksum;
+  uint64_t flags;
+  uint64_t reserved[3];
+} vec_file_header_t;
+
+/// @brief the state behind a vector opened with vec_mmap_open or
+/// vec_mmap_create. The vector is embedded and its allocator is alloc, which
+/// unmaps the file when the buffer is freed and grows it with ftruncate and
+/// mremap. Every other allocation goes to malloc
+typedef struct _vec_mmap {
+  vec_t vec;
+  gbc_allocator_t alloc;
+  int fd;
+  bool readonly;
+  char *base;
+  size_t map_size;
+} vec_mmap_t;
+
+/// @brief write the vector to path, a header then the raw buffer
+/// @param vec
+/// @param path
+/// @return return false if the file can not be written
+bool vec_save(const vec_t *vec, const char *path);
+
+/// @brief read a file written by vec_save or a mapped vector into a new heap
+/// vector, checking its checksum when it has one
+/// @param path
+/// @return return NULL if the file can not be read or is corrupted
+vec_t *vec_load(const char *path);
+
+/// @brief map a vector file into memory, no element is read or copied. The
+/// vector is dropped with vec_drop as usual. Its iterators and clones must be
+/// dropped before it
+/// @param path
+/// @param readonly: when true the mapping is private, changes are never
+/// written back and the vector can not grow. Otherwise the file is shared,
+/// grows with the vector and its size is written back when dropped
+/// @return return NULL if the file can not be opened or is not a vector file
+vec_t *vec_mmap_open(const char *path, bool readonly);
+
+/// @brief create or truncate path as an empty file-backed vector with room
+/// for cap elements
+/// @param path
+/// @param obj_size
+/// @param cap
+/// @return
+vec_t *vec_mmap_create(const char *path, size_t obj_size, size_t cap);
+
+/// @brief check if the vector buffer is a file mapping
+/// @param vec
+/// @return
+bool vec_is_mapped(const vec_t *vec);
+
+/// @brief write the size and the checksum of a writable mapped vector to its
+/// header and flush the mapping to the disk. Writes made after the last sync
+/// leave the file without a valid checksum
+/// @param vec
+/// @return return false if the vector is not a writable mapping
+bool vec_mmap_sync(vec_t *vec);
+
+/// @brief check the elements of a mapped vector against the checksum stored
+/// by vec_save or vec_mmap_sync
+/// @param vec
+/// @return return false if there is no up to date checksum or it differs
+bool vec_mmap_verify(const vec_t *vec);
+
+/// @brief FNV-1a over 8-byte words continuing from h, the bytes past the
+/// last full word are folded in one by one. Hashing in pieces that are all
+/// but the last a multiple of 8 bytes gives the same result as in one go
+static uint64_t vec_file_checksum_update(uint64_t h, const char *buf,
+                                         size_t len) {
+  const uint64_t prime = 1099511628211ull;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, buf + i, sizeof(word));
+    h = (h ^ word) * prime;
+  }
+  for (; i < len; ++i) h = (h ^ (unsigned char)buf[i]) * prime;
+  return h;
+}
+
+static uint64_t vec_file_checksum(const char *buf, size_t len) {
+  return vec_file_checksum_update(VEC_FILE_CHECKSUM_SEED, buf, len);
+}
+
+static bool vec_file_header_check(const vec_file_header_t *header,
+                                  size_t file_size) {
+  if (memcmp(header->magic, VEC_FILE_MAGIC, sizeof(header->magic)) != 0)
+    return false;
+  if (header->obj_size == 0) return false;
+  size_t data_size = file_size - sizeof(vec_file_header_t);
+  return header->count <= data_size / header->obj_size;
+}
+
+bool vec_save(const vec_t *vec, const char *path) {
+  assert(vec && path);
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  size_t len = vec->size * vec->obj_size;
+  vec_file_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, VEC_FILE_MAGIC, sizeof(header.magic));
+  header.obj_size = vec->obj_size;
+  header.count = vec->size;
+  header.checksum = vec_file_checksum(vec->buf, len);
+  header.flags = VEC_FILE_HAS_CHECKSUM;
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            (len == 0 || fwrite(vec->buf, len, 1, f) == 1);
+  if (fclose(f) != 0) ok = false;
+  return ok;
+}
+
+vec_t *vec_load(const char *path) {
+  assert(path);
+  FILE *f = fopen(path, "rb");
+  if (!f) return NULL;
+  vec_file_header_t header;
+  struct stat st;
+  if (fstat(fileno(f), &st) != 0 || (size_t)st.st_size < sizeof(header) ||
+      fread(&header, sizeof(header), 1, f) != 1 ||
+      !vec_file_header_check(&header, st.st_size)) {
+    fclose(f);
+    return NULL;
+  }
+  size_t cap = header.count ? header.count : DEFAULT_VEC_CAP;
+  vec_t *vec = vec_new_with_cap(header.obj_size, cap);
+  if (!vec) {
+    fclose(f);
+    return NULL;
+  }
+  size_t len = header.count * header.obj_size;
+  bool ok = len == 0 || fread(vec->buf, len, 1, f) == 1;
+  fclose(f);
+  if (ok && (header.flags & VEC_FILE_HAS_CHECKSUM))
+    ok = vec_file_checksum(vec->buf, len) == header.checksum;
+  if (!ok) {
+    vec_drop(vec);
+    return NULL;
+  }
+  vec->size = header.count;
+  return vec;
+}
+
+static inline vec_file_header_t *vec_mmap_header(const vec_mmap_t *m) {
+  return (vec_file_header_t *)m->base;
+}
+
+static void *vec_mmap_alloc(void *ctx, size_t size) {
+  (void)ctx;
+  return malloc(size);
+}
+
+static void *vec_mmap_realloc(void *ctx, void *ptr, size_t old_size,
+                              size_t new_size) {
+  vec_mmap_t *m = (vec_mmap_t *)ctx;
+  char *data = m->base + sizeof(vec_file_header_t);
+  if (ptr != data) return realloc(ptr, new_size);
+  if (m->readonly) return NULL;
+  // the vector's bytes always fit in the mapping; the remap below moves the
+  // whole mapping, so old_size is only needed for the check
+  assert(old_size <= m->map_size - sizeof(vec_file_header_t));
+  (void)old_size;
+  size_t map_size = sizeof(vec_file_header_t) + new_size;
+  if (ftruncate(m->fd, map_size) != 0) return NULL;
+#ifdef MREMAP_MAYMOVE
+  void *base = mremap(m->base, m->map_size, map_size, MREMAP_MAYMOVE);
+#else
+  void *base =
+      mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+  if (base != MAP_FAILED) munmap(m->base, m->map_size);
+#endif
+  if (base == MAP_FAILED) {
+    // keep the file the size of the mapping still in use
+    int rc = ftruncate(m->fd, m->map_size);
+    (void)rc;
+    return NULL;
+  }
+  m->base = (char *)base;
+  m->map_size = map_size;
+  return m->base + sizeof(vec_file_header_t);
+}
+
+static void vec_mmap_free(void *ctx, void *ptr, size_t size) {
+  vec_mmap_t *m = (vec_mmap_t *)ctx;
+  (void)size;
+  if (m->base && ptr == m->base + sizeof(vec_file_header_t)) {
+    if (!m->readonly) {
+      // the checksum is only refreshed by vec_mmap_sync
+      vec_file_header_t *header = vec_mmap_header(m);
+      if (header->count != m->vec.size)
+        header->flags &= ~VEC_FILE_HAS_CHECKSUM;
+      header->count = m->vec.size;
+    }
+    munmap(m->base, m->map_size);
+    m->base = NULL;
+  } else if (ptr == &m->vec) {
+    if (m->base) munmap(m->base, m->map_size);
+    close(m->fd);
+    free(m);
+  } else {
+    free(ptr);
+  }
+}
+
+/// @brief map fd, whose header is already valid, and wrap it into a vector
+static vec_t *vec_mmap_wrap(int fd, size_t file_size, bool readonly) {
+  int flags = readonly ? MAP_PRIVATE : MAP_SHARED;
+#ifdef MAP_NORESERVE
+  // a private mapping that is never written needs no swap behind it
+  if (readonly) flags |= MAP_NORESERVE;
+#endif
+  void *base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, flags, fd, 0);
+  if (base == MAP_FAILED) return NULL;
+  vec_mmap_t *m = (vec_mmap_t *)malloc(sizeof(vec_mmap_t));
+  if (!m) {
+    munmap(base, file_size);
+    return NULL;
+  }
+  m->fd = fd;
+  m->readonly = readonly;
+  m->base = (char *)base;
+  m->map_size = file_size;
+  gbc_allocator_t alloc = {.alloc = vec_mmap_alloc,
+                           .realloc = vec_mmap_realloc,
+                           .free = vec_mmap_free,
+                           .ctx = m};
+  m->alloc = alloc;
+  vec_file_header_t *header = vec_mmap_header(m);
+  // elements written through a shared mapping are not covered by the stored
+  // checksum until the next vec_mmap_sync
+  if (!readonly) header->flags &= ~VEC_FILE_HAS_CHECKSUM;
+  vec_t *vec = &m->vec;
+  vec_init(vec, header->obj_size);
+  vec->alloc = &m->alloc;
+  vec->buf = m->base + sizeof(vec_file_header_t);
+  vec->size = header->count;
+  // a read-only mapping can not grow, so it is full by construction
+  vec->cap = readonly ? header->count
+                      : (file_size - sizeof(vec_file_header_t)) /
+                            header->obj_size;
+  GBC_STATS_ALLOC(vec, vec->cap * vec->obj_size);
+  return vec;
+}
+
+vec_t *vec_mmap_open(const char *path, bool readonly) {
+  assert(path);
+  int fd = open(path, readonly ? O_RDONLY : O_RDWR);
+  if (fd < 0) return NULL;
+  struct stat st;
+  vec_file_header_t header;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header) ||
+      pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      !vec_file_header_check(&header, st.st_size)) {
+    close(fd);
+    return NULL;
+  }
+  vec_t *vec = vec_mmap_wrap(fd, st.st_size, readonly);
+  if (!vec) close(fd);
+  return vec;
+}
+
+vec_t *vec_mmap_create(const char *path, size_t obj_size, size_t cap) {
+  assert(path && obj_size > 0);
+  if (cap == 0) cap = DEFAULT_VEC_CAP;
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return NULL;
+  vec_file_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, VEC_FILE_MAGIC, sizeof(header.magic));
+  header.obj_size = obj_size;
+  size_t file_size = sizeof(header) + obj_size * cap;
+  if (ftruncate(fd, file_size) != 0 ||
+      pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+    close(fd);
+    return NULL;
+  }
+  vec_t *vec = vec_mmap_wrap(fd, file_size, false);
+  if (!vec) close(fd);
+  return vec;
+}
+
+bool vec_is_mapped(const vec_t *vec) {
+  assert(vec);
+  return vec->alloc && vec->alloc->free == vec_mmap_free;
+}
+
+bool vec_mmap_sync(vec_t *vec) {
+  assert(vec);
+  if (!vec_is_mapped(vec)) return false;
+  vec_mmap_t *m = (vec_mmap_t *)vec->alloc->ctx;
+  if (m->readonly) return false;
+  vec_file_header_t *header = vec_mmap_header(m);
+  header->count = vec->size;
+  header->checksum = vec_file_checksum(vec->buf, vec->size * vec->obj_size);
+  header->flags |= VEC_FILE_HAS_CHECKSUM;
+  return msync(m->base, m->map_size, MS_SYNC) == 0;
+}
+
+bool vec_mmap_verify(const vec_t *vec) {
+  assert(vec);
+  if (!vec_is_mapped(vec)) return false;
+  const vec_mmap_t *m = (const vec_mmap_t *)vec->alloc->ctx;
+  const vec_file_header_t *header = vec_mmap_header(m);
+  if (!(header->flags & VEC_FILE_HAS_CHECKSUM)) return false;
+  if (!m->readonly && header->count != vec->size) return false;
+  return vec_file_checksum(vec->buf, header->count * vec->obj_size) ==
+         header->checksum;
+}
+
+#endif
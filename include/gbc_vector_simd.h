@@ -0,0 +1,215 @@
+#ifndef _GBC_VECTOR_SIMD_H
+#define _GBC_VECTOR_SIMD_H
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gbc_cpu.h"
+#include "gbc_vector.h"
+
+/// Typed scan kernels for vectors of 32 and 64 bit integers and floats. They
+/// compare the elements by value with no cmp_fn call, a whole register of
+/// them at a time, with AVX2 or SSE2 picked at run time and a scalar loop
+/// elsewhere. The vector's obj_size must be the size of the type. Floats
+/// compare with ==, so NaN matches nothing and 0.0 matches -0.0
+///
+///   vec_find_u32(vec, x, &idx)       the first index holding x
+///   vec_count_eq_u32(vec, x)         the number of elements equal to x
+///   vec_remove_all_eq_u32(vec, x)    delete them all in one pass, keeping
+///                                    the order of the others
+///
+/// and the same for u64, f32 and f64
+
+/// @brief find the first element equal to x
+/// @param vec
+/// @param x
+/// @param idx: its index when found, may be NULL
+/// @return return false if no element equals x
+bool vec_find_u32(const vec_t *vec, uint32_t x, size_t *idx);
+bool vec_find_u64(const vec_t *vec, uint64_t x, size_t *idx);
+bool vec_find_f32(const vec_t *vec, float x, size_t *idx);
+bool vec_find_f64(const vec_t *vec, double x, size_t *idx);
+
+/// @brief count the elements equal to x
+/// @param vec
+/// @param x
+/// @return
+size_t vec_count_eq_u32(const vec_t *vec, uint32_t x);
+size_t vec_count_eq_u64(const vec_t *vec, uint64_t x);
+size_t vec_count_eq_f32(const vec_t *vec, float x);
+size_t vec_count_eq_f64(const vec_t *vec, double x);
+
+/// @brief delete every element equal to x, compacting the vector in a single
+/// pass. A block of the vector with no match moves as one register
+/// @param vec
+/// @param x
+/// @return the number of deleted elements
+size_t vec_remove_all_eq_u32(vec_t *vec, uint32_t x);
+size_t vec_remove_all_eq_u64(vec_t *vec, uint64_t x);
+size_t vec_remove_all_eq_f32(vec_t *vec, float x);
+size_t vec_remove_all_eq_f64(vec_t *vec, double x);
+
+/// @brief generate the scan kernels of one instruction set for one type.
+/// EQ_MASK(p, x) returns a bit per lane of the LANES elements at p, set when
+/// the lane equals x
+#define _VEC_SIMD_KERNELS(sfx, T, isa, LANES, TARGET, EQ_MASK)               \
+  TARGET static size_t vec_find_##sfx##_##isa(const T *a, size_t n, T x) {   \
+    size_t i = 0;                                                            \
+    for (; i + (LANES) <= n; i += (LANES)) {                                 \
+      unsigned m = EQ_MASK(a + i, x);                                        \
+      if (m) return i + (size_t)__builtin_ctz(m);                            \
+    }                                                                        \
+    for (; i < n; ++i)                                                       \
+      if (a[i] == x) return i;                                               \
+    return n;                                                                \
+  }                                                                          \
+                                                                             \
+  TARGET static size_t vec_count_##sfx##_##isa(const T *a, size_t n, T x) {  \
+    size_t count = 0, i = 0;                                                 \
+    for (; i + (LANES) <= n; i += (LANES)) {                                 \
+      count += (size_t)__builtin_popcount(EQ_MASK(a + i, x));                \
+    }                                                                        \
+    for (; i < n; ++i) count += (a[i] == x);                                 \
+    return count;                                                            \
+  }                                                                          \
+                                                                             \
+  TARGET static size_t vec_remove_##sfx##_##isa(T *a, size_t n, T x) {       \
+    const unsigned all = (1u << (LANES)) - 1;                                \
+    size_t w = 0, i = 0;                                                     \
+    for (; i + (LANES) <= n; i += (LANES)) {                                 \
+      unsigned m = EQ_MASK(a + i, x);                                        \
+      if (m == 0) {                                                          \
+        if (w != i) memmove(a + w, a + i, (LANES) * sizeof(T));              \
+        w += (LANES);                                                        \
+      } else if (m != all) {                                                 \
+        for (size_t j = 0; j < (LANES); ++j)                                 \
+          if (!((m >> j) & 1)) a[w++] = a[i + j];                            \
+      }                                                                      \
+    }                                                                        \
+    for (; i < n; ++i)                                                       \
+      if (a[i] != x) a[w++] = a[i];                                          \
+    return w;                                                                \
+  }
+
+#define _VEC_SCALAR_EQ_MASK(p, x) ((unsigned)(*(p) == (x)))
+
+#define _VEC_SIMD_NOTARGET
+
+_VEC_SIMD_KERNELS(u32, uint32_t, scalar, 1, _VEC_SIMD_NOTARGET,
+                  _VEC_SCALAR_EQ_MASK)
+_VEC_SIMD_KERNELS(u64, uint64_t, scalar, 1, _VEC_SIMD_NOTARGET,
+                  _VEC_SCALAR_EQ_MASK)
+_VEC_SIMD_KERNELS(f32, float, scalar, 1, _VEC_SIMD_NOTARGET,
+                  _VEC_SCALAR_EQ_MASK)
+_VEC_SIMD_KERNELS(f64, double, scalar, 1, _VEC_SIMD_NOTARGET,
+                  _VEC_SCALAR_EQ_MASK)
+
+#ifdef GBC_CPU_X86
+
+GBC_TARGET_SSE2 static inline unsigned vec_eq_u32_sse2(const uint32_t *p,
+                                                        uint32_t x) {
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  __m128i m = _mm_cmpeq_epi32(v, _mm_set1_epi32((int)x));
+  return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m));
+}
+
+/// SSE2 has no 64 bit compare: both 32 bit halves must match
+GBC_TARGET_SSE2 static inline unsigned vec_eq_u64_sse2(const uint64_t *p,
+                                                        uint64_t x) {
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  __m128i m = _mm_cmpeq_epi32(v, _mm_set1_epi64x((long long)x));
+  m = _mm_and_si128(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (unsigned)_mm_movemask_pd(_mm_castsi128_pd(m));
+}
+
+GBC_TARGET_SSE2 static inline unsigned vec_eq_f32_sse2(const float *p,
+                                                        float x) {
+  return (unsigned)_mm_movemask_ps(
+      _mm_cmpeq_ps(_mm_loadu_ps(p), _mm_set1_ps(x)));
+}
+
+GBC_TARGET_SSE2 static inline unsigned vec_eq_f64_sse2(const double *p,
+                                                        double x) {
+  return (unsigned)_mm_movemask_pd(
+      _mm_cmpeq_pd(_mm_loadu_pd(p), _mm_set1_pd(x)));
+}
+
+GBC_TARGET_AVX2 static inline unsigned vec_eq_u32_avx2(const uint32_t *p,
+                                                        uint32_t x) {
+  __m256i v = _mm256_loadu_si256((const __m256i *)p);
+  __m256i m = _mm256_cmpeq_epi32(v, _mm256_set1_epi32((int)x));
+  return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+GBC_TARGET_AVX2 static inline unsigned vec_eq_u64_avx2(const uint64_t *p,
+                                                        uint64_t x) {
+  __m256i v = _mm256_loadu_si256((const __m256i *)p);
+  __m256i m = _mm256_cmpeq_epi64(v, _mm256_set1_epi64x((long long)x));
+  return (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(m));
+}
+
+GBC_TARGET_AVX2 static inline unsigned vec_eq_f32_avx2(const float *p,
+                                                        float x) {
+  return (unsigned)_mm256_movemask_ps(
+      _mm256_cmp_ps(_mm256_loadu_ps(p), _mm256_set1_ps(x), _CMP_EQ_OQ));
+}
+
+GBC_TARGET_AVX2 static inline unsigned vec_eq_f64_avx2(const double *p,
+                                                        double x) {
+  return (unsigned)_mm256_movemask_pd(
+      _mm256_cmp_pd(_mm256_loadu_pd(p), _mm256_set1_pd(x), _CMP_EQ_OQ));
+}
+
+_VEC_SIMD_KERNELS(u32, uint32_t, sse2, 4, GBC_TARGET_SSE2, vec_eq_u32_sse2)
+_VEC_SIMD_KERNELS(u64, uint64_t, sse2, 2, GBC_TARGET_SSE2, vec_eq_u64_sse2)
+_VEC_SIMD_KERNELS(f32, float, sse2, 4, GBC_TARGET_SSE2, vec_eq_f32_sse2)
+_VEC_SIMD_KERNELS(f64, double, sse2, 2, GBC_TARGET_SSE2, vec_eq_f64_sse2)
+_VEC_SIMD_KERNELS(u32, uint32_t, avx2, 8, GBC_TARGET_AVX2, vec_eq_u32_avx2)
+_VEC_SIMD_KERNELS(u64, uint64_t, avx2, 4, GBC_TARGET_AVX2, vec_eq_u64_avx2)
+_VEC_SIMD_KERNELS(f32, float, avx2, 8, GBC_TARGET_AVX2, vec_eq_f32_avx2)
+_VEC_SIMD_KERNELS(f64, double, avx2, 4, GBC_TARGET_AVX2, vec_eq_f64_avx2)
+
+/// @brief call the kernel of the best instruction set the CPU has
+#define _VEC_SIMD_CALL(fn, ...)                                \
+  (gbc_cpu_level() >= GBC_CPU_AVX2 ? fn##_avx2(__VA_ARGS__)    \
+   : gbc_cpu_level() >= GBC_CPU_SSE2 ? fn##_sse2(__VA_ARGS__)  \
+                                     : fn##_scalar(__VA_ARGS__))
+
+#else
+
+#define _VEC_SIMD_CALL(fn, ...) fn##_scalar(__VA_ARGS__)
+
+#endif
+
+/// @brief generate the public functions of one type
+#define _VEC_SIMD_API(sfx, T)                                                  \
+  bool vec_find_##sfx(const vec_t *vec, T x, size_t *idx) {                    \
+    assert(vec && vec->obj_size == sizeof(T));                                 \
+    size_t i = _VEC_SIMD_CALL(vec_find_##sfx, (const T *)vec->buf,             \
+                              vec->size, x);                                   \
+    if (i == vec->size) return false;                                          \
+    if (idx) *idx = i;                                                         \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  size_t vec_count_eq_##sfx(const vec_t *vec, T x) {                           \
+    assert(vec && vec->obj_size == sizeof(T));                                 \
+    return _VEC_SIMD_CALL(vec_count_##sfx, (const T *)vec->buf, vec->size,     \
+                          x);                                                  \
+  }                                                                            \
+                                                                               \
+  size_t vec_remove_all_eq_##sfx(vec_t *vec, T x) {                            \
+    assert(vec && vec->obj_size == sizeof(T));                                 \
+    size_t n = _VEC_SIMD_CALL(vec_remove_##sfx, (T *)vec->buf, vec->size, x);  \
+    size_t removed = vec->size - n;                                            \
+    vec->size = n;                                                             \
+    return removed;                                                            \
+  }
+
+_VEC_SIMD_API(u32, uint32_t)
+_VEC_SIMD_API(u64, uint64_t)
+_VEC_SIMD_API(f32, float)
+_VEC_SIMD_API(f64, double)
+
+#endif
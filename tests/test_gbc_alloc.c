@@ -0,0 +1,119 @@
+#include "../include/gbc_alloc.h"
+#include "../include/gbc_avl.h"
+#include "../include/gbc_deque.h"
+#include "../include/gbc_vector.h"
+
+#include <stdint.h>
+
+int int_cmp(const void *a, const void *b) {
+  const int *_a = (int *)a;
+  const int *_b = (int *)b;
+  if (*_a == *_b)
+    return 0;
+  else if (*_a < *_b)
+    return -1;
+  else
+    return 1;
+}
+
+typedef struct _counting_ctx {
+  size_t live_bytes;
+  size_t allocs;
+} counting_ctx_t;
+
+void *counting_alloc(void *ctx, size_t size) {
+  counting_ctx_t *c = (counting_ctx_t *)ctx;
+  c->live_bytes += size;
+  c->allocs++;
+  return malloc(size);
+}
+
+void *counting_realloc(void *ctx, void *ptr, size_t old_size,
+                       size_t new_size) {
+  counting_ctx_t *c = (counting_ctx_t *)ctx;
+  c->live_bytes += new_size - old_size;
+  return realloc(ptr, new_size);
+}
+
+void counting_free(void *ctx, void *ptr, size_t size) {
+  counting_ctx_t *c = (counting_ctx_t *)ctx;
+  c->live_bytes -= size;
+  free(ptr);
+}
+
+void test_alloc_counting(void) {
+  counting_ctx_t ctx = {0, 0};
+  gbc_allocator_t alloc = {.alloc = counting_alloc,
+                           .realloc = counting_realloc,
+                           .free = counting_free,
+                           .ctx = &ctx};
+  vec_t *v = vec_new_ex(sizeof(int), 2, &alloc);
+  for (int i = 0; i < 100; ++i) vec_push(v, &i);
+  vec_iter_t *vi = vec_iter_new(v);
+  vec_iter_drop(vi);
+  vec_drop(v);
+  assert(ctx.live_bytes == 0 && ctx.allocs > 0);
+
+  vdq_t *q = vdq_new_ex(sizeof(int), 2, &alloc);
+  for (int i = 0; i < 100; ++i) {
+    vdq_push_front(q, &i);
+    vdq_push_back(q, &i);
+  }
+  vdq_drop(q);
+  assert(ctx.live_bytes == 0);
+
+  avl_set_t *s1 = avl_set_new_ex(sizeof(int), int_cmp, &alloc);
+  avl_set_t *s2 = avl_set_new_ex(sizeof(int), int_cmp, &alloc);
+  for (int i = 0; i < 50; ++i) {
+    avl_set_add(s1, &i);
+    int j = i + 25;
+    avl_set_add(s2, &j);
+  }
+  avl_set_t *s3 = avl_set_union(s1, s2);
+  assert(s3->size == 75);
+  avl_set_drop(s1);
+  avl_set_drop(s2);
+  avl_set_drop(s3);
+  assert(ctx.live_bytes == 0);
+}
+
+void test_alloc_arena(void) {
+  gbc_arena_t arena;
+  gbc_arena_init(&arena, 1024);
+  const gbc_allocator_t *alloc = gbc_arena_allocator(&arena);
+  vec_t *v = vec_new_ex(sizeof(int), 4, alloc);
+  avl_map_t *map = avl_map_new_ex(sizeof(int), sizeof(int), int_cmp, alloc);
+  for (int i = 0; i < 1000; ++i) {
+    vec_push(v, &i);
+    avl_map_add(map, &i, &i);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    assert(*(int *)vec_at(v, i) == i);
+    assert(*(int *)avl_map_get(map, &i) == i);
+  }
+  avl_map_iter_t *iter = avl_map_iter_new(map);
+  int expected = 0;
+  while (avl_map_iter_has_next(iter)) {
+    avl_pair_t *pair = avl_map_iter_next(iter);
+    assert(*(int *)pair->key == expected++);
+  }
+  assert(expected == 1000);
+  // everything goes away at once, no drop needed
+  gbc_arena_reset(&arena);
+  void *p1 = gbc_alloc(alloc, 10);
+  void *p2 = gbc_realloc(alloc, p1, 10, 100);
+  assert(p1 == p2);
+  // odd sizes, in the first chunk, past it and bigger than a chunk
+  size_t sizes[] = {1, 3, 8, 17, 100, 1000, 5000};
+  for (int i = 0; i < 100; ++i) {
+    void *p = gbc_alloc(alloc, sizes[i % 7]);
+    assert(p && ((uintptr_t)p % GBC_ARENA_ALIGN) == 0);
+  }
+  gbc_arena_fini(&arena);
+}
+
+int main() {
+  test_alloc_counting();
+  test_alloc_arena();
+  return 0;
+}
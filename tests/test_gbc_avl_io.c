@@ -0,0 +1,197 @@
+#include "../include/gbc_avl_io.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int int_cmp(const void *a, const void *b) {
+  const int *_a = (int *)a;
+  const int *_b = (int *)b;
+  if (*_a == *_b)
+    return 0;
+  else if (*_a < *_b)
+    return -1;
+  else
+    return 1;
+}
+
+static size_t check_avl_node(const avl_node_t *node) {
+  if (!node) return 0;
+  if (node->left) assert(node->left->parent == node);
+  if (node->right) assert(node->right->parent == node);
+  size_t lh = check_avl_node(node->left);
+  size_t rh = check_avl_node(node->right);
+  assert(lh <= rh + 1 && rh <= lh + 1);
+  assert(node->height == 1 + avl_max(lh, rh));
+  return node->height;
+}
+
+static long long range_sum;
+
+void sum_vals(const void *key, const void *val) {
+  (void)key;
+  range_sum += *(const long long *)val;
+}
+
+void test_map_save_load(void) {
+  char path[] = "/tmp/gbc_avl_io_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  // odd keys 1, 3, ..., 2n - 1, inserted out of order
+  size_t n = 1001;
+  avl_map_t *map = avl_map_new(sizeof(int), sizeof(long long), int_cmp);
+  for (size_t i = 0; i < n; ++i) {
+    int k = (int)((i * 7919) % n) * 2 + 1;
+    long long v = (long long)k * 10;
+    avl_map_add(map, &k, &v);
+  }
+  assert(avl_map_save(map, path));
+
+  avl_map_t *loaded = avl_map_load(path, int_cmp);
+  assert(loaded && loaded->size == n);
+  assert(check_avl_node(loaded->root) <= map->root->height);
+  for (int k = 0; k < (int)(2 * n + 1); ++k) {
+    const long long *v = avl_map_get(loaded, &k);
+    if (k % 2 == 1) {
+      assert(v && *v == (long long)k * 10);
+    } else {
+      assert(!v);
+    }
+  }
+  // the rebuilt map is an ordinary one
+  int k = 4;
+  long long v = 40;
+  assert(avl_map_add(loaded, &k, &v) && avl_map_del(loaded, &k));
+  check_avl_node(loaded->root);
+  avl_map_drop(loaded);
+  free(loaded);
+
+  avl_snapshot_t *snap = avl_snapshot_open(path, int_cmp);
+  assert(snap && avl_snapshot_length(snap) == n && avl_snapshot_verify(snap));
+  for (int k = 0; k < (int)(2 * n + 1); ++k) {
+    const long long *v = avl_snapshot_get(snap, &k);
+    assert(avl_snapshot_contains(snap, &k) == (k % 2 == 1));
+    if (v) assert(*v == (long long)k * 10);
+  }
+  int lo = 10, hi = 21;
+  assert(avl_snapshot_lower_bound(snap, &lo) == 5);
+  assert(avl_snapshot_upper_bound(snap, &hi) == 11);
+  assert(*(const int *)avl_snapshot_key_at(snap, 5) == 11);
+  range_sum = 0;
+  // 11 + 13 + ... + 19
+  assert(avl_snapshot_range(snap, &lo, &hi, sum_vals) == 5);
+  assert(range_sum == 750);
+  assert(avl_snapshot_range(snap, &hi, &lo, sum_vals) == 0);
+  avl_snapshot_close(snap);
+
+  // a flipped value byte is caught by the checksum
+  FILE *f = fopen(path, "r+b");
+  fseek(f, -5, SEEK_END);
+  fputc(0x7f, f);
+  fclose(f);
+  assert(avl_map_load(path, int_cmp) == NULL);
+  snap = avl_snapshot_open(path, int_cmp);
+  assert(snap && !avl_snapshot_verify(snap));
+  avl_snapshot_close(snap);
+
+  avl_map_drop(map);
+  free(map);
+  unlink(path);
+}
+
+void test_set_and_empty(void) {
+  char path[] = "/tmp/gbc_avl_io_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  avl_set_t *set = avl_set_new(sizeof(int), int_cmp);
+  for (int i = 100; i > 0; --i) avl_set_add(set, &i);
+  assert(avl_map_save(set->map, path));
+  avl_snapshot_t *snap = avl_snapshot_open(path, int_cmp);
+  assert(snap && avl_snapshot_length(snap) == 100);
+  for (int i = 0; i < 100; ++i) {
+    assert(*(const int *)avl_snapshot_key_at(snap, i) == i + 1);
+  }
+  avl_snapshot_close(snap);
+  avl_set_drop(set);
+
+  avl_map_t *empty = avl_map_new(sizeof(int), sizeof(int), int_cmp);
+  assert(avl_map_save(empty, path));
+  avl_map_t *loaded = avl_map_load(path, int_cmp);
+  assert(loaded && loaded->size == 0 && !loaded->root);
+  int k = 1;
+  assert(avl_map_add(loaded, &k, &k) && loaded->size == 1);
+  avl_map_drop(loaded);
+  free(loaded);
+  avl_map_drop(empty);
+  free(empty);
+
+  assert(avl_snapshot_open("/nonexistent/gbc_avl_io", int_cmp) == NULL);
+  unlink(path);
+}
+
+// write header over the start of the file at path
+static void patch_header(const char *path, const avl_file_header_t *header) {
+  FILE *f = fopen(path, "r+b");
+  assert(f && fwrite(header, sizeof(*header), 1, f) == 1);
+  fclose(f);
+}
+
+void test_corrupt_header(void) {
+  char path[] = "/tmp/gbc_avl_io_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  avl_map_t *map = avl_map_new(sizeof(int), sizeof(long long), int_cmp);
+  for (int i = 0; i < 100; ++i) {
+    long long v = i;
+    avl_map_add(map, &i, &v);
+  }
+  assert(avl_map_save(map, path));
+  avl_file_header_t good;
+  FILE *f = fopen(path, "rb");
+  assert(f && fread(&good, sizeof(good), 1, f) == 1);
+  fclose(f);
+
+  // counts whose sizes wrap to a file that would fit, a count one too big,
+  // and a value array starting past the end
+  uint64_t counts[] = {1ull << 62, (1ull << 62) + 100, 101};
+  for (int c = 0; c < 3; ++c) {
+    avl_file_header_t bad = good;
+    bad.count = counts[c];
+    bad.vals_offset = avl_file_vals_offset(bad.key_obj_size, bad.count);
+    patch_header(path, &bad);
+    assert(avl_snapshot_open(path, int_cmp) == NULL);
+    assert(avl_map_load(path, int_cmp) == NULL);
+  }
+  avl_file_header_t bad = good;
+  bad.count = 0;
+  bad.vals_offset = avl_file_vals_offset(bad.key_obj_size, 0);
+  bad.val_obj_size = 1ull << 62;
+  patch_header(path, &bad);
+  avl_snapshot_t *snap = avl_snapshot_open(path, int_cmp);
+  assert(snap && avl_snapshot_length(snap) == 0);
+  avl_snapshot_close(snap);
+  bad.count = 2;
+  patch_header(path, &bad);
+  assert(avl_snapshot_open(path, int_cmp) == NULL);
+
+  // the untouched header opens again
+  patch_header(path, &good);
+  snap = avl_snapshot_open(path, int_cmp);
+  assert(snap && avl_snapshot_verify(snap) && avl_snapshot_length(snap) == 100);
+  avl_snapshot_close(snap);
+  avl_map_drop(map);
+  free(map);
+  unlink(path);
+}
+
+int main(void) {
+  test_map_save_load();
+  test_set_and_empty();
+  test_corrupt_header();
+  return 0;
+}
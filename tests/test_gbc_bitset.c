@@ -0,0 +1,243 @@
+#include "../include/gbc_bitset.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_BITS 5000
+
+static const gbc_cpu_level_t levels[] = {GBC_CPU_SCALAR, GBC_CPU_AVX2};
+
+// sizes around the word and the AVX2 register edges
+static const size_t sizes[] = {0, 1, 63, 64, 65, 255, 256, 257, 1000, 4999};
+
+static bool ref_a[MAX_BITS], ref_b[MAX_BITS];
+
+// compare b with the reference through test, count and the foreach macro
+static void check_same(const bitset_t *b, const bool *ref, size_t nbits) {
+  size_t count = 0, prev = 0;
+  for (size_t i = 0; i < nbits; ++i) {
+    assert(bitset_test(b, i) == ref[i]);
+    count += ref[i];
+  }
+  assert(!bitset_test(b, nbits) && !bitset_test(b, nbits + 1000));
+  assert(bitset_count(b) == count);
+  size_t seen = 0;
+  GBC_BITSET_FOREACH(i, b) {
+    assert(ref[i] && (seen == 0 || i > prev));
+    prev = i;
+    seen++;
+  }
+  assert(seen == count);
+}
+
+static void fill(bitset_t *b, bool *ref, size_t nbits, int percent) {
+  memset(ref, 0, MAX_BITS * sizeof(bool));
+  bitset_clear_all(b);
+  for (size_t i = 0; i < nbits; ++i) {
+    if (rand() % 100 < percent) {
+      bitset_set(b, i);
+      ref[i] = true;
+    }
+  }
+}
+
+void test_bitset_set_clear(void) {
+  bitset_t *b = bitset_new(100);
+  assert(b->nbits == 100 && bitset_count(b) == 0);
+  assert(bitset_next(b, 0) == 100);
+  assert(bitset_set(b, 3) && !bitset_set(b, 3) && bitset_test(b, 3));
+  assert(bitset_clear(b, 3) && !bitset_clear(b, 3) && !bitset_test(b, 3));
+  assert(!bitset_clear(b, 100000));
+
+  // setting past the end grows
+  assert(bitset_set(b, 1000) && b->nbits == 1001 && bitset_test(b, 1000));
+  assert(bitset_set(b, 64) && bitset_next(b, 0) == 64);
+  assert(bitset_next(b, 65) == 1000 && bitset_next(b, 1001) == 1001);
+
+  // shrinking drops the bits, growing back finds them clear
+  assert(bitset_resize(b, 500) && bitset_count(b) == 1);
+  assert(bitset_resize(b, 2000) && !bitset_test(b, 1000));
+  assert(bitset_resize(b, 64) && bitset_count(b) == 0);
+  assert(bitset_resize(b, 65) && !bitset_test(b, 64));
+
+  // ranges within a word and across several
+  memset(ref_a, 0, sizeof(ref_a));
+  bitset_clear_all(b);
+  size_t ranges[][2] = {{3, 9}, {60, 70}, {128, 192}, {200, 200}, {250, 900}};
+  for (size_t r = 0; r < 5; ++r) {
+    assert(bitset_set_range(b, ranges[r][0], ranges[r][1]));
+    for (size_t i = ranges[r][0]; i < ranges[r][1]; ++i) ref_a[i] = true;
+  }
+  assert(b->nbits == 900);
+  check_same(b, ref_a, b->nbits);
+  assert(bitset_set_range(b, 900, 1203) && b->nbits == 1203);
+  for (size_t i = 900; i < 1203; ++i) ref_a[i] = true;
+  check_same(b, ref_a, b->nbits);
+
+  bitset_t *c = bitset_clone(b);
+  assert(bitset_equal(b, c) && c->nbits == b->nbits);
+  check_same(c, ref_a, c->nbits);
+  bitset_drop(c);
+  bitset_drop(b);
+}
+
+void test_bitset_rank_select(void) {
+  for (int l = 0; l < 2; ++l) {
+    gbc_cpu_force_level(levels[l]);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+      size_t n = sizes[s];
+      bitset_t *b = bitset_new(n);
+      fill(b, ref_a, n, 30);
+      check_same(b, ref_a, n);
+      size_t rank = 0;
+      for (size_t i = 0; i < n; ++i) {
+        assert(bitset_rank(b, i) == rank);
+        if (ref_a[i]) {
+          size_t at;
+          assert(bitset_select(b, rank, &at) && at == i);
+          rank++;
+        }
+      }
+      size_t at;
+      assert(bitset_rank(b, n) == rank && bitset_rank(b, n + 100) == rank);
+      assert(!bitset_select(b, rank, &at));
+      bitset_drop(b);
+    }
+  }
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+}
+
+void test_bitset_algebra(void) {
+  static bool expected[MAX_BITS];
+  for (int l = 0; l < 2; ++l) {
+    gbc_cpu_force_level(levels[l]);
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+      for (size_t t = 0; t < sizeof(sizes) / sizeof(sizes[0]); t += 3) {
+        size_t na = sizes[s], nb = sizes[t];
+        size_t lo = na < nb ? na : nb, hi = na < nb ? nb : na;
+        bitset_t *a = bitset_new(na), *b = bitset_new(nb);
+        fill(a, ref_a, na, 40);
+        fill(b, ref_b, nb, 60);
+
+        size_t both = 0;
+        for (size_t i = 0; i < lo; ++i) both += ref_a[i] && ref_b[i];
+        assert(bitset_and_count(a, b) == both);
+        assert(bitset_and_count(b, a) == both);
+
+        bitset_t *d = bitset_clone(a);
+        bitset_and(d, b);
+        for (size_t i = 0; i < na; ++i) expected[i] = ref_a[i] && ref_b[i];
+        assert(d->nbits == na);
+        check_same(d, expected, na);
+        assert(bitset_is_subset(d, a) && bitset_is_subset(d, b));
+        bitset_drop(d);
+
+        d = bitset_clone(a);
+        assert(bitset_or(d, b) && d->nbits == hi);
+        for (size_t i = 0; i < hi; ++i) expected[i] = ref_a[i] || ref_b[i];
+        check_same(d, expected, hi);
+        assert(bitset_is_subset(a, d) && bitset_is_subset(b, d));
+        bitset_drop(d);
+
+        d = bitset_clone(a);
+        assert(bitset_xor(d, b) && d->nbits == hi);
+        for (size_t i = 0; i < hi; ++i) expected[i] = ref_a[i] != ref_b[i];
+        check_same(d, expected, hi);
+        // xor twice gives a back, maybe longer
+        assert(bitset_xor(d, b) && bitset_equal(d, a));
+        bitset_drop(d);
+
+        d = bitset_clone(a);
+        bitset_andnot(d, b);
+        for (size_t i = 0; i < na; ++i) expected[i] = ref_a[i] && !ref_b[i];
+        check_same(d, expected, na);
+        assert(bitset_and_count(d, b) == 0);
+        bitset_drop(d);
+
+        bitset_drop(a);
+        bitset_drop(b);
+      }
+    }
+  }
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+
+  // equal and subset ignore the size
+  bitset_t *a = bitset_new(10), *b = bitset_new(1000);
+  bitset_set(a, 5);
+  bitset_set(b, 5);
+  assert(bitset_equal(a, b) && bitset_equal(b, a));
+  assert(bitset_is_subset(a, b) && bitset_is_subset(b, a));
+  bitset_set(b, 900);
+  assert(!bitset_equal(a, b) && bitset_is_subset(a, b));
+  assert(!bitset_is_subset(b, a));
+  bitset_drop(a);
+  bitset_drop(b);
+}
+
+void test_bitset_iter(void) {
+  bitset_t *b = bitset_new(MAX_BITS);
+  fill(b, ref_a, MAX_BITS, 50);
+  // a full word and an empty stretch
+  bitset_set_range(b, 128, 192);
+  bitset_t *gap = bitset_new(0);
+  bitset_set_range(gap, 1000, 3000);
+  bitset_andnot(b, gap);
+  for (size_t i = 128; i < 192; ++i) ref_a[i] = true;
+  for (size_t i = 1000; i < 3000; ++i) ref_a[i] = false;
+  check_same(b, ref_a, MAX_BITS);
+
+  bitset_iter_t it;
+  bitset_iter_init(&it, b);
+  for (size_t i = 0; i < MAX_BITS; ++i) {
+    if (!ref_a[i]) continue;
+    assert(bitset_iter_has_next(&it));
+    assert(*(size_t *)bitset_iter_next(&it) == i);
+  }
+  assert(!bitset_iter_has_next(&it) && bitset_iter_next(&it) == NULL);
+  bitset_iter_fini(&it);
+
+  // batches of odd sizes end inside words
+  size_t max_batches[] = {1, 7, 64, ITER_BATCH_MAX};
+  for (size_t m = 0; m < 4; ++m) {
+    bitset_iter_t *hit = bitset_iter_new(b);
+    iter_batch_t batch;
+    size_t n, x = 0, total = 0;
+    while ((n = iter_next_batch((iter_t *)hit, &batch, max_batches[m])) > 0) {
+      assert(n <= max_batches[m] && batch.span);
+      for (size_t k = 0; k < n; ++k) {
+        while (!ref_a[x]) x++;
+        assert(*(size_t *)iter_batch_at(&batch, k, sizeof(size_t)) == x++);
+      }
+      total += n;
+    }
+    assert(total == bitset_count(b));
+    bitset_iter_drop(hit);
+  }
+  bitset_drop(gap);
+  bitset_drop(b);
+}
+
+void test_bitset_arena(void) {
+  gbc_arena_t arena;
+  gbc_arena_init(&arena, 1 << 12);
+  bitset_t *b = bitset_new_ex(0, gbc_arena_allocator(&arena));
+  for (size_t i = 0; i < 100000; i += 3) bitset_set(b, i);
+  assert(bitset_count(b) == 33334 && bitset_test(b, 99999));
+  bitset_t *c = bitset_clone(b);
+  bitset_xor(c, b);
+  assert(bitset_count(c) == 0);
+  bitset_drop(c);
+  bitset_drop(b);
+  gbc_arena_fini(&arena);
+}
+
+int main(void) {
+  srand(11);
+  test_bitset_set_clear();
+  test_bitset_rank_select();
+  test_bitset_algebra();
+  test_bitset_iter();
+  test_bitset_arena();
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include "../include/gbc_cdq.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static long long foreach_sum;
+
+void sum_fn(const void *p) { foreach_sum += *(const long long *)p; }
+
+int cmp_ll(const void *a, const void *b) {
+  long long x = *(const long long *)a, y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+void test_cdq_push_pop(void) {
+  cdq_t *q = cdq_new(sizeof(long long));
+  assert(cdq_is_empty(q) && cdq_front(q) == NULL && cdq_back(q) == NULL);
+  long long n = 10000;
+  // -n .. n-1 with the middle pushed first
+  for (long long i = 0; i < n; ++i) {
+    long long neg = -i - 1;
+    assert(cdq_push_back(q, &i));
+    assert(cdq_push_front(q, &neg));
+  }
+  assert(cdq_length(q) == (size_t)(2 * n));
+  for (long long i = 0; i < 2 * n; ++i) {
+    assert(*(const long long *)cdq_at(q, i) == i - n);
+  }
+  // growing never moved the elements
+  const long long *mid = cdq_at(q, n);
+  for (long long i = 0; i < n; ++i) {
+    assert(cdq_push_back(q, &i) && cdq_push_front(q, &i));
+  }
+  assert(mid == cdq_at(q, 2 * n) && *mid == 0);
+  for (long long i = 0; i < n; ++i) {
+    assert(cdq_del_front(q) && cdq_del_back(q));
+  }
+  assert(*(const long long *)cdq_front(q) == -n);
+  assert(*(const long long *)cdq_back(q) == n - 1);
+
+  long long x = 42;
+  assert(cdq_update(q, 3, &x) && *(long long *)cdq_at_mut(q, 3) == 42);
+  assert(!cdq_update(q, cdq_length(q), &x));
+  while (cdq_del_back(q)) {
+  }
+  assert(cdq_is_empty(q) && q->n_blocks == 0 && !cdq_del_front(q));
+  // the deque works again once emptied, from both ends
+  assert(cdq_push_front(q, &x) && *(const long long *)cdq_back(q) == 42);
+  assert(cdq_del_front(q) && cdq_is_empty(q));
+  cdq_drop(q);
+}
+
+void test_cdq_fifo_cache(void) {
+  cdq_t *q = cdq_new(sizeof(long long));
+  long long next = 0;
+  for (long long i = 0; i < 100000; ++i) {
+    assert(cdq_push_back(q, &i));
+    if (cdq_length(q) == 1000) {
+      assert(*(const long long *)cdq_front(q) == next++);
+      cdq_del_front(q);
+    }
+  }
+  // a sliding window needs a bounded number of blocks and a small map
+  assert(q->n_blocks <= 1000 / q->block_cap + 2);
+  assert(q->map_cap <= 64);
+  assert(q->n_cached <= CDQ_BLOCK_CACHE);
+  cdq_drop(q);
+}
+
+void test_cdq_insert_del_at(void) {
+  cdq_t *q = cdq_new(sizeof(long long));
+  long long ref[3000];
+  size_t len = 0;
+  srand(7);
+  for (int round = 0; round < 3000; ++round) {
+    long long v = round;
+    size_t idx = len ? (size_t)rand() % (len + 1) : 0;
+    assert(cdq_insert(q, idx, &v));
+    memmove(ref + idx + 1, ref + idx, (len - idx) * sizeof(long long));
+    ref[idx] = v;
+    len++;
+    if (round % 3 == 2) {
+      idx = (size_t)rand() % len;
+      assert(cdq_del_at(q, idx));
+      memmove(ref + idx, ref + idx + 1, (len - idx - 1) * sizeof(long long));
+      len--;
+    }
+  }
+  assert(cdq_length(q) == len);
+  for (size_t i = 0; i < len; ++i) {
+    assert(*(const long long *)cdq_at(q, i) == ref[i]);
+  }
+  assert(!cdq_del_at(q, len));
+  long long target = ref[len / 2];
+  assert(cdq_del(q, &target, cmp_ll) && cdq_length(q) == len - 1);
+  assert(!cdq_del(q, &target, cmp_ll));
+  cdq_drop(q);
+}
+
+void test_cdq_reverse_sort_clone(void) {
+  long long arr[1000];
+  for (long long i = 0; i < 1000; ++i) arr[i] = (i * 7919) % 1000;
+  cdq_t *q = cdq_from_array(arr, 1000, sizeof(long long));
+  for (long long i = 0; i < 100; ++i) cdq_del_front(q);
+  assert(cdq_sort(q, cmp_ll));
+  for (size_t i = 1; i < cdq_length(q); ++i) {
+    assert(*(const long long *)cdq_at(q, i - 1) <=
+           *(const long long *)cdq_at(q, i));
+  }
+  cdq_t *c = cdq_clone(q);
+  assert(cdq_reverse(c) && cdq_length(c) == 900);
+  for (size_t i = 0; i < 900; ++i) {
+    assert(*(const long long *)cdq_at(c, i) ==
+           *(const long long *)cdq_at(q, 899 - i));
+  }
+
+  cdq_iter_t *iter = cdq_iter_new(q);
+  cdq_t *from = cdq_from_iter((iter_t *)iter);
+  cdq_iter_drop(iter);
+  foreach_sum = 0;
+  cdq_foreach(from, sum_fn);
+  long long expected = foreach_sum;
+  foreach_sum = 0;
+  cdq_foreach(c, sum_fn);
+  assert(foreach_sum == expected && cdq_length(from) == 900);
+
+  iter = cdq_iter_new(from);
+  size_t i = 0;
+  while (cdq_iter_has_next(iter)) {
+    assert(*(long long *)cdq_iter_next(iter) ==
+           *(const long long *)cdq_at(q, i++));
+  }
+  assert(i == 900 && cdq_iter_next(iter) == NULL);
+  cdq_iter_drop(iter);
+  cdq_drop(from);
+  cdq_drop(c);
+  cdq_drop(q);
+}
+
+int main(void) {
+  test_cdq_push_pop();
+  test_cdq_fifo_cache();
+  test_cdq_insert_del_at();
+  test_cdq_reverse_sort_clone();
+  return 0;
+}
@@ -0,0 +1,192 @@
+#define GBC_STATS
+#include "../include/gbc_chashmap.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_KEYS 50000
+#define N_THREADS 8
+
+static void add_fn(void *val, bool found, void *ctx) {
+  long long *v = (long long *)val;
+  assert(found || *v == 0);
+  *v += *(const long long *)ctx;
+}
+
+static void sum_fn(const void *key, const void *val, void *ctx) {
+  assert(*(const long long *)key * 2 == *(const long long *)val);
+  *(long long *)ctx += *(const long long *)val;
+}
+
+void test_chashmap_ops(void) {
+  // one shard and many, so that both the shard bits and the slots are used
+  size_t shards[] = {1, 3, 64};
+  static signed char ref[2 * N_KEYS];
+  for (int k = 0; k < 3; ++k) {
+    chashmap_t *map =
+        chashmap_new_ex(sizeof(long long), sizeof(long long), NULL, NULL,
+                        shards[k], NULL);
+    assert(map->nshards == (shards[k] == 3 ? 4 : shards[k]));
+    memset(ref, 0, sizeof(ref));
+    srand(5);
+    size_t size = 0;
+    for (int op = 0; op < 4 * N_KEYS; ++op) {
+      long long key = rand() % (2 * N_KEYS), val = 2 * key, got = -1;
+      switch (rand() % 4) {
+        case 0:
+        case 1:
+          assert(chashmap_insert(map, &key, &val) == !ref[key]);
+          size += !ref[key];
+          ref[key] = 1;
+          break;
+        case 2:
+          assert(chashmap_erase(map, &key, &got) == ref[key]);
+          assert(ref[key] ? got == val : got == -1);
+          size -= ref[key];
+          ref[key] = 0;
+          break;
+        default:
+          assert(chashmap_get(map, &key, &got) == ref[key]);
+          assert(ref[key] ? got == val : got == -1);
+          break;
+      }
+    }
+    assert(chashmap_size(map) == size);
+    long long sum = 0, expected = 0;
+    for (long long key = 0; key < 2 * N_KEYS; ++key) {
+      assert(chashmap_contains(map, &key) == ref[key]);
+      if (ref[key]) expected += 2 * key;
+    }
+    chashmap_foreach(map, sum_fn, &sum);
+    assert(sum == expected);
+
+    // every key gone, one by one, the rest is still found
+    for (long long key = 0; key < 2 * N_KEYS; ++key) {
+      assert(chashmap_erase(map, &key, NULL) == ref[key]);
+      long long next = key + 1;
+      if (next < 2 * N_KEYS) {
+        assert(chashmap_contains(map, &next) == ref[next]);
+      }
+    }
+    assert(chashmap_size(map) == 0);
+
+    // the map, its shard array and two buffers per used shard are live,
+    // emptied shards keep their memory
+    gbc_stats_t stats;
+    assert(chashmap_stats(map, &stats) && stats.grows > 0);
+    size_t used = 0;
+    for (size_t s = 0; s < map->nshards; ++s) used += map->shards[s].cap > 0;
+    assert(stats.allocs - stats.frees == 2 + 2 * used);
+    chashmap_drop(map);
+  }
+}
+
+void test_chashmap_upsert(void) {
+  chashmap_t *map = chashmap_new(sizeof(long long), sizeof(long long), NULL,
+                                 NULL);
+  for (long long i = 0; i < 1000; ++i) {
+    long long key = i % 10, delta = i;
+    assert(chashmap_upsert_with(map, &key, add_fn, &delta));
+  }
+  assert(chashmap_size(map) == 10);
+  for (long long key = 0; key < 10; ++key) {
+    long long got;
+    // key, key + 10, ... up to 990 + key
+    assert(chashmap_get(map, &key, &got) && got == 100 * key + 49500);
+  }
+  long long key = 3, val = 1;
+  assert(!chashmap_insert(map, &key, &val));
+  chashmap_clear(map);
+  assert(chashmap_size(map) == 0 && !chashmap_contains(map, &key));
+  assert(chashmap_insert(map, &key, &val));
+  chashmap_drop(map);
+}
+
+// string keys in 24-byte buffers with garbage after the terminator, so
+// the hash and the compare only look at the characters
+static uint64_t str_hash(const void *key, size_t size) {
+  (void)size;
+  return gbc_hash_bytes(key, strlen((const char *)key));
+}
+
+static int str_cmp(const void *a, const void *b) {
+  return strcmp((const char *)a, (const char *)b);
+}
+
+void test_chashmap_custom_keys(void) {
+  // a 3-byte value after a 24-byte key
+  chashmap_t *map = chashmap_new(24, 3, str_hash, str_cmp);
+  assert(map->val_offset == 24 && map->stride == 32);
+  char key[24], val[3];
+  for (int i = 0; i < 3000; ++i) {
+    memset(key, i & 0x7f, sizeof(key));
+    snprintf(key, sizeof(key), "key-%d", i);
+    memcpy(val, &i, 3);
+    assert(chashmap_insert(map, key, val));
+  }
+  for (int i = 0; i < 6000; ++i) {
+    char probe[24] = {0};
+    snprintf(probe, sizeof(probe), "key-%d", i);
+    int got = 0;
+    assert(chashmap_get(map, probe, &got) == (i < 3000));
+    assert(i >= 3000 || got == i);
+  }
+  chashmap_drop(map);
+}
+
+typedef struct {
+  chashmap_t *map;
+  long long id;
+} worker_t;
+
+// each thread inserts its own keys, bumps shared counters and erases half
+// of its keys again
+static void *worker_main(void *p) {
+  worker_t *w = (worker_t *)p;
+  for (long long i = 0; i < N_KEYS; ++i) {
+    long long key = w->id * N_KEYS + i + 1000, val = key * 2;
+    assert(chashmap_insert(w->map, &key, &val));
+    long long counter = i % 100, one = 1;
+    assert(chashmap_upsert_with(w->map, &counter, add_fn, &one));
+    long long got;
+    assert(chashmap_get(w->map, &key, &got) && got == val);
+    if (i % 2) assert(chashmap_erase(w->map, &key, NULL));
+  }
+  return NULL;
+}
+
+void test_chashmap_threads(void) {
+  chashmap_t *map = chashmap_new(sizeof(long long), sizeof(long long), NULL,
+                                 NULL);
+  pthread_t tids[N_THREADS];
+  worker_t workers[N_THREADS];
+  for (int t = 0; t < N_THREADS; ++t) {
+    workers[t].map = map;
+    workers[t].id = t;
+    assert(pthread_create(&tids[t], NULL, worker_main, &workers[t]) == 0);
+  }
+  for (int t = 0; t < N_THREADS; ++t) pthread_join(tids[t], NULL);
+
+  assert(chashmap_size(map) == 100 + N_THREADS * N_KEYS / 2);
+  for (long long counter = 0; counter < 100; ++counter) {
+    long long got;
+    assert(chashmap_get(map, &counter, &got));
+    assert(got == N_THREADS * N_KEYS / 100);
+  }
+  for (long long t = 0; t < N_THREADS; ++t) {
+    for (long long i = 0; i < N_KEYS; ++i) {
+      long long key = t * N_KEYS + i + 1000;
+      assert(chashmap_contains(map, &key) == (i % 2 == 0));
+    }
+  }
+  chashmap_drop(map);
+}
+
+int main(void) {
+  test_chashmap_ops();
+  test_chashmap_upsert();
+  test_chashmap_custom_keys();
+  test_chashmap_threads();
+  return 0;
+}
@@ -154,11 +154,100 @@ void test_deque_sort(void) {
   vdq_drop(q);
 }
 
+// insert and delete at random positions of a wrapped ring, checked against
+// a plain array, with no allocation unless the ring is full
+void test_deque_insert_del_at(void) {
+  vdq_t *q = vdq_new_with_cap(sizeof(int), 64);
+  int ref[64];
+  size_t len = 0;
+  // wrap the ring before starting
+  for (int i = 0; i < 40; ++i) {
+    vdq_push_back(q, &i);
+    vdq_del_front(q);
+  }
+  srand(11);
+  for (int round = 0; round < 5000; ++round) {
+    if (len < 60 && (len < 4 || rand() % 2)) {
+      size_t idx = (size_t)rand() % (len + 1);
+      assert(vdq_insert(q, idx, &round));
+      memmove(ref + idx + 1, ref + idx, (len - idx) * sizeof(int));
+      ref[idx] = round;
+      len++;
+    } else {
+      size_t idx = (size_t)rand() % len;
+      assert(vdq_del_at(q, idx));
+      memmove(ref + idx, ref + idx + 1, (len - idx - 1) * sizeof(int));
+      len--;
+    }
+    assert(q->size == len && q->cap == 64);
+    assert(q->rear == (q->front + q->size) % q->cap);
+    for (size_t i = 0; i < len; ++i) assert(*(int *)vdq_at(q, i) == ref[i]);
+  }
+  vdq_drop(q);
+}
+
+void test_deque_drain_range(void) {
+  for (size_t from = 0; from <= 12; ++from) {
+    for (size_t to = from; to <= 12; ++to) {
+      vdq_t *q = vdq_new_with_cap(sizeof(int), 16);
+      // the elements 0..11 start at slot 10 and wrap
+      for (int i = 0; i < 10; ++i) {
+        vdq_push_back(q, &i);
+        vdq_del_front(q);
+      }
+      for (int i = 0; i < 12; ++i) vdq_push_back(q, &i);
+      assert(vdq_drain_range(q, from, to));
+      assert(q->size == 12 - (to - from) && q->cap == 16);
+      for (size_t i = 0; i < q->size; ++i) {
+        int expected = (int)(i < from ? i : i + (to - from));
+        assert(*(int *)vdq_at(q, i) == expected);
+      }
+      vdq_drop(q);
+    }
+  }
+}
+
+static bool is_odd(const void *x, void *ctx) {
+  (void)ctx;
+  return *(const int *)x % 2;
+}
+
+void test_deque_bulk_delete(void) {
+  vdq_t *q = vdq_new_with_cap(sizeof(int), 64);
+  // the elements start at slot 40 and wrap
+  for (int i = 0; i < 40; ++i) {
+    vdq_push_back(q, &i);
+    vdq_del_front(q);
+  }
+  for (int i = 0; i < 60; ++i) vdq_push_back(q, &i);
+  assert(vdq_retain(q, is_odd, NULL) == 30 && q->size == 30);
+  assert(q->rear == (q->front + q->size) % q->cap);
+  for (int i = 0; i < 30; ++i) assert(*(int *)vdq_at(q, i) == 2 * i + 1);
+  assert(vdq_swap_remove(q, 0) && q->size == 29);
+  assert(*(int *)vdq_front(q) == 59 && *(int *)vdq_back(q) == 57);
+  vdq_truncate(q, 40);
+  assert(q->size == 29);
+  vdq_truncate(q, 2);
+  assert(q->size == 2 && *(int *)vdq_back(q) == 3);
+
+  int xs[] = {7, 7, 8, 8, 8, 9, 7};
+  for (int i = 0; i < 7; ++i) vdq_push_front(q, &xs[i]);
+  // front to back: 7 9 8 8 8 7 7 59 3
+  assert(vdq_dedup(q, int_cmp) == 3 && q->size == 6);
+  int expected[] = {7, 9, 8, 7, 59, 3};
+  for (int i = 0; i < 6; ++i) assert(*(int *)vdq_at(q, i) == expected[i]);
+  assert(q->rear == (q->front + q->size) % q->cap);
+  vdq_drop(q);
+}
+
 int main() {
   test_deque_new();
   test_deque_del();
   test_deque_reverse();
   test_deque_push();
   test_deque_sort();
+  test_deque_insert_del_at();
+  test_deque_drain_range();
+  test_deque_bulk_delete();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,281 @@
+// the counters show how many lookups the filters answer
+#define GBC_STATS
+#include "../include/gbc_avl.h"
+#include "../include/gbc_filter.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_KEYS 100000
+
+static const gbc_cpu_level_t levels[] = {GBC_CPU_SCALAR, GBC_CPU_AVX2};
+
+static uint64_t key_hash(uint64_t i) { return gbc_hash_bytes(&i, sizeof(i)); }
+
+static int u64_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// the keys N_KEYS and up were never added, count the ones that pass
+static size_t false_positives(const gbc_filter_t *f) {
+  size_t fp = 0;
+  for (uint64_t i = N_KEYS; i < 2 * N_KEYS; ++i) {
+    fp += gbc_filter_may_contain(f, key_hash(i));
+  }
+  return fp;
+}
+
+void test_hash_bytes(void) {
+  char a[40], b[40];
+  for (int i = 0; i < 40; ++i) a[i] = b[i] = (char)i;
+  for (size_t size = 0; size <= 40; ++size) {
+    assert(gbc_hash_bytes(a, size) == gbc_hash_bytes(b, size));
+    if (size > 0) {
+      // every byte counts
+      b[size - 1] ^= 1;
+      assert(gbc_hash_bytes(a, size) != gbc_hash_bytes(b, size));
+      b[size - 1] ^= 1;
+    }
+  }
+  assert(gbc_hash_bytes(a, 3) != gbc_hash_bytes(a, 4));
+}
+
+void test_bloom(void) {
+  for (int l = 0; l < 2; ++l) {
+    gbc_cpu_force_level(levels[l]);
+    size_t bits[] = {8, 12, 16};
+    // false positives per 10000 absent keys, with some slack
+    size_t max_fp[] = {400, 80, 25};
+    for (int b = 0; b < 3; ++b) {
+      bloom_t *bloom = bloom_new(N_KEYS, bits[b]);
+      for (uint64_t i = 0; i < N_KEYS; ++i) {
+        assert(bloom_add(bloom, key_hash(i)));
+      }
+      assert(!bloom_add(bloom, key_hash(N_KEYS * 10)));
+      for (uint64_t i = 0; i < N_KEYS; ++i) {
+        assert(bloom_may_contain(bloom, key_hash(i)));
+      }
+      size_t fp = 0;
+      for (uint64_t i = N_KEYS + 1; i < 2 * N_KEYS; ++i) {
+        fp += bloom_may_contain(bloom, key_hash(i));
+      }
+      assert(fp * 10000 / N_KEYS <= max_fp[b]);
+      // the other level sees the same bits
+      gbc_cpu_force_level(levels[1 - l]);
+      for (uint64_t i = 0; i < N_KEYS; i += 7) {
+        assert(bloom_may_contain(bloom, key_hash(i)));
+      }
+      gbc_cpu_force_level(levels[l]);
+      bloom_clear(bloom);
+      assert(!bloom_may_contain(bloom, key_hash(1)));
+      bloom_drop(bloom);
+    }
+  }
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+}
+
+void test_cuckoo(void) {
+  cuckoo_t *c = cuckoo_new(N_KEYS);
+  assert(c->capacity >= N_KEYS);
+  for (uint64_t i = 0; i < N_KEYS; ++i) assert(cuckoo_add(c, key_hash(i)));
+  for (uint64_t i = 0; i < N_KEYS; ++i) {
+    assert(cuckoo_may_contain(c, key_hash(i)));
+  }
+  size_t fp = 0;
+  for (uint64_t i = N_KEYS; i < 2 * N_KEYS; ++i) {
+    fp += cuckoo_may_contain(c, key_hash(i));
+  }
+  assert(fp * 10000 / N_KEYS <= 10);
+
+  // deleting half keeps the other half
+  for (uint64_t i = 0; i < N_KEYS; i += 2) assert(cuckoo_del(c, key_hash(i)));
+  assert(c->count == N_KEYS / 2);
+  for (uint64_t i = 1; i < N_KEYS; i += 2) {
+    assert(cuckoo_may_contain(c, key_hash(i)));
+  }
+  for (uint64_t i = 0; i < N_KEYS; i += 2) {
+    fp += cuckoo_may_contain(c, key_hash(i));
+  }
+  assert(fp * 10000 / N_KEYS <= 20);
+  cuckoo_clear(c);
+  assert(c->count == 0 && !cuckoo_may_contain(c, key_hash(1)));
+  cuckoo_drop(c);
+
+  // overfill a small filter until it gives up, nothing added is lost
+  c = cuckoo_new(100);
+  uint64_t added = 0;
+  while (cuckoo_add(c, key_hash(added))) added++;
+  assert(added >= c->capacity && c->victim != 0);
+  assert(c->count == added);
+  for (uint64_t i = 0; i < added; ++i) {
+    assert(cuckoo_may_contain(c, key_hash(i)));
+  }
+  // a delete frees a slot, the victim goes back in
+  for (uint64_t i = 0; c->victim != 0 && i < added; ++i) {
+    assert(cuckoo_del(c, key_hash(i)));
+    for (uint64_t j = i + 1; j < added; ++j) {
+      assert(cuckoo_may_contain(c, key_hash(j)));
+    }
+  }
+  assert(c->victim == 0 && cuckoo_add(c, key_hash(added)));
+  cuckoo_drop(c);
+}
+
+void test_gbc_filter(void) {
+  gbc_filter_kind_t kinds[] = {GBC_FILTER_BLOOM, GBC_FILTER_CUCKOO};
+  for (int k = 0; k < 2; ++k) {
+    gbc_filter_t *f = gbc_filter_new(kinds[k], N_KEYS, NULL);
+    assert(gbc_filter_capacity(f) >= N_KEYS);
+    for (uint64_t i = 0; i < N_KEYS; ++i) {
+      assert(gbc_filter_add(f, key_hash(i)));
+    }
+    for (uint64_t i = 0; i < N_KEYS; ++i) {
+      assert(gbc_filter_may_contain(f, key_hash(i)));
+    }
+    assert(false_positives(f) * 100 < N_KEYS);
+    assert(gbc_filter_del(f, key_hash(3)) == (kinds[k] == GBC_FILTER_CUCKOO));
+    // a few bytes a key
+    assert(gbc_filter_memory_usage(f) < 4 * N_KEYS);
+    gbc_filter_drop(f);
+  }
+}
+
+void test_avl_map_filter(void) {
+  gbc_filter_kind_t kinds[] = {GBC_FILTER_BLOOM, GBC_FILTER_CUCKOO};
+  static bool ref[2 * N_KEYS];
+  for (int k = 0; k < 2; ++k) {
+    avl_map_t *map = avl_map_new(sizeof(uint64_t), sizeof(uint64_t), u64_cmp);
+    for (uint64_t i = 0; i < 1000; ++i) avl_map_add(map, &i, &i);
+    // enabled on a filled map, then grown far past its first size
+    assert(avl_map_enable_filter(map, kinds[k], NULL));
+    assert(gbc_filter_capacity(map->filter) < 10000);
+    memset(ref, 0, sizeof(ref));
+    for (uint64_t i = 0; i < 1000; ++i) ref[i] = true;
+    srand(3);
+    for (int op = 0; op < 4 * N_KEYS; ++op) {
+      uint64_t key = (uint64_t)rand() % (2 * N_KEYS);
+      if (rand() % 3) {
+        avl_map_add(map, &key, &key);
+        ref[key] = true;
+      } else {
+        assert(avl_map_del(map, &key) == ref[key]);
+        ref[key] = false;
+      }
+    }
+    gbc_stats_t stats;
+    avl_map_stats(map, &stats);
+    size_t skips = stats.filter_skips;
+    size_t misses = 0;
+    for (uint64_t key = 0; key < 2 * N_KEYS; ++key) {
+      assert(avl_map_contains(map, &key) == ref[key]);
+      const uint64_t *val = (const uint64_t *)avl_map_get(map, &key);
+      assert(ref[key] ? val && *val == key : val == NULL);
+      misses += !ref[key];
+    }
+    assert(gbc_filter_capacity(map->filter) >= map->size);
+    // most misses never reach the tree, but the deleted keys a Bloom filter
+    // still holds always do
+    avl_map_stats(map, &stats);
+    assert(map->filter_stale <= map->size / 4);
+    misses -= map->filter_stale;
+    assert(stats.filter_skips - skips > 2 * misses * 95 / 100);
+
+    // a map emptied by deletes, the Bloom filter is rebuilt on the way
+    for (uint64_t key = 0; key < 2 * N_KEYS; ++key) {
+      assert(avl_map_del(map, &key) == ref[key]);
+    }
+    assert(map->size == 0 && map->filter->kind == kinds[k]);
+    uint64_t key = 5;
+    assert(!avl_map_contains(map, &key));
+    avl_map_add(map, &key, &key);
+    assert(avl_map_contains(map, &key) && avl_map_update(map, &key, &key));
+    avl_map_disable_filter(map);
+    assert(!map->filter && avl_map_contains(map, &key));
+    avl_map_drop(map);
+    free(map);
+  }
+}
+
+GBC_AVL_DECLARE(u64_map, uint64_t, uint64_t, GBC_AVL_CMP_NUM)
+
+void test_typed_map_filter(void) {
+  gbc_filter_kind_t kinds[] = {GBC_FILTER_BLOOM, GBC_FILTER_CUCKOO};
+  for (int k = 0; k < 2; ++k) {
+    u64_map_t *map = u64_map_new();
+    assert(!map->base.filter);
+    for (uint64_t i = 0; i < 1000; i += 2) u64_map_add(map, i, i);
+    assert(avl_map_enable_filter(&map->base, kinds[k], NULL));
+    // the typed add and del keep the filter up to date, past a rebuild
+    for (uint64_t i = 1000; i < 20000; i += 2) u64_map_add(map, i, i);
+    for (uint64_t i = 0; i < 20000; i += 4) assert(u64_map_del(map, i));
+    for (uint64_t i = 0; i < 20000; ++i) {
+      assert(u64_map_contains(map, i) == (i % 4 == 2));
+      assert(avl_map_contains(&map->base, &i) == (i % 4 == 2));
+    }
+    gbc_stats_t stats;
+    avl_map_stats(&map->base, &stats);
+    assert(stats.filter_skips > 2 * 15000 * 9 / 10);
+    u64_map_drop(map);
+  }
+}
+
+// string keys compare with strcmp, so only their characters are hashed
+static int str_cmp(const void *a, const void *b) {
+  return strcmp((const char *)a, (const char *)b);
+}
+
+static uint64_t str_hash(const void *key, size_t size) {
+  (void)size;
+  return gbc_hash_bytes(key, strlen((const char *)key));
+}
+
+void test_avl_set_filter(void) {
+  avl_set_t *set = avl_set_new(32, str_cmp);
+  assert(avl_set_enable_filter(set, GBC_FILTER_CUCKOO, str_hash));
+  char key[32];
+  for (int i = 0; i < 5000; ++i) {
+    memset(key, i & 0xff, sizeof(key));
+    snprintf(key, sizeof(key), "user-%d", i);
+    assert(avl_set_add(set, key));
+  }
+  for (int i = 0; i < 10000; ++i) {
+    char probe[32] = {0};
+    snprintf(probe, sizeof(probe), "user-%d", i);
+    assert(avl_set_contains(set, probe) == (i < 5000));
+  }
+  for (int i = 0; i < 5000; i += 2) {
+    snprintf(key, sizeof(key), "user-%d", i);
+    assert(avl_set_del(set, key));
+  }
+  for (int i = 0; i < 5000; ++i) {
+    snprintf(key, sizeof(key), "user-%d", i);
+    assert(avl_set_contains(set, key) == (i % 2 == 1));
+  }
+  avl_set_disable_filter(set);
+  avl_set_drop(set);
+
+  // a set with a filter from an arena
+  gbc_arena_t arena;
+  gbc_arena_init(&arena, 1 << 16);
+  set = avl_set_new_ex(sizeof(uint64_t), u64_cmp, gbc_arena_allocator(&arena));
+  assert(avl_set_enable_filter(set, GBC_FILTER_BLOOM, NULL));
+  for (uint64_t i = 0; i < 10000; i += 3) avl_set_add(set, &i);
+  for (uint64_t i = 0; i < 10000; ++i) {
+    assert(avl_set_contains(set, &i) == (i % 3 == 0));
+  }
+  avl_set_drop(set);
+  gbc_arena_fini(&arena);
+}
+
+int main(void) {
+  test_hash_bytes();
+  test_bloom();
+  test_cuckoo();
+  test_gbc_filter();
+  test_avl_map_filter();
+  test_typed_map_filter();
+  test_avl_set_filter();
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include "../include/gbc_heap.h"
+
+int int_cmp(const void *a, const void *b) {
+  const int *_a = (int *)a;
+  const int *_b = (int *)b;
+  if (*_a == *_b)
+    return 0;
+  else if (*_a < *_b)
+    return -1;
+  else
+    return 1;
+}
+
+void check_heap_sorted(heap_t *h, size_t n) {
+  assert(heap_length(h) == n);
+  int prev;
+  assert(heap_pop(h, &prev));
+  for (size_t i = 1; i < n; ++i) {
+    int cur;
+    assert(heap_pop(h, &cur));
+    assert(prev <= cur);
+    prev = cur;
+  }
+  assert(heap_is_empty(h) && !heap_pop(h, NULL) && !heap_top(h));
+}
+
+void test_heap_push_pop(void) {
+  size_t arities[] = {2, 3, 4};
+  for (int a = 0; a < 3; ++a) {
+    heap_t *h = heap_new_with_arity(sizeof(int), arities[a], int_cmp);
+    int n = 100;
+    for (int i = 0; i < n; ++i) {
+      int v = (i * 37) % n;
+      heap_push(h, &v);
+    }
+    assert(*(int *)heap_top(h) == 0);
+    check_heap_sorted(h, n);
+    heap_drop(h);
+  }
+}
+
+void test_heap_from_vec(void) {
+  int arr[] = {30, 51, 21, 24, 26, 10, 10, 3, 99};
+  vec_t *v = vec_from_array(arr, 9, sizeof(int));
+  heap_t *h = heap_from_vec_with_arity(v, 4, int_cmp);
+  assert(*(int *)heap_top(h) == 3);
+  check_heap_sorted(h, 9);
+  heap_drop(h);
+}
+
+void test_heap_fused(void) {
+  heap_t *h = heap_new(sizeof(int), int_cmp);
+  int out;
+  int v = 5;
+  heap_push_pop(h, &v, &out);
+  assert(out == 5 && heap_is_empty(h));
+  assert(!heap_replace(h, &v, &out));
+  for (int i = 10; i < 15; ++i) heap_push(h, &i);
+  heap_push_pop(h, &v, &out);
+  assert(out == 5 && heap_length(h) == 5);
+  v = 20;
+  heap_push_pop(h, &v, &out);
+  assert(out == 10 && *(int *)heap_top(h) == 11);
+  v = 1;
+  heap_replace(h, &v, &out);
+  assert(out == 11 && *(int *)heap_top(h) == 1);
+  check_heap_sorted(h, 5);
+  heap_drop(h);
+}
+
+int main() {
+  test_heap_push_pop();
+  test_heap_from_vec();
+  test_heap_fused();
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include "../include/gbc_ipq.h"
+
+int int_cmp(const void *a, const void *b) {
+  const int *_a = (int *)a;
+  const int *_b = (int *)b;
+  if (*_a == *_b)
+    return 0;
+  else if (*_a < *_b)
+    return -1;
+  else
+    return 1;
+}
+
+void test_ipq_push_pop(void) {
+  ipq_t *q = ipq_new(sizeof(int), int_cmp);
+  ipq_handle_t handles[10];
+  for (int i = 0; i < 10; ++i) {
+    int k = 100 - i;
+    ipq_push(q, &k, &handles[i]);
+  }
+  assert(ipq_length(q) == 10);
+  ipq_handle_t top;
+  assert(*(int *)ipq_top(q, &top) == 91 && top == handles[9]);
+  int k = 50;
+  assert(ipq_decrease_key(q, handles[0], &k));
+  k = 200;
+  assert(!ipq_decrease_key(q, handles[1], &k));
+  assert(ipq_update(q, handles[1], &k));
+  assert(ipq_remove(q, handles[5]));
+  assert(!ipq_remove(q, handles[5]) && !ipq_contains(q, handles[5]));
+  int out;
+  ipq_handle_t h;
+  assert(ipq_pop(q, &out, &h));
+  assert(out == 50 && h == handles[0]);
+  int expected[] = {91, 92, 93, 94, 96, 97, 98, 200};
+  for (int i = 0; i < 8; ++i) {
+    assert(ipq_pop(q, &out, NULL));
+    assert(out == expected[i]);
+  }
+  assert(ipq_is_empty(q) && !ipq_pop(q, NULL, NULL));
+  ipq_drop(q);
+}
+
+void test_ipq_handle_reuse(void) {
+  ipq_t *q = ipq_new_with_cap(sizeof(int), 64, int_cmp);
+  int keys[64];
+  ipq_handle_t handles[64];
+  for (int i = 0; i < 64; ++i) {
+    keys[i] = (i * 37) % 64;
+    ipq_push(q, &keys[i], &handles[i]);
+  }
+  char *heap_buf = q->heap->buf;
+  char *key_buf = q->keys->buf;
+  for (int round = 0; round < 1000; ++round) {
+    int i = (round * 13) % 64;
+    assert(ipq_remove(q, handles[i]));
+    keys[i] = (keys[i] * 7 + round) % 1000;
+    assert(ipq_push(q, &keys[i], &handles[i]));
+    int j = (round * 29) % 64;
+    keys[j] -= 3;
+    assert(ipq_decrease_key(q, handles[j], &keys[j]));
+  }
+  // steady state does not reallocate
+  assert(q->heap->buf == heap_buf && q->keys->buf == key_buf);
+  int prev;
+  ipq_handle_t h;
+  ipq_pop(q, &prev, &h);
+  assert(prev == keys[h]);
+  while (!ipq_is_empty(q)) {
+    int cur;
+    ipq_pop(q, &cur, &h);
+    assert(prev <= cur && cur == keys[h]);
+    prev = cur;
+  }
+  ipq_drop(q);
+
+  // grown far past its first capacity, every handle still comes back
+  q = ipq_new_with_cap(sizeof(int), 4, int_cmp);
+  for (int i = 0; i < 1000; ++i) assert(ipq_push(q, &i, NULL));
+  assert(q->free_handles->cap >= q->keys->size);
+  while (ipq_pop(q, NULL, NULL)) {
+  }
+  assert(q->free_handles->size == 1000);
+  for (int i = 0; i < 1000; ++i) {
+    assert(ipq_push(q, &i, &h) && h < 1000);
+  }
+  assert(q->keys->size == 1000);
+  ipq_drop(q);
+}
+
+int main() {
+  test_ipq_push_pop();
+  test_ipq_handle_reuse();
+  return 0;
+}
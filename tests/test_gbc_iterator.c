@@ -0,0 +1,335 @@
+#include "../include/gbc_avl.h"
+#include "../include/gbc_cdq.h"
+#include "../include/gbc_deque.h"
+#include "../include/gbc_iterator.h"
+#include "../include/gbc_segvec.h"
+#include "../include/gbc_vector.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+bool is_odd(const void *elem, void *ctx) {
+  (void)ctx;
+  return *(const int *)elem % 2 != 0;
+}
+
+void scale(void *out, const void *in, void *ctx) {
+  *(long long *)out = (long long)*(const int *)in * *(const int *)ctx;
+}
+
+void sum_ll(void *acc, const void *elem, void *ctx) {
+  (void)ctx;
+  *(long long *)acc += *(const long long *)elem;
+}
+
+int int_cmp(const void *a, const void *b) {
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+vec_t *int_range(int from, int to) {
+  vec_t *v = vec_new(sizeof(int));
+  for (int i = from; i < to; ++i) vec_push(v, &i);
+  return v;
+}
+
+void test_iter_pipeline(void) {
+  vec_t *v = int_range(0, 100);
+  vec_iter_t *vit = vec_iter_new(v);
+  // skip 10, keep the odd ones, times 3, take 5: 33 39 45 51 57
+  iter_skip_t skip;
+  iter_filter_t filter;
+  iter_map_t map;
+  iter_take_t take;
+  int factor = 3;
+  long long out;
+  iter_t *it = iter_skip(&skip, (iter_t *)vit, 10);
+  it = iter_filter(&filter, it, is_odd, NULL);
+  it = iter_map(&map, it, sizeof(long long), &out, scale, &factor);
+  it = iter_take(&take, it, 5);
+
+  vec_t *res = vec_new(sizeof(long long));
+  assert(iter_collect_into(it, res) && res->size == 5);
+  for (size_t i = 0; i < 5; ++i) {
+    assert(*(const long long *)vec_at(res, i) == 33 + 6 * (long long)i);
+  }
+  assert(!it->has_next(it) && it->next(it) == NULL);
+  // take stopped pulling, the vector iterator is where take left it
+  assert(vec_iter_has_next(vit));
+  vec_drop(res);
+  vec_iter_drop(vit);
+
+  vit = vec_iter_new(v);
+  it = iter_filter(&filter, (iter_t *)vit, is_odd, NULL);
+  it = iter_map(&map, it, sizeof(long long), &out, scale, &factor);
+  long long acc = 0;
+  iter_fold(it, &acc, sum_ll, NULL);
+  assert(acc == 3 * 2500);
+  vec_iter_drop(vit);
+  vec_drop(v);
+}
+
+void test_iter_zip_chain_enumerate(void) {
+  vec_t *a = int_range(0, 10);
+  vdq_t *b = vdq_new(sizeof(int));
+  for (int i = 0; i < 5; ++i) {
+    int x = 100 + i;
+    vdq_push_front(b, &x);
+  }
+  vec_iter_t *ait = vec_iter_new(a);
+  vdq_iter_t *bit = vdq_iter_new(b);
+  iter_zip_t zip;
+  iter_t *it = iter_zip(&zip, (iter_t *)ait, (iter_t *)bit);
+  int n = 0;
+  while (it->has_next(it)) {
+    iter_pair_t *p = it->next(it);
+    assert(*(int *)p->first == n && *(int *)p->second == 104 - n);
+    n++;
+  }
+  assert(n == 5);
+  vec_iter_drop(ait);
+  vdq_iter_drop(bit);
+
+  ait = vec_iter_new(a);
+  bit = vdq_iter_new(b);
+  iter_chain_t chain;
+  iter_enumerate_t en;
+  it = iter_enumerate(&en, iter_chain(&chain, (iter_t *)ait, (iter_t *)bit));
+  size_t count = 0;
+  while (it->has_next(it)) {
+    iter_enum_t *e = it->next(it);
+    assert(e->idx == count);
+    int expected = count < 10 ? (int)count : 104 - (int)(count - 10);
+    assert(*(int *)e->value == expected);
+    count++;
+  }
+  assert(count == 15);
+  vec_iter_drop(ait);
+  vdq_iter_drop(bit);
+  vec_drop(a);
+  vdq_drop(b);
+}
+
+void test_iter_avl_count(void) {
+  avl_set_t *set = avl_set_new(sizeof(int), int_cmp);
+  for (int i = 0; i < 50; ++i) avl_set_add(set, &i);
+  avl_set_iter_t *sit = avl_set_iter_new(set);
+  iter_skip_t skip;
+  assert(iter_count(iter_skip(&skip, (iter_t *)sit, 20)) == 30);
+  avl_set_iter_drop(sit);
+  avl_set_drop(set);
+
+  vec_t *empty = vec_new(sizeof(int));
+  vec_iter_t *vit = vec_iter_new(empty);
+  iter_filter_t filter;
+  assert(iter_count(iter_filter(&filter, (iter_t *)vit, is_odd, NULL)) == 0);
+  vec_iter_drop(vit);
+  vec_drop(empty);
+}
+
+// drain iter in batches of max, checking the elements are 0, 1, 2, ...
+size_t drain_batches(iter_t *iter, size_t max, size_t *n_batches) {
+  void *ptrs[ITER_BATCH_MAX];
+  iter_batch_t batch = {.span = NULL, .ptrs = ptrs, .len = 0};
+  size_t n = 0;
+  *n_batches = 0;
+  while (iter_next_batch(iter, &batch, max) > 0) {
+    assert(batch.len <= max);
+    for (size_t i = 0; i < batch.len; ++i) {
+      const void *elem = iter_batch_at(&batch, i, iter->obj_size);
+      if (iter->obj_size == sizeof(avl_pair_t)) {
+        elem = ((const avl_pair_t *)elem)->key;
+      }
+      assert(*(const int *)elem == (int)n++);
+    }
+    (*n_batches)++;
+  }
+  assert(!iter->has_next(iter));
+  return n;
+}
+
+void test_iter_batch(void) {
+  size_t n_batches;
+  vec_t *v = int_range(0, 1000);
+  vec_iter_t *vit = vec_iter_new(v);
+  // a vector is one span
+  assert(drain_batches((iter_t *)vit, ITER_BATCH_MAX, &n_batches) == 1000);
+  assert(n_batches == (1000 + ITER_BATCH_MAX - 1) / ITER_BATCH_MAX);
+  vec_iter_drop(vit);
+
+  // a wrapped ring is two spans
+  vdq_t *q = vdq_new_with_cap(sizeof(int), 16);
+  for (int i = 0; i < 10; ++i) {
+    vdq_push_back(q, &i);
+    vdq_del_front(q);
+  }
+  for (int i = 0; i < 16; ++i) vdq_push_back(q, &i);
+  vdq_iter_t *qit = vdq_iter_new(q);
+  assert(drain_batches((iter_t *)qit, ITER_BATCH_MAX, &n_batches) == 16);
+  assert(n_batches == 2);
+  vdq_iter_drop(qit);
+  vdq_t *q2 = vdq_from_iter((iter_t *)(qit = vdq_iter_new(q)));
+  assert(q2->size == 16 && *(int *)vdq_back(q2) == 15);
+  vdq_iter_drop(qit);
+  vdq_drop(q2);
+  vdq_drop(q);
+
+  avl_set_t *set = avl_set_new(sizeof(int), int_cmp);
+  for (int i = 299; i >= 0; --i) avl_set_add(set, &i);
+  avl_set_iter_t *sit = avl_set_iter_new(set);
+  assert(drain_batches((iter_t *)sit, 100, &n_batches) == 300);
+  assert(n_batches == 3);
+  avl_set_iter_drop(sit);
+  avl_set_drop(set);
+
+  cdq_t *cq = cdq_new(sizeof(int));
+  for (int i = 999; i >= 0; --i) cdq_push_front(cq, &i);
+  cdq_iter_t *cit = cdq_iter_new(cq);
+  assert(drain_batches((iter_t *)cit, ITER_BATCH_MAX, &n_batches) == 1000);
+  cdq_iter_drop(cit);
+  cdq_drop(cq);
+
+  segvec_t *sv = segvec_new(sizeof(int));
+  for (int i = 0; i < 1000; ++i) segvec_push(sv, &i);
+  segvec_iter_t *svit = segvec_iter_new(sv);
+  assert(drain_batches((iter_t *)svit, ITER_BATCH_MAX, &n_batches) == 1000);
+  segvec_iter_drop(svit);
+  segvec_drop(sv);
+
+  // the adapters keep the batches of their source, the fallback gives one
+  vit = vec_iter_new(v);
+  iter_skip_t skip;
+  iter_filter_t filter;
+  iter_take_t take;
+  iter_t *it = iter_skip(&skip, (iter_t *)vit, 100);
+  it = iter_take(&take, iter_filter(&filter, it, is_odd, NULL), 300);
+  vec_t *res = vec_new(sizeof(int));
+  assert(iter_collect_into(it, res) && res->size == 300);
+  for (size_t i = 0; i < 300; ++i) {
+    assert(*(const int *)vec_at(res, i) == 101 + 2 * (int)i);
+  }
+  vec_iter_drop(vit);
+  vec_drop(res);
+
+  vit = vec_iter_new(v);
+  iter_map_t map;
+  long long out;
+  int factor = 2;
+  it = iter_map(&map, (iter_t *)vit, sizeof(long long), &out, scale, &factor);
+  res = vec_from_iter(it);
+  assert(res->size == 1000 && *(const long long *)vec_at(res, 999) == 1998);
+  vec_iter_drop(vit);
+  vec_drop(res);
+  vec_drop(v);
+}
+
+static size_t n_allocs;
+
+void *counting_alloc(void *ctx, size_t size) {
+  (void)ctx;
+  n_allocs++;
+  return malloc(size);
+}
+
+void *counting_realloc(void *ctx, void *ptr, size_t old_size,
+                       size_t new_size) {
+  (void)ctx;
+  (void)old_size;
+  n_allocs++;
+  return realloc(ptr, new_size);
+}
+
+void counting_free(void *ctx, void *ptr, size_t size) {
+  (void)ctx;
+  (void)size;
+  free(ptr);
+}
+
+void test_iter_init_no_alloc(void) {
+  gbc_allocator_t alloc = {.alloc = counting_alloc,
+                           .realloc = counting_realloc,
+                           .free = counting_free,
+                           .ctx = NULL};
+  vec_t *v = vec_new_ex(sizeof(int), 16, &alloc);
+  vdq_t *q = vdq_new_ex(sizeof(int), 16, &alloc);
+  avl_map_t *map = avl_map_new_ex(sizeof(int), sizeof(int), int_cmp, &alloc);
+  avl_set_t *set = avl_set_new_ex(sizeof(int), int_cmp, &alloc);
+  // insert in a scrambled order, then delete every third key
+  for (int i = 0; i < 500; ++i) {
+    int k = (i * 211) % 500;
+    vec_push(v, &i);
+    vdq_push_front(q, &i);
+    avl_map_add(map, &k, &i);
+    avl_set_add(set, &k);
+  }
+  for (int k = 0; k < 500; k += 3) {
+    avl_map_del(map, &k);
+    avl_set_del(set, &k);
+  }
+
+  n_allocs = 0;
+  vec_iter_t vit;
+  vec_iter_init(&vit, v);
+  int n = 0;
+  while (vec_iter_has_next(&vit)) assert(*(int *)vec_iter_next(&vit) == n++);
+  assert(n == 500);
+  vec_iter_fini(&vit);
+
+  vdq_iter_t qit;
+  vdq_iter_init(&qit, q);
+  while (vdq_iter_has_next(&qit)) assert(*(int *)vdq_iter_next(&qit) == --n);
+  assert(n == 0);
+  vdq_iter_fini(&qit);
+
+  // the successor walk visits the keys in order, skipping the deleted ones
+  avl_map_iter_t mit;
+  avl_map_iter_init(&mit, map);
+  int prev = -1;
+  while (avl_map_iter_has_next(&mit)) {
+    avl_pair_t *pair = avl_map_iter_next(&mit);
+    int k = *(int *)pair->key;
+    assert(k > prev && k % 3 != 0);
+    assert((*(int *)pair->val * 211) % 500 == k);
+    prev = k;
+    n++;
+  }
+  assert(n == 333 && avl_map_iter_next(&mit) == NULL);
+  avl_map_iter_fini(&mit);
+
+  avl_set_iter_t sit;
+  avl_set_iter_init(&sit, set);
+  assert(iter_count(&sit.base) == 333);
+  avl_set_iter_fini(&sit);
+  assert(n_allocs == 0);
+
+  avl_set_iter_t *heap_it = avl_set_iter_new(set);
+  assert(n_allocs == 1 && iter_count(&heap_it->base) == 333);
+  avl_set_iter_drop(heap_it);
+
+  n = 0;
+  GBC_VEC_FOREACH(int, x, v) {
+    if (*x % 2) continue;
+    if (*x == 100) break;
+    n++;
+  }
+  assert(n == 50);
+  n = 0;
+  GBC_VDQ_FOREACH(const int, x, q) { assert(*x == 499 - n++); }
+  assert(n == 500);
+
+  vec_drop(v);
+  vdq_drop(q);
+  avl_map_drop(map);
+  gbc_free(&alloc, map, sizeof(avl_map_t));
+  avl_set_drop(set);
+}
+
+int main(void) {
+  test_iter_pipeline();
+  test_iter_zip_chain_enumerate();
+  test_iter_avl_count();
+  test_iter_batch();
+  test_iter_init_no_alloc();
+  return 0;
+}
@@ -80,8 +80,53 @@ void test_map_new(void) {
   avl_map_drop(map);
 }
 
+GBC_AVL_DECLARE(int_map, int, int, GBC_AVL_CMP_NUM)
+
+static size_t check_avl_node(const avl_node_t *node) {
+  if (!node) return 0;
+  if (node->left) assert(node->left->parent == node);
+  if (node->right) assert(node->right->parent == node);
+  size_t lh = check_avl_node(node->left);
+  size_t rh = check_avl_node(node->right);
+  assert(lh <= rh + 1 && rh <= lh + 1);
+  assert(node->height == 1 + avl_max(lh, rh));
+  return node->height;
+}
+
+void test_typed_map(void) {
+  int_map_t *map = int_map_new();
+  int n = 1000;
+  for (int i = 0; i < n; ++i) {
+    int k = (i * 7919) % n;
+    assert(int_map_add(map, k, k * 2));
+  }
+  assert(int_map_size(map) == n);
+  check_avl_node(map->base.root);
+  for (int i = 0; i < n; i += 3) {
+    assert(int_map_del(map, i));
+    assert(!int_map_del(map, i));
+  }
+  check_avl_node(map->base.root);
+  for (int i = 0; i < n; ++i) {
+    const int *v = int_map_get(map, i);
+    if (i % 3 == 0) {
+      assert(!v && !int_map_contains(map, i));
+    } else {
+      assert(v && *v == i * 2);
+    }
+  }
+  int_map_add(map, 1, 42);
+  assert(*int_map_get(map, 1) == 42);
+  *int_map_get_mut(map, 1) = 43;
+  int k1 = 1;
+  const int *generic = avl_map_get(&map->base, &k1);
+  assert(*generic == 43);
+  int_map_drop(map);
+}
+
 int main() {
   test_map_del();
   test_map_new();
+  test_typed_map();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,226 @@
+// the threaded path runs from small inputs on, so the test exercises it
+#define GBC_THREADS
+#define GBC_NUMERIC_PAR_MIN 1000
+#include "../include/gbc_numeric.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const gbc_cpu_level_t levels[] = {GBC_CPU_SCALAR, GBC_CPU_AVX2};
+static const size_t threads[] = {1, 3, 8};
+
+// every length up to a few registers for the tails, then a threaded one
+static const size_t lengths[] = {0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17,
+                                 31, 33, 64, 100, 1000, 4099};
+
+void test_numeric_i32(void) {
+  for (int l = 0; l < 2; ++l) {
+    gbc_cpu_force_level(levels[l]);
+    for (int t = 0; t < 3; ++t) {
+      gbc_numeric_set_threads(threads[t]);
+      for (size_t s = 0; s < sizeof(lengths) / sizeof(lengths[0]); ++s) {
+        size_t n = lengths[s];
+        vec_t *x = vec_new(sizeof(int32_t));
+        vec_t *y = vec_new(sizeof(int32_t));
+        int64_t sum = 0, dot = 0;
+        int32_t min = INT32_MAX, max = INT32_MIN;
+        size_t min_idx = 0, max_idx = 0;
+        for (size_t i = 0; i < n; ++i) {
+          // big values, so the sums need 64 bits
+          int32_t a = (int32_t)(rand() % 2000001) - 1000000;
+          int32_t b = (int32_t)(rand() % 2001) - 1000;
+          if (i % 97 == 5) a = INT32_MAX - 1;
+          vec_push(x, &a);
+          vec_push(y, &b);
+          sum += a;
+          dot += (int64_t)a * b;
+          if (a < min) {
+            min = a;
+            min_idx = i;
+          }
+          if (a > max) {
+            max = a;
+            max_idx = i;
+          }
+        }
+        assert(vec_sum_i32(x) == sum);
+        assert(vec_dot_i32(x, y) == dot);
+        int32_t m;
+        size_t idx;
+        assert(vec_min_i32(x, &m, &idx) == (n > 0));
+        if (n > 0) assert(m == min && idx == min_idx);
+        assert(vec_max_i32(x, &m, &idx) == (n > 0));
+        if (n > 0) assert(m == max && idx == max_idx);
+
+        // y += 3x, then the prefix sum of y, both wrapping like uint32_t
+        uint32_t expected[4099];
+        uint32_t run = 0;
+        for (size_t i = 0; i < n; ++i) {
+          run += (uint32_t) * (int32_t *)vec_at(y, i) +
+                 3u * (uint32_t) * (int32_t *)vec_at(x, i);
+          expected[i] = run;
+        }
+        vec_axpy_i32(3, x, y);
+        vec_prefix_sum_i32(y);
+        for (size_t i = 0; i < n; ++i) {
+          assert((uint32_t) * (int32_t *)vec_at(y, i) == expected[i]);
+        }
+        vec_drop(x);
+        vec_drop(y);
+      }
+    }
+  }
+  gbc_numeric_set_threads(1);
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+}
+
+void test_numeric_i64(void) {
+  for (int l = 0; l < 2; ++l) {
+    gbc_cpu_force_level(levels[l]);
+    for (int t = 0; t < 3; ++t) {
+      gbc_numeric_set_threads(threads[t]);
+      vec_t *x = vec_new(sizeof(int64_t));
+      vec_t *y = vec_new(sizeof(int64_t));
+      for (size_t i = 0; i < 3001; ++i) {
+        // the products overflow and wrap around
+        int64_t a = ((int64_t)rand() << 20) - ((int64_t)1 << 40);
+        int64_t b = (int64_t)rand() * ((i % 2) ? 1 : -1);
+        vec_push(x, &a);
+        vec_push(y, &b);
+      }
+      int64_t lowest = INT64_MIN + 1;
+      vec_update(x, 1234, &lowest);
+      vec_update(x, 2345, &lowest);
+      uint64_t sum = 0, dot = 0;
+      for (size_t i = 0; i < 3001; ++i) {
+        uint64_t a = (uint64_t) * (int64_t *)vec_at(x, i);
+        uint64_t b = (uint64_t) * (int64_t *)vec_at(y, i);
+        sum += a;
+        dot += a * b;
+      }
+      assert((uint64_t)vec_sum_i64(x) == sum);
+      assert((uint64_t)vec_dot_i64(x, y) == dot);
+      int64_t m;
+      size_t idx;
+      assert(vec_min_i64(x, &m, &idx) && m == lowest && idx == 1234);
+      assert(vec_max_i64(y, &m, NULL) && m >= 0);
+
+      vec_t *c = vec_clone(x);
+      vec_axpy_i64(-7, y, c);
+      for (size_t i = 0; i < 3001; ++i) {
+        uint64_t e = (uint64_t) * (int64_t *)vec_at(x, i) +
+                     (uint64_t)-7 * (uint64_t) * (int64_t *)vec_at(y, i);
+        assert((uint64_t) * (int64_t *)vec_at(c, i) == e);
+      }
+      // the prefix sums of c give back its elements
+      vec_t *p = vec_clone(c);
+      vec_prefix_sum_i64(p);
+      uint64_t run = 0;
+      for (size_t i = 0; i < 3001; ++i) {
+        run += (uint64_t) * (int64_t *)vec_at(c, i);
+        assert((uint64_t) * (int64_t *)vec_at(p, i) == run);
+      }
+      vec_drop(p);
+      vec_drop(c);
+      vec_drop(x);
+      vec_drop(y);
+    }
+  }
+  gbc_numeric_set_threads(1);
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+}
+
+void test_numeric_floats(void) {
+  for (int l = 0; l < 2; ++l) {
+    gbc_cpu_force_level(levels[l]);
+    for (int t = 0; t < 3; ++t) {
+      gbc_numeric_set_threads(threads[t]);
+      for (size_t s = 0; s < sizeof(lengths) / sizeof(lengths[0]); ++s) {
+        size_t n = lengths[s];
+        vec_t *f = vec_new(sizeof(float));
+        vec_t *d = vec_new(sizeof(double));
+        // small integers keep every sum exact, whatever the order
+        double sum = 0, dot = 0;
+        for (size_t i = 0; i < n; ++i) {
+          float a = (float)(rand() % 201 - 100);
+          double b = (double)(rand() % 201 - 100);
+          vec_push(f, &a);
+          vec_push(d, &b);
+          sum += a;
+          dot += a * a;
+        }
+        assert(vec_sum_f32(f) == (float)sum);
+        assert(vec_dot_f32(f, f) == (float)dot);
+        float fm;
+        size_t idx;
+        if (n > 0) {
+          float lowest = -1000.0f;
+          vec_update(f, n / 2, &lowest);
+          assert(vec_min_f32(f, &fm, &idx) && fm == lowest && idx == n / 2);
+          double highest = 1e9;
+          vec_update(d, n - 1, &highest);
+          double dm;
+          assert(vec_max_f64(d, &dm, &idx) && dm == 1e9 && idx == n - 1);
+        } else {
+          assert(!vec_min_f32(f, &fm, &idx) && !vec_max_f64(d, NULL, NULL));
+        }
+
+        vec_t *c = vec_clone(d);
+        vec_axpy_f64(0.5, d, c);
+        vec_prefix_sum_f64(c);
+        double run = 0;
+        for (size_t i = 0; i < n; ++i) {
+          double x = *(double *)vec_at(d, i);
+          run += x + 0.5 * x;
+          assert(*(double *)vec_at(c, i) == run);
+        }
+        assert(vec_sum_f64(d) == (n ? run / 1.5 : 0));
+        vec_drop(c);
+        vec_drop(f);
+        vec_drop(d);
+      }
+    }
+  }
+  gbc_numeric_set_threads(1);
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+}
+
+// as many threads as allowed, on lengths that do not split evenly and some
+// too short to give every thread GBC_NUMERIC_PAR_MIN elements
+void test_numeric_chunks(void) {
+  static const size_t edges[] = {999, 1000, 1001, 1999, 2000, 4099,
+                                 63999, 64000, 64001, 100003};
+  gbc_numeric_set_threads(GBC_NUMERIC_MAX_THREADS);
+  for (size_t s = 0; s < sizeof(edges) / sizeof(edges[0]); ++s) {
+    size_t n = edges[s];
+    vec_t *x = vec_new(sizeof(int32_t));
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      // the smallest at the end, the largest at the start
+      int32_t a = (int32_t)(i % 1000) - 500;
+      if (i == 0) a = 1000;
+      if (i == n - 1) a = -1000;
+      vec_push(x, &a);
+      sum += a;
+    }
+    assert(vec_sum_i32(x) == sum);
+    int32_t m;
+    size_t idx;
+    assert(vec_min_i32(x, &m, &idx) && m == -1000 && idx == n - 1);
+    assert(vec_max_i32(x, &m, &idx) && m == 1000 && idx == 0);
+    vec_prefix_sum_i32(x);
+    assert(*(int32_t *)vec_at(x, n - 1) == (int32_t)sum);
+    vec_drop(x);
+  }
+  gbc_numeric_set_threads(1);
+}
+
+int main(void) {
+  srand(5);
+  test_numeric_i32();
+  test_numeric_i64();
+  test_numeric_floats();
+  test_numeric_chunks();
+  return 0;
+}
@@ -0,0 +1,395 @@
+#include "../include/gbc_roaring.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// the reference sets span four containers
+#define UNIVERSE (4u << 16)
+
+static bool ref_a[UNIVERSE], ref_b[UNIVERSE];
+
+// compare r with the reference through contains and the iterator
+static void check_same(const roaring_t *r, const bool *ref) {
+  uint64_t card = 0;
+  roaring_iter_t it;
+  roaring_iter_init(&it, r);
+  uint32_t prev = 0;
+  for (uint32_t x = 0; x < UNIVERSE; ++x) {
+    assert(roaring_contains(r, x) == ref[x]);
+    if (!ref[x]) continue;
+    card++;
+    assert(roaring_iter_has_next(&it));
+    uint32_t got = *(uint32_t *)roaring_iter_next(&it);
+    assert(got == x && (card == 1 || got > prev));
+    prev = got;
+  }
+  assert(!roaring_iter_has_next(&it) && roaring_iter_next(&it) == NULL);
+  roaring_iter_fini(&it);
+  assert(roaring_cardinality(r) == card);
+  assert(roaring_is_empty(r) == (card == 0));
+}
+
+// a sparse container, a dense one, one with long ranges and a mixed one
+static void fill(roaring_t *r, bool *ref, unsigned seed) {
+  srand(seed);
+  memset(ref, 0, UNIVERSE * sizeof(bool));
+  for (int i = 0; i < 1000; ++i) {
+    uint32_t x = (uint32_t)rand() % 65536;
+    assert(roaring_add(r, x) != ref[x]);
+    ref[x] = true;
+  }
+  for (int i = 0; i < 40000; ++i) {
+    uint32_t x = 65536 + (uint32_t)rand() % 65536;
+    assert(roaring_add(r, x) != ref[x]);
+    ref[x] = true;
+  }
+  for (uint32_t lo = 2 * 65536; lo < 3 * 65536; lo += 1000) {
+    uint32_t hi = lo + (uint32_t)rand() % 500;
+    assert(roaring_add_range(r, lo, hi));
+    for (uint32_t x = lo; x <= hi; ++x) ref[x] = true;
+  }
+  for (int i = 0; i < 5000; ++i) {
+    uint32_t x = 3 * 65536 + (uint32_t)rand() % 65536;
+    roaring_add(r, x);
+    ref[x] = true;
+  }
+}
+
+void test_roaring_add_del(void) {
+  roaring_t *r = roaring_new();
+  assert(roaring_is_empty(r) && !roaring_contains(r, 0));
+  fill(r, ref_a, 1);
+  check_same(r, ref_a);
+  assert(r->size == 4);
+  assert(r->cs[0].kind == ROARING_ARRAY);
+  assert(r->cs[1].kind == ROARING_BITMAP);
+
+  // deleting back under the array size turns the bitmap into an array
+  for (uint32_t x = 65536; x < 2 * 65536; ++x) {
+    if (ref_a[x] && x % 16 != 0) {
+      assert(roaring_del(r, x));
+      ref_a[x] = false;
+    }
+  }
+  assert(!roaring_del(r, 65536 + 1));
+  assert(r->cs[1].kind == ROARING_ARRAY);
+  check_same(r, ref_a);
+
+  // emptying a container removes it
+  for (uint32_t x = 0; x < 65536; ++x) {
+    assert(roaring_del(r, x) == ref_a[x]);
+    ref_a[x] = false;
+  }
+  assert(r->size == 3 && r->cs[0].key == 1);
+  check_same(r, ref_a);
+
+  // the extremes of uint32_t
+  assert(roaring_add(r, 0xffffffffu) && roaring_add(r, 0));
+  assert(roaring_contains(r, 0xffffffffu) && r->cs[0].key == 0);
+  assert(roaring_del(r, 0xffffffffu) && roaring_del(r, 0));
+  check_same(r, ref_a);
+  roaring_drop(r);
+}
+
+void test_roaring_runs(void) {
+  roaring_t *r = roaring_new();
+  memset(ref_a, 0, sizeof(ref_a));
+  // a whole container is a single run
+  assert(roaring_add_range(r, 65536 - 10, 3 * 65536 + 9));
+  for (uint32_t x = 65536 - 10; x <= 3 * 65536 + 9; ++x) ref_a[x] = true;
+  assert(r->size == 4 && r->cs[1].kind == ROARING_RUN && r->cs[1].n == 1);
+  assert(r->cs[1].card == 65536 && r->cs[3].card == 10);
+  check_same(r, ref_a);
+
+  // splitting and joining runs
+  for (uint32_t x = 65536 + 100; x < 65536 + 60000; x += 100) {
+    assert(roaring_del(r, x));
+    ref_a[x] = false;
+  }
+  assert(r->cs[1].kind == ROARING_RUN && r->cs[1].n == 600);
+  check_same(r, ref_a);
+  for (uint32_t x = 65536 + 100; x < 65536 + 30000; x += 100) {
+    assert(roaring_add(r, x) && !roaring_add(r, x));
+    ref_a[x] = true;
+  }
+  assert(r->cs[1].n == 301);
+  check_same(r, ref_a);
+
+  // too many runs turn into a bitmap
+  for (uint32_t x = 65536 + 30001; x < 65536 + 60000; x += 4) {
+    roaring_del(r, x);
+    ref_a[x] = false;
+  }
+  assert(r->cs[1].kind == ROARING_BITMAP);
+  check_same(r, ref_a);
+
+  roaring_drop(r);
+
+  // run_optimize picks the smallest kind of each container
+  r = roaring_new();
+  fill(r, ref_a, 2);
+  assert(r->cs[2].kind == ROARING_RUN);
+  assert(roaring_run_optimize(r));
+  assert(r->cs[0].kind == ROARING_ARRAY);
+  assert(r->cs[1].kind == ROARING_BITMAP);
+  assert(r->cs[2].kind == ROARING_RUN);
+  check_same(r, ref_a);
+  // values added one by one stay an array until then
+  roaring_t *seq = roaring_new();
+  for (uint32_t x = 0; x < 3000; ++x) roaring_add(seq, x);
+  size_t before = roaring_memory_usage(seq);
+  assert(seq->cs[0].kind == ROARING_ARRAY && roaring_run_optimize(seq));
+  assert(seq->cs[0].kind == ROARING_RUN && seq->cs[0].n == 1);
+  assert(roaring_memory_usage(seq) < before);
+  assert(roaring_contains(seq, 2999) && !roaring_contains(seq, 3000));
+  roaring_drop(seq);
+  // and back, once the runs are broken up
+  for (uint32_t x = 2 * 65536; x < 3 * 65536; x += 2) {
+    roaring_del(r, x);
+    ref_a[x] = false;
+  }
+  assert(roaring_run_optimize(r) && r->cs[2].kind != ROARING_RUN);
+  check_same(r, ref_a);
+
+  roaring_t *c = roaring_clone(r);
+  check_same(c, ref_a);
+  roaring_drop(c);
+  roaring_drop(r);
+}
+
+void test_roaring_run_edits(void) {
+  roaring_t *r = roaring_new();
+  roaring_add_range(r, 10, 20);
+  roaring_add_range(r, 30, 40);
+  assert(r->cs[0].kind == ROARING_RUN && r->cs[0].n == 2);
+  assert(roaring_add(r, 21) && roaring_add(r, 29) && roaring_add(r, 25));
+  roaring_run_t *runs = (roaring_run_t *)r->cs[0].data;
+  assert(r->cs[0].n == 3 && runs[0].len == 11 && runs[2].start == 29);
+  assert(roaring_del(r, 25) && r->cs[0].n == 2);
+  // filling the gap joins the two runs
+  assert(roaring_add_range(r, 22, 28) && r->cs[0].kind == ROARING_RUN);
+  runs = (roaring_run_t *)r->cs[0].data;
+  assert(r->cs[0].n == 1 && runs[0].start == 10 && runs[0].len == 30);
+  assert(roaring_cardinality(r) == 31);
+
+  // broken into single values the runs are bigger than an array
+  for (uint32_t x = 11; x <= 40; x += 2) roaring_del(r, x);
+  assert(r->cs[0].kind == ROARING_RUN && r->cs[0].n == 16);
+  assert(roaring_run_optimize(r) && r->cs[0].kind == ROARING_ARRAY);
+  assert(roaring_cardinality(r) == 16 && roaring_contains(r, 40));
+  assert(!roaring_contains(r, 39));
+
+  // a whole container, over an array
+  assert(roaring_add_range(r, 0, 65535));
+  assert(r->cs[0].kind == ROARING_RUN && r->cs[0].card == 65536);
+  assert(roaring_del(r, 0) && roaring_del(r, 65535) && roaring_del(r, 7));
+  assert(roaring_cardinality(r) == 65533 && r->cs[0].n == 2);
+  roaring_drop(r);
+}
+
+void test_roaring_set_ops(void) {
+  for (int optimize = 0; optimize < 2; ++optimize) {
+    roaring_t *a = roaring_new(), *b = roaring_new();
+    fill(a, ref_a, 3);
+    fill(b, ref_b, 4);
+    // b without its first container, and some dense ranges in a
+    for (uint32_t x = 0; x < 65536; ++x) {
+      if (ref_b[x]) roaring_del(b, x);
+      ref_b[x] = false;
+    }
+    roaring_add_range(a, 3 * 65536 + 100, 3 * 65536 + 40000);
+    for (uint32_t x = 3 * 65536 + 100; x <= 3 * 65536 + 40000; ++x) {
+      ref_a[x] = true;
+    }
+    if (optimize) {
+      roaring_run_optimize(a);
+      roaring_run_optimize(b);
+    }
+
+    static bool expected[UNIVERSE];
+    roaring_t *i = roaring_intersection(a, b);
+    roaring_t *u = roaring_union(a, b);
+    roaring_t *d = roaring_diff(a, b);
+    uint64_t both = 0;
+    for (uint32_t x = 0; x < UNIVERSE; ++x) {
+      expected[x] = ref_a[x] && ref_b[x];
+      both += expected[x];
+    }
+    check_same(i, expected);
+    assert(roaring_intersection_cardinality(a, b) == both);
+    assert(roaring_intersection_cardinality(b, a) == both);
+    for (uint32_t x = 0; x < UNIVERSE; ++x) expected[x] = ref_a[x] || ref_b[x];
+    check_same(u, expected);
+    for (uint32_t x = 0; x < UNIVERSE; ++x) expected[x] = ref_a[x] && !ref_b[x];
+    check_same(d, expected);
+
+    // with an empty set
+    roaring_t *e = roaring_new();
+    roaring_t *ie = roaring_intersection(a, e);
+    roaring_t *ue = roaring_union(e, a);
+    assert(roaring_is_empty(ie) && roaring_intersection_cardinality(e, a) == 0);
+    check_same(ue, ref_a);
+    roaring_drop(ie);
+    roaring_drop(ue);
+    roaring_drop(e);
+
+    roaring_drop(i);
+    roaring_drop(u);
+    roaring_drop(d);
+    roaring_drop(a);
+    roaring_drop(b);
+  }
+}
+
+// ranges every 50000 and 70000 values over 2^24, a few runs per container
+#define RANGE_END (1u << 24)
+static bool in_range_a(uint32_t x) { return x % 50000 < 30000; }
+static bool in_range_b(uint32_t x) {
+  return x >= 10000 && (x - 10000) % 70000 < 40000;
+}
+
+void test_roaring_range_ops(void) {
+  roaring_t *a = roaring_new(), *b = roaring_new();
+  for (uint32_t lo = 0; lo < RANGE_END; lo += 50000) {
+    uint32_t hi = lo + 29999;
+    assert(roaring_add_range(a, lo, hi < RANGE_END ? hi : RANGE_END - 1));
+  }
+  for (uint32_t lo = 10000; lo < RANGE_END; lo += 70000) {
+    uint32_t hi = lo + 39999;
+    assert(roaring_add_range(b, lo, hi < RANGE_END ? hi : RANGE_END - 1));
+  }
+  roaring_t *ops[3] = {roaring_intersection(a, b), roaring_union(a, b),
+                       roaring_diff(a, b)};
+  uint64_t card[3] = {0, 0, 0};
+  for (uint32_t x = 0; x < RANGE_END; ++x) {
+    bool in_a = in_range_a(x), in_b = in_range_b(x);
+    card[0] += in_a && in_b;
+    card[1] += in_a || in_b;
+    card[2] += in_a && !in_b;
+    if (x % 7) continue;
+    assert(roaring_contains(ops[0], x) == (in_a && in_b));
+    assert(roaring_contains(ops[1], x) == (in_a || in_b));
+    assert(roaring_contains(ops[2], x) == (in_a && !in_b));
+  }
+  assert(roaring_intersection_cardinality(a, b) == card[0]);
+  for (int k = 0; k < 3; ++k) {
+    roaring_t *r = ops[k];
+    assert(roaring_cardinality(r) == card[k]);
+    // the results stay runs, not a bitmap per container
+    for (size_t i = 0; i < r->size; ++i) {
+      assert(r->cs[i].kind == ROARING_RUN && r->cs[i].n == r->cs[i].cap);
+    }
+    assert(roaring_serialized_size(r) < 16 * 1024);
+    roaring_drop(r);
+  }
+
+  // a full container or-ed into a bitmap is one run
+  roaring_t *full = roaring_new(), *dense = roaring_new();
+  roaring_add_range(full, 0, 65535);
+  for (uint32_t x = 0; x < 65536; x += 3) roaring_add(dense, x);
+  assert(dense->cs[0].kind == ROARING_BITMAP);
+  assert(roaring_intersection_cardinality(dense, full) == 21846);
+  roaring_t *u = roaring_union(dense, full);
+  assert(u->cs[0].kind == ROARING_RUN && u->cs[0].card == 65536);
+  roaring_drop(u);
+  roaring_drop(full);
+  roaring_drop(dense);
+  roaring_drop(a);
+  roaring_drop(b);
+}
+
+void test_roaring_iter_batch(void) {
+  roaring_t *r = roaring_new();
+  fill(r, ref_a, 5);
+  roaring_run_optimize(r);
+  roaring_iter_t *it = roaring_iter_new(r);
+  iter_batch_t batch;
+  uint32_t x = 0;
+  size_t n, total = 0;
+  // odd batch sizes cross the container ends
+  while ((n = iter_next_batch((iter_t *)it, &batch, 77)) > 0) {
+    assert(n <= 77 && batch.span);
+    for (size_t k = 0; k < n; ++k) {
+      uint32_t v = *(uint32_t *)iter_batch_at(&batch, k, sizeof(uint32_t));
+      while (!ref_a[x]) x++;
+      assert(v == x++);
+    }
+    total += n;
+  }
+  assert(total == roaring_cardinality(r));
+  roaring_iter_drop(it);
+  roaring_drop(r);
+}
+
+void test_roaring_serialize(void) {
+  roaring_t *r = roaring_new();
+  fill(r, ref_a, 6);
+  roaring_run_optimize(r);
+  size_t len = roaring_serialized_size(r);
+  char *buf = (char *)malloc(len);
+  assert(roaring_serialize(r, buf) == len);
+  roaring_t *back = roaring_deserialize(buf, len);
+  assert(back && back->size == r->size);
+  for (size_t i = 0; i < r->size; ++i) {
+    assert(back->cs[i].kind == r->cs[i].kind);
+  }
+  check_same(back, ref_a);
+  roaring_drop(back);
+
+  // a flipped byte anywhere, or a short buffer, is rejected
+  for (size_t off = 0; off < len; off += len / 97 + 1) {
+    buf[off] ^= 0x10;
+    assert(roaring_deserialize(buf, len) == NULL);
+    buf[off] ^= 0x10;
+  }
+  assert(roaring_deserialize(buf, len - 1) == NULL);
+  assert(roaring_deserialize(buf, 10) == NULL);
+
+  char path[] = "/tmp/gbc_roaring_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+  assert(roaring_save(r, path));
+  roaring_t *loaded = roaring_load(path);
+  assert(loaded);
+  check_same(loaded, ref_a);
+  roaring_drop(loaded);
+  remove(path);
+  assert(roaring_load(path) == NULL);
+
+  // an empty set
+  roaring_t *e = roaring_new();
+  assert(roaring_serialize(e, buf) == sizeof(roaring_file_header_t));
+  roaring_t *e2 = roaring_deserialize(buf, sizeof(roaring_file_header_t));
+  assert(e2 && roaring_is_empty(e2));
+  roaring_drop(e2);
+  roaring_drop(e);
+  free(buf);
+  roaring_drop(r);
+}
+
+void test_roaring_arena(void) {
+  gbc_arena_t arena;
+  gbc_arena_init(&arena, 1 << 16);
+  roaring_t *r = roaring_new_ex(gbc_arena_allocator(&arena));
+  fill(r, ref_a, 7);
+  roaring_t *u = roaring_union(r, r);
+  check_same(u, ref_a);
+  roaring_drop(u);
+  roaring_drop(r);
+  gbc_arena_fini(&arena);
+}
+
+int main(void) {
+  test_roaring_add_del();
+  test_roaring_runs();
+  test_roaring_run_edits();
+  test_roaring_set_ops();
+  test_roaring_range_ops();
+  test_roaring_iter_batch();
+  test_roaring_serialize();
+  test_roaring_arena();
+  return 0;
+}
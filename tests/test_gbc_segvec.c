@@ -0,0 +1,79 @@
+#include "../include/gbc_segvec.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static long long foreach_sum;
+
+void sum_fn(const void *p) { foreach_sum += *(const long long *)p; }
+
+void test_segvec_push_at(void) {
+  segvec_t *v = segvec_new(sizeof(long long));
+  assert(segvec_length(v) == 0 && segvec_top(v) == NULL);
+  size_t n = 100000;
+  const long long *first = NULL;
+  const long long *at_1000 = NULL;
+  for (size_t i = 0; i < n; ++i) {
+    long long val = (long long)i;
+    assert(segvec_push(v, &val));
+    if (i == 0) first = segvec_at(v, 0);
+    if (i == 1000) at_1000 = segvec_at(v, 1000);
+  }
+  // growing never moved the elements
+  assert(first == segvec_at(v, 0) && *first == 0);
+  assert(at_1000 == segvec_at(v, 1000) && *at_1000 == 1000);
+  assert(segvec_length(v) == n && segvec_capacity(v) >= n);
+  for (size_t i = 0; i < n; ++i) {
+    assert(*(const long long *)segvec_at(v, i) == (long long)i);
+  }
+  // chunk boundaries: 8, 8 + 16, 8 + 16 + 32
+  assert(*(const long long *)segvec_at(v, 7) == 7);
+  assert(*(const long long *)segvec_at(v, 8) == 8);
+  assert(*(const long long *)segvec_at(v, 23) == 23);
+  assert(*(const long long *)segvec_at(v, 24) == 24);
+
+  long long x = -1;
+  assert(segvec_update(v, 5, &x) && *(long long *)segvec_at_mut(v, 5) == -1);
+  assert(!segvec_update(v, n, &x));
+  assert(*(const long long *)segvec_top(v) == (long long)n - 1);
+  assert(segvec_del_top(v) && segvec_length(v) == n - 1);
+  segvec_drop(v);
+}
+
+void test_segvec_iter_foreach(void) {
+  segvec_t *v = segvec_new(sizeof(long long));
+  assert(segvec_reserve(v, 1000) && segvec_capacity(v) >= 1000);
+  size_t cap = segvec_capacity(v);
+  long long expected = 0;
+  for (long long i = 0; i < 1000; ++i) {
+    segvec_push(v, &i);
+    expected += i;
+  }
+  assert(segvec_capacity(v) == cap);
+  foreach_sum = 0;
+  segvec_foreach(v, sum_fn);
+  assert(foreach_sum == expected);
+
+  segvec_iter_t *iter = segvec_iter_new(v);
+  long long i = 0;
+  while (segvec_iter_has_next(iter)) {
+    assert(*(long long *)segvec_iter_next(iter) == i++);
+  }
+  assert(i == 1000 && segvec_iter_next(iter) == NULL);
+  segvec_iter_drop(iter);
+
+  while (segvec_del_top(v)) {
+  }
+  assert(segvec_length(v) == 0);
+  foreach_sum = 0;
+  segvec_foreach(v, sum_fn);
+  assert(foreach_sum == 0);
+  segvec_drop(v);
+}
+
+int main(void) {
+  test_segvec_push_at();
+  test_segvec_iter_foreach();
+  return 0;
+}
@@ -0,0 +1,112 @@
+#define GBC_STATS
+#include "../include/gbc_avl.h"
+#include "../include/gbc_cdq.h"
+#include "../include/gbc_deque.h"
+#include "../include/gbc_vector.h"
+
+int int_cmp(const void *a, const void *b) {
+  const int *_a = (int *)a;
+  const int *_b = (int *)b;
+  if (*_a == *_b)
+    return 0;
+  else if (*_a < *_b)
+    return -1;
+  else
+    return 1;
+}
+
+GBC_AVL_DECLARE(int_map, int, int, GBC_AVL_CMP_NUM)
+
+void test_stats_vector(void) {
+  vec_t *v = vec_new_with_cap(sizeof(int), 4);
+  for (int i = 0; i < 16; ++i) vec_push(v, &i);
+  gbc_stats_t st;
+  assert(vec_stats(v, &st));
+  assert(st.grows == 2 && st.allocs == 4);
+  assert(st.bytes == sizeof(vec_t) + 16 * sizeof(int));
+  assert(st.peak_bytes == st.bytes);
+  vec_drop(v);
+
+  vdq_t *q = vdq_new_with_cap(sizeof(int), 4);
+  for (int i = 0; i < 8; ++i) vdq_push_front(q, &i);
+  assert(vdq_stats(q, &st));
+  assert(st.grows == 1 && st.bytes == sizeof(vdq_t) + 8 * sizeof(int));
+  vdq_drop(q);
+}
+
+void test_stats_cmp_calls(void) {
+  gbc_stats_t st;
+  vec_t *v = vec_new(sizeof(int));
+  for (int i = 15; i >= 0; --i) vec_push(v, &i);
+  assert(vec_sort(v, int_cmp) && vec_stats(v, &st) && st.cmp_calls > 0);
+  size_t before = st.cmp_calls;
+  // a linear scan up to the match, then one comparison per later element
+  int target = 5;
+  assert(vec_del(v, &target, int_cmp));
+  assert(vec_stats(v, &st) && st.cmp_calls == before + 6);
+  assert(vec_dedup(v, int_cmp) == 0);
+  assert(vec_stats(v, &st) && st.cmp_calls == before + 6 + 14);
+  vec_drop(v);
+
+  vdq_t *q = vdq_new_with_cap(sizeof(int), 4);
+  for (int i = 15; i >= 0; --i) vdq_push_front(q, &i);
+  assert(vdq_del(q, &target, int_cmp));
+  assert(vdq_stats(q, &st) && st.cmp_calls == 6);
+  assert(vdq_dedup(q, int_cmp) == 0);
+  assert(vdq_stats(q, &st) && st.cmp_calls == 6 + 14);
+  assert(vdq_sort(q, int_cmp) && vdq_stats(q, &st) && st.cmp_calls > 20);
+  vdq_drop(q);
+
+  cdq_t *c = cdq_new(sizeof(int));
+  for (int i = 15; i >= 0; --i) cdq_push_back(c, &i);
+  assert(cdq_del(c, &target, int_cmp));
+  assert(cdq_stats(c, &st) && st.cmp_calls == 11);
+  assert(cdq_sort(c, int_cmp) && cdq_stats(c, &st) && st.cmp_calls > 11);
+  cdq_drop(c);
+}
+
+void test_stats_map(void) {
+  avl_map_t *map = avl_map_new(sizeof(int), sizeof(int), int_cmp);
+  size_t n = 1024;
+  for (size_t i = 0; i < n; ++i) {
+    int key = (int)i;
+    avl_map_add(map, &key, &key);
+  }
+  gbc_stats_t st;
+  assert(avl_map_stats(map, &st));
+  // sequential keys rotate on nearly every insertion
+  assert(st.rotations > 0 && st.cmp_calls > 0);
+  assert(st.max_depth >= 11 && st.max_depth <= 15);
+  assert(st.allocs == 1 + 3 * n);
+  size_t cmp_before = st.cmp_calls;
+  int k = 5;
+  avl_map_contains(map, &k);
+  avl_map_stats(map, &st);
+  assert(st.cmp_calls > cmp_before);
+  for (size_t i = 0; i < n; ++i) {
+    int key = (int)i;
+    avl_map_del(map, &key);
+  }
+  avl_map_stats(map, &st);
+  assert(st.bytes == sizeof(avl_map_t) && st.frees == 3 * n);
+  free(map);
+
+  int_map_t *typed = int_map_new();
+  for (size_t i = 0; i < n; ++i) int_map_add(typed, (int)i, (int)i);
+  avl_map_stats(&typed->base, &st);
+  assert(st.bytes == sizeof(int_map_t) + n * sizeof(int_map_node_t));
+  assert(st.max_depth <= 15 && st.rotations > 0);
+  // the subtree drop behind int_map_drop counts its frees like avl_map_t
+  int_map_drop_subtree(typed, typed->base.root);
+  avl_map_stats(&typed->base, &st);
+  assert(st.bytes == sizeof(int_map_t) && st.frees == n);
+  typed->base.root = NULL;
+  int_map_drop(typed);
+}
+
+int main() {
+  test_stats_vector();
+  test_stats_cmp_calls();
+  test_stats_map();
+  return 0;
+}
@@ -102,11 +102,81 @@ void test_vector_sort(void) {
   // vec_foreach(int_v, print_int);
 }
 
+typedef struct _int_bag {
+  int id;
+  vec_t items;
+  int storage[4];
+} int_bag_t;
+
+void test_vector_inline(void) {
+  VEC_INLINE_DECL(v, int, 4);
+  for (int i = 0; i < 4; ++i) vec_push(&v, &i);
+  assert(vec_is_inline(&v) && v.cap == 4 && v.buf == (char *)v_inline_buf);
+  int i4 = 4;
+  vec_push(&v, &i4);
+  assert(!vec_is_inline(&v) && v.size == 5);
+  for (int i = 0; i < 5; ++i) assert(*(int *)vec_at(&v, i) == i);
+  vec_fini(&v);
+
+  int_bag_t bag;
+  vec_init_inline(&bag.items, sizeof(int), bag.storage, 4);
+  int i7 = 7;
+  vec_push(&bag.items, &i7);
+  assert(vec_is_inline(&bag.items) && bag.storage[0] == 7);
+  vec_fini(&bag.items);
+
+  vec_t lazy;
+  vec_init(&lazy, sizeof(int));
+  assert(lazy.cap == 0 && !lazy.buf);
+  for (int i = 0; i < 20; ++i) vec_push(&lazy, &i);
+  assert(lazy.size == 20 && *(int *)vec_top(&lazy) == 19);
+  vec_fini(&lazy);
+}
+
+static bool is_odd(const void *x, void *ctx) {
+  (void)ctx;
+  return *(const int *)x % 2;
+}
+
+void test_vector_bulk_delete(void) {
+  vec_t *v = vec_new(sizeof(int));
+  for (int i = 0; i < 100; ++i) vec_push(v, &i);
+  int minus = -1;
+  // the tail moves by whole elements
+  vec_insert(v, 50, &minus);
+  assert(*(int *)vec_at(v, 50) == -1 && *(int *)vec_at(v, 100) == 99);
+  assert(vec_del_at(v, 50));
+
+  assert(vec_retain(v, is_odd, NULL) == 50 && v->size == 50);
+  for (int i = 0; i < 50; ++i) assert(*(int *)vec_at(v, i) == 2 * i + 1);
+  assert(vec_drain(v, 10, 40) && v->size == 20);
+  assert(*(int *)vec_at(v, 9) == 19 && *(int *)vec_at(v, 10) == 81);
+  assert(vec_drain(v, 5, 5) && v->size == 20);
+  assert(vec_swap_remove(v, 0) && v->size == 19);
+  assert(*(int *)vec_at(v, 0) == 99 && *(int *)vec_top(v) == 97);
+  assert(vec_swap_remove(v, 18) && *(int *)vec_top(v) == 95);
+  vec_truncate(v, 30);
+  assert(v->size == 18);
+  vec_truncate(v, 3);
+  assert(v->size == 3 && *(int *)vec_top(v) == 5);
+
+  vec_t *d = vec_new(sizeof(int));
+  int xs[] = {1, 1, 2, 3, 3, 3, 4, 5, 5};
+  for (int i = 0; i < 9; ++i) vec_push(d, &xs[i]);
+  assert(vec_dedup(d, int_cmp) == 4 && d->size == 5);
+  for (int i = 0; i < 5; ++i) assert(*(int *)vec_at(d, i) == i + 1);
+  assert(vec_dedup(d, int_cmp) == 0);
+  vec_drop(d);
+  vec_drop(v);
+}
+
 int main() {
   test_vector_new();
   test_vector_del();
   test_vector_reverse();
   test_vector_push();
   test_vector_sort();
+  test_vector_inline();
+  test_vector_bulk_delete();
   return 0;
 }
\ No newline at end of file
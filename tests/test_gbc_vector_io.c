@@ -0,0 +1,104 @@
+#include "../include/gbc_vector_io.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct _record {
+  long long id;
+  double score;
+} record_t;
+
+void test_vec_save_load(void) {
+  char path[] = "/tmp/gbc_vec_io_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  vec_t *v = vec_new(sizeof(record_t));
+  for (int i = 0; i < 1000; ++i) {
+    record_t r = {i, i * 0.5};
+    vec_push(v, &r);
+  }
+  assert(vec_save(v, path));
+
+  vec_t *loaded = vec_load(path);
+  assert(loaded && loaded->size == 1000);
+  assert(loaded->obj_size == sizeof(record_t));
+  assert(memcmp(loaded->buf, v->buf, 1000 * sizeof(record_t)) == 0);
+  vec_drop(loaded);
+
+  vec_t *mapped = vec_mmap_open(path, true);
+  assert(mapped && vec_is_mapped(mapped) && !vec_is_mapped(v));
+  assert(mapped->size == 1000 && vec_mmap_verify(mapped));
+  for (int i = 0; i < 1000; ++i) {
+    const record_t *r = (const record_t *)vec_at(mapped, i);
+    assert(r->id == i && r->score == i * 0.5);
+  }
+  // private pages: the change never reaches the file
+  record_t changed = {-1, -1.0};
+  vec_update(mapped, 0, &changed);
+  assert(!vec_push(mapped, &changed));
+  assert(!vec_mmap_sync(mapped));
+  vec_t *copy = vec_clone(mapped);
+  assert(copy && ((record_t *)vec_at(copy, 0))->id == -1);
+  vec_drop(copy);
+  vec_drop(mapped);
+
+  loaded = vec_load(path);
+  assert(((const record_t *)vec_at(loaded, 0))->id == 0);
+  vec_drop(loaded);
+
+  // a flipped byte is caught by the checksum
+  FILE *f = fopen(path, "r+b");
+  fseek(f, sizeof(vec_file_header_t) + 3, SEEK_SET);
+  fputc(0x7f, f);
+  fclose(f);
+  assert(vec_load(path) == NULL);
+  mapped = vec_mmap_open(path, true);
+  assert(mapped && !vec_mmap_verify(mapped));
+  vec_drop(mapped);
+
+  vec_drop(v);
+  unlink(path);
+}
+
+void test_vec_mmap_writable(void) {
+  char path[] = "/tmp/gbc_vec_io_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  vec_t *v = vec_mmap_create(path, sizeof(long long), 4);
+  assert(v && v->size == 0 && v->cap == 4);
+  // grows the file and the mapping well past the initial capacity
+  for (long long i = 0; i < 100000; ++i) assert(vec_push(v, &i));
+  assert(v->cap >= 100000 && vec_is_mapped(v));
+  assert(vec_mmap_sync(v) && vec_mmap_verify(v));
+  vec_del_top(v);
+  assert(!vec_mmap_verify(v));
+  vec_drop(v);
+
+  // the size survives the vector, the stale checksum is not trusted
+  v = vec_mmap_open(path, false);
+  assert(v && v->size == 99999 && !vec_mmap_verify(v));
+  for (long long i = 0; i < 99999; ++i)
+    assert(*(const long long *)vec_at(v, i) == i);
+  long long x = 123;
+  assert(vec_push(v, &x) && vec_mmap_sync(v));
+  vec_drop(v);
+
+  vec_t *loaded = vec_load(path);
+  assert(loaded && loaded->size == 100000);
+  assert(*(const long long *)vec_top(loaded) == 123);
+  vec_drop(loaded);
+
+  assert(vec_mmap_open("/nonexistent/gbc_vec_io", true) == NULL);
+  unlink(path);
+}
+
+int main(void) {
+  test_vec_save_load();
+  test_vec_mmap_writable();
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "../include/gbc_vector_simd.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// every level up to the detected one, the scalar fallback included
+static const gbc_cpu_level_t levels[] = {GBC_CPU_SCALAR, GBC_CPU_SSE2,
+                                         GBC_CPU_AVX2};
+
+void test_simd_u32(void) {
+  for (int l = 0; l < 3; ++l) {
+    gbc_cpu_force_level(levels[l]);
+    // lengths around the register widths exercise the scalar tails
+    for (size_t n = 0; n < 70; n += 3) {
+      vec_t *v = vec_new(sizeof(uint32_t));
+      size_t expected_count = 0, first = n;
+      for (size_t i = 0; i < n; ++i) {
+        uint32_t x = (uint32_t)(rand() % 4);
+        vec_push(v, &x);
+        if (x == 2) {
+          expected_count++;
+          if (first == n) first = i;
+        }
+      }
+      size_t idx = (size_t)-1;
+      assert(vec_find_u32(v, 2, &idx) == (first < n));
+      if (first < n) assert(idx == first);
+      assert(!vec_find_u32(v, 7, NULL));
+      assert(vec_count_eq_u32(v, 2) == expected_count);
+
+      vec_t *keep = vec_new(sizeof(uint32_t));
+      for (size_t i = 0; i < n; ++i) {
+        const uint32_t *x = vec_at(v, i);
+        if (*x != 2) vec_push(keep, x);
+      }
+      assert(vec_remove_all_eq_u32(v, 2) == expected_count);
+      assert(v->size == keep->size);
+      assert(memcmp(v->buf, keep->buf, v->size * sizeof(uint32_t)) == 0);
+      assert(vec_count_eq_u32(v, 2) == 0);
+      vec_drop(keep);
+      vec_drop(v);
+    }
+  }
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+}
+
+void test_simd_u64_floats(void) {
+  for (int l = 0; l < 3; ++l) {
+    gbc_cpu_force_level(levels[l]);
+    vec_t *u = vec_new(sizeof(uint64_t));
+    vec_t *f = vec_new(sizeof(float));
+    vec_t *d = vec_new(sizeof(double));
+    for (size_t i = 0; i < 1001; ++i) {
+      // the low halves of the 64 bit keys collide, only the high ones differ
+      uint64_t x = (i % 10 == 3 ? 5ull : 6ull) << 32 | 42;
+      float fx = (i % 10 == 3) ? -0.0f : (float)i;
+      double dx = (i % 100 == 7) ? NAN : (i % 10 == 3 ? 2.5 : (double)i);
+      vec_push(u, &x);
+      vec_push(f, &fx);
+      vec_push(d, &dx);
+    }
+    size_t idx;
+    assert(vec_find_u64(u, 5ull << 32 | 42, &idx) && idx == 3);
+    assert(!vec_find_u64(u, 42, NULL));
+    assert(vec_count_eq_u64(u, 5ull << 32 | 42) == 100);
+    assert(vec_remove_all_eq_u64(u, 6ull << 32 | 42) == 901);
+    assert(u->size == 100);
+
+    // 0.0 matches -0.0 and NaN matches nothing
+    assert(vec_find_f32(f, 0.0f, &idx) && idx == 0);
+    assert(vec_count_eq_f32(f, 0.0f) == 101);
+    assert(vec_remove_all_eq_f32(f, 0.0f) == 101 && f->size == 900);
+    assert(*(const float *)vec_at(f, 0) == 1.0f);
+    assert(vec_count_eq_f64(d, NAN) == 0 && !vec_find_f64(d, NAN, NULL));
+    assert(vec_find_f64(d, 2.5, &idx) && idx == 3);
+    assert(vec_remove_all_eq_f64(d, 2.5) == 100 && d->size == 901);
+    vec_drop(u);
+    vec_drop(f);
+    vec_drop(d);
+  }
+  gbc_cpu_force_level(GBC_CPU_AVX2);
+}
+
+int main(void) {
+  srand(3);
+  test_simd_u32();
+  test_simd_u64_floats();
+  return 0;
+}